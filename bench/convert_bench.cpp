@@ -0,0 +1,83 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "../vendor/dr_wav.h"
+
+#include "sample_convert.h"
+
+static constexpr size_t SAMPLES = 1 << 22;
+static constexpr int RUNS = 7;
+
+/* best of RUNS, in millions of samples per second */
+static double throughput(const std::function<void()> &fn) {
+    double best = 1e30;
+
+    for (int run = 0; run < RUNS; run++) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const auto end = std::chrono::steady_clock::now();
+
+        best = std::min(best, std::chrono::duration<double>(end - start).count());
+    }
+
+    return SAMPLES / best / 1e6;
+}
+
+static void report(const char *name, double ours, double reference) {
+    std::printf("%-22s %10.1f %10.1f %8.2fx\n", name, ours, reference, ours / reference);
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<uint8_t> s16(SAMPLES * 2), s24(SAMPLES * 3), s32(SAMPLES * 4);
+    for (auto &b : s16) b = static_cast<uint8_t>(byte(rng));
+    for (auto &b : s24) b = static_cast<uint8_t>(byte(rng));
+    for (auto &b : s32) b = static_cast<uint8_t>(byte(rng));
+
+    std::vector<float> f32(SAMPLES);
+    for (float &v : f32) v = unit(rng);
+
+    std::vector<float> out_f32(SAMPLES);
+    std::vector<int16_t> out_s16(SAMPLES);
+    dither_state dither;
+
+    std::printf("backend: %s, %zu samples, best of %d\n\n", convert_backend(), SAMPLES, RUNS);
+    std::printf("%-22s %10s %10s %9s\n", "conversion", "Ms/s", "dr_wav", "speedup");
+
+    report("s16 -> f32",
+        throughput([&] { convert_to_f32(s16.data(), sample_format::s16, out_f32.data(), SAMPLES); }),
+        throughput([&] { drwav_s16_to_f32(out_f32.data(), reinterpret_cast<const drwav_int16 *>(s16.data()), SAMPLES); }));
+
+    report("s24 -> f32",
+        throughput([&] { convert_to_f32(s24.data(), sample_format::s24, out_f32.data(), SAMPLES); }),
+        throughput([&] { drwav_s24_to_f32(out_f32.data(), s24.data(), SAMPLES); }));
+
+    report("s32 -> f32",
+        throughput([&] { convert_to_f32(s32.data(), sample_format::s32, out_f32.data(), SAMPLES); }),
+        throughput([&] { drwav_s32_to_f32(out_f32.data(), reinterpret_cast<const drwav_int32 *>(s32.data()), SAMPLES); }));
+
+    report("s24 -> s16",
+        throughput([&] { convert_to_s16(s24.data(), sample_format::s24, out_s16.data(), SAMPLES, nullptr); }),
+        throughput([&] { drwav_s24_to_s16(out_s16.data(), s24.data(), SAMPLES); }));
+
+    report("s32 -> s16",
+        throughput([&] { convert_to_s16(s32.data(), sample_format::s32, out_s16.data(), SAMPLES, nullptr); }),
+        throughput([&] { drwav_s32_to_s16(out_s16.data(), reinterpret_cast<const drwav_int32 *>(s32.data()), SAMPLES); }));
+
+    report("f32 -> s16",
+        throughput([&] { convert_to_s16(f32.data(), sample_format::f32, out_s16.data(), SAMPLES, nullptr); }),
+        throughput([&] { drwav_f32_to_s16(out_s16.data(), f32.data(), SAMPLES); }));
+
+    report("f32 -> s16 (tpdf)",
+        throughput([&] { convert_to_s16(f32.data(), sample_format::f32, out_s16.data(), SAMPLES, &dither); }),
+        throughput([&] { drwav_f32_to_s16(out_s16.data(), f32.data(), SAMPLES); }));
+
+    return 0;
+}
@@ -0,0 +1,815 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "imgui.h"
+
+#include "audio_engine.h"
+#include "library_db.h"
+#include "library_index.h"
+#include "pcm_cache.h"
+#include "peak_cache.h"
+#include "player_ui.h"
+#include "profiler.h"
+#include "resampler.h"
+#include "sample_convert.h"
+#include "search_index.h"
+#include "track_stream.h"
+
+/* headless regression suite. everything runs against a generated library in a temp directory,
+   audio goes through an ALC_SOFT_loopback device and the ui frame is built without a window,
+   so it needs neither a sound card nor a display. results are written as json */
+
+namespace fs = std::filesystem;
+using bench_clock = std::chrono::steady_clock;
+
+static constexpr unsigned int SAMPLE_RATE = 44100;
+static constexpr unsigned int LOOPBACK_RATE = 48000;
+static constexpr size_t RENDER_FRAMES = 128;
+static constexpr int DECODE_RUNS = 3;
+static constexpr int LATENCY_RUNS = 8;
+static constexpr int REPLAY_RUNS = 8;
+static constexpr int SEEK_RUNS = 50;
+static constexpr int UI_WARMUP_FRAMES = 30;
+static constexpr int UI_FRAMES = 300;
+static constexpr double LATENCY_TIMEOUT = 2.0;
+
+struct bench_options {
+    std::string json_path;
+    std::string trace_path;
+    int scan_tracks = 5000;
+    int bulk_tracks = 2000;
+    int decode_seconds = 60;
+    bool keep = false;
+};
+
+struct wav_format {
+    const char *name;
+    drwav_uint16 tag;
+    drwav_uint16 bits;
+};
+
+static const wav_format WAV_FORMATS[] = {
+    { "u8", DR_WAVE_FORMAT_PCM, 8 },
+    { "s16", DR_WAVE_FORMAT_PCM, 16 },
+    { "s24", DR_WAVE_FORMAT_PCM, 24 },
+    { "s32", DR_WAVE_FORMAT_PCM, 32 },
+    { "f32", DR_WAVE_FORMAT_IEEE_FLOAT, 32 },
+};
+
+/* keeps the decode loops from being optimized away */
+static volatile uint64_t checksum_sink;
+
+static double elapsed_ms(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+/* minimal streaming json, commas are tracked per nesting level */
+class json_writer {
+    private:
+        std::ostringstream _out;
+        std::vector<bool> _first;
+
+        void separate() {
+            if (_first.empty()) return;
+            if (!_first.back()) _out << ",";
+            _first.back() = false;
+        }
+
+    public:
+        json_writer() { _out.precision(6); }
+
+        void begin_object(const char *key = nullptr) { if (key) this->key(key); else separate(); _out << "{"; _first.push_back(true); }
+        void end_object() { _out << "}"; _first.pop_back(); }
+        void begin_array(const char *key) { this->key(key); _out << "["; _first.push_back(true); }
+        void end_array() { _out << "]"; _first.pop_back(); }
+
+        void key(const char *name) { separate(); _out << "\"" << name << "\":"; }
+        void value(const char *name, double number) { key(name); _out << (std::isfinite(number) ? number : -1.0); }
+        void value(const char *name, const std::string &text) { key(name); _out << "\"" << text << "\""; }
+
+        std::string str() const { return _out.str() + "\n"; }
+};
+
+struct summary {
+    double mean = 0, p50 = 0, p99 = 0, max = 0;
+};
+
+static summary summarize(std::vector<double> samples) {
+    summary result;
+    if (samples.empty()) return result;
+
+    std::sort(samples.begin(), samples.end());
+
+    for (double sample : samples) result.mean += sample;
+    result.mean /= samples.size();
+    result.p50 = samples[samples.size() / 2];
+    result.p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    result.max = samples.back();
+    return result;
+}
+
+static void write_summary(json_writer &json, const char *key, const summary &s) {
+    json.begin_object(key);
+    json.value("mean", s.mean);
+    json.value("p50", s.p50);
+    json.value("p99", s.p99);
+    json.value("max", s.max);
+    json.end_object();
+}
+
+/* frames of interleaved float in [-1, 1], encoded as the given wav format */
+static bool write_wav(const std::string &path, const wav_format &format, unsigned int channels, const std::vector<float> &samples) {
+    drwav_data_format data_format;
+    data_format.container = drwav_container_riff;
+    data_format.format = format.tag;
+    data_format.channels = channels;
+    data_format.sampleRate = SAMPLE_RATE;
+    data_format.bitsPerSample = format.bits;
+
+    const size_t bytes_per_sample = format.bits / 8;
+    std::vector<uint8_t> encoded(samples.size() * bytes_per_sample);
+
+    for (size_t i = 0; i < samples.size(); i++) {
+        const float x = std::clamp(samples[i], -1.0f, 1.0f);
+        uint8_t *out = encoded.data() + i * bytes_per_sample;
+
+        if (format.tag == DR_WAVE_FORMAT_IEEE_FLOAT) {
+            std::memcpy(out, &x, sizeof(float));
+        } else if (format.bits == 8) {
+            out[0] = static_cast<uint8_t>(std::lround(x * 127.0f) + 128);
+        } else {
+            const int32_t value = static_cast<int32_t>(std::lround(static_cast<double>(x) * 2147483647.0));
+            for (size_t b = 0; b < bytes_per_sample; b++) out[b] = static_cast<uint8_t>(value >> (32 - 8 * (bytes_per_sample - b)));
+        }
+    }
+
+    drwav wav;
+    if (!drwav_init_file_write(&wav, path.c_str(), &data_format, NULL)) return false;
+
+    const drwav_uint64 frames = samples.size() / channels;
+    const bool ok = drwav_write_pcm_frames(&wav, frames, encoded.data()) == frames;
+    drwav_uninit(&wav);
+    return ok;
+}
+
+static std::vector<float> noise(size_t frames, unsigned int channels, float level, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(-level, level);
+
+    std::vector<float> samples(frames * channels);
+    for (float &sample : samples) sample = unit(rng);
+    return samples;
+}
+
+/* the library: artist/album/track folders plus one flat folder of bulk_tracks tracks */
+static bool generate_library(const std::string &root, const bench_options &options) {
+    const wav_format &s16 = WAV_FORMATS[1];
+    const std::vector<float> short_clip = noise(1024, 2, 0.25f, 7);
+
+    const int tracks_per_album = 50;
+    const int albums = std::max(1, options.scan_tracks / tracks_per_album);
+    int written = 0;
+
+    for (int album = 0; album < albums; album++) {
+        const std::string dir = root + "/artist " + std::to_string(album / 10) + "/album " + std::to_string(album);
+        fs::create_directories(dir);
+
+        for (int track = 0; track < tracks_per_album; track++, written++) {
+            char name[64];
+            std::snprintf(name, sizeof(name), "/%02d track %d.wav", track + 1, written);
+            if (!write_wav(dir + name, s16, 2, short_clip)) return false;
+        }
+    }
+
+    const std::string bulk = root + "/bulk";
+    fs::create_directories(bulk);
+
+    for (int track = 0; track < options.bulk_tracks; track++) {
+        if (!write_wav(bulk + "/bulk track " + std::to_string(track) + ".wav", s16, 2, short_clip)) return false;
+    }
+
+    return true;
+}
+
+/* the same noise as flac and mp3, through the ffmpeg on PATH. the bench has no encoders of its
+   own, without ffmpeg those cases are skipped */
+static bool encode(const std::string &wav, const std::string &path, const char *codec_args) {
+    const std::string command = "ffmpeg -v error -y -i '" + wav + "' " + codec_args + " '" + path + "'";
+    return std::system(command.c_str()) == 0 && fs::exists(path);
+}
+
+/* time to land anywhere in the track and read the block after it, as a click on the progress bar
+   does */
+static summary time_seeks(const std::string &path) {
+    std::vector<double> samples;
+    std::vector<uint8_t> scratch(4096 * 2 * sizeof(float));
+
+    track_stream stream;
+    if (!stream.open(path)) return summary();
+
+    std::mt19937 random(5);
+    for (int i = 0; i < SEEK_RUNS; i++) {
+        const drwav_uint64 frame = random() % stream.frame_count();
+        const auto start = bench_clock::now();
+
+        const void *data = nullptr;
+        if (!stream.seek(frame) || stream.read(4096, scratch.data(), &data) == 0) break;
+
+        samples.push_back(elapsed_ms(start));
+    }
+
+    return summarize(samples);
+}
+
+static void decode_case(json_writer &json, const char *name, const std::string &path, const bench_options &options, std::vector<uint8_t> &scratch) {
+    for (sample_format output : { sample_format::s16, sample_format::f32 }) {
+        double best = 1e30;
+        bool zero_copy = false;
+
+        for (int run = 0; run < DECODE_RUNS; run++) {
+            track_stream stream;
+            const auto start = bench_clock::now();
+
+            if (!stream.open(path)) break;
+            stream.set_output(output, false);
+            zero_copy = stream.zero_copy();
+
+            /* touch every output sample so a zero-copy read still pages the data in */
+            uint64_t checksum = 0;
+            while (!stream.finished()) {
+                const void *data = nullptr;
+                const drwav_uint64 read = stream.read(8192, scratch.data(), &data);
+                if (read == 0) break;
+
+                const uint8_t *bytes = static_cast<const uint8_t *>(data);
+                const size_t length = read * stream.frame_bytes();
+                for (size_t i = 0; i < length; i += 64) checksum += bytes[i];
+            }
+
+            best = std::min(best, elapsed_ms(start));
+            checksum_sink = checksum;
+        }
+
+        const double source_mb = static_cast<double>(fs::file_size(path)) / (1024.0 * 1024.0);
+
+        json.begin_object();
+        json.value("format", name);
+        json.value("output", output == sample_format::f32 ? "f32" : "s16");
+        json.value("zero_copy", zero_copy ? 1 : 0);
+        json.value("ms", best);
+        json.value("mb_per_s", source_mb / (best / 1000.0));
+        json.value("realtime", options.decode_seconds / (best / 1000.0));
+        if (output == sample_format::s16) write_summary(json, "seek_ms", time_seeks(path));
+        json.end_object();
+
+        std::cerr << "decode " << name << " -> " << (output == sample_format::f32 ? "f32" : "s16") << ": " << best << " ms\n";
+    }
+}
+
+static void bench_decode(json_writer &json, const std::string &dir, const bench_options &options) {
+    json.begin_array("decode");
+
+    const size_t frames = static_cast<size_t>(options.decode_seconds) * SAMPLE_RATE;
+    const std::vector<float> samples = noise(frames, 2, 0.5f, 1);
+    std::vector<uint8_t> scratch(8192 * 2 * sizeof(float));
+
+    for (const wav_format &format : WAV_FORMATS) {
+        const std::string path = dir + "/decode_" + format.name + ".wav";
+        if (!write_wav(path, format, 2, samples)) {
+            std::cerr << "failed to write " << path << "\n";
+            continue;
+        }
+
+        decode_case(json, format.name, path, options, scratch);
+    }
+
+    const std::string source = dir + "/decode_s16.wav";
+    const std::string flac = dir + "/decode.flac";
+    const std::string mp3 = dir + "/decode.mp3";
+
+    if (encode(source, flac, "-c:a flac")) decode_case(json, "flac", flac, options, scratch);
+    else std::cerr << "no ffmpeg to encode " << flac << ", skipped\n";
+
+    if (encode(source, mp3, "-c:a libmp3lame -b:a 256k")) decode_case(json, "mp3", mp3, options, scratch);
+    else std::cerr << "no ffmpeg to encode " << mp3 << ", skipped\n";
+
+    json.end_array();
+}
+
+/* stereo noise from the common library rates into the loopback rate, fed in read-sized blocks */
+static void bench_resample(json_writer &json, const bench_options &options) {
+    json.begin_array("resample");
+
+    std::vector<float> out(8192 * 2);
+    resampler resample;
+
+    for (unsigned int in_rate : { 44100u, 96000u }) {
+        const size_t frames = static_cast<size_t>(options.decode_seconds) * in_rate;
+        const std::vector<float> samples = noise(frames, 2, 0.5f, 2);
+        double best = 1e30;
+
+        for (int run = 0; run < DECODE_RUNS; run++) {
+            const auto start = bench_clock::now();
+            resample.configure(in_rate, LOOPBACK_RATE, 2);
+
+            double checksum = 0.0;
+            for (size_t pos = 0; pos < frames; ) {
+                size_t consumed = 0;
+                const size_t made = resample.process(samples.data() + pos * 2, std::min<size_t>(frames - pos, 8192), consumed, out.data(), 8192);
+
+                if (made > 0) checksum += out[0];
+                pos += consumed;
+            }
+
+            best = std::min(best, elapsed_ms(start));
+            checksum_sink = static_cast<uint64_t>(std::fabs(checksum));
+
+            /* a second configure at the same ratio keeps the bank, so time the rebuild on every run */
+            resample.configure(LOOPBACK_RATE, LOOPBACK_RATE, 2);
+        }
+
+        json.begin_object();
+        json.value("in_rate", in_rate);
+        json.value("out_rate", LOOPBACK_RATE);
+        json.value("ms", best);
+        json.value("realtime", options.decode_seconds / (best / 1000.0));
+        json.end_object();
+
+        std::cerr << "resample " << in_rate << " -> " << LOOPBACK_RATE << ": " << best << " ms\n";
+    }
+
+    json.end_array();
+}
+
+/* opening a track and reading its first block, then seeking back to its middle, once through the
+   decoder and again out of the decode cache. u8 is used because dr_wav decodes it rather than
+   mapping it */
+static void bench_replay(json_writer &json, const std::string &dir, const bench_options &options) {
+    const std::string path = dir + "/replay_u8.wav";
+    const size_t frames = static_cast<size_t>(options.decode_seconds) * SAMPLE_RATE;
+    if (!write_wav(path, WAV_FORMATS[0], 2, noise(frames, 2, 0.5f, 3))) {
+        std::cerr << "failed to write " << path << "\n";
+        return;
+    }
+
+    pcm_cache cache;
+    if (!cache.init(frames * 2 * sizeof(float) + pcm_cache::CHUNK_BYTES)) return;
+
+    std::vector<uint8_t> scratch(8192 * 2 * sizeof(float));
+
+    /* open and first block, then seek to the middle and read one block */
+    auto measure = [&](track_stream &stream, double &open_ms, double &seek_ms) {
+        const void *data = nullptr;
+
+        auto start = bench_clock::now();
+        if (!stream.open(path)) return false;
+        stream.set_output(sample_format::f32, false);
+        if (stream.read(8192, scratch.data(), &data) == 0) return false;
+        open_ms = elapsed_ms(start);
+
+        start = bench_clock::now();
+        if (!stream.seek(stream.frame_count() / 2) || stream.read(8192, scratch.data(), &data) == 0) return false;
+        seek_ms = elapsed_ms(start);
+
+        checksum_sink = static_cast<const uint8_t *>(data)[0];
+        return true;
+    };
+
+    std::vector<double> cold_open, cold_seek, cached_open, cached_seek;
+
+    for (int run = 0; run < REPLAY_RUNS; run++) {
+        double open_ms = 0.0, seek_ms = 0.0;
+
+        track_stream cold;
+        if (measure(cold, open_ms, seek_ms)) {
+            cold_open.push_back(open_ms);
+            cold_seek.push_back(seek_ms);
+        }
+    }
+
+    /* one full pass fills the cache, every run after that reads from it */
+    {
+        track_stream fill;
+        fill.set_cache(&cache, true);
+        fill.open(path);
+        fill.set_output(sample_format::f32, false);
+
+        while (!fill.finished()) {
+            const void *data = nullptr;
+            if (fill.read(8192, scratch.data(), &data) == 0) break;
+        }
+    }
+
+    for (int run = 0; run < REPLAY_RUNS; run++) {
+        double open_ms = 0.0, seek_ms = 0.0;
+
+        track_stream cached;
+        cached.set_cache(&cache, true);
+        if (measure(cached, open_ms, seek_ms) && cached.cached()) {
+            cached_open.push_back(open_ms);
+            cached_seek.push_back(seek_ms);
+        }
+    }
+
+    json.begin_object("replay");
+    json.value("format", "u8");
+    json.value("cache_hits", static_cast<double>(cache.hits()));
+    write_summary(json, "cold_open_ms", summarize(cold_open));
+    write_summary(json, "cold_seek_ms", summarize(cold_seek));
+    write_summary(json, "cached_open_ms", summarize(cached_open));
+    write_summary(json, "cached_seek_ms", summarize(cached_seek));
+    json.end_object();
+
+    std::cerr << "replay u8: open " << summarize(cold_open).p50 << " -> " << summarize(cached_open).p50 << " ms, seek "
+              << summarize(cold_seek).p50 << " -> " << summarize(cached_seek).p50 << " ms\n";
+
+    cache.cleanup();
+}
+
+static void bench_scan(json_writer &json, const std::string &root, const std::string &db_path) {
+    json.begin_object("scan");
+
+    library_db db;
+    db.load(db_path);
+
+    auto revalidate = [&] {
+        const auto start = bench_clock::now();
+        db.revalidate(root);
+        while (!db.poll()) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        return elapsed_ms(start);
+    };
+
+    const double db_cold = revalidate();
+    const double db_warm = revalidate();
+
+    json.value("entries", db.size());
+    json.value("db_cold_ms", db_cold);
+    json.value("db_warm_ms", db_warm);
+
+    /* every directory listed from the filesystem, the way a first launch without a database does */
+    std::vector<std::string> directories = { root };
+    for (uint32_t i = 0; i < db.size(); i++) {
+        const db_record &record = db.record(i);
+        if (record.kind == static_cast<uint8_t>(entry_kind::directory)) directories.emplace_back(db.path(record));
+    }
+
+    {
+        library_index index;
+        index.init();
+
+        const auto start = bench_clock::now();
+        for (const std::string &dir : directories) index.open(dir);
+        json.value("index_cold_ms", elapsed_ms(start));
+
+        index.cleanup();
+    }
+
+    {
+        library_index index;
+        index.init();
+
+        const auto start = bench_clock::now();
+        index.hydrate(db);
+        json.value("index_hydrate_ms", elapsed_ms(start));
+
+        index.cleanup();
+    }
+
+    {
+        search_index search;
+
+        const auto start = bench_clock::now();
+        search.update(db);
+        json.value("search_build_ms", elapsed_ms(start));
+
+        /* one query per keystroke of a search being typed, a name and then a folder */
+        std::vector<double> keystrokes;
+        std::vector<search_result> results;
+
+        for (const std::string text : { "track 12", "album 3" }) {
+            for (size_t length = 1; length <= text.size(); length++) {
+                const auto query_start = bench_clock::now();
+                search.query(text.substr(0, length), results);
+                keystrokes.push_back(elapsed_ms(query_start));
+            }
+        }
+
+        write_summary(json, "search_query_ms", summarize(keystrokes));
+        std::cerr << "search: p50 " << summarize(keystrokes).p50 << " ms, max " << summarize(keystrokes).max << " ms a keystroke\n";
+    }
+
+    db.cleanup();
+    json.end_object();
+
+    std::cerr << "scan: db cold " << db_cold << " ms, warm " << db_warm << " ms\n";
+}
+
+static bool audible(const float *samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (std::fabs(samples[i]) > 1e-4f) return true;
+    }
+    return false;
+}
+
+/* renders until the output is audible, returns the wall time since start or -1 on timeout */
+static double render_until_audible(audio_engine &audio, bench_clock::time_point start) {
+    float out[RENDER_FRAMES * 2];
+
+    while (elapsed_ms(start) < LATENCY_TIMEOUT * 1000.0) {
+        audio.render(out, RENDER_FRAMES);
+        if (audible(out, RENDER_FRAMES * 2)) return elapsed_ms(start);
+    }
+
+    return -1.0;
+}
+
+static void render_for(audio_engine &audio, double seconds) {
+    float out[RENDER_FRAMES * 2];
+    const size_t chunks = static_cast<size_t>(seconds * LOOPBACK_RATE / RENDER_FRAMES) + 1;
+
+    for (size_t i = 0; i < chunks; i++) audio.render(out, RENDER_FRAMES);
+}
+
+/* commands are asynchronous, so keep rendering until the engine reports it has settled and the
+   output is silent. otherwise the next measurement could stop at audio from before the command */
+static bool settle_silent(audio_engine &audio, const std::function<bool(const playback_state &)> &settled) {
+    float out[RENDER_FRAMES * 2];
+    const auto start = bench_clock::now();
+
+    while (elapsed_ms(start) < LATENCY_TIMEOUT * 1000.0) {
+        audio.render(out, RENDER_FRAMES);
+        if (settled(audio.get_state()) && !audible(out, RENDER_FRAMES * 2)) return true;
+    }
+
+    return false;
+}
+
+static void bench_latency(json_writer &json, audio_engine &audio, const std::string &dir) {
+    json.begin_array("time_to_first_sample");
+
+    for (const wav_format &format : WAV_FORMATS) {
+        const std::string path = dir + "/decode_" + format.name + ".wav";
+        if (!fs::exists(path)) continue;
+
+        std::vector<double> samples;
+
+        for (int run = 0; run < LATENCY_RUNS; run++) {
+            audio.stop();
+            if (!settle_silent(audio, [](const playback_state &state) { return !state.playing; })) continue;
+
+            const auto start = bench_clock::now();
+            audio.play(path);
+
+            const double ms = render_until_audible(audio, start);
+            if (ms >= 0.0) samples.push_back(ms);
+        }
+
+        json.begin_object();
+        json.value("format", format.name);
+        json.value("timeouts", LATENCY_RUNS - static_cast<int>(samples.size()));
+        write_summary(json, "ms", summarize(samples));
+        json.end_object();
+
+        std::cerr << "time to first sample " << format.name << ": " << summarize(samples).p50 << " ms\n";
+    }
+
+    json.end_array();
+
+    /* silence with a burst every five seconds. each seek lands in silence first, then on a burst,
+       so the first audible output marks the seek taking effect */
+    const float burst_seconds = 0.5f, spacing = 5.0f;
+    const int bursts = 5;
+
+    std::vector<float> signal(static_cast<size_t>((bursts + 1) * spacing * SAMPLE_RATE) * 2, 0.0f);
+    const std::vector<float> burst = noise(static_cast<size_t>(burst_seconds * SAMPLE_RATE), 2, 0.5f, 3);
+
+    for (int b = 1; b <= bursts; b++) {
+        std::copy(burst.begin(), burst.end(), signal.begin() + static_cast<size_t>(b * spacing * SAMPLE_RATE) * 2);
+    }
+
+    const std::string path = dir + "/seek.wav";
+    std::vector<double> samples;
+
+    if (write_wav(path, WAV_FORMATS[1], 2, signal)) {
+        audio.play(path);
+        render_for(audio, 0.1);
+
+        for (int run = 0; run < LATENCY_RUNS; run++) {
+            const float target = spacing * (1 + run % bursts);
+
+            audio.seek(target - 2.0f);
+            if (!settle_silent(audio, [&](const playback_state &state) { return std::fabs(state.position - (target - 2.0f)) < 0.5f; })) continue;
+
+            const auto start = bench_clock::now();
+            audio.seek(target);
+
+            const double ms = render_until_audible(audio, start);
+            if (ms >= 0.0) samples.push_back(ms);
+        }
+
+        audio.stop();
+    }
+
+    json.begin_object("seek_latency");
+    json.value("timeouts", LATENCY_RUNS - static_cast<int>(samples.size()));
+    write_summary(json, "ms", summarize(samples));
+    json.end_object();
+
+    std::cerr << "seek latency: " << summarize(samples).p50 << " ms\n";
+}
+
+/* frame times of the real player ui without a window, with audio rendered in step at 60 fps */
+static void bench_ui(json_writer &json, audio_engine &audio, const std::string &root, const std::string &work) {
+    library_index library;
+    library.init();
+
+    library_db db;
+    db.load(work + "/library.db");
+    db.revalidate(root);
+    while (!db.poll()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    library.hydrate(db);
+
+    search_index search;
+    search.init();
+    search.update(db);
+
+    peak_cache peaks;
+    peaks.init(work + "/peaks");
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    io.DisplaySize = ImVec2(800, 600);
+    io.DeltaTime = 1.0f / 60.0f;
+
+    /* the real fonts when run from the build directory like the player, imgui's own otherwise */
+    ImFont *bold_font = nullptr;
+    if (fs::exists("../res/fonts/inter.ttf") && fs::exists("../res/fonts/inter-bold.ttf")) {
+        io.Fonts->AddFontFromFileTTF("../res/fonts/inter.ttf", 36.0f);
+        bold_font = io.Fonts->AddFontFromFileTTF("../res/fonts/inter-bold.ttf", 36.0f);
+    } else {
+        bold_font = io.Fonts->AddFontDefault();
+    }
+
+    unsigned char *pixels = nullptr;
+    int width = 0, height = 0;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    player_services services;
+    services.audio = &audio;
+    services.library = &library;
+    services.db = &db;
+    services.search = &search;
+    services.peaks = &peaks;
+
+    player_ui ui;
+    ui.init(services, root, bold_font);
+
+    std::vector<float> out(LOOPBACK_RATE / 60 * 2);
+
+    auto run = [&](const char *name, const std::function<void()> &setup) {
+        setup();
+
+        std::vector<double> samples;
+        size_t vertices = 0;
+
+        for (int frame = 0; frame < UI_WARMUP_FRAMES + UI_FRAMES; frame++) {
+            audio.render(out.data(), out.size() / 2);
+
+            const auto start = bench_clock::now();
+            ui.frame();
+            const double us = elapsed_ms(start) * 1000.0;
+
+            if (frame >= UI_WARMUP_FRAMES) samples.push_back(us);
+            vertices = ImGui::GetDrawData()->TotalVtxCount;
+        }
+
+        json.begin_object(name);
+        json.value("vertices", static_cast<double>(vertices));
+        write_summary(json, "us", summarize(samples));
+        json.end_object();
+
+        std::cerr << "ui " << name << ": " << summarize(samples).p50 << " us\n";
+    };
+
+    json.begin_object("ui_frame");
+
+    run("idle", [&] { ui.show_directory(root); });
+    run("bulk_directory", [&] { ui.show_directory(root + "/bulk"); });
+    run("playing", [&] {
+        audio.play(root + "/bulk/bulk track 0.wav");
+        ui.show_directory(root + "/bulk");
+    });
+    run("search", [&] { ui.show_search("track 1"); });
+
+    json.end_object();
+
+    audio.stop();
+    ImGui::DestroyContext();
+
+    peaks.cleanup();
+    search.cleanup();
+    db.cleanup();
+    library.cleanup();
+}
+
+static bool parse_options(int argc, char **argv, bench_options &options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--json" && has_value) {
+            options.json_path = argv[++i];
+        } else if (arg == "--trace" && has_value) {
+            options.trace_path = argv[++i];
+        } else if (arg == "--scan-tracks" && has_value) {
+            options.scan_tracks = std::max(50, std::atoi(argv[++i]));
+        } else if (arg == "--bulk-tracks" && has_value) {
+            options.bulk_tracks = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--decode-seconds" && has_value) {
+            options.decode_seconds = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else {
+            std::cerr << "usage: hexen_bench [--json path] [--trace path] [--scan-tracks n] [--bulk-tracks n] [--decode-seconds n] [--keep]\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bench_options options;
+    if (!parse_options(argc, argv, options)) return 2;
+
+    std::string work = (fs::temp_directory_path() / "hexen_bench.XXXXXX").string();
+    if (!mkdtemp(&work[0])) {
+        std::cerr << "failed to create a temp directory\n";
+        return 1;
+    }
+
+    const std::string root = work + "/music";
+
+    std::cerr << "generating library in " << work << "\n";
+    if (!generate_library(root, options)) {
+        std::cerr << "failed to generate the library\n";
+        return 1;
+    }
+
+    audio_settings settings;
+    settings.loopback_rate = LOOPBACK_RATE;
+
+    audio_engine audio;
+    if (!audio.init(settings)) {
+        std::cerr << "failed to open a loopback audio device\n";
+        return 1;
+    }
+
+    json_writer json;
+    json.begin_object();
+    json.value("version", 1);
+    json.value("convert_backend", convert_backend());
+    json.value("resample_backend", resampler_backend());
+    json.value("scan_tracks", options.scan_tracks);
+    json.value("bulk_tracks", options.bulk_tracks);
+
+    bench_decode(json, work, options);
+    bench_resample(json, options);
+    bench_replay(json, work, options);
+    bench_scan(json, root, work + "/scan.db");
+    bench_latency(json, audio, work);
+    bench_ui(json, audio, root, work);
+
+    json.end_object();
+    audio.cleanup();
+
+    if (!options.trace_path.empty() && !profile_export_trace(options.trace_path)) {
+        std::cerr << "failed to write the trace to " << options.trace_path << "\n";
+    }
+
+    if (options.json_path.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream(options.json_path) << json.str();
+    }
+
+    if (!options.keep) fs::remove_all(work);
+    return 0;
+}
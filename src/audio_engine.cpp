@@ -0,0 +1,712 @@
+#include "audio_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "profiler.h"
+
+static ALCdevice *open_loopback(unsigned int rate, LPALCRENDERSAMPLESSOFT &render_samples) {
+    if (!alcIsExtensionPresent(NULL, "ALC_SOFT_loopback")) {
+        std::cerr << "ALC_SOFT_loopback is not available\n";
+        return nullptr;
+    }
+
+    auto open_device = reinterpret_cast<LPALCLOOPBACKOPENDEVICESOFT>(alcGetProcAddress(NULL, "alcLoopbackOpenDeviceSOFT"));
+    auto format_supported = reinterpret_cast<LPALCISRENDERFORMATSUPPORTEDSOFT>(alcGetProcAddress(NULL, "alcIsRenderFormatSupportedSOFT"));
+    render_samples = reinterpret_cast<LPALCRENDERSAMPLESSOFT>(alcGetProcAddress(NULL, "alcRenderSamplesSOFT"));
+    if (!open_device || !format_supported || !render_samples) return nullptr;
+
+    ALCdevice *device = open_device(NULL);
+    if (device && !format_supported(device, static_cast<ALCsizei>(rate), ALC_STEREO_SOFT, ALC_FLOAT_SOFT)) {
+        std::cerr << "loopback device cannot render stereo float at " << rate << " hz\n";
+        alcCloseDevice(device);
+        return nullptr;
+    }
+
+    return device;
+}
+
+bool audio_engine::init(const audio_settings &settings) {
+    _device = settings.loopback_rate ? open_loopback(settings.loopback_rate, _render_samples) : alcOpenDevice(NULL);
+    if (!_device) {
+        return false;
+    }
+
+    const ALCint loopback_attributes[] = {
+        ALC_FORMAT_CHANNELS_SOFT, ALC_STEREO_SOFT,
+        ALC_FORMAT_TYPE_SOFT, ALC_FLOAT_SOFT,
+        ALC_FREQUENCY, static_cast<ALCint>(settings.loopback_rate),
+        0
+    };
+
+    _context = alcCreateContext(_device, settings.loopback_rate ? loopback_attributes : NULL);
+    if (!_context) {
+        alcCloseDevice(_device);
+        _device = nullptr;
+        return false;
+    }
+
+    alcMakeContextCurrent(_context);
+
+    alGenSources(1, &_source);
+
+    /* the mix is already stereo at the device rate, keep openal from panning its two channels as
+       point sources so it reaches the output as it was mixed */
+    if (alIsExtensionPresent("AL_SOFT_direct_channels")) alSourcei(_source, AL_DIRECT_CHANNELS_SOFT, AL_TRUE);
+
+    alGenBuffers(STREAM_BUFFER_COUNT, _buffers);
+    _free_buffers.assign(_buffers, _buffers + STREAM_BUFFER_COUNT);
+
+    const ALenum float_stereo = alIsExtensionPresent("AL_EXT_FLOAT32") ? alGetEnumValue("AL_FORMAT_STEREO_FLOAT32") : AL_NONE;
+    _format = (float_stereo != AL_NONE) ? float_stereo : AL_FORMAT_STEREO16;
+
+    /* mix at the rate the device runs at, so openal does not resample a second time */
+    ALCint rate = 0;
+    alcGetIntegerv(_device, ALC_FREQUENCY, 1, &rate);
+    if (rate <= 0) rate = DEFAULT_RATE;
+
+    _settings = settings;
+    for (track_stream &stream : _streams) {
+        stream.set_cache(settings.pcm, true);
+        _free_streams.push_back(&stream);
+    }
+
+    _mixer.init(static_cast<unsigned int>(rate));
+    _crossfade_frames = static_cast<uint64_t>(std::max(settings.crossfade_seconds, 0.0f) * rate);
+
+    _mix.resize(STREAM_CHUNK_FRAMES * mixer::CHANNELS);
+    _mix_s16.resize(STREAM_CHUNK_FRAMES * mixer::CHANNELS);
+    _analysis_chunk.resize(STREAM_CHUNK_FRAMES);
+
+    publish_state();
+
+    _running = true;
+    _thread = std::thread(&audio_engine::audio_thread, this);
+    _loader = std::thread(&audio_engine::loader_thread, this);
+    return true;
+}
+
+void audio_engine::cleanup() {
+    _running = false;
+    _wake.notify_all();
+    _loader_wake.notify_all();
+    if (_thread.joinable()) _thread.join();
+    if (_loader.joinable()) _loader.join();
+
+    if (!_context) return;
+
+    clear_queue();
+
+    /* both threads are gone, whatever they were still passing each other is dropped with the pool */
+    loaded_track loaded;
+    while (_loaded.pop(loaded)) {}
+    loader_request request;
+    while (_requests.pop(request)) {}
+
+    for (track_stream &stream : _streams) stream.close();
+    _free_streams.clear();
+    _slots[0] = _slots[1] = nullptr;
+    _next = nullptr;
+
+    alDeleteSources(1, &_source);
+    alDeleteBuffers(STREAM_BUFFER_COUNT, _buffers);
+
+    alcMakeContextCurrent(NULL);
+    alcDestroyContext(_context);
+    alcCloseDevice(_device);
+
+    _context = nullptr;
+    _device = nullptr;
+    _render_samples = nullptr;
+}
+
+bool audio_engine::render(float *out, size_t frames) {
+    if (!_context || !_render_samples) return false;
+
+    _render_samples(_device, out, static_cast<ALCsizei>(frames));
+    return true;
+}
+
+void audio_engine::play(const std::string &file, std::vector<std::string> queue) {
+    command cmd;
+    cmd.type = command_type::play;
+    cmd.path = file;
+    cmd.queue = std::move(queue);
+    post(std::move(cmd));
+}
+
+void audio_engine::enqueue(const std::string &file) {
+    command cmd;
+    cmd.type = command_type::enqueue;
+    cmd.path = file;
+    post(std::move(cmd));
+}
+
+void audio_engine::stop() {
+    command cmd;
+    cmd.type = command_type::stop;
+    post(std::move(cmd));
+}
+
+void audio_engine::seek(float seconds) {
+    command cmd;
+    cmd.type = command_type::seek;
+    cmd.seconds = seconds;
+    post(std::move(cmd));
+}
+
+void audio_engine::post(command cmd) {
+    if (!_commands.push(std::move(cmd))) {
+        std::cerr << "audio command queue full, dropping command\n";
+        return;
+    }
+
+    _loader_wake.notify_one();
+}
+
+static bool playable(const track_stream &stream) {
+    return (stream.channels() == 1 || stream.channels() == 2) && stream.sample_rate() > 0;
+}
+
+void audio_engine::loader_thread() {
+    PROFILE_THREAD("loader");
+    command cmd;
+
+    while (_running) {
+        drain_requests();
+
+        while (_commands.pop(cmd)) {
+            switch (cmd.type) {
+                case command_type::play:
+                    _queue.assign(std::make_move_iterator(cmd.queue.begin()), std::make_move_iterator(cmd.queue.end()));
+                    load_play(cmd.path);
+                    break;
+                case command_type::enqueue:
+                    _queue.push_back(std::move(cmd.path));
+                    break;
+                case command_type::stop:
+                    _queue.clear();
+                    hand(load_type::stop, nullptr, std::string());
+                    break;
+                case command_type::seek:
+                    load_seek(cmd.seconds);
+                    break;
+            }
+        }
+
+        if (_next_wanted) load_next();
+
+        /* what has already played out can no longer be seeked back into */
+        const uint32_t audible = audible_serial();
+        while (!_handed.empty() && _handed.front().serial < audible) _handed.pop_front();
+
+        std::unique_lock<std::mutex> lock(_loader_mutex);
+        _loader_wake.wait_for(lock, std::chrono::milliseconds(10), [this] { return !_running || !_commands.empty() || !_requests.empty(); });
+    }
+}
+
+/* closes the streams the audio thread is done with, and notes whether it wants the next track */
+void audio_engine::drain_requests() {
+    loader_request request;
+
+    while (_requests.pop(request)) {
+        if (request.stream) {
+            request.stream->close();
+            _free_streams.push_back(request.stream);
+        } else if (request.generation == _load_generation) {
+            _next_wanted = true;
+        }
+    }
+}
+
+track_stream *audio_engine::acquire_stream() {
+    while (true) {
+        drain_requests();
+
+        if (!_free_streams.empty()) {
+            track_stream *stream = _free_streams.back();
+            _free_streams.pop_back();
+            return stream;
+        }
+
+        if (!_running) return nullptr;
+
+        std::unique_lock<std::mutex> lock(_loader_mutex);
+        _loader_wake.wait_for(lock, std::chrono::milliseconds(10), [this] { return !_running || !_requests.empty(); });
+    }
+}
+
+/* opens path for the mixer, which works in float, requantizing only happens on the way out */
+track_stream *audio_engine::open_track(const std::string &path) {
+    PROFILE_SCOPE(profile_zone::open_track);
+
+    track_stream *stream = acquire_stream();
+    if (!stream) return nullptr;
+
+    if (stream->open(path) && playable(*stream)) {
+        stream->set_output(sample_format::f32, false);
+        stream->reserve(mixer::READ_FRAMES);
+        return stream;
+    }
+
+    if (stream->is_open()) {
+        std::cerr << "unsupported format (" << stream->channels() << " channels, " << stream->sample_rate() << " hz): " << path << "\n";
+    }
+
+    stream->close();
+    _free_streams.push_back(stream);
+    return nullptr;
+}
+
+void audio_engine::hand(load_type type, track_stream *stream, const std::string &path) {
+    /* a play or stop starts over, whatever was handed over or asked for before it is stale */
+    if (type != load_type::next) {
+        _load_generation++;
+        _handed.clear();
+        _next_wanted = false;
+    }
+
+    loaded_track loaded;
+    loaded.type = type;
+    loaded.stream = stream;
+    loaded.serial = ++_load_serial;
+    loaded.generation = _load_generation;
+    if (stream) loaded.gain = track_gain(path);
+
+    if (type == load_type::play) _play_serial = loaded.serial;
+    if (stream) _handed.push_back({ loaded.serial, path });
+
+    /* the audio thread drains these every tick, a full queue only means it is behind */
+    while (!_loaded.push(loaded)) {
+        if (!_running) {
+            if (stream) {
+                stream->close();
+                _free_streams.push_back(stream);
+            }
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    _wake.notify_one();
+}
+
+float audio_engine::track_gain(const std::string &path) const {
+    loudness_result loudness;
+    if (!_settings.loudness || !_settings.loudness->lookup(path, loudness)) return 1.0f;
+
+    const float gain_db = normalization_gain(loudness, _settings.target_lufs, _settings.peak_ceiling_dbtp);
+    return std::min(MAX_GAIN, std::pow(10.0f, gain_db / 20.0f));
+}
+
+void audio_engine::load_play(const std::string &path) {
+    track_stream *stream = open_track(path);
+    if (!stream) {
+        std::cerr << "failed to open track: " << path << "\n";
+        hand(load_type::stop, nullptr, std::string());
+        return;
+    }
+
+    /* the first block is decoded here rather than on the audio thread */
+    stream->preroll(mixer::READ_FRAMES * stream->frame_bytes());
+    hand(load_type::play, stream, path);
+}
+
+/* reopens the audible track at seconds. tracks already handed over behind it go back on the
+   front of the queue, to be prefetched again after it */
+void audio_engine::load_seek(float seconds) {
+    PROFILE_SCOPE(profile_zone::seek);
+
+    const uint32_t audible = audible_serial();
+    auto found = std::find_if(_handed.begin(), _handed.end(), [audible](const handed_track &track) { return track.serial == audible; });
+    if (found == _handed.end()) return;
+
+    const std::string path = found->path;
+
+    track_stream *stream = open_track(path);
+    if (!stream) return;
+
+    if (!stream->seek(static_cast<drwav_uint64>(std::max(seconds, 0.0f) * stream->sample_rate()))) {
+        stream->close();
+        _free_streams.push_back(stream);
+        return;
+    }
+
+    stream->preroll(mixer::READ_FRAMES * stream->frame_bytes());
+
+    for (auto later = _handed.rbegin(); later->serial != audible; ++later) _queue.push_front(later->path);
+    hand(load_type::play, stream, path);
+}
+
+void audio_engine::load_next() {
+    while (!_queue.empty() && _running) {
+        const std::string path = std::move(_queue.front());
+        _queue.pop_front();
+
+        track_stream *stream = open_track(path);
+        if (!stream) {
+            std::cerr << "skipping unplayable track: " << path << "\n";
+            continue;
+        }
+
+        stream->preroll(_settings.prefetch_budget);
+
+        _next_wanted = false;
+        hand(load_type::next, stream, path);
+        return;
+    }
+}
+
+/* the track the audio thread is playing, or the one it was last told to play if it has not got to
+   it yet */
+uint32_t audio_engine::audible_serial() const {
+    return std::max(_snapshot.load().track_serial, _play_serial);
+}
+
+void audio_engine::audio_thread() {
+    PROFILE_THREAD("audio");
+    loaded_track loaded;
+
+    while (_running) {
+        while (_loaded.pop(loaded)) receive(loaded);
+
+        if (_state.playing) {
+            request_next();
+            service_queue();
+        }
+
+        publish_state();
+
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _wake.wait_for(lock, std::chrono::milliseconds(10), [this] { return !_running || !_loaded.empty(); });
+    }
+}
+
+void audio_engine::receive(const loaded_track &loaded) {
+    switch (loaded.type) {
+        case load_type::play:
+            clear_queue();
+            release_streams();
+
+            _generation = loaded.generation;
+            _slots[_feed] = loaded.stream;
+            register_track(loaded.serial, loaded.stream, loaded.gain);
+            begin_playback();
+            break;
+
+        case load_type::next:
+            if (loaded.generation != _generation || _next) {
+                recycle(loaded.stream);
+                break;
+            }
+
+            _next = loaded.stream;
+            _next_serial = loaded.serial;
+            _next_gain = loaded.gain;
+            _next_requested = false;
+
+            /* it came in after the current track had already run out */
+            if (!_state.playing && advance()) begin_playback();
+            break;
+
+        case load_type::stop:
+            _generation = loaded.generation;
+            close_track(loaded.serial);
+            break;
+    }
+}
+
+void audio_engine::recycle(track_stream *stream) {
+    if (!_requests.push({ stream, _generation })) {
+        std::cerr << "loader request queue full, leaking a stream\n";
+        return;
+    }
+
+    _loader_wake.notify_one();
+}
+
+void audio_engine::release_slot(int slot) {
+    if (!_slots[slot]) return;
+
+    recycle(_slots[slot]);
+    _slots[slot] = nullptr;
+}
+
+void audio_engine::release_streams() {
+    release_slot(0);
+    release_slot(1);
+
+    if (_next) recycle(_next);
+    _next = nullptr;
+    _next_requested = false;
+}
+
+/* hands back an outgoing track once its fade has ended, and asks for the next one as soon as
+   there is room for it */
+void audio_engine::request_next() {
+    if (!_mixer.active(_feed ^ 1)) release_slot(_feed ^ 1);
+    if (_next || _next_requested) return;
+
+    if (!_requests.push({ nullptr, _generation })) return;
+
+    _next_requested = true;
+    _loader_wake.notify_one();
+}
+
+void audio_engine::begin_playback() {
+    start_voice(0);
+
+    /* start on a short first buffer and mix the rest while it plays, so the first sample does not
+       wait on a whole queue of resampling */
+    if (!_free_buffers.empty() && fill_buffer(_free_buffers.back(), STREAM_START_FRAMES)) _free_buffers.pop_back();
+    alSourcePlay(_source);
+    fill_free_buffers();
+
+    _state.playing = true;
+    set_audible(_serial);
+}
+
+void audio_engine::close_track(uint32_t serial) {
+    clear_queue();
+    release_streams();
+
+    register_track(serial, nullptr, 1.0f);
+    set_audible(_serial);
+
+    _state.position = 0.0f;
+    _state.playing = false;
+}
+
+bool audio_engine::advance() {
+    if (!_next || _mixer.active(_feed ^ 1)) return false;
+
+    /* a track fading out keeps its stream until the fade ends */
+    release_slot(_feed ^ 1);
+    if (!_mixer.active(_feed)) release_slot(_feed);
+
+    _feed ^= 1;
+    _slots[_feed] = _next;
+    _next = nullptr;
+
+    register_track(_next_serial, _slots[_feed], _next_gain);
+    return true;
+}
+
+void audio_engine::register_track(uint32_t serial, const track_stream *stream, float gain) {
+    _serial = serial;
+
+    track_meta &meta = _tracks[_serial % TRACK_HISTORY];
+    meta.serial = _serial;
+    meta.path[0] = '\0';
+    meta.duration = 0.0f;
+    meta.sample_rate = 0;
+    meta.gain = gain;
+
+    if (!stream) return;
+
+    const size_t length = std::min(stream->path().size(), sizeof(meta.path) - 1);
+    std::memcpy(meta.path, stream->path().data(), length);
+    meta.path[length] = '\0';
+
+    meta.duration = stream->duration();
+    meta.sample_rate = stream->sample_rate();
+}
+
+void audio_engine::start_voice(uint64_t fade_in) {
+    _mixer.start(_feed, feed(), _tracks[_serial % TRACK_HISTORY].gain, fade_in);
+}
+
+void audio_engine::service_queue() {
+    ALint processed = 0;
+    alGetSourcei(_source, AL_BUFFERS_PROCESSED, &processed);
+
+    while (processed-- > 0) {
+        ALuint buffer = 0;
+        alSourceUnqueueBuffers(_source, 1, &buffer);
+
+        _queued_head = (_queued_head + 1) % STREAM_BUFFER_COUNT;
+        _queued_count--;
+        _free_buffers.push_back(buffer);
+    }
+
+    fill_free_buffers();
+    PROFILE_GAUGE(profile_counter::queue_depth, _queued_count);
+
+    ALint queued = 0, state = 0;
+    alGetSourcei(_source, AL_BUFFERS_QUEUED, &queued);
+    alGetSourcei(_source, AL_SOURCE_STATE, &state);
+
+    if (state == AL_PLAYING) return;
+
+    if (queued > 0) {
+        PROFILE_COUNT(profile_counter::underruns, 1);
+        alSourcePlay(_source); /* underrun, the source ran dry before we refilled */
+    } else if (!_mixer.active(_feed)) {
+        /* the next track was not ready in time to follow on directly, start it once the old one has drained */
+        if (advance()) {
+            begin_playback();
+        } else {
+            _state.position = _state.duration;
+            _state.playing = false;
+        }
+    }
+}
+
+void audio_engine::publish_state() {
+    ALint state = 0, offset = 0;
+    alGetSourcei(_source, AL_SOURCE_STATE, &state);
+
+    if (_queued_count > 0 && (state == AL_PLAYING || state == AL_PAUSED)) {
+        alGetSourcei(_source, AL_SAMPLE_OFFSET, &offset);
+
+        /* the offset counts from the head of the source queue, find the buffer it lands in */
+        drwav_uint64 remaining = static_cast<drwav_uint64>(offset);
+        for (int i = 0; i < _queued_count; i++) {
+            const queued_buffer &queued = _queued[(_queued_head + i) % STREAM_BUFFER_COUNT];
+
+            if (remaining < queued.frames) {
+                set_audible(queued.serial);
+
+                const track_meta &meta = _tracks[queued.serial % TRACK_HISTORY];
+                _state.position = static_cast<float>((queued.start_frame + remaining * queued.step) / meta.sample_rate);
+                _state.analysis_position = queued.analysis_start + remaining;
+                _state.sample_rate = _mixer.rate();
+                break;
+            }
+
+            remaining -= queued.frames;
+        }
+    }
+
+    _snapshot.store(_state);
+}
+
+void audio_engine::set_audible(uint32_t serial) {
+    if (serial == _audible_serial && serial == _state.track_serial) return;
+
+    const track_meta &meta = _tracks[serial % TRACK_HISTORY];
+    std::memcpy(_state.track, meta.path, sizeof(_state.track));
+
+    _state.track_serial = serial;
+    _state.duration = meta.duration;
+    _audible_serial = serial;
+}
+
+void audio_engine::publish_analysis(const float *mix, size_t frames) {
+    float *mono = _analysis_chunk.data();
+    for (size_t i = 0; i < frames; i++) mono[i] = 0.5f * (mix[2 * i] + mix[2 * i + 1]);
+
+    _analysis.write(mono, frames);
+}
+
+/* mixes up to limit frames into _mix and returns how many. the chunk stops early where the feed
+   changes, so every buffer belongs to a single track, whose frame at the chunk's start and frames
+   per output frame come back in start_frame and step */
+size_t audio_engine::mix_chunk(size_t limit, double &start_frame, double &step) {
+    PROFILE_SCOPE(profile_zone::mix);
+    size_t done = 0;
+
+    while (done < limit) {
+        /* ask for the next track as soon as its slot frees up, so it is ready before the feed
+           reaches its own crossfade */
+        request_next();
+
+        if (!_mixer.active(_feed)) {
+            if (done > 0 || !advance()) break;
+            start_voice(0);
+        }
+
+        uint64_t remaining = _mixer.remaining(_feed);
+        size_t span = limit - done;
+        if (_mixer.active(_feed ^ 1)) span = static_cast<size_t>(std::min<uint64_t>(span, _mixer.remaining(_feed ^ 1)));
+
+        /* the crossfade starts exactly fade frames before the end of the outgoing track */
+        if (_crossfade_frames && _next && !_mixer.active(_feed ^ 1)) {
+            const uint64_t fade = std::min({ _crossfade_frames, remaining, _mixer.output_frames(next()) / 2 });
+
+            if (remaining <= fade) {
+                if (done > 0) break;
+
+                _mixer.fade_out(_feed, fade);
+                advance();
+                start_voice(fade);
+
+                remaining = _mixer.remaining(_feed);
+            } else {
+                span = static_cast<size_t>(std::min<uint64_t>(span, remaining - fade));
+            }
+        }
+
+        span = static_cast<size_t>(std::min<uint64_t>(span, remaining));
+        if (span == 0) break;
+
+        if (done == 0) {
+            start_frame = _mixer.position(_feed);
+            step = _mixer.step(_feed);
+        }
+
+        _mixer.mix(_mix.data() + done * mixer::CHANNELS, span);
+        done += span;
+    }
+
+    return done;
+}
+
+bool audio_engine::fill_buffer(ALuint buffer, size_t limit) {
+    double start_frame = 0.0, step = 1.0;
+
+    const size_t frames = mix_chunk(std::min<size_t>(limit, STREAM_CHUNK_FRAMES), start_frame, step);
+    if (frames == 0) return false;
+
+    {
+        PROFILE_SCOPE(profile_zone::upload);
+
+        const void *samples = _mix.data();
+        ALsizei bytes = static_cast<ALsizei>(frames * mixer::CHANNELS * sizeof(float));
+
+        if (_format == AL_FORMAT_STEREO16) {
+            convert_to_s16(_mix.data(), sample_format::f32, _mix_s16.data(), frames * mixer::CHANNELS, _settings.dither ? &_dither : nullptr);
+
+            samples = _mix_s16.data();
+            bytes = static_cast<ALsizei>(frames * mixer::CHANNELS * sizeof(int16_t));
+        }
+
+        alBufferData(buffer, _format, samples, bytes, static_cast<ALsizei>(_mixer.rate()));
+        alSourceQueueBuffers(_source, 1, &buffer);
+    }
+
+    const uint64_t analysis_start = _analysis.written();
+    publish_analysis(_mix.data(), frames);
+
+    queued_buffer &queued = _queued[(_queued_head + _queued_count) % STREAM_BUFFER_COUNT];
+    queued.buffer = buffer;
+    queued.serial = _serial;
+    queued.start_frame = start_frame;
+    queued.step = step;
+    queued.frames = frames;
+    queued.analysis_start = analysis_start;
+    _queued_count++;
+
+    return true;
+}
+
+void audio_engine::fill_free_buffers() {
+    while (!_free_buffers.empty() && fill_buffer(_free_buffers.back())) {
+        _free_buffers.pop_back();
+    }
+}
+
+void audio_engine::clear_queue() {
+    _mixer.stop_all();
+
+    alSourceStop(_source);
+    alSourcei(_source, AL_BUFFER, 0);
+
+    _free_buffers.assign(_buffers, _buffers + STREAM_BUFFER_COUNT);
+    _queued_head = 0;
+    _queued_count = 0;
+}
@@ -0,0 +1,272 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <AL/alext.h>
+
+#include "loudness_cache.h"
+#include "mixer.h"
+#include "sample_ring.h"
+#include "seqlock.h"
+#include "spsc_queue.h"
+#include "track_stream.h"
+
+struct audio_settings {
+    /* caps the memory used to pre-decode the head of the next track */
+    size_t prefetch_budget = 4 * 1024 * 1024;
+
+    /* when set, decoded tracks are kept in it so replays and seeks back skip the decoder */
+    pcm_cache *pcm = nullptr;
+
+    /* tpdf dither when hi-res tracks have to be requantized to s16 */
+    bool dither = true;
+
+    /* when set, tracks it has measured are played at target_lufs, kept under the true peak ceiling */
+    const loudness_cache *loudness = nullptr;
+    float target_lufs = -18.0f;
+    float peak_ceiling_dbtp = -1.0f;
+
+    /* equal-power crossfade between consecutive tracks in the play queue, 0 plays them gaplessly */
+    float crossfade_seconds = 0.0f;
+
+    /* when set, mixes to an ALC_SOFT_loopback device at this rate instead of the default device.
+       nothing plays until render() pulls the output, so it runs without a sound card */
+    unsigned int loopback_rate = 0;
+};
+
+/* what the ui sees of the engine, republished by the audio thread every tick */
+struct playback_state {
+    char track[4096];
+    uint32_t track_serial;
+
+    float position;
+    float duration;
+
+    /* where the audible sample sits in the analysis ring, and the output rate it is written at */
+    uint64_t analysis_position;
+    uint32_t sample_rate;
+
+    bool playing;
+};
+
+/* streams the mixer's output through a small ring of queued al buffers on a dedicated audio thread.
+   the ui thread never touches openal, it posts commands and reads back a playback_state snapshot.
+
+   commands go to a loader thread, which owns the play queue and does everything that touches the
+   filesystem or the heap: it opens, prerolls and seeks tracks in a small pool of streams and hands
+   the ready ones to the audio thread, which hands them back to be closed once they are done. the
+   audio thread only mixes, and asks the loader for the next track when it has room for one.
+
+   every track is resampled to the device rate and mixed to stereo float in software, so one source
+   plays everything at one format. the next track in the play queue is opened and its head decoded
+   by the loader while the current one plays, then started on the frame the current one ends, or
+   crossfaded over its last crossfade_seconds. measured tracks are loudness normalized in the mix.
+   the mix is uploaded as float when the device has AL_EXT_FLOAT32 and requantized to s16 otherwise.
+
+   a mono downmix of everything queued on the source is also written to an analysis ring, which the
+   ui reads back for its visualizer at the position the source is actually playing */
+class audio_engine {
+    private:
+        static constexpr int STREAM_BUFFER_COUNT = 4;
+        static constexpr drwav_uint64 STREAM_CHUNK_FRAMES = 8192;
+        static constexpr drwav_uint64 STREAM_START_FRAMES = 1024;
+        static constexpr int TRACK_HISTORY = STREAM_BUFFER_COUNT + 1;
+        static constexpr size_t ANALYSIS_CAPACITY = 65536;
+        static constexpr float MAX_GAIN = 4.0f;
+        static constexpr ALCint DEFAULT_RATE = 44100;
+
+        /* the feed, a track fading out and the next one, plus one for the loader to open while the
+           audio thread hands the others back */
+        static constexpr int STREAM_POOL = 4;
+
+        enum class command_type { play, enqueue, stop, seek };
+
+        struct command {
+            command_type type = command_type::stop;
+            std::string path;
+            std::vector<std::string> queue;
+            float seconds = 0.0f;
+        };
+
+        /* loader to audio thread. play replaces whatever plays with stream, next queues it behind the
+           feed, stop ends playback. generation changes with every play and stop, a next from an older
+           one is handed straight back. gain is looked up while the track is opened, so the audio
+           thread never waits on the loudness cache */
+        enum class load_type { play, next, stop };
+
+        struct loaded_track {
+            load_type type = load_type::stop;
+            track_stream *stream = nullptr;
+            uint32_t serial = 0;
+            uint32_t generation = 0;
+            float gain = 1.0f;
+        };
+
+        /* audio thread to loader: a stream to close, or with none, a request for the next track */
+        struct loader_request {
+            track_stream *stream = nullptr;
+            uint32_t generation = 0;
+        };
+
+        /* a track the loader has handed over, by serial, so a seek can find what is audible */
+        struct handed_track {
+            uint32_t serial;
+            std::string path;
+        };
+
+        /* a buffer on the source queue and which track frames it carries. each buffer belongs to one
+           track, its output frames advance that track by step frames each */
+        struct queued_buffer {
+            ALuint buffer;
+            uint32_t serial;
+            double start_frame;
+            double step;
+            drwav_uint64 frames;
+            uint64_t analysis_start;
+        };
+
+        /* tracks that may still have buffers on the source queue, indexed by serial. the path is
+           copied in rather than held as a string, so the audio thread never frees one */
+        struct track_meta {
+            uint32_t serial = 0;
+            char path[sizeof(playback_state::track)] = "";
+            float duration = 0.0f;
+            unsigned int sample_rate = 0;
+            float gain = 1.0f;
+        };
+
+        ALCdevice *_device = nullptr;
+        ALCcontext *_context = nullptr;
+        LPALCRENDERSAMPLESSOFT _render_samples = nullptr;
+
+        ALuint _source = 0;
+        ALuint _buffers[STREAM_BUFFER_COUNT] = {};
+
+        std::vector<ALuint> _free_buffers;
+        queued_buffer _queued[STREAM_BUFFER_COUNT] = {};
+        int _queued_head = 0;
+        int _queued_count = 0;
+
+        /* audio thread. the stream in slot i plays through mixer voice i. after a crossfade starts,
+           the outgoing track keeps playing from the other slot until its fade ends. the next track
+           waits outside both until the feed moves on to it */
+        track_stream *_slots[2] = {};
+        int _feed = 0;
+        track_stream *_next = nullptr;
+        uint32_t _next_serial = 0;
+        float _next_gain = 1.0f;
+        bool _next_requested = false;
+        uint32_t _generation = 0;
+
+        mixer _mixer;
+        uint64_t _crossfade_frames = 0;
+
+        track_meta _tracks[TRACK_HISTORY];
+        uint32_t _serial = 0;
+        uint32_t _audible_serial = 0;
+
+        /* loader thread */
+        track_stream _streams[STREAM_POOL];
+        std::vector<track_stream *> _free_streams;
+
+        std::deque<std::string> _queue;
+        std::deque<handed_track> _handed;
+        uint32_t _load_serial = 0;
+        uint32_t _load_generation = 0;
+        uint32_t _play_serial = 0;
+        bool _next_wanted = false;
+
+        audio_settings _settings;
+
+        ALenum _format = AL_NONE;
+        std::vector<float> _mix;
+        std::vector<int16_t> _mix_s16;
+        dither_state _dither;
+
+        sample_ring<ANALYSIS_CAPACITY> _analysis;
+        std::vector<float> _analysis_chunk;
+
+        playback_state _state = {};
+
+        spsc_queue<command, 64> _commands;
+        spsc_queue<loaded_track, 16> _loaded;
+        spsc_queue<loader_request, 16> _requests;
+        seqlock<playback_state> _snapshot;
+
+        std::thread _thread;
+        std::atomic<bool> _running{false};
+        std::mutex _wake_mutex;
+        std::condition_variable _wake;
+
+        std::thread _loader;
+        std::mutex _loader_mutex;
+        std::condition_variable _loader_wake;
+
+        void post(command cmd);
+
+        void loader_thread();
+        void drain_requests();
+        track_stream *acquire_stream();
+        track_stream *open_track(const std::string &path);
+        void hand(load_type type, track_stream *stream, const std::string &path);
+        float track_gain(const std::string &path) const;
+        void load_play(const std::string &path);
+        void load_seek(float seconds);
+        void load_next();
+        uint32_t audible_serial() const;
+
+        void audio_thread();
+        void receive(const loaded_track &loaded);
+        void recycle(track_stream *stream);
+        void release_slot(int slot);
+        void release_streams();
+        void request_next();
+
+        track_stream &feed() { return *_slots[_feed]; }
+        track_stream &next() { return *_next; }
+
+        void begin_playback();
+        void close_track(uint32_t serial);
+
+        bool advance();
+        void register_track(uint32_t serial, const track_stream *stream, float gain);
+        void start_voice(uint64_t fade_in);
+
+        void service_queue();
+        void publish_state();
+        void set_audible(uint32_t serial);
+
+        void publish_analysis(const float *mix, size_t frames);
+        size_t mix_chunk(size_t limit, double &start_frame, double &step);
+        bool fill_buffer(ALuint buffer, size_t limit = STREAM_CHUNK_FRAMES);
+        void fill_free_buffers();
+        void clear_queue();
+
+    public:
+        bool init(const audio_settings &settings);
+        void cleanup();
+
+        /* non-blocking, the audio thread picks these up on its next tick.
+           play() replaces the play queue with the tracks that should follow file */
+        void play(const std::string &file, std::vector<std::string> queue = {});
+        void enqueue(const std::string &file);
+        void stop();
+        void seek(float seconds);
+
+        playback_state get_state() const { return _snapshot.load(); }
+
+        /* loopback only: mixes the next frames of stereo float output into out */
+        bool render(float *out, size_t frames);
+
+        /* copies the count mono samples that end at playback_state::analysis_position, wait-free */
+        bool read_analysis(uint64_t end, float *out, size_t count) const { return _analysis.read(end, out, count); }
+};
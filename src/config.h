@@ -1,2 +1,21 @@
 #define WINDOW_BG_COLOR ImVec4(20.0f / 255.0f, 23.0f / 255.0f, 28.0f / 255, 1.0f);
 #define WINDOW_SECONDARY_COLOR ImVec4(600.f / 255.0f, 64.0f / 255.0f, 72.0f / 255.0f, 1.0f);
+
+#define LIBRARY_ROOT "../music"
+#define LIBRARY_DB_PATH "../library.db"
+#define PEAK_CACHE_DIR "../library.peaks"
+#define LOUDNESS_DB_PATH "../loudness.db"
+#define TRACE_EXPORT_PATH "../hexen-trace.json"
+#define LIBRARY_SETTLE_SECONDS 0.5
+
+#define PREFETCH_BUDGET_BYTES (4 * 1024 * 1024)
+#define DECODE_CACHE_BYTES (256 * 1024 * 1024)
+#define DITHER_TO_S16 true
+#define CROSSFADE_SECONDS 2.0f
+
+#define NORMALIZE_LOUDNESS true
+#define LOUDNESS_TARGET_LUFS -18.0f
+#define LOUDNESS_PEAK_CEILING_DBTP -1.0f
+
+#define PLAYING_REDRAW_INTERVAL (1.0 / 30.0)
+#define IDLE_REDRAW_INTERVAL 1.0
@@ -0,0 +1,192 @@
+#include "decoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#define DR_WAV_IMPLEMENTATION
+#include "../vendor/dr_wav.h"
+
+#include "flac_decoder.h"
+#include "mp3_decoder.h"
+
+static bool has_extension(const char *name, size_t length, const char *extension) {
+    const size_t extension_length = std::strlen(extension);
+    if (length <= extension_length) return false;
+
+    const char *suffix = name + length - extension_length;
+    for (size_t i = 0; i < extension_length; i++) {
+        if (std::tolower(static_cast<unsigned char>(suffix[i])) != extension[i]) return false;
+    }
+
+    return true;
+}
+
+bool codec_for_name(const char *name, size_t length, codec &out) {
+    if (has_extension(name, length, ".wav")) {
+        out = codec::wav;
+        return true;
+    }
+
+    if (has_extension(name, length, ".flac")) {
+        out = codec::flac;
+        return true;
+    }
+
+    if (has_extension(name, length, ".mp3")) {
+        out = codec::mp3;
+        return true;
+    }
+
+    return false;
+}
+
+void append_tag(std::string &tags, const char *text, size_t length) {
+    if (length == 0) return;
+
+    if (!tags.empty()) tags.push_back('\n');
+    tags.append(text, length);
+}
+
+bool read_whole_file(const std::string &path, std::vector<uint8_t> &out) {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    bool ok = std::fseek(file, 0, SEEK_END) == 0;
+    const long size = ok ? std::ftell(file) : -1;
+    ok = size >= 0 && std::fseek(file, 0, SEEK_SET) == 0;
+
+    if (ok) {
+        out.resize(static_cast<size_t>(size));
+        ok = std::fread(out.data(), 1, out.size(), file) == out.size();
+    }
+
+    std::fclose(file);
+    return ok;
+}
+
+/* wav */
+
+static bool source_format(const drwav &wav, sample_format &format) {
+    if (wav.translatedFormatTag == DR_WAVE_FORMAT_PCM) {
+        switch (wav.bitsPerSample) {
+            case 16: format = sample_format::s16; break;
+            case 24: format = sample_format::s24; break;
+            case 32: format = sample_format::s32; break;
+            default: return false;
+        }
+    } else if (wav.translatedFormatTag == DR_WAVE_FORMAT_IEEE_FLOAT && wav.bitsPerSample == 32) {
+        format = sample_format::f32;
+    } else {
+        return false;
+    }
+
+    /* padded containers (e.g. 24-bit in 32-bit slots) are left to dr_wav */
+    return wav.fmt.blockAlign == sample_size(format) * wav.channels;
+}
+
+/* pcm that sample_convert understands is handed out raw, straight from the mapping when there is
+   one, everything else (u8, adpcm, a-law, ...) is decoded to f32 by dr_wav */
+class wav_decoder : public decoder {
+    private:
+        drwav _wav = {};
+        bool _open = false;
+        bool _raw = false;
+        const uint8_t *_pcm = nullptr;
+
+    public:
+        ~wav_decoder() override {
+            if (_open) drwav_uninit(&_wav);
+        }
+
+        bool open(const std::string &path, const uint8_t *data, size_t size) override {
+            _open = data ? drwav_init_memory(&_wav, data, size, NULL) : drwav_init_file(&_wav, path.c_str(), NULL);
+            if (!_open) return false;
+
+            _channels = _wav.channels;
+            _sample_rate = _wav.sampleRate;
+            _bits_per_sample = _wav.bitsPerSample;
+            _frame_count = _wav.totalPCMFrameCount;
+
+            _raw = source_format(_wav, _source);
+            if (!_raw) _source = sample_format::f32;
+
+            /* wav is little-endian, so the mapped samples are only usable as-is on a little-endian host */
+            if (data && _raw && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) {
+                const uint64_t available = (size - _wav.dataChunkDataPos) / _wav.fmt.blockAlign;
+
+                _pcm = data + _wav.dataChunkDataPos;
+                _frame_count = std::min(_frame_count, available);
+            }
+
+            return true;
+        }
+
+        uint64_t read(uint64_t frames, void *out) override {
+            if (_raw) return drwav_read_pcm_frames(&_wav, frames, out);
+            return drwav_read_pcm_frames_f32(&_wav, frames, static_cast<float *>(out));
+        }
+
+        bool seek(uint64_t frame) override {
+            return _pcm || drwav_seek_to_pcm_frame(&_wav, frame);
+        }
+
+        const uint8_t *pcm() const override { return _pcm; }
+};
+
+/* the INFO fields worth searching on */
+static bool probe_wav(const std::string &path, track_probe &out) {
+    /* only the header and metadata chunks are parsed here, nothing is decoded */
+    drwav wav;
+    if (!drwav_init_file_with_metadata(&wav, path.c_str(), 0, NULL)) return false;
+
+    out.frame_count = wav.totalPCMFrameCount;
+    out.sample_rate = wav.sampleRate;
+    out.channels = wav.channels;
+
+    for (drwav_uint32 i = 0; i < wav.metadataCount; i++) {
+        const drwav_metadata &metadata = wav.pMetadata[i];
+
+        switch (metadata.type) {
+            case drwav_metadata_type_list_info_title:
+            case drwav_metadata_type_list_info_artist:
+            case drwav_metadata_type_list_info_album:
+            case drwav_metadata_type_list_info_genre:
+                break;
+            default:
+                continue;
+        }
+
+        const drwav_list_info_text &text = metadata.data.infoText;
+        if (text.pString == NULL) continue;
+
+        append_tag(out.tags, text.pString, strnlen(text.pString, text.stringLength));
+    }
+
+    drwav_uninit(&wav);
+    return true;
+}
+
+std::unique_ptr<decoder> make_decoder(codec format) {
+    switch (format) {
+        case codec::wav: return std::make_unique<wav_decoder>();
+        case codec::flac: return std::make_unique<flac_decoder>();
+        case codec::mp3: return std::make_unique<mp3_decoder>();
+    }
+
+    return nullptr;
+}
+
+bool probe_track(const std::string &path, track_probe &out) {
+    codec format;
+    if (!codec_for_name(path.data(), path.size(), format)) return false;
+
+    switch (format) {
+        case codec::wav: return probe_wav(path, out);
+        case codec::flac: return probe_flac(path, out);
+        case codec::mp3: return probe_mp3(path, out);
+    }
+
+    return false;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sample_convert.h"
+
+/* container formats a track can be stored in */
+enum class codec : uint8_t { wav, flac, mp3 };
+
+/* picks the codec from a file name's extension, false when this build cannot decode it */
+bool codec_for_name(const char *name, size_t length, codec &out);
+
+/* one format's parser and decoder, used by track_stream for everything except the mapped pcm it
+   converts itself.
+
+   data is the whole file, mapped by the caller and kept alive until the decoder is destroyed.
+   when the file could not be mapped it is null and the decoder reads path through stdio instead.
+   read() hands out frames in source(), whichever of the sample formats the codec produces
+   natively, and the caller converts them with sample_convert */
+class decoder {
+    protected:
+        unsigned int _channels = 0;
+        unsigned int _sample_rate = 0;
+        unsigned int _bits_per_sample = 0;
+        uint64_t _frame_count = 0;
+        sample_format _source = sample_format::f32;
+
+    public:
+        virtual ~decoder() = default;
+
+        virtual bool open(const std::string &path, const uint8_t *data, size_t size) = 0;
+        virtual uint64_t read(uint64_t frames, void *out) = 0;
+        virtual bool seek(uint64_t frame) = 0;
+
+        /* interleaved samples inside data in a format sample_convert reads directly, null when
+           they have to be decoded through read() */
+        virtual const uint8_t *pcm() const { return nullptr; }
+
+        unsigned int channels() const { return _channels; }
+        unsigned int sample_rate() const { return _sample_rate; }
+        unsigned int bits_per_sample() const { return _bits_per_sample; }
+        uint64_t frame_count() const { return _frame_count; }
+        sample_format source() const { return _source; }
+};
+
+std::unique_ptr<decoder> make_decoder(codec format);
+
+/* stream info and searchable tags (title, artist, album and genre, newline separated) for the
+   library scan, without decoding any audio */
+struct track_probe {
+    uint64_t frame_count = 0;
+    unsigned int sample_rate = 0;
+    unsigned int channels = 0;
+    std::string tags;
+};
+
+bool probe_track(const std::string &path, track_probe &out);
+
+/* appends one tag value to a newline separated list */
+void append_tag(std::string &tags, const char *text, size_t length);
+
+/* the whole file, for decoders that were handed no mapping */
+bool read_whole_file(const std::string &path, std::vector<uint8_t> &out);
@@ -0,0 +1,709 @@
+#include "flac_decoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+/* frames decoded from a bad one on are replaced by silence of the length its header gives, this
+   many bytes are searched for the next good header before giving up */
+static constexpr size_t RESYNC_LIMIT = 1024 * 1024;
+
+/* below this many bytes between the bounds a seek stops interpolating and walks the headers */
+static constexpr size_t SEEK_WALK_BYTES = 64 * 1024;
+
+/* reads big-endian bit fields. peek() returns the next 57 bits or more at the top of a word, past
+   the end of the data they read as zeros, and reading past the end sets failed */
+class bit_reader {
+    private:
+        const uint8_t *_data;
+        size_t _size;
+        size_t _bit;
+
+    public:
+        bool failed = false;
+
+        bit_reader(const uint8_t *data, size_t size, size_t byte) : _data(data), _size(size), _bit(byte * 8) {}
+
+        uint64_t peek() const {
+            const size_t byte = _bit >> 3;
+            uint64_t word = 0;
+
+            if (byte + 8 <= _size) {
+                std::memcpy(&word, _data + byte, 8);
+                word = __builtin_bswap64(word);
+            } else {
+                for (size_t i = 0; i < 8; i++) word = (word << 8) | (byte + i < _size ? _data[byte + i] : 0);
+            }
+
+            return word << (_bit & 7);
+        }
+
+        void skip(size_t bits) {
+            _bit += bits;
+            if (_bit > _size * 8) failed = true;
+        }
+
+        /* up to 32 bits */
+        uint32_t bits(unsigned int count) {
+            if (count == 0) return 0;
+
+            const uint32_t value = static_cast<uint32_t>(peek() >> (64 - count));
+            skip(count);
+            return value;
+        }
+
+        int32_t signed_bits(unsigned int count) {
+            if (count == 0) return 0;
+
+            const int64_t value = static_cast<int64_t>(peek()) >> (64 - count);
+            skip(count);
+            return static_cast<int32_t>(value);
+        }
+
+        /* zeros up to the next one, which is consumed */
+        uint32_t unary() {
+            uint32_t zeros = 0;
+
+            for (;;) {
+                const uint64_t word = peek();
+                if (word != 0) {
+                    const unsigned int count = __builtin_clzll(word);
+                    skip(count + 1);
+                    return zeros + count;
+                }
+
+                zeros += 56;
+                skip(56);
+                if (failed) return zeros;
+            }
+        }
+
+        /* rice coded, zigzag signed values with parameter k */
+        bool rice(int32_t *out, uint32_t count, unsigned int k) {
+            for (uint32_t i = 0; i < count; i++) {
+                uint64_t word = peek();
+                uint32_t quotient;
+
+                /* almost always the quotient and the remainder both sit in one word */
+                if (word != 0 && __builtin_clzll(word) + 1 + k <= 57) {
+                    quotient = __builtin_clzll(word);
+                    word <<= quotient + 1;
+                    _bit += quotient + 1 + k;
+                } else {
+                    quotient = unary();
+                    word = peek();
+                    _bit += k;
+                }
+
+                const uint32_t folded = (quotient << k) | (k ? static_cast<uint32_t>(word >> (64 - k)) : 0);
+                out[i] = static_cast<int32_t>(folded >> 1) ^ -static_cast<int32_t>(folded & 1);
+            }
+
+            if (_bit > _size * 8) failed = true;
+            return !failed;
+        }
+
+        void align() { _bit = (_bit + 7) & ~static_cast<size_t>(7); }
+        size_t byte() const { return _bit >> 3; }
+};
+
+static uint32_t big_endian(const uint8_t *p, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++) value = (value << 8) | p[i];
+    return value;
+}
+
+/* frame header checksum, polynomial x^8 + x^2 + x + 1 */
+static uint8_t crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+
+    return crc;
+}
+
+/* whole frame checksum, polynomial x^16 + x^15 + x^2 + 1, a byte at a time through a table */
+static uint16_t crc16(const uint8_t *data, size_t length) {
+    static const auto table = [] {
+        std::vector<uint16_t> out(256);
+
+        for (unsigned int i = 0; i < 256; i++) {
+            uint16_t crc = static_cast<uint16_t>(i << 8);
+            for (int bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+            out[i] = crc;
+        }
+
+        return out;
+    }();
+
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++) crc = static_cast<uint16_t>((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+static unsigned int channels_for(unsigned int assignment) {
+    return assignment < 8 ? assignment + 1 : 2;
+}
+
+bool flac_decoder::open(const std::string &path, const uint8_t *data, size_t size) {
+    if (!data) {
+        if (!read_whole_file(path, _file)) return false;
+
+        data = _file.data();
+        size = _file.size();
+    }
+
+    _data = data;
+    _size = size;
+
+    if (!parse_metadata()) return false;
+
+    _source = (_bits_per_sample <= 16) ? sample_format::s16 : sample_format::s32;
+    _samples.resize(static_cast<size_t>(_max_block) * _channels);
+
+    /* streaminfo may leave the length unknown, counting the frames is the only way to get it */
+    if (_frame_count == 0) _frame_count = count_frames();
+
+    _next = _first_frame;
+    _next_sample = 0;
+    return true;
+}
+
+/* STREAMINFO comes first and is all the decoding needs, SEEKTABLE narrows seeks down and anything
+   else is skipped */
+bool flac_decoder::parse_metadata() {
+    if (_size < 8 || std::memcmp(_data, "fLaC", 4) != 0) return false;
+
+    size_t pos = 4;
+    bool found_info = false;
+
+    for (bool last = false; !last;) {
+        if (pos + 4 > _size) return false;
+
+        last = (_data[pos] & 0x80) != 0;
+        const unsigned int type = _data[pos] & 0x7F;
+        const size_t length = big_endian(_data + pos + 1, 3);
+
+        pos += 4;
+        if (length > _size - pos) return false;
+
+        const uint8_t *block = _data + pos;
+
+        if (type == 0 && length >= 34) {
+            _min_block = big_endian(block, 2);
+            _max_block = big_endian(block + 2, 2);
+            _sample_rate = big_endian(block + 10, 3) >> 4;
+            _channels = ((block[12] >> 1) & 0x07) + 1;
+            _bits_per_sample = (((block[12] & 0x01) << 4) | (block[13] >> 4)) + 1;
+            _frame_count = (static_cast<uint64_t>(block[13] & 0x0F) << 32) | big_endian(block + 14, 4);
+            found_info = true;
+        } else if (type == 3) {
+            /* offsets count from the first frame, placeholders have all bits of the sample set */
+            for (size_t i = 0; i + 18 <= length; i += 18) {
+                const uint64_t sample = (static_cast<uint64_t>(big_endian(block + i, 4)) << 32) | big_endian(block + i + 4, 4);
+                const uint64_t offset = (static_cast<uint64_t>(big_endian(block + i + 8, 4)) << 32) | big_endian(block + i + 12, 4);
+                if (sample == UINT64_MAX) continue;
+
+                _seek_table.push_back({ sample, static_cast<size_t>(std::min<uint64_t>(offset, SIZE_MAX)) });
+            }
+        }
+
+        pos += length;
+    }
+
+    _first_frame = pos;
+    for (seek_point &point : _seek_table) point.offset = std::min(_size, _first_frame + std::min(point.offset, _size));
+
+    if (!found_info || _sample_rate == 0 || _bits_per_sample < 4 || _max_block < 16 || _min_block > _max_block) return false;
+
+    /* points go in ascending order, a table that does not is ignored */
+    for (size_t i = 1; i < _seek_table.size(); i++) {
+        if (_seek_table[i].sample <= _seek_table[i - 1].sample || _seek_table[i].offset < _seek_table[i - 1].offset) {
+            _seek_table.clear();
+            break;
+        }
+    }
+
+    return true;
+}
+
+/* parses and checksums the frame header at pos, false when the bytes there are not one of this
+   stream's */
+bool flac_decoder::parse_header(size_t pos, frame_header &out) const {
+    const uint8_t *p = _data + pos;
+    const size_t available = _size - pos;
+
+    if (available < 6 || p[0] != 0xFF || (p[1] & 0xFE) != 0xF8) return false;
+
+    const unsigned int block_code = p[2] >> 4;
+    const unsigned int rate_code = p[2] & 0x0F;
+    const unsigned int assignment = p[3] >> 4;
+    const unsigned int size_code = (p[3] >> 1) & 0x07;
+
+    if (block_code == 0 || rate_code == 15 || assignment > 10 || size_code == 3 || (p[3] & 1)) return false;
+    if (channels_for(assignment) != _channels) return false;
+
+    /* the number is utf-8 coded, one to seven bytes */
+    size_t n = 4;
+    const uint8_t lead = p[n++];
+    uint64_t number = 0;
+    int extra = 0;
+
+    if (lead < 0x80) { number = lead; extra = 0; }
+    else if ((lead & 0xE0) == 0xC0) { number = lead & 0x1F; extra = 1; }
+    else if ((lead & 0xF0) == 0xE0) { number = lead & 0x0F; extra = 2; }
+    else if ((lead & 0xF8) == 0xF0) { number = lead & 0x07; extra = 3; }
+    else if ((lead & 0xFC) == 0xF8) { number = lead & 0x03; extra = 4; }
+    else if ((lead & 0xFE) == 0xFC) { number = lead & 0x01; extra = 5; }
+    else if (lead == 0xFE) { number = 0; extra = 6; }
+    else return false;
+
+    const size_t block_bytes = (block_code == 6) ? 1 : (block_code == 7) ? 2 : 0;
+    const size_t rate_bytes = (rate_code == 12) ? 1 : (rate_code == 13 || rate_code == 14) ? 2 : 0;
+    if (n + extra + block_bytes + rate_bytes + 1 > available) return false;
+
+    for (int i = 0; i < extra; i++) {
+        const uint8_t byte = p[n++];
+        if ((byte & 0xC0) != 0x80) return false;
+        number = (number << 6) | (byte & 0x3F);
+    }
+
+    uint32_t block;
+    if (block_code == 1) block = 192;
+    else if (block_code <= 5) block = 576u << (block_code - 2);
+    else if (block_code == 6) block = p[n] + 1u;
+    else if (block_code == 7) block = big_endian(p + n, 2) + 1u;
+    else block = 256u << (block_code - 8);
+
+    n += block_bytes + rate_bytes;
+    if (crc8(p, n) != p[n]) return false;
+
+    static const unsigned int SIZES[] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+    const unsigned int bits = size_code ? SIZES[size_code] : _bits_per_sample;
+
+    /* a header that checksums but does not fit the stream is compressed data that looks like one */
+    if (block > _max_block || bits != _bits_per_sample) return false;
+
+    const bool variable = (p[1] & 1) != 0;
+
+    out.sample = variable ? number : number * _max_block;
+    out.block = block;
+    out.assignment = assignment;
+    out.bits = bits;
+    out.length = n + 1;
+
+    /* the frame would start past the end of the stream */
+    if (_frame_count && out.sample >= _frame_count) return false;
+    return true;
+}
+
+/* the first frame header in [from, to) */
+bool flac_decoder::find_frame(size_t from, size_t to, size_t &pos, frame_header &header) const {
+    to = std::min(to, _size);
+
+    while (from + 1 < to) {
+        const void *sync = std::memchr(_data + from, 0xFF, to - from - 1);
+        if (!sync) return false;
+
+        from = static_cast<const uint8_t *>(sync) - _data;
+        if (parse_header(from, header)) {
+            pos = from;
+            return true;
+        }
+
+        from++;
+    }
+
+    return false;
+}
+
+/* residual of a fixed or lpc subframe, after the warm-up samples */
+static bool decode_residual(bit_reader &bits, int32_t *out, uint32_t block, unsigned int order) {
+    const unsigned int method = bits.bits(2);
+    if (method > 1) return false;
+
+    const unsigned int parameter_bits = method == 0 ? 4 : 5;
+    const unsigned int escape = method == 0 ? 15 : 31;
+    const unsigned int partition_order = bits.bits(4);
+
+    const uint32_t partition_size = block >> partition_order;
+    if ((partition_size << partition_order) != block || partition_size < order) return false;
+
+    uint32_t i = order;
+
+    for (uint32_t partition = 0; partition < (1u << partition_order); partition++) {
+        const uint32_t count = partition_size - (partition == 0 ? order : 0);
+        const unsigned int k = bits.bits(parameter_bits);
+
+        if (k == escape) {
+            const unsigned int width = bits.bits(5);
+            for (uint32_t j = 0; j < count; j++) out[i + j] = bits.signed_bits(width);
+        } else if (!bits.rice(out + i, count, k)) {
+            return false;
+        }
+
+        i += count;
+    }
+
+    return !bits.failed;
+}
+
+/* predictions are summed in 64 bits, 32-bit sources and their side channels overflow 32 */
+static void restore_fixed(int32_t *s, uint32_t block, unsigned int order) {
+    switch (order) {
+        case 1:
+            for (uint32_t i = 1; i < block; i++) s[i] += s[i - 1];
+            break;
+        case 2:
+            for (uint32_t i = 2; i < block; i++) s[i] = static_cast<int32_t>(s[i] + 2 * int64_t(s[i - 1]) - s[i - 2]);
+            break;
+        case 3:
+            for (uint32_t i = 3; i < block; i++) s[i] = static_cast<int32_t>(s[i] + 3 * (int64_t(s[i - 1]) - s[i - 2]) + s[i - 3]);
+            break;
+        case 4:
+            for (uint32_t i = 4; i < block; i++) s[i] = static_cast<int32_t>(s[i] + 4 * (int64_t(s[i - 1]) + s[i - 3]) - 6 * int64_t(s[i - 2]) - s[i - 4]);
+            break;
+        default:
+            break;
+    }
+}
+
+static void restore_lpc(int32_t *s, uint32_t block, const int32_t *coefficients, unsigned int order, int shift) {
+    for (uint32_t i = order; i < block; i++) {
+        int64_t sum = 0;
+        for (unsigned int j = 0; j < order; j++) sum += static_cast<int64_t>(coefficients[j]) * s[i - 1 - j];
+        s[i] = static_cast<int32_t>(s[i] + (sum >> shift));
+    }
+}
+
+static bool decode_subframe(bit_reader &bits, int32_t *out, uint32_t block, unsigned int sample_bits) {
+    if (bits.bits(1) != 0) return false;
+
+    const unsigned int type = bits.bits(6);
+
+    unsigned int wasted = 0;
+    if (bits.bits(1)) wasted = bits.unary() + 1;
+    if (wasted >= sample_bits) return false;
+
+    sample_bits -= wasted;
+
+    if (type == 0) {
+        const int32_t value = bits.signed_bits(sample_bits);
+        std::fill(out, out + block, value);
+    } else if (type == 1) {
+        for (uint32_t i = 0; i < block; i++) out[i] = bits.signed_bits(sample_bits);
+    } else if (type >= 8 && type <= 12) {
+        const unsigned int order = type - 8;
+        if (order > block) return false;
+
+        for (unsigned int i = 0; i < order; i++) out[i] = bits.signed_bits(sample_bits);
+        if (!decode_residual(bits, out, block, order)) return false;
+
+        restore_fixed(out, block, order);
+    } else if (type >= 32) {
+        const unsigned int order = type - 31;
+        if (order > block) return false;
+
+        for (unsigned int i = 0; i < order; i++) out[i] = bits.signed_bits(sample_bits);
+
+        const unsigned int precision = bits.bits(4) + 1;
+        const int shift = bits.signed_bits(5);
+        if (precision == 16 || shift < 0) return false;
+
+        int32_t coefficients[32];
+        for (unsigned int i = 0; i < order; i++) coefficients[i] = bits.signed_bits(precision);
+
+        if (!decode_residual(bits, out, block, order)) return false;
+        restore_lpc(out, block, coefficients, order, shift);
+    } else {
+        return false;
+    }
+
+    if (wasted) {
+        for (uint32_t i = 0; i < block; i++) out[i] = static_cast<int32_t>(static_cast<uint32_t>(out[i]) << wasted);
+    }
+
+    return !bits.failed;
+}
+
+/* decodes the frame at pos into _samples and checks its crc, end is where the next one starts */
+bool flac_decoder::decode_frame(size_t pos, const frame_header &header, size_t &end) {
+    bit_reader bits(_data, _size, pos + header.length);
+    const uint32_t block = header.block;
+
+    for (unsigned int channel = 0; channel < _channels; channel++) {
+        /* the side channel of a stereo pair is one bit wider */
+        unsigned int sample_bits = header.bits;
+        if ((header.assignment == 8 && channel == 1) || (header.assignment == 9 && channel == 0) || (header.assignment == 10 && channel == 1)) sample_bits++;
+
+        if (!decode_subframe(bits, _samples.data() + channel * _max_block, block, sample_bits)) return false;
+    }
+
+    bits.align();
+    if (bits.failed || bits.byte() + 2 > _size) return false;
+
+    end = bits.byte() + 2;
+    if (crc16(_data + pos, end - 2 - pos) != big_endian(_data + end - 2, 2)) return false;
+
+    int32_t *left = _samples.data();
+    int32_t *right = _samples.data() + _max_block;
+
+    switch (header.assignment) {
+        case 8:
+            for (uint32_t i = 0; i < block; i++) right[i] = left[i] - right[i];
+            break;
+        case 9:
+            for (uint32_t i = 0; i < block; i++) left[i] += right[i];
+            break;
+        case 10:
+            for (uint32_t i = 0; i < block; i++) {
+                const int32_t side = right[i];
+                const int32_t mid = static_cast<int32_t>(static_cast<uint32_t>(left[i]) << 1) | (side & 1);
+                left[i] = (mid + side) >> 1;
+                right[i] = (mid - side) >> 1;
+            }
+            break;
+        default:
+            break;
+    }
+
+    _block_frames = block;
+    _block_read = 0;
+    return true;
+}
+
+/* a frame that does not decode plays as silence, from its header's length up to the next good
+   one. with no header there is nothing left to play */
+void flac_decoder::skip_bad_frame() {
+    frame_header header;
+    if (!parse_header(_next, header)) {
+        _next = _size;
+        return;
+    }
+
+    std::fill(_samples.begin(), _samples.end(), 0);
+    _block_frames = header.block;
+    _block_read = 0;
+
+    size_t pos;
+    frame_header following;
+    _next = find_frame(_next + 1, _next + RESYNC_LIMIT, pos, following) ? pos : _size;
+}
+
+uint64_t flac_decoder::read(uint64_t frames, void *out) {
+    uint64_t done = 0;
+
+    while (done < frames && _next_sample < _frame_count) {
+        if (_block_read == _block_frames) {
+            frame_header header;
+            size_t end = 0;
+
+            if (_next >= _size) break;
+
+            if (parse_header(_next, header) && decode_frame(_next, header, end)) {
+                _next = end;
+            } else {
+                skip_bad_frame();
+            }
+
+            continue;
+        }
+
+        const uint64_t count = std::min<uint64_t>({ frames - done, _block_frames - _block_read, _frame_count - _next_sample });
+        const int32_t *in = _samples.data() + _block_read;
+
+        /* interleaved and left-justified in the output format */
+        if (_source == sample_format::s16) {
+            int16_t *samples = static_cast<int16_t *>(out) + done * _channels;
+            const unsigned int shift = 16 - _bits_per_sample;
+
+            for (unsigned int channel = 0; channel < _channels; channel++) {
+                const int32_t *run = in + channel * _max_block;
+                for (uint64_t i = 0; i < count; i++) samples[i * _channels + channel] = static_cast<int16_t>(run[i] << shift);
+            }
+        } else {
+            int32_t *samples = static_cast<int32_t *>(out) + done * _channels;
+            const unsigned int shift = 32 - _bits_per_sample;
+
+            for (unsigned int channel = 0; channel < _channels; channel++) {
+                const int32_t *run = in + channel * _max_block;
+                for (uint64_t i = 0; i < count; i++) samples[i * _channels + channel] = static_cast<int32_t>(static_cast<uint32_t>(run[i]) << shift);
+            }
+        }
+
+        _block_read += static_cast<uint32_t>(count);
+        _next_sample += count;
+        done += count;
+    }
+
+    return done;
+}
+
+bool flac_decoder::seek(uint64_t frame) {
+    if (frame >= _frame_count) {
+        _next = _size;
+        _next_sample = _frame_count;
+        _block_frames = _block_read = 0;
+        return true;
+    }
+
+    /* the seek table points on either side of the target bound the search */
+    seek_point low = { 0, _first_frame };
+    seek_point high = { _frame_count, _size };
+
+    for (const seek_point &point : _seek_table) {
+        if (point.sample <= frame && point.offset >= low.offset) low = point;
+        if (point.sample > frame && point.sample < high.sample) high = point;
+    }
+
+    /* interpolate between the bounds, landing a little early so the frame found after the guess
+       is before the target rather than after it */
+    for (int attempt = 0; attempt < 64 && high.offset - low.offset > SEEK_WALK_BYTES; attempt++) {
+        const double fraction = static_cast<double>(frame - low.sample) / static_cast<double>(high.sample - low.sample);
+        size_t guess = low.offset + static_cast<size_t>(fraction * (high.offset - low.offset));
+        guess = (guess > low.offset + SEEK_WALK_BYTES / 4) ? guess - SEEK_WALK_BYTES / 4 : low.offset;
+        guess = std::min(guess, high.offset - 1);
+
+        size_t pos;
+        frame_header header;
+        if (!find_frame(guess, high.offset, pos, header)) {
+            high.offset = guess;
+            continue;
+        }
+
+        if (header.sample > frame) {
+            high = { header.sample, pos };
+        } else if (frame < header.sample + header.block || pos == low.offset) {
+            low = { header.sample, pos };
+            break;
+        } else {
+            low = { header.sample, pos };
+        }
+    }
+
+    /* then walk the headers from the lower bound to the frame holding the target, decoding only
+       that one */
+    size_t pos = low.offset;
+    frame_header header;
+
+    while (find_frame(pos, _size, pos, header)) {
+        size_t end;
+
+        if (header.sample > frame) {
+            /* past the target, unless this is compressed data that only looks like a header */
+            if (decode_frame(pos, header, end)) return false;
+        } else if (frame < header.sample + header.block && decode_frame(pos, header, end)) {
+            _next = end;
+            _block_read = static_cast<uint32_t>(frame - header.sample);
+            _next_sample = frame;
+            return true;
+        }
+
+        pos += header.length;
+    }
+
+    return false;
+}
+
+/* the length of a stream whose STREAMINFO leaves it out: where the last frame header ends */
+uint64_t flac_decoder::count_frames() const {
+    uint64_t total = 0;
+    size_t pos = _first_frame;
+    frame_header header;
+
+    while (find_frame(pos, _size, pos, header)) {
+        total = std::max(total, header.sample + header.block);
+        pos += header.length;
+    }
+
+    return total;
+}
+
+/* vorbis comment keys are case-insensitive */
+static bool searchable_comment(const char *key, size_t length) {
+    static const char *const KEYS[] = { "title", "artist", "album", "genre" };
+
+    for (const char *wanted : KEYS) {
+        if (std::strlen(wanted) != length) continue;
+
+        size_t i = 0;
+        while (i < length && std::tolower(static_cast<unsigned char>(key[i])) == wanted[i]) i++;
+        if (i == length) return true;
+    }
+
+    return false;
+}
+
+static uint32_t little_endian(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void read_vorbis_comments(const uint8_t *block, size_t length, std::string &tags) {
+    if (length < 8) return;
+
+    size_t pos = 4 + little_endian(block);
+    if (pos + 4 > length) return;
+
+    const uint32_t count = little_endian(block + pos);
+    pos += 4;
+
+    for (uint32_t i = 0; i < count && pos + 4 <= length; i++) {
+        const size_t size = little_endian(block + pos);
+        pos += 4;
+        if (size > length - pos) return;
+
+        const char *comment = reinterpret_cast<const char *>(block + pos);
+        const char *equals = static_cast<const char *>(std::memchr(comment, '=', size));
+        if (equals && searchable_comment(comment, equals - comment)) append_tag(tags, equals + 1, size - (equals + 1 - comment));
+
+        pos += size;
+    }
+}
+
+bool probe_flac(const std::string &path, track_probe &out) {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    uint8_t head[4];
+    bool found_info = false;
+
+    if (std::fread(head, 1, 4, file) != 4 || std::memcmp(head, "fLaC", 4) != 0) {
+        std::fclose(file);
+        return false;
+    }
+
+    std::vector<uint8_t> block;
+
+    for (bool last = false; !last;) {
+        if (std::fread(head, 1, 4, file) != 4) break;
+
+        last = (head[0] & 0x80) != 0;
+        const unsigned int type = head[0] & 0x7F;
+        const size_t length = big_endian(head + 1, 3);
+
+        /* only streaminfo and the comments are read, pictures and padding are skipped over */
+        if (type != 0 && type != 4) {
+            if (std::fseek(file, static_cast<long>(length), SEEK_CUR) != 0) break;
+            continue;
+        }
+
+        block.resize(length);
+        if (std::fread(block.data(), 1, length, file) != length) break;
+
+        if (type == 0 && length >= 34) {
+            out.sample_rate = big_endian(block.data() + 10, 3) >> 4;
+            out.channels = ((block[12] >> 1) & 0x07) + 1;
+            out.frame_count = (static_cast<uint64_t>(block[13] & 0x0F) << 32) | big_endian(block.data() + 14, 4);
+            found_info = true;
+        } else if (type == 4) {
+            read_vorbis_comments(block.data(), length, out.tags);
+        }
+    }
+
+    std::fclose(file);
+    return found_info;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decoder.h"
+
+/* native flac, decoded a frame at a time from the mapping (or from the whole file read into memory
+   when it could not be mapped). 16-bit and narrower streams come out as s16, wider ones as s32,
+   both left-justified.
+
+   frames carry their own frame or sample number, so a seek needs no table of every frame: it
+   narrows down the byte range through the stream's SEEKTABLE when there is one, then interpolates
+   between the frame headers it finds until it lands on the frame holding the target. only that
+   frame is decoded, whatever the length of the file */
+class flac_decoder : public decoder {
+    private:
+        struct seek_point {
+            uint64_t sample;
+            size_t offset;
+        };
+
+        struct frame_header {
+            uint64_t sample = 0;
+            uint32_t block = 0;
+            unsigned int assignment = 0;
+            unsigned int bits = 0;
+            size_t length = 0;
+        };
+
+        std::vector<uint8_t> _file;
+        const uint8_t *_data = nullptr;
+        size_t _size = 0;
+        size_t _first_frame = 0;
+
+        uint32_t _min_block = 0;
+        uint32_t _max_block = 0;
+        std::vector<seek_point> _seek_table;
+
+        /* the decoded frame, one run of _max_block samples per channel */
+        std::vector<int32_t> _samples;
+        uint32_t _block_frames = 0;
+        uint32_t _block_read = 0;
+
+        size_t _next = 0;
+        uint64_t _next_sample = 0;
+
+        bool parse_metadata();
+        bool parse_header(size_t pos, frame_header &out) const;
+        bool find_frame(size_t from, size_t to, size_t &pos, frame_header &header) const;
+        bool decode_frame(size_t pos, const frame_header &header, size_t &end);
+        void skip_bad_frame();
+        uint64_t count_frames() const;
+
+    public:
+        bool open(const std::string &path, const uint8_t *data, size_t size) override;
+        uint64_t read(uint64_t frames, void *out) override;
+        bool seek(uint64_t frame) override;
+};
+
+/* stream info from STREAMINFO and title, artist, album and genre from the vorbis comment block,
+   reading only the metadata at the head of the file */
+bool probe_flac(const std::string &path, track_probe &out);
@@ -0,0 +1,287 @@
+#include "library_db.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "decoder.h"
+#include "library_index.h"
+
+namespace fs = std::filesystem;
+
+static const char DB_MAGIC[8] = { 'h', 'e', 'x', 'e', 'n', 'd', 'b', '\0' };
+
+bool library_db::load(const std::string &path) {
+    _path = path;
+    return map();
+}
+
+bool library_db::map() {
+    _records = nullptr;
+    _strings = nullptr;
+    _count = 0;
+
+    if (!_file.open(_path)) return false;
+
+    const uint8_t *data = _file.data();
+    const size_t size = _file.size();
+
+    db_header header;
+    if (size < sizeof(header)) { _file.close(); return false; }
+    std::memcpy(&header, data, sizeof(header));
+
+    const uint64_t records_size = static_cast<uint64_t>(header.record_count) * sizeof(db_record);
+    if (std::memcmp(header.magic, DB_MAGIC, sizeof(DB_MAGIC)) != 0 || header.version != VERSION ||
+        sizeof(header) + records_size + header.strings_size != size) {
+        std::cerr << "ignoring stale library database: " << _path << "\n";
+        _file.close();
+        return false;
+    }
+
+    const db_record *records = reinterpret_cast<const db_record *>(data + sizeof(header));
+    for (uint32_t i = 0; i < header.record_count; i++) {
+        if (static_cast<uint64_t>(records[i].path_offset) + records[i].path_length > header.strings_size ||
+            static_cast<uint64_t>(records[i].tags_offset) + records[i].tags_length > header.strings_size) {
+            std::cerr << "ignoring corrupt library database: " << _path << "\n";
+            _file.close();
+            return false;
+        }
+    }
+
+    _records = records;
+    _strings = reinterpret_cast<const char *>(data + sizeof(header) + records_size);
+    _count = header.record_count;
+    return true;
+}
+
+void library_db::cleanup() {
+    _cancel = true;
+    if (_worker.joinable()) _worker.join();
+
+    _worker_running = false;
+    _file.close();
+
+    _records = nullptr;
+    _strings = nullptr;
+    _count = 0;
+}
+
+const db_record *library_db::find(std::string_view path) const {
+    const db_record *end = _records + _count;
+    const db_record *it = std::lower_bound(_records, end, path, [this](const db_record &record, std::string_view value) {
+        return this->path(record) < value;
+    });
+
+    return (it != end && this->path(*it) == path) ? it : nullptr;
+}
+
+void library_db::revalidate(const std::string &root) {
+    start(root, {}, true);
+}
+
+void library_db::revalidate(const std::string &root, std::vector<std::string> paths) {
+    if (!paths.empty()) start(root, std::move(paths), false);
+}
+
+void library_db::start(const std::string &root, std::vector<std::string> paths, bool full) {
+    _root = root;
+
+    /* changes that arrive mid-pass are gathered up for one more pass once this one is done */
+    if (_worker_running) {
+        _rerun = true;
+        _rerun_full = _rerun_full || full;
+        _rerun_paths.insert(_rerun_paths.end(), paths.begin(), paths.end());
+        return;
+    }
+
+    _worker_running = true;
+    _worker_done = false;
+    _cancel = false;
+    _worker = std::thread(&library_db::revalidate_thread, this, root, std::move(paths), full);
+}
+
+bool library_db::poll() {
+    if (!_worker_running || !_worker_done) return false;
+
+    _worker.join();
+    _worker_running = false;
+
+    map();
+
+    if (_rerun) {
+        std::vector<std::string> paths;
+        paths.swap(_rerun_paths);
+
+        const bool full = _rerun_full;
+        _rerun = false;
+        _rerun_full = false;
+
+        start(_root, std::move(paths), full);
+    }
+
+    return true;
+}
+
+void library_db::add_record(const std::string &path, bool directory, std::vector<db_record> &records, std::string &strings) const {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return;
+
+    db_record record = {};
+    std::string tags;
+    record.kind = static_cast<uint8_t>(directory ? entry_kind::directory : entry_kind::track);
+    record.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+    if (!directory) {
+        record.size = static_cast<uint64_t>(st.st_size);
+
+        const db_record *known = find(path);
+        if (known && known->kind == record.kind && known->size == record.size && known->mtime == record.mtime) {
+            record.frame_count = known->frame_count;
+            record.sample_rate = known->sample_rate;
+            record.channels = known->channels;
+            tags.assign(this->tags(*known));
+        } else {
+            track_probe probe;
+            if (probe_track(path, probe)) {
+                record.frame_count = probe.frame_count;
+                record.sample_rate = probe.sample_rate;
+                record.channels = probe.channels;
+                tags = std::move(probe.tags);
+            }
+        }
+    }
+
+    record.path_offset = static_cast<uint32_t>(strings.size());
+    record.path_length = static_cast<uint32_t>(path.size());
+    strings += path;
+
+    record.tags_offset = static_cast<uint32_t>(strings.size());
+    record.tags_length = static_cast<uint32_t>(tags.size());
+    strings += tags;
+
+    records.push_back(record);
+}
+
+/* everything below root, not root itself */
+void library_db::add_tree(const std::string &root, std::vector<db_record> &records, std::string &strings) const {
+    std::error_code ec;
+    fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+
+    for (; !ec && it != end && !_cancel; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+
+        const bool directory = it->is_directory(ec);
+        if (!directory && !(it->is_regular_file(ec) && is_audio_file(name.data(), name.size()))) continue;
+
+        add_record(it->path().string(), directory, records, strings);
+    }
+}
+
+void library_db::revalidate_thread(std::string root, std::vector<std::string> paths, bool full) {
+    std::vector<db_record> records;
+    std::string strings;
+
+    if (full) {
+        add_tree(root, records, strings);
+    } else {
+        while (root.size() > 1 && root.back() == '/') root.pop_back();
+
+        /* shortest first, so a changed directory is taken before anything inside it, which its walk
+           already covers */
+        std::sort(paths.begin(), paths.end(), [](const std::string &a, const std::string &b) {
+            return a.size() != b.size() ? a.size() < b.size() : a < b;
+        });
+
+        auto changed_under = [](const std::unordered_set<std::string_view> &changed, std::string_view path) {
+            for (;;) {
+                if (changed.count(path)) return true;
+
+                const size_t slash = path.rfind('/');
+                if (slash == std::string_view::npos || slash == 0) return false;
+                path = path.substr(0, slash);
+            }
+        };
+
+        std::unordered_set<std::string_view> changed;
+        std::vector<std::string_view> order;
+
+        for (const std::string &path : paths) {
+            if (path.size() <= root.size() || path.compare(0, root.size(), root) != 0 || path[root.size()] != '/') continue;
+            if (changed_under(changed, path)) continue;
+
+            changed.insert(path);
+            order.push_back(path);
+        }
+
+        /* every record outside the changed paths stays as it is */
+        for (uint32_t i = 0; i < _count && !_cancel; i++) {
+            const db_record &known = _records[i];
+            if (changed_under(changed, this->path(known))) continue;
+
+            db_record record = known;
+            record.path_offset = static_cast<uint32_t>(strings.size());
+            strings += this->path(known);
+            record.tags_offset = static_cast<uint32_t>(strings.size());
+            strings += this->tags(known);
+
+            records.push_back(record);
+        }
+
+        /* and whatever is there now replaces the rest, gone files simply don't come back */
+        for (std::string_view changed_path : order) {
+            if (_cancel) break;
+
+            const std::string path(changed_path);
+            const std::string name = fs::path(path).filename().string();
+
+            std::error_code ec;
+            const fs::file_status status = fs::status(path, ec);
+
+            if (fs::is_directory(status)) {
+                add_record(path, true, records, strings);
+                add_tree(path, records, strings);
+            } else if (fs::is_regular_file(status) && is_audio_file(name.data(), name.size())) {
+                add_record(path, false, records, strings);
+            }
+        }
+    }
+
+    if (_cancel) return;
+
+    std::sort(records.begin(), records.end(), [&strings](const db_record &a, const db_record &b) {
+        return std::string_view(strings.data() + a.path_offset, a.path_length) <
+               std::string_view(strings.data() + b.path_offset, b.path_length);
+    });
+
+    db_header header = {};
+    std::memcpy(header.magic, DB_MAGIC, sizeof(DB_MAGIC));
+    header.version = VERSION;
+    header.record_count = static_cast<uint32_t>(records.size());
+    header.strings_size = strings.size();
+
+    const std::string temp_path = _path + ".tmp";
+    FILE *file = std::fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        std::cerr << "failed to write library database: " << temp_path << "\n";
+        _worker_done = true;
+        return;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!records.empty()) ok = ok && std::fwrite(records.data(), sizeof(db_record), records.size(), file) == records.size();
+    if (!strings.empty()) ok = ok && std::fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok || std::rename(temp_path.c_str(), _path.c_str()) != 0) {
+        std::cerr << "failed to write library database: " << _path << "\n";
+        std::remove(temp_path.c_str());
+    }
+
+    _worker_done = true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+
+/* on-disk layout: db_header, then header.record_count db_records sorted by path, then the string blob
+   holding paths and tags. everything is used in place from the mapping, nothing is parsed at startup */
+struct db_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_count;
+    uint64_t strings_size;
+};
+
+struct db_record {
+    uint32_t path_offset;
+    uint32_t path_length;
+
+    uint64_t size;
+    int64_t mtime;
+    uint64_t frame_count;
+
+    uint32_t sample_rate;
+    uint16_t channels;
+    uint8_t kind;
+    uint8_t reserved;
+
+    /* riff INFO title, artist, album and genre, one per line */
+    uint32_t tags_offset;
+    uint32_t tags_length;
+};
+
+static_assert(sizeof(db_header) == 24, "db_header layout changed");
+static_assert(sizeof(db_record) == 48, "db_record layout changed");
+
+class library_db {
+    private:
+        static constexpr uint32_t VERSION = 2;
+
+        std::string _path;
+        mapped_file _file;
+
+        const db_record *_records = nullptr;
+        const char *_strings = nullptr;
+        uint32_t _count = 0;
+
+        std::thread _worker;
+        std::atomic<bool> _worker_done{false};
+        std::atomic<bool> _cancel{false};
+        bool _worker_running = false;
+        bool _rerun = false;
+        bool _rerun_full = false;
+        std::string _root;
+        std::vector<std::string> _rerun_paths;
+
+        bool map();
+        void start(const std::string &root, std::vector<std::string> paths, bool full);
+        void revalidate_thread(std::string root, std::vector<std::string> paths, bool full);
+
+        void add_record(const std::string &path, bool directory, std::vector<db_record> &records, std::string &strings) const;
+        void add_tree(const std::string &root, std::vector<db_record> &records, std::string &strings) const;
+
+    public:
+        /* maps the database at path, an absent or corrupt file just leaves it empty */
+        bool load(const std::string &path);
+        void cleanup();
+
+        /* walks root in the background, re-reading track headers only for files whose size or mtime
+           changed, then rewrites the database. poll() remaps it once the pass is finished */
+        void revalidate(const std::string &root);
+
+        /* the same, but only re-reads the given files and directory trees under root and keeps every
+           other record as it is */
+        void revalidate(const std::string &root, std::vector<std::string> paths);
+        bool poll();
+
+        uint32_t size() const { return _count; }
+        const db_record &record(uint32_t index) const { return _records[index]; }
+        std::string_view path(const db_record &record) const { return std::string_view(_strings + record.path_offset, record.path_length); }
+        std::string_view tags(const db_record &record) const { return std::string_view(_strings + record.tags_offset, record.tags_length); }
+
+        const db_record *find(std::string_view path) const;
+};
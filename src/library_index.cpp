@@ -0,0 +1,321 @@
+#include "library_index.h"
+#include "decoder.h"
+#include "library_db.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef __linux__
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static std::string normalize_path(const std::string &path) {
+    std::string normalized = fs::path(path).lexically_normal().string();
+    while (normalized.size() > 1 && normalized.back() == '/') normalized.pop_back();
+    return normalized;
+}
+
+static track_info record_info(const db_record &record) {
+    track_info info;
+    info.size = record.size;
+    info.frame_count = record.frame_count;
+    info.sample_rate = record.sample_rate;
+    info.channels = record.channels;
+    return info;
+}
+
+bool is_audio_file(const char *name, size_t length) {
+    codec format;
+    return codec_for_name(name, length, format);
+}
+
+bool library_index::init() {
+#ifdef __linux__
+    _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_inotify < 0) {
+        std::cerr << "inotify unavailable, library will not update live\n";
+        return false;
+    }
+#endif
+    return true;
+}
+
+void library_index::cleanup() {
+#ifdef __linux__
+    if (_inotify >= 0) close(_inotify);
+#endif
+    _inotify = -1;
+
+    _directories.clear();
+    _by_path.clear();
+    _by_watch.clear();
+    _last_open.clear();
+    _changes.clear();
+    _overflowed = false;
+}
+
+uint32_t library_index::directory_index(const std::string &key) {
+    auto it = _by_path.find(key);
+    if (it != _by_path.end()) return it->second;
+
+    const uint32_t index = static_cast<uint32_t>(_directories.size());
+    _directories.emplace_back();
+    _directories.back().path = key;
+    _by_path.emplace(key, index);
+
+    return index;
+}
+
+const library_directory &library_index::open(const std::string &path) {
+    /* the browser asks for the same directory every frame, skip the path normalization */
+    if (path != _last_open || _directories.empty()) {
+        _last_open = path;
+        _last_open_index = directory_index(normalize_path(path));
+    }
+
+    const uint32_t index = _last_open_index;
+
+    watch(index);
+
+    library_directory &dir = _directories[index];
+    if (!dir.scanned) scan(dir);
+
+    return dir;
+}
+
+void library_index::hydrate(const library_db &db) {
+    _db = &db;
+
+    for (library_directory &dir : _directories) {
+        clear_entries(dir);
+        dir.scanned = false;
+    }
+
+    /* records are sorted by path, so siblings mostly arrive back to back */
+    std::string parent;
+    uint32_t index = 0;
+    bool have_parent = false;
+
+    for (uint32_t i = 0; i < db.size(); i++) {
+        const db_record &record = db.record(i);
+        const std::string_view path = db.path(record);
+
+        const size_t slash = path.rfind('/');
+        if (slash == std::string_view::npos || slash + 1 == path.size()) continue;
+
+        const std::string_view dir_path = path.substr(0, slash);
+        const std::string_view name = path.substr(slash + 1);
+
+        if (!have_parent || dir_path != parent) {
+            parent.assign(dir_path.data(), dir_path.size());
+            index = directory_index(parent);
+            have_parent = true;
+        }
+
+        library_directory &dir = _directories[index];
+        dir.scanned = true;
+
+        add_entry(dir, name.data(), name.size(), static_cast<entry_kind>(record.kind), record_info(record));
+    }
+}
+
+void library_index::watch(uint32_t index) {
+#ifdef __linux__
+    library_directory &dir = _directories[index];
+    if (_inotify < 0 || dir.watch >= 0) return;
+
+    /* IN_CLOSE_WRITE catches files that were still being written when IN_CREATE fired */
+    const uint32_t mask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+    dir.watch = inotify_add_watch(_inotify, dir.path.c_str(), mask);
+    if (dir.watch >= 0) _by_watch[dir.watch] = index;
+#else
+    (void)index;
+#endif
+}
+
+void library_index::scan(library_directory &dir) {
+    clear_entries(dir);
+    dir.scanned = true;
+
+    std::error_code ec;
+    for (fs::directory_iterator it(dir.path, ec), end; !ec && it != end; it.increment(ec)) {
+        const std::string name = it->path().filename().string();
+
+        if (it->is_directory(ec)) {
+            add_entry(dir, name.data(), name.size(), entry_kind::directory);
+        } else if (it->is_regular_file(ec) && is_audio_file(name.data(), name.size())) {
+            add_entry(dir, name.data(), name.size(), entry_kind::track, known_info(it->path().string()));
+        }
+    }
+}
+
+track_info library_index::known_info(const std::string &path) const {
+    const db_record *record = _db ? _db->find(path) : nullptr;
+    return record ? record_info(*record) : track_info();
+}
+
+void library_index::add_entry(library_directory &dir, const char *name, size_t length, entry_kind kind, const track_info &info) {
+    library_entry entry;
+    entry.name_offset = static_cast<uint32_t>(dir.names.size());
+    entry.name_length = static_cast<uint16_t>(length);
+    entry.kind = kind;
+    entry.info = info;
+
+    dir.names.append(name, length);
+    if (kind == entry_kind::directory) dir.names.push_back('/');
+    dir.names.push_back('\0');
+
+    /* only kept up once an event has asked for it */
+    if (!dir.entries.empty() && dir.by_name.size() == dir.entries.size()) dir.by_name.emplace(std::string(name, length), static_cast<uint32_t>(dir.entries.size()));
+
+    dir.entries.push_back(entry);
+    dir.generation = ++_generation;
+}
+
+void library_index::remove_entry(library_directory &dir, const char *name, size_t length) {
+    if (dir.by_name.size() != dir.entries.size()) {
+        dir.by_name.clear();
+        for (uint32_t i = 0; i < dir.entries.size(); i++) dir.by_name.emplace(dir.name(dir.entries[i]), i);
+    }
+
+    auto it = dir.by_name.find(std::string(name, length));
+    if (it == dir.by_name.end()) return;
+
+    /* the table sorts its own row order, so the last entry can simply move into the hole */
+    const uint32_t index = it->second;
+    library_entry &entry = dir.entries[index];
+    dir.dead_names += entry.name_length + (entry.kind == entry_kind::directory ? 2 : 1);
+    dir.by_name.erase(it);
+
+    if (index + 1 != dir.entries.size()) {
+        entry = dir.entries.back();
+        dir.by_name[dir.name(entry)] = index;
+    }
+
+    dir.entries.pop_back();
+    dir.generation = ++_generation;
+
+    /* removed names stay in the pool until they make up half of it */
+    if (dir.dead_names > dir.names.size() / 2 + 4096) compact_names(dir);
+}
+
+void library_index::clear_entries(library_directory &dir) {
+    dir.entries.clear();
+    dir.names.clear();
+    dir.by_name.clear();
+    dir.dead_names = 0;
+    dir.generation = ++_generation;
+}
+
+void library_index::compact_names(library_directory &dir) {
+    std::string names;
+    names.reserve(dir.names.size() / 2);
+
+    for (library_entry &entry : dir.entries) {
+        const char *label = dir.label(entry);
+        const uint32_t offset = static_cast<uint32_t>(names.size());
+
+        names.append(label, std::strlen(label) + 1);
+        entry.name_offset = offset;
+    }
+
+    dir.names.swap(names);
+    dir.dead_names = 0;
+}
+
+bool library_index::poll() {
+    bool changed = false;
+
+#ifdef __linux__
+    if (_inotify < 0) return false;
+
+    alignas(inotify_event) char buffer[16384];
+
+    for (;;) {
+        const ssize_t length = read(_inotify, buffer, sizeof(buffer));
+        if (length <= 0) break;
+
+        for (char *ptr = buffer; ptr < buffer + length; ) {
+            const inotify_event *event = reinterpret_cast<const inotify_event *>(ptr);
+            ptr += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                /* events were dropped, rescan whatever we have on screen */
+                for (library_directory &dir : _directories) {
+                    if (dir.scanned) scan(dir);
+                }
+                _overflowed = true;
+                changed = true;
+                continue;
+            }
+
+            auto it = _by_watch.find(event->wd);
+            if (it == _by_watch.end()) continue;
+
+            library_directory &dir = _directories[it->second];
+
+            if (event->mask & IN_IGNORED) {
+                _by_watch.erase(it);
+                dir.watch = -1;
+                dir.scanned = false;
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                inotify_rm_watch(_inotify, dir.watch);
+                clear_entries(dir);
+                dir.scanned = false;
+                _changes.push_back(dir.path);
+                changed = true;
+                continue;
+            }
+
+            if (event->len == 0) continue;
+
+            const size_t name_length = std::strlen(event->name);
+            const entry_kind kind = (event->mask & IN_ISDIR) ? entry_kind::directory : entry_kind::track;
+            if (kind == entry_kind::track && !is_audio_file(event->name, name_length)) continue;
+
+            std::string path = dir.path + "/" + event->name;
+
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                remove_entry(dir, event->name, name_length);
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE)) {
+                remove_entry(dir, event->name, name_length);
+                add_entry(dir, event->name, name_length, kind, known_info(path));
+
+                /* files copied into a new directory only show up through a watch on it. this may grow
+                   _directories, so dir is not used past here */
+                if (kind == entry_kind::directory) watch(directory_index(path));
+            } else {
+                continue;
+            }
+
+            /* the database re-reads the path once the burst settles, and so re-probes the file now
+               that its size and mtime are final */
+            _changes.push_back(std::move(path));
+            changed = true;
+        }
+    }
+#endif
+
+    return changed;
+}
+
+void library_index::take_changes(std::vector<std::string> &paths, bool &everything) {
+    /* a copy writes each file in a few events, one entry per path is plenty */
+    std::sort(_changes.begin(), _changes.end());
+    _changes.erase(std::unique(_changes.begin(), _changes.end()), _changes.end());
+
+    paths.swap(_changes);
+    _changes.clear();
+
+    everything = _overflowed;
+    _overflowed = false;
+}
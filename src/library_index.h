@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class library_db;
+
+enum class entry_kind : uint8_t { directory, track };
+
+/* zero until the library database has read the file's header */
+struct track_info {
+    uint64_t size = 0;
+    uint64_t frame_count = 0;
+    uint32_t sample_rate = 0;
+    uint16_t channels = 0;
+
+    float duration() const { return sample_rate ? static_cast<float>(frame_count) / sample_rate : 0.0f; }
+};
+
+/* names live in the owning directory's pool as "name\0", or "name/\0" for directories,
+   so the browser can hand the label straight to imgui */
+struct library_entry {
+    uint32_t name_offset;
+    uint16_t name_length;
+    entry_kind kind;
+
+    track_info info;
+};
+
+struct library_directory {
+    std::string path;
+    std::vector<library_entry> entries;
+    std::string names;
+
+    /* entry index by name, built on the first filesystem event rather than with every listing */
+    std::unordered_map<std::string, uint32_t> by_name;
+
+    /* bytes in names that belong to removed entries */
+    size_t dead_names = 0;
+
+    int watch = -1;
+    bool scanned = false;
+
+    /* changes whenever entries does, unique across directories */
+    uint32_t generation = 0;
+
+    const char *label(const library_entry &entry) const { return names.data() + entry.name_offset; }
+    std::string name(const library_entry &entry) const { return names.substr(entry.name_offset, entry.name_length); }
+    std::string entry_path(const library_entry &entry) const { return path + "/" + name(entry); }
+};
+
+bool is_audio_file(const char *name, size_t length);
+
+/* scans each directory once and keeps it current from inotify events,
+   so drawing the browser is only a walk over a prebuilt vector */
+class library_index {
+    private:
+        int _inotify = -1;
+        const library_db *_db = nullptr;
+
+        std::vector<library_directory> _directories;
+        std::unordered_map<std::string, uint32_t> _by_path;
+        std::unordered_map<int, uint32_t> _by_watch;
+
+        std::string _last_open;
+        uint32_t _last_open_index = 0;
+
+        uint32_t _generation = 0;
+
+        std::vector<std::string> _changes;
+        bool _overflowed = false;
+
+        uint32_t directory_index(const std::string &key);
+
+        void scan(library_directory &dir);
+        track_info known_info(const std::string &path) const;
+        void watch(uint32_t index);
+
+        void add_entry(library_directory &dir, const char *name, size_t length, entry_kind kind, const track_info &info = {});
+        void remove_entry(library_directory &dir, const char *name, size_t length);
+        void clear_entries(library_directory &dir);
+        void compact_names(library_directory &dir);
+
+    public:
+        bool init();
+        void cleanup();
+
+        /* the reference stays valid until the next open() call */
+        const library_directory &open(const std::string &path);
+
+        /* replaces every cached listing with the database contents, no filesystem access */
+        void hydrate(const library_db &db);
+
+        /* drains pending filesystem events without blocking, true if any listing changed */
+        bool poll();
+
+        /* every file and directory poll() saw change since the last call, for the database to re-read.
+           everything is set instead when inotify dropped events and nothing short of a full pass will do */
+        void take_changes(std::vector<std::string> &paths, bool &everything);
+};
@@ -0,0 +1,314 @@
+#include "loudness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "sample_convert.h"
+#include "track_stream.h"
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+/* channels are filtered side by side, four to the lanes of one vector, up to 7.1 */
+static constexpr unsigned int MAX_LANES = 8;
+static constexpr drwav_uint64 READ_FRAMES = 16384;
+
+static constexpr int OVERSAMPLE = 4;
+static constexpr int PHASE_TAPS = 12;
+
+static constexpr double ABSOLUTE_GATE_LUFS = -70.0;
+static constexpr double RELATIVE_GATE_LU = -10.0;
+
+static constexpr double PI = 3.14159265358979323846;
+
+struct biquad {
+    float b0, b1, b2, a1, a2;
+};
+
+/* the two k-weighting stages from bs.1770, derived for any rate from their analog prototypes */
+static void k_weighting(double rate, biquad &shelf, biquad &highpass) {
+    {
+        const double f0 = 1681.974450955533, gain_db = 3.999843853973347, q = 0.7071752369554196;
+        const double k = std::tan(PI * f0 / rate);
+        const double vh = std::pow(10.0, gain_db / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        shelf.b0 = static_cast<float>((vh + vb * k / q + k * k) / a0);
+        shelf.b1 = static_cast<float>(2.0 * (k * k - vh) / a0);
+        shelf.b2 = static_cast<float>((vh - vb * k / q + k * k) / a0);
+        shelf.a1 = static_cast<float>(2.0 * (k * k - 1.0) / a0);
+        shelf.a2 = static_cast<float>((1.0 - k / q + k * k) / a0);
+    }
+
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        const double k = std::tan(PI * f0 / rate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        highpass.b0 = 1.0f;
+        highpass.b1 = -2.0f;
+        highpass.b2 = 1.0f;
+        highpass.a1 = static_cast<float>(2.0 * (k * k - 1.0) / a0);
+        highpass.a2 = static_cast<float>((1.0 - k / q + k * k) / a0);
+    }
+}
+
+/* bs.1770 channel weights for the default wave layout of each channel count. front and centre
+   channels count once, surrounds between 60 and 120 degrees off centre 1.41 times, the lfe not at all */
+static void channel_weights(unsigned int channels, float *weights) {
+    std::fill(weights, weights + MAX_LANES, 1.0f);
+
+    switch (channels) {
+        case 4: /* fl fr bl br */
+        case 5: /* fl fr fc bl br */
+            weights[channels - 2] = weights[channels - 1] = 1.41f;
+            break;
+        case 6: /* fl fr fc lfe bl br */
+            weights[3] = 0.0f;
+            weights[4] = weights[5] = 1.41f;
+            break;
+        case 7: /* fl fr fc lfe bc sl sr */
+            weights[3] = 0.0f;
+            weights[5] = weights[6] = 1.41f;
+            break;
+        case 8: /* fl fr fc lfe bl br sl sr, the rear pair sits past 120 degrees */
+            weights[3] = 0.0f;
+            weights[6] = weights[7] = 1.41f;
+            break;
+    }
+}
+
+/* k-weighted energy in 100ms steps plus the oversampled peak, fed one chunk of interleaved frames at a time */
+class loudness_meter {
+    private:
+        unsigned int _channels;
+        size_t _step_frames;
+
+        biquad _shelf, _highpass;
+
+        /* transposed direct form ii state, one lane per channel */
+        alignas(16) float _shelf_z1[MAX_LANES] = {}, _shelf_z2[MAX_LANES] = {};
+        alignas(16) float _pass_z1[MAX_LANES] = {}, _pass_z2[MAX_LANES] = {};
+        alignas(16) float _energy[MAX_LANES] = {};
+        float _weights[MAX_LANES];
+        size_t _step_fill = 0;
+
+        /* windowed sinc at the source nyquist, tap-major so each tap is one vector across the phases */
+        alignas(16) float _phases[PHASE_TAPS][OVERSAMPLE];
+        alignas(16) float _history[MAX_LANES][2 * PHASE_TAPS] = {};
+        int _history_pos = 0;
+        float _peak = 0.0f;
+
+        std::vector<double> _steps;
+
+        void end_step();
+        void filter_frame(const float *frame);
+        void peak_frame(const float *frame);
+
+    public:
+        loudness_meter(unsigned int channels, unsigned int sample_rate);
+
+        void process(const float *samples, size_t frames);
+
+        double integrated() const;
+        double true_peak_db() const { return 20.0 * std::log10(std::max(_peak, 1e-9f)); }
+};
+
+loudness_meter::loudness_meter(unsigned int channels, unsigned int sample_rate)
+    : _channels(channels), _step_frames(std::max(1u, sample_rate / 10)) {
+    k_weighting(sample_rate, _shelf, _highpass);
+    channel_weights(channels, _weights);
+
+    const int taps = PHASE_TAPS * OVERSAMPLE;
+    const double center = (taps - 1) / 2.0;
+
+    for (int p = 0; p < OVERSAMPLE; p++) {
+        double sum = 0.0;
+
+        for (int t = 0; t < PHASE_TAPS; t++) {
+            const double x = (p + t * OVERSAMPLE - center) / OVERSAMPLE;
+            const double sinc = (x == 0.0) ? 1.0 : std::sin(PI * x) / (PI * x);
+            const double window = 0.5 - 0.5 * std::cos(2.0 * PI * (p + t * OVERSAMPLE + 0.5) / taps);
+
+            _phases[t][p] = static_cast<float>(sinc * window);
+            sum += sinc * window;
+        }
+
+        /* unity gain at dc for every phase */
+        for (int t = 0; t < PHASE_TAPS; t++) _phases[t][p] = static_cast<float>(_phases[t][p] / sum);
+    }
+}
+
+void loudness_meter::end_step() {
+    double energy = 0.0;
+    for (unsigned int c = 0; c < _channels; c++) energy += static_cast<double>(_energy[c]) * _weights[c];
+
+    _steps.push_back(energy / _step_frames);
+
+    std::fill(_energy, _energy + MAX_LANES, 0.0f);
+    _step_fill = 0;
+}
+
+#ifdef __SSE2__
+
+void loudness_meter::filter_frame(const float *frame) {
+    for (unsigned int first = 0; first < _channels; first += 4) {
+        alignas(16) float lanes[4] = {};
+        std::copy(frame + first, frame + std::min(first + 4, _channels), lanes);
+
+        const __m128 x = _mm_load_ps(lanes);
+
+        __m128 z1 = _mm_load_ps(_shelf_z1 + first), z2 = _mm_load_ps(_shelf_z2 + first);
+        const __m128 y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(_shelf.b0), x), z1);
+        z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(_shelf.b1), x), _mm_mul_ps(_mm_set1_ps(_shelf.a1), y)), z2);
+        z2 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(_shelf.b2), x), _mm_mul_ps(_mm_set1_ps(_shelf.a2), y));
+        _mm_store_ps(_shelf_z1 + first, z1);
+        _mm_store_ps(_shelf_z2 + first, z2);
+
+        __m128 w1 = _mm_load_ps(_pass_z1 + first), w2 = _mm_load_ps(_pass_z2 + first);
+        const __m128 out = _mm_add_ps(y, w1);
+        w1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(_highpass.b1), y), _mm_mul_ps(_mm_set1_ps(_highpass.a1), out)), w2);
+        w2 = _mm_sub_ps(y, _mm_mul_ps(_mm_set1_ps(_highpass.a2), out));
+        _mm_store_ps(_pass_z1 + first, w1);
+        _mm_store_ps(_pass_z2 + first, w2);
+
+        _mm_store_ps(_energy + first, _mm_add_ps(_mm_load_ps(_energy + first), _mm_mul_ps(out, out)));
+    }
+}
+
+void loudness_meter::peak_frame(const float *frame) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_set1_ps(_peak);
+
+    for (unsigned int c = 0; c < _channels; c++) {
+        float *history = _history[c];
+        history[_history_pos] = history[_history_pos + PHASE_TAPS] = frame[c];
+
+        const float *recent = history + _history_pos;
+        __m128 acc = _mm_setzero_ps();
+        for (int t = 0; t < PHASE_TAPS; t++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(_phases[t]), _mm_set1_ps(recent[t])));
+        }
+
+        peak = _mm_max_ps(peak, _mm_and_ps(acc, abs_mask));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peak);
+    _peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+}
+
+#else
+
+void loudness_meter::filter_frame(const float *frame) {
+    for (unsigned int c = 0; c < _channels; c++) {
+        const float x = frame[c];
+
+        const float y = _shelf.b0 * x + _shelf_z1[c];
+        _shelf_z1[c] = _shelf.b1 * x - _shelf.a1 * y + _shelf_z2[c];
+        _shelf_z2[c] = _shelf.b2 * x - _shelf.a2 * y;
+
+        const float out = y + _pass_z1[c];
+        _pass_z1[c] = _highpass.b1 * y - _highpass.a1 * out + _pass_z2[c];
+        _pass_z2[c] = y - _highpass.a2 * out;
+
+        _energy[c] += out * out;
+    }
+}
+
+void loudness_meter::peak_frame(const float *frame) {
+    for (unsigned int c = 0; c < _channels; c++) {
+        float *history = _history[c];
+        history[_history_pos] = history[_history_pos + PHASE_TAPS] = frame[c];
+
+        const float *recent = history + _history_pos;
+        for (int p = 0; p < OVERSAMPLE; p++) {
+            float acc = 0.0f;
+            for (int t = 0; t < PHASE_TAPS; t++) acc += _phases[t][p] * recent[t];
+            _peak = std::max(_peak, std::fabs(acc));
+        }
+    }
+}
+
+#endif
+
+void loudness_meter::process(const float *samples, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        const float *frame = samples + i * _channels;
+
+        /* newest sample first, so recent[t] is t samples back */
+        _history_pos = (_history_pos + PHASE_TAPS - 1) % PHASE_TAPS;
+
+        filter_frame(frame);
+        peak_frame(frame);
+
+        if (++_step_fill == _step_frames) end_step();
+    }
+}
+
+double loudness_meter::integrated() const {
+    /* 400ms blocks overlapping by 75%, i.e. every run of four 100ms steps */
+    std::vector<double> blocks;
+    for (size_t i = 3; i < _steps.size(); i++) {
+        blocks.push_back((_steps[i - 3] + _steps[i - 2] + _steps[i - 1] + _steps[i]) / 4.0);
+    }
+
+    auto loudness = [](double energy) { return -0.691 + 10.0 * std::log10(energy); };
+
+    auto gated_mean = [&](double threshold) {
+        double sum = 0.0;
+        size_t count = 0;
+
+        for (double energy : blocks) {
+            if (energy > 0.0 && loudness(energy) > threshold) {
+                sum += energy;
+                count++;
+            }
+        }
+
+        return count ? sum / count : 0.0;
+    };
+
+    const double absolute = gated_mean(ABSOLUTE_GATE_LUFS);
+    if (absolute <= 0.0) return -INFINITY;
+
+    const double relative = gated_mean(std::max(ABSOLUTE_GATE_LUFS, loudness(absolute) + RELATIVE_GATE_LU));
+    return relative > 0.0 ? loudness(relative) : -INFINITY;
+}
+
+bool measure_loudness(const std::string &path, loudness_result &result, const std::atomic<bool> &cancel, pcm_cache *pcm) {
+    track_stream stream;
+    stream.set_cache(pcm, false);
+    if (!stream.open(path)) return false;
+
+    const unsigned int channels = stream.channels();
+    if (channels == 0 || channels > MAX_LANES || stream.sample_rate() == 0) return false;
+
+    stream.set_output(sample_format::f32, false);
+
+    loudness_meter meter(channels, stream.sample_rate());
+    std::vector<float> scratch(READ_FRAMES * channels);
+
+    while (!stream.finished()) {
+        if (cancel) return false;
+
+        const void *samples = nullptr;
+        const drwav_uint64 frames = stream.read(READ_FRAMES, scratch.data(), &samples);
+        if (frames == 0) break;
+
+        meter.process(static_cast<const float *>(samples), frames);
+    }
+
+    result.integrated_lufs = static_cast<float>(meter.integrated());
+    result.true_peak_dbtp = static_cast<float>(meter.true_peak_db());
+    return true;
+}
+
+float normalization_gain(const loudness_result &result, float target_lufs, float ceiling_dbtp) {
+    if (!std::isfinite(result.integrated_lufs)) return 0.0f;
+
+    return std::min(target_lufs - result.integrated_lufs, ceiling_dbtp - result.true_peak_dbtp);
+}
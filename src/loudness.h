@@ -0,0 +1,21 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+class pcm_cache;
+
+/* bs.1770 integrated loudness and 4x oversampled true peak of one track */
+struct loudness_result {
+    float integrated_lufs;
+    float true_peak_dbtp;
+};
+
+/* decodes path in chunks and measures it. silent tracks report -inf lufs. surround channels are
+   weighted as bs.1770 asks for the default wave layouts up to 7.1. returns false if the file can't
+   be read, has more than 8 channels or cancel was raised part way. frames already in pcm are read
+   from there, but nothing is added to it */
+bool measure_loudness(const std::string &path, loudness_result &result, const std::atomic<bool> &cancel, pcm_cache *pcm = nullptr);
+
+/* gain in db that brings a track to target_lufs without pushing its true peak over ceiling_dbtp */
+float normalization_gain(const loudness_result &result, float target_lufs, float ceiling_dbtp);
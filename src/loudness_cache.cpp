@@ -0,0 +1,218 @@
+#include "loudness_cache.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "library_db.h"
+#include "library_index.h"
+
+static const char LOUDNESS_MAGIC[8] = { 'h', 'e', 'x', 'e', 'n', 'l', 'd', '\0' };
+
+bool loudness_cache::load(const std::string &path, pcm_cache *pcm) {
+    _path = path;
+    _pcm = pcm;
+    _cancel = false;
+
+    uint32_t records = 0;
+    read_log(records);
+
+    /* superseded records pile up as files change, rewrite once they are most of the log */
+    if (_log == nullptr || records > 2 * _entries.size() + 256) rewrite_log();
+
+    if (!_log) {
+        std::cerr << "failed to open loudness cache, results will not persist: " << _path << "\n";
+    }
+
+    _pool.init(0, true);
+    return true;
+}
+
+void loudness_cache::cleanup() {
+    _cancel = true;
+    _pool.cleanup();
+
+    if (_log) std::fclose(_log);
+    _log = nullptr;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _in_flight.clear();
+}
+
+void loudness_cache::read_log(uint32_t &records) {
+    FILE *file = std::fopen(_path.c_str(), "rb");
+    if (!file) return;
+
+    loudness_header header;
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, LOUDNESS_MAGIC, sizeof(LOUDNESS_MAGIC)) != 0 || header.version != VERSION) {
+        std::cerr << "ignoring stale loudness cache: " << _path << "\n";
+        std::fclose(file);
+        return;
+    }
+
+    loudness_record record;
+    std::string path;
+    long valid_end = std::ftell(file);
+
+    while (std::fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.path_length == 0 || record.path_length > 65536) break;
+
+        path.resize(record.path_length);
+        if (std::fread(&path[0], 1, path.size(), file) != path.size()) break;
+
+        const bool measured = (record.flags & LOUDNESS_UNMEASURABLE) == 0;
+        _entries[path] = entry{ record.size, record.mtime, { record.integrated_lufs, record.true_peak_dbtp }, measured };
+        records++;
+        valid_end = std::ftell(file);
+    }
+
+    std::fclose(file);
+
+    /* drop a record torn by an interrupted write before appending after it */
+    if (truncate(_path.c_str(), valid_end) == 0) _log = std::fopen(_path.c_str(), "ab");
+}
+
+void loudness_cache::rewrite_log() {
+    if (_log) std::fclose(_log);
+    _log = nullptr;
+
+    const std::string temp_path = _path + ".tmp";
+    FILE *file = std::fopen(temp_path.c_str(), "wb");
+    if (!file) return;
+
+    loudness_header header = {};
+    std::memcpy(header.magic, LOUDNESS_MAGIC, sizeof(LOUDNESS_MAGIC));
+    header.version = VERSION;
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (const auto &[path, value] : _entries) {
+        loudness_record record = {};
+        record.path_length = static_cast<uint32_t>(path.size());
+        record.flags = value.measured ? 0 : LOUDNESS_UNMEASURABLE;
+        record.size = value.size;
+        record.mtime = value.mtime;
+        record.integrated_lufs = value.result.integrated_lufs;
+        record.true_peak_dbtp = value.result.true_peak_dbtp;
+
+        ok = ok && std::fwrite(&record, sizeof(record), 1, file) == 1;
+        ok = ok && std::fwrite(path.data(), 1, path.size(), file) == path.size();
+    }
+
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok || std::rename(temp_path.c_str(), _path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return;
+    }
+
+    _log = std::fopen(_path.c_str(), "ab");
+}
+
+void loudness_cache::append(const std::string &path, const entry &value) {
+    loudness_record record = {};
+    record.path_length = static_cast<uint32_t>(path.size());
+    record.flags = value.measured ? 0 : LOUDNESS_UNMEASURABLE;
+    record.size = value.size;
+    record.mtime = value.mtime;
+    record.integrated_lufs = value.result.integrated_lufs;
+    record.true_peak_dbtp = value.result.true_peak_dbtp;
+
+    /* one write per record, flushed right away so a crash loses at most the track in progress */
+    std::vector<char> buffer(sizeof(record) + path.size());
+    std::memcpy(buffer.data(), &record, sizeof(record));
+    std::memcpy(buffer.data() + sizeof(record), path.data(), path.size());
+
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    if (!_log) return;
+
+    std::fwrite(buffer.data(), 1, buffer.size(), _log);
+    std::fflush(_log);
+}
+
+void loudness_cache::scan(const library_db &db) {
+    struct candidate {
+        std::string path;
+        uint64_t size;
+        int64_t mtime;
+    };
+
+    /* the walk over the database and the path copies happen before the lock, lookup() only waits
+       on the hash probes */
+    std::vector<candidate> tracks;
+    tracks.reserve(db.size());
+
+    for (uint32_t i = 0; i < db.size(); i++) {
+        const db_record &record = db.record(i);
+        if (record.kind != static_cast<uint8_t>(entry_kind::track)) continue;
+
+        tracks.push_back({ std::string(db.path(record)), record.size, record.mtime });
+    }
+
+    size_t queued = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for (size_t i = 0; i < tracks.size(); i++) {
+            const candidate &track = tracks[i];
+
+            auto it = _entries.find(track.path);
+            if (it != _entries.end() && it->second.size == track.size && it->second.mtime == track.mtime) continue;
+            if (!_in_flight.insert(track.path).second) continue;
+
+            if (queued != i) tracks[queued] = std::move(tracks[i]);
+            queued++;
+        }
+    }
+
+    tracks.resize(queued);
+    _scan_total += static_cast<uint32_t>(queued);
+
+    for (candidate &track : tracks) {
+        _pool.submit([this, path = std::move(track.path), size = track.size, mtime = track.mtime]() mutable {
+            analyze(std::move(path), size, mtime);
+        });
+    }
+}
+
+void loudness_cache::analyze(std::string path, uint64_t size, int64_t mtime) {
+    entry value = { size, mtime, {}, false };
+    value.measured = measure_loudness(path, value.result, _cancel, _pcm);
+
+    /* a cancelled measurement says nothing about the track, it is picked up again next scan */
+    if (!value.measured && _cancel) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _in_flight.erase(path);
+        _scan_done++;
+        return;
+    }
+
+    append(path, value);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _in_flight.erase(path);
+    _scan_done++;
+
+    _entries[std::move(path)] = value;
+}
+
+bool loudness_cache::lookup(const std::string &path, loudness_result &result) const {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+
+    const int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _entries.find(path);
+    if (it == _entries.end() || it->second.size != static_cast<uint64_t>(st.st_size) || it->second.mtime != mtime) return false;
+    if (!it->second.measured) return false;
+
+    result = it->second.result;
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "loudness.h"
+#include "thread_pool.h"
+
+class library_db;
+
+/* on-disk layout: loudness_header, then an append-only log of loudness_record, each followed by
+   its path. the newest record for a path wins, a torn record at the end is ignored */
+struct loudness_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+/* the track could not be measured, it is not retried until its size or mtime changes */
+static constexpr uint32_t LOUDNESS_UNMEASURABLE = 1;
+
+struct loudness_record {
+    uint32_t path_length;
+    uint32_t flags;
+
+    uint64_t size;
+    int64_t mtime;
+
+    float integrated_lufs;
+    float true_peak_dbtp;
+};
+
+static_assert(sizeof(loudness_header) == 16, "loudness_header layout changed");
+static_assert(sizeof(loudness_record) == 32, "loudness_record layout changed");
+
+/* loudness of every track in the library, measured on a work-stealing pool and keyed by path,
+   size and mtime. every result is appended to the log as soon as it is known, so an interrupted
+   scan picks up where it stopped the next time scan() runs */
+class loudness_cache {
+    private:
+        static constexpr uint32_t VERSION = 2;
+
+        struct entry {
+            uint64_t size;
+            int64_t mtime;
+            loudness_result result;
+            bool measured;
+        };
+
+        std::string _path;
+
+        /* appends from the pool's workers are serialized on their own lock, so lookup() never waits on the disk */
+        std::mutex _log_mutex;
+        FILE *_log = nullptr;
+        pcm_cache *_pcm = nullptr;
+
+        mutable std::mutex _mutex;
+        std::unordered_map<std::string, entry> _entries;
+        std::unordered_set<std::string> _in_flight;
+
+        thread_pool _pool;
+        std::atomic<bool> _cancel{false};
+
+        std::atomic<uint32_t> _scan_total{0};
+        std::atomic<uint32_t> _scan_done{0};
+
+        void read_log(uint32_t &records);
+        void rewrite_log();
+        void append(const std::string &path, const entry &value);
+        void analyze(std::string path, uint64_t size, int64_t mtime);
+
+    public:
+        /* pcm, when set, lets the scan read tracks that have already been decoded */
+        bool load(const std::string &path, pcm_cache *pcm = nullptr);
+        void cleanup();
+
+        /* queues every track in db whose measurement is missing or stale */
+        void scan(const library_db &db);
+
+        /* thread-safe. checks the file's size and mtime, so a stale measurement is never used */
+        bool lookup(const std::string &path, loudness_result &result) const;
+
+        uint32_t scan_total() const { return _scan_total; }
+        uint32_t scan_done() const { return _scan_done; }
+};
@@ -0,0 +1,74 @@
+#include "mapped_file.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(mapped_file &&other) noexcept
+    : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)) { }
+
+mapped_file &mapped_file::operator=(mapped_file &&other) noexcept {
+    if (this != &other) {
+        close();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+    }
+
+    return *this;
+}
+
+bool mapped_file::open(const std::string &path) {
+    close();
+
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED) return false;
+
+    _data = data;
+    _size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void mapped_file::close() {
+    if (_data) munmap(_data, _size);
+
+    _data = nullptr;
+    _size = 0;
+}
+
+void mapped_file::advise_sequential() {
+    if (_data) madvise(_data, _size, MADV_SEQUENTIAL);
+}
+
+static void advise_range(void *data, size_t size, size_t offset, size_t length, int advice) {
+    if (!data || offset >= size) return;
+
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    const size_t begin = offset & ~(page - 1);
+    const size_t end = std::min(offset + length, size);
+
+    madvise(static_cast<uint8_t *>(data) + begin, end - begin, advice);
+}
+
+void mapped_file::advise_willneed(size_t offset, size_t length) {
+    advise_range(_data, _size, offset, length, MADV_WILLNEED);
+}
+
+void mapped_file::advise_dontneed(size_t offset, size_t length) {
+    advise_range(_data, _size, offset, length, MADV_DONTNEED);
+}
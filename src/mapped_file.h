@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* read-only memory mapping of a whole file */
+class mapped_file {
+    private:
+        void *_data = nullptr;
+        size_t _size = 0;
+
+    public:
+        mapped_file() = default;
+        ~mapped_file() { close(); }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        mapped_file(mapped_file &&other) noexcept;
+        mapped_file &operator=(mapped_file &&other) noexcept;
+
+        bool open(const std::string &path);
+        void close();
+
+        /* readahead hints over a byte range, rounded out to whole pages */
+        void advise_sequential();
+        void advise_willneed(size_t offset, size_t length);
+        void advise_dontneed(size_t offset, size_t length);
+
+        bool is_open() const { return _data != nullptr; }
+
+        const uint8_t *data() const { return static_cast<const uint8_t *>(_data); }
+        size_t size() const { return _size; }
+};
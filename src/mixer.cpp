@@ -0,0 +1,165 @@
+#include "mixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "profiler.h"
+
+static constexpr float HALF_PI = 1.57079632679f;
+
+/* fed to a resampler once its track has run out, to push the last frames through the filter */
+static constexpr size_t SILENCE_FRAMES = 256;
+static const float SILENCE[SILENCE_FRAMES * resampler::MAX_CHANNELS] = {};
+
+void mixer::init(unsigned int rate) {
+    _rate = rate;
+    _block.resize(BLOCK_FRAMES * resampler::MAX_CHANNELS);
+
+    for (voice &v : _voices) v.scratch.resize(READ_FRAMES * resampler::MAX_CHANNELS);
+}
+
+void mixer::start(int slot, track_stream &stream, float gain, uint64_t fade_in) {
+    voice &v = _voices[slot];
+
+    v.stream = &stream;
+    v.resample.configure(stream.sample_rate(), _rate, stream.channels());
+    v.gain = gain;
+
+    v.pending = nullptr;
+    v.pending_frames = 0;
+
+    v.base_frame = stream.cursor();
+    v.end_frame = stream.frame_count();
+    v.drained = false;
+    v.active = v.end_frame > v.base_frame;
+
+    v.fade_length = fade_in;
+    v.fade_done = 0;
+    v.fade_in = true;
+}
+
+void mixer::fade_out(int slot, uint64_t frames) {
+    voice &v = _voices[slot];
+
+    v.fade_length = frames;
+    v.fade_done = 0;
+    v.fade_in = false;
+}
+
+void mixer::stop(int slot) {
+    voice &v = _voices[slot];
+
+    v.active = false;
+    v.stream = nullptr;
+    v.pending = nullptr;
+    v.pending_frames = 0;
+}
+
+void mixer::stop_all() {
+    for (int slot = 0; slot < VOICES; slot++) stop(slot);
+}
+
+uint64_t mixer::remaining(int slot) const {
+    const voice &v = _voices[slot];
+    if (!v.active) return 0;
+
+    const uint64_t end = v.end_frame > v.base_frame ? v.end_frame - v.base_frame : 0;
+    const uint64_t frames = v.resample.frames_until(end);
+
+    if (v.fade_length && !v.fade_in) return std::min(frames, v.fade_length - v.fade_done);
+    return frames;
+}
+
+uint64_t mixer::output_frames(const track_stream &stream) const {
+    if (stream.sample_rate() == 0) return 0;
+    return (stream.frame_count() * _rate + stream.sample_rate() - 1) / stream.sample_rate();
+}
+
+double mixer::position(int slot) const {
+    const voice &v = _voices[slot];
+    return static_cast<double>(v.base_frame) + v.resample.position();
+}
+
+double mixer::step(int slot) const {
+    const voice &v = _voices[slot];
+    return v.resample.out_rate() ? static_cast<double>(v.resample.in_rate()) / v.resample.out_rate() : 1.0;
+}
+
+void mixer::refill(voice &v) {
+    PROFILE_SCOPE(profile_zone::decode);
+
+    const void *samples = nullptr;
+    const drwav_uint64 frames = v.stream->read(READ_FRAMES, v.scratch.data(), &samples);
+
+    /* zero-copy reads point into the file mapping, which does not promise float alignment */
+    if (reinterpret_cast<uintptr_t>(samples) % alignof(float) != 0) {
+        std::memcpy(v.scratch.data(), samples, frames * v.stream->frame_bytes());
+        samples = v.scratch.data();
+    }
+
+    v.pending = static_cast<const float *>(samples);
+    v.pending_frames = static_cast<size_t>(frames);
+
+    /* a short file ends where its data does, not where its header says */
+    if (v.stream->finished()) {
+        v.drained = true;
+        v.end_frame = std::min<uint64_t>(v.end_frame, v.stream->cursor());
+    }
+}
+
+void mixer::render(int slot, float *out, size_t frames) {
+    voice &v = _voices[slot];
+    const unsigned int channels = v.stream->channels();
+    size_t done = 0;
+
+    while (done < frames) {
+        if (v.pending_frames == 0 && !v.drained) refill(v);
+
+        const size_t count = std::min<uint64_t>({ frames - done, BLOCK_FRAMES, remaining(slot) });
+        if (count == 0) break;
+
+        size_t consumed = 0, made = 0;
+        if (v.pending_frames > 0) {
+            made = v.resample.process(v.pending, v.pending_frames, consumed, _block.data(), count);
+
+            v.pending += consumed * channels;
+            v.pending_frames -= consumed;
+        } else {
+            made = v.resample.process(SILENCE, SILENCE_FRAMES, consumed, _block.data(), count);
+        }
+
+        float *mixed = out + done * CHANNELS;
+
+        for (size_t i = 0; i < made; i++) {
+            float gain = v.gain;
+
+            if (v.fade_length) {
+                const float x = (static_cast<float>(v.fade_done) + 0.5f) / static_cast<float>(v.fade_length);
+                gain *= v.fade_in ? std::sin(x * HALF_PI) : std::cos(x * HALF_PI);
+
+                if (++v.fade_done == v.fade_length) {
+                    if (!v.fade_in) v.active = false;
+                    v.fade_length = 0;
+                }
+            }
+
+            const float *frame = _block.data() + i * channels;
+            mixed[i * 2] += frame[0] * gain;
+            mixed[i * 2 + 1] += frame[channels - 1] * gain;
+        }
+
+        done += made;
+        if (!v.active) break;
+    }
+
+    if (v.active && remaining(slot) == 0) v.active = false;
+}
+
+void mixer::mix(float *out, size_t frames) {
+    std::fill(out, out + frames * CHANNELS, 0.0f);
+
+    for (int slot = 0; slot < VOICES; slot++) {
+        if (_voices[slot].active) render(slot, out, frames);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "resampler.h"
+#include "track_stream.h"
+
+/* mixes up to two open tracks into interleaved stereo float at the output rate.
+
+   each voice reads f32 from its track_stream, resamples it to the output rate and adds it into the
+   mix with its loudness gain and, while one runs, an equal-power fade. a voice ends on the exact output
+   frame its track does, so the caller can start the next one on the following frame, or fade the
+   two across each other by starting the fade remaining() frames ahead of the end.
+
+   voices are driven from one thread and all buffers are sized in init(), mix() never allocates */
+class mixer {
+    public:
+        static constexpr int VOICES = 2;
+        static constexpr unsigned int CHANNELS = 2;
+
+        /* streams are read this many frames at a time */
+        static constexpr size_t READ_FRAMES = 2048;
+
+    private:
+        static constexpr size_t BLOCK_FRAMES = 1024;
+
+        struct voice {
+            track_stream *stream = nullptr;
+            resampler resample;
+            bool active = false;
+            float gain = 1.0f;
+
+            /* decoded frames the resampler has not taken yet, in scratch or the stream's own buffers */
+            std::vector<float> scratch;
+            const float *pending = nullptr;
+            size_t pending_frames = 0;
+
+            /* the track frame resampler input starts at, and the one it ends before */
+            uint64_t base_frame = 0;
+            uint64_t end_frame = 0;
+            bool drained = false;
+
+            /* fade_length output frames of sin (in) or cos (out) gain, fade_done of them already mixed */
+            uint64_t fade_length = 0;
+            uint64_t fade_done = 0;
+            bool fade_in = false;
+        };
+
+        voice _voices[VOICES];
+        unsigned int _rate = 0;
+        std::vector<float> _block;
+
+        void refill(voice &v);
+        void render(int slot, float *out, size_t frames);
+
+    public:
+        void init(unsigned int rate);
+        unsigned int rate() const { return _rate; }
+
+        /* plays stream from its current cursor in slot, fading in over fade_in output frames */
+        void start(int slot, track_stream &stream, float gain, uint64_t fade_in);
+
+        /* fades the voice out over its next frames output frames and ends it there */
+        void fade_out(int slot, uint64_t frames);
+
+        void stop(int slot);
+        void stop_all();
+
+        bool active(int slot) const { return _voices[slot].active; }
+
+        /* output frames until the voice's track ends */
+        uint64_t remaining(int slot) const;
+
+        /* a whole track's length at the output rate */
+        uint64_t output_frames(const track_stream &stream) const;
+
+        /* the track frame the voice's next output frame sits on, and track frames per output frame */
+        double position(int slot) const;
+        double step(int slot) const;
+
+        /* writes frames of stereo output, silence where no voice plays */
+        void mix(float *out, size_t frames);
+};
@@ -0,0 +1,1230 @@
+#include "mp3_decoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "mp3_tables.h"
+
+/* junk between frames is searched this far for the next good header before the stream ends */
+static constexpr size_t RESYNC_LIMIT = 1024 * 1024;
+
+/* id3v2 tags past this size are only read this far for their text frames */
+static constexpr size_t ID3_READ_LIMIT = 1024 * 1024;
+
+/* bytes after the id3v2 tag that probe_mp3 reads to find the first frame */
+static constexpr size_t PROBE_BYTES = 64 * 1024;
+
+/* the delay of the decoder's own filterbanks, which the encoder delay of a lame tag leaves out */
+static constexpr uint64_t DECODER_DELAY = 529;
+
+struct mpeg_header {
+    bool lsf = false;
+    unsigned int rate_index = 0;
+    unsigned int sample_rate = 0;
+    unsigned int bitrate = 0;
+    unsigned int channels = 0;
+    unsigned int mode = 0;
+    unsigned int mode_extension = 0;
+    bool crc = false;
+    size_t length = 0;
+    size_t side_info = 0;
+};
+
+/* the four header bytes at p, false unless they start a layer iii frame. rate_index counts the
+   three mpeg-1 rates, then the mpeg-2 and the mpeg-2.5 ones */
+static bool parse_mpeg_header(const uint8_t *p, mpeg_header &out) {
+    if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0) return false;
+
+    const unsigned int version = (p[1] >> 3) & 3;
+    const unsigned int layer = (p[1] >> 1) & 3;
+    const unsigned int bitrate_index = p[2] >> 4;
+    const unsigned int rate = (p[2] >> 2) & 3;
+
+    /* free format is not supported, its frame length is not in the header */
+    if (version == 1 || layer != 1 || bitrate_index == 0 || bitrate_index == 15 || rate == 3 || (p[3] & 3) == 2) return false;
+
+    static const unsigned int MPEG1_BITRATES[15] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+    static const unsigned int LSF_BITRATES[15] = { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 };
+    static const unsigned int RATES[9] = { 44100, 48000, 32000, 22050, 24000, 16000, 11025, 12000, 8000 };
+
+    out.lsf = version != 3;
+    out.rate_index = rate + (version == 3 ? 0 : version == 2 ? 3 : 6);
+    out.sample_rate = RATES[out.rate_index];
+    out.bitrate = (out.lsf ? LSF_BITRATES : MPEG1_BITRATES)[bitrate_index] * 1000;
+    out.mode = p[3] >> 6;
+    out.mode_extension = (p[3] >> 4) & 3;
+    out.channels = out.mode == 3 ? 1 : 2;
+    out.crc = (p[1] & 1) == 0;
+    out.length = (out.lsf ? 72 : 144) * out.bitrate / out.sample_rate + ((p[2] >> 1) & 1);
+    out.side_info = out.lsf ? (out.channels == 1 ? 9 : 17) : (out.channels == 1 ? 17 : 32);
+
+    return out.length >= 6 + out.side_info;
+}
+
+/* frames of one stream keep the version, rate and channel count of the first */
+static bool same_stream(const mpeg_header &a, const mpeg_header &b) {
+    return a.rate_index == b.rate_index && a.channels == b.channels;
+}
+
+/* the first header in [from, from + limit) whose frame is followed by another header of the same
+   stream or by the end of the data, and of stream when that is given. one header alone is too
+   easily matched by the bytes of a tag or of compressed data */
+static bool find_frame(const uint8_t *data, size_t size, size_t from, size_t limit, const mpeg_header *stream, size_t &pos, mpeg_header &header) {
+    const size_t to = (from < size && size - from > limit) ? from + limit : size;
+
+    while (from + 4 <= to) {
+        const void *sync = std::memchr(data + from, 0xFF, to - from - 3);
+        if (!sync) return false;
+
+        from = static_cast<const uint8_t *>(sync) - data;
+
+        if (parse_mpeg_header(data + from, header) && (!stream || same_stream(header, *stream)) && header.length <= size - from) {
+            const size_t next = from + header.length;
+            mpeg_header following;
+
+            if (next + 4 > size || (parse_mpeg_header(data + next, following) && same_stream(following, header))) {
+                pos = from;
+                return true;
+            }
+        }
+
+        from++;
+    }
+
+    return false;
+}
+
+static uint32_t big_endian(const uint8_t *p, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++) value = (value << 8) | p[i];
+    return value;
+}
+
+static uint32_t syncsafe(const uint8_t *p) {
+    return (static_cast<uint32_t>(p[0] & 0x7F) << 21) | (static_cast<uint32_t>(p[1] & 0x7F) << 14) | (static_cast<uint32_t>(p[2] & 0x7F) << 7) | (p[3] & 0x7F);
+}
+
+/* the length of an id3v2 tag starting at p, zero when there is none */
+static size_t id3v2_length(const uint8_t *p, size_t available) {
+    if (available < 10 || std::memcmp(p, "ID3", 3) != 0) return 0;
+    return 10 + syncsafe(p + 6) + ((p[5] & 0x10) ? 10 : 0);
+}
+
+/* what the first frame tells about the stream when it holds a xing, info or vbri tag in place of
+   audio. delay and padding come from the lame extension of a xing tag */
+struct stream_tag {
+    uint32_t frames = 0;
+    bool gapless = false;
+    uint32_t delay = 0;
+    uint32_t padding = 0;
+};
+
+static bool read_stream_tag(const uint8_t *frame, const mpeg_header &header, stream_tag &out) {
+    const uint8_t *end = frame + header.length;
+    const uint8_t *tag = frame + 4 + header.side_info;
+
+    if (header.length >= 36 + 18 && std::memcmp(frame + 36, "VBRI", 4) == 0) {
+        out.frames = big_endian(frame + 36 + 14, 4);
+        return true;
+    }
+
+    if (end - tag < 8 || (std::memcmp(tag, "Xing", 4) != 0 && std::memcmp(tag, "Info", 4) != 0)) return false;
+
+    const uint32_t flags = big_endian(tag + 4, 4);
+    const uint8_t *p = tag + 8;
+
+    if (flags & 1) {
+        if (end - p < 4) return true;
+        out.frames = big_endian(p, 4);
+        p += 4;
+    }
+
+    if (flags & 2) p += 4;
+    if (flags & 4) p += 100;
+    if (flags & 8) p += 4;
+
+    if (end - p >= 24 && (std::memcmp(p, "LAME", 4) == 0 || std::memcmp(p, "Lavf", 4) == 0 || std::memcmp(p, "Lavc", 4) == 0)) {
+        const uint32_t value = big_endian(p + 21, 3);
+        out.gapless = true;
+        out.delay = value >> 12;
+        out.padding = value & 0xFFF;
+    }
+
+    return true;
+}
+
+/* reads big-endian bit fields from the side info and the main data. peek() returns the next 57
+   bits or more at the top of a word, past the end of the data they read as zeros */
+class mpeg_bits {
+    private:
+        const uint8_t *_data;
+        size_t _size;
+        size_t _bit;
+
+    public:
+        mpeg_bits(const uint8_t *data, size_t size, size_t bit) : _data(data), _size(size), _bit(bit) {}
+
+        uint64_t peek() const {
+            const size_t byte = _bit >> 3;
+            uint64_t word = 0;
+
+            if (byte + 8 <= _size) {
+                std::memcpy(&word, _data + byte, 8);
+                word = __builtin_bswap64(word);
+            } else {
+                for (size_t i = 0; i < 8; i++) word = (word << 8) | (byte + i < _size ? _data[byte + i] : 0);
+            }
+
+            return word << (_bit & 7);
+        }
+
+        void skip(unsigned int bits) { _bit += bits; }
+
+        /* up to 32 bits */
+        uint32_t bits(unsigned int count) {
+            if (count == 0) return 0;
+
+            const uint32_t value = static_cast<uint32_t>(peek() >> (64 - count));
+            _bit += count;
+            return value;
+        }
+
+        size_t position() const { return _bit; }
+};
+
+/* huffman tables decode through a lookup on the first bits of the code, and for longer codes a
+   second one on the bits after them. an entry is the code length above the symbol, or with the top
+   bit set the width and offset of the second lookup */
+struct huffman_table {
+    std::vector<uint32_t> lookup;
+    unsigned int first_bits = 0;
+    unsigned int linbits = 0;
+};
+
+static constexpr uint32_t HUFFMAN_NODE = 0x80000000;
+
+/* symbols are (x << 4) | y, x and y counted from the codes' row major order */
+template <typename T>
+static huffman_table build_huffman(const T *codes, const uint8_t *lengths, unsigned int count, unsigned int row, unsigned int linbits) {
+    huffman_table table;
+    table.linbits = linbits;
+
+    unsigned int longest = 0;
+    for (unsigned int i = 0; i < count; i++) longest = std::max<unsigned int>(longest, lengths[i]);
+
+    const unsigned int first = std::min(longest, 8u);
+    table.first_bits = first;
+    table.lookup.assign(size_t(1) << first, 0);
+
+    for (unsigned int i = 0; i < count; i++) {
+        const unsigned int length = lengths[i];
+        const uint32_t leaf = (length << 8) | ((i / row) << 4) | (i % row);
+        if (length > first) continue;
+
+        const size_t start = static_cast<size_t>(codes[i]) << (first - length);
+        std::fill(table.lookup.begin() + start, table.lookup.begin() + start + (size_t(1) << (first - length)), leaf);
+    }
+
+    for (uint32_t prefix = 0; prefix < (1u << first); prefix++) {
+        unsigned int width = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            if (lengths[i] > first && (static_cast<uint32_t>(codes[i]) >> (lengths[i] - first)) == prefix) width = std::max(width, lengths[i] - first);
+        }
+
+        if (width == 0) continue;
+
+        const size_t offset = table.lookup.size();
+        table.lookup[prefix] = HUFFMAN_NODE | (width << 16) | static_cast<uint32_t>(offset);
+        table.lookup.resize(offset + (size_t(1) << width), 0);
+
+        for (unsigned int i = 0; i < count; i++) {
+            const unsigned int length = lengths[i];
+            if (length <= first || (static_cast<uint32_t>(codes[i]) >> (length - first)) != prefix) continue;
+
+            const uint32_t leaf = (length << 8) | ((i / row) << 4) | (i % row);
+            const unsigned int rest = length - first;
+            const size_t start = offset + ((static_cast<size_t>(codes[i]) & ((size_t(1) << rest) - 1)) << (width - rest));
+            std::fill(table.lookup.begin() + start, table.lookup.begin() + start + (size_t(1) << (width - rest)), leaf);
+        }
+    }
+
+    return table;
+}
+
+/* the 32 big value tables by table_select, empty for the zero table and the two unused ones, then
+   count1 table a */
+static const std::vector<huffman_table> &huffman_tables() {
+    static const std::vector<huffman_table> tables = [] {
+        std::vector<huffman_table> out(33);
+
+        out[1] = build_huffman(MP3_CODES_1, MP3_LENGTHS_1, 4, 2, 0);
+        out[2] = build_huffman(MP3_CODES_2, MP3_LENGTHS_2, 9, 3, 0);
+        out[3] = build_huffman(MP3_CODES_3, MP3_LENGTHS_3, 9, 3, 0);
+        out[5] = build_huffman(MP3_CODES_5, MP3_LENGTHS_5, 16, 4, 0);
+        out[6] = build_huffman(MP3_CODES_6, MP3_LENGTHS_6, 16, 4, 0);
+        out[7] = build_huffman(MP3_CODES_7, MP3_LENGTHS_7, 36, 6, 0);
+        out[8] = build_huffman(MP3_CODES_8, MP3_LENGTHS_8, 36, 6, 0);
+        out[9] = build_huffman(MP3_CODES_9, MP3_LENGTHS_9, 36, 6, 0);
+        out[10] = build_huffman(MP3_CODES_10, MP3_LENGTHS_10, 64, 8, 0);
+        out[11] = build_huffman(MP3_CODES_11, MP3_LENGTHS_11, 64, 8, 0);
+        out[12] = build_huffman(MP3_CODES_12, MP3_LENGTHS_12, 64, 8, 0);
+        out[13] = build_huffman(MP3_CODES_13, MP3_LENGTHS_13, 256, 16, 0);
+        out[15] = build_huffman(MP3_CODES_15, MP3_LENGTHS_15, 256, 16, 0);
+
+        static const unsigned int LINBITS[16] = { 1, 2, 3, 4, 6, 8, 10, 13, 4, 5, 6, 7, 8, 9, 11, 13 };
+        for (unsigned int i = 0; i < 8; i++) {
+            out[16 + i] = build_huffman(MP3_CODES_16, MP3_LENGTHS_16, 256, 16, LINBITS[i]);
+            out[24 + i] = build_huffman(MP3_CODES_24, MP3_LENGTHS_24, 256, 16, LINBITS[8 + i]);
+        }
+
+        out[32] = build_huffman(MP3_QUAD_CODES, MP3_QUAD_LENGTHS, 16, 16, 0);
+        return out;
+    }();
+
+    return tables;
+}
+
+static uint32_t huffman_symbol(const huffman_table &table, uint64_t word) {
+    uint32_t entry = table.lookup[word >> (64 - table.first_bits)];
+
+    if (entry & HUFFMAN_NODE) {
+        const unsigned int width = (entry >> 16) & 0xFF;
+        entry = table.lookup[(entry & 0xFFFF) + ((word << table.first_bits) >> (64 - width))];
+    }
+
+    return entry;
+}
+
+/* |x|^(4/3) for every value the huffman codes can carry */
+static const float *power_table() {
+    static const std::vector<float> table = [] {
+        std::vector<float> out(8207);
+        for (size_t i = 0; i < out.size(); i++) out[i] = static_cast<float>(std::pow(static_cast<double>(i), 4.0 / 3.0));
+        return out;
+    }();
+
+    return table.data();
+}
+
+struct granule_info {
+    unsigned int part2_3_length = 0;
+    unsigned int big_values = 0;
+    unsigned int global_gain = 0;
+    unsigned int scalefac_compress = 0;
+    unsigned int block_type = 0;
+    bool mixed = false;
+    unsigned int table_select[3] = {};
+    unsigned int subblock_gain[3] = {};
+    unsigned int region0_count = 0;
+    unsigned int region1_count = 0;
+    bool preflag = false;
+    bool scalefac_scale = false;
+    bool count1_table = false;
+};
+
+/* one scalefactor band. short block bands come once per window, in the order the lines of the
+   granule are coded, which is also the order of its scalefactors */
+struct band {
+    uint16_t start;
+    uint16_t end;
+    int8_t window;
+    uint8_t index;
+};
+
+static unsigned int band_layout(unsigned int rate_index, bool lsf, const granule_info &granule, band *out) {
+    const uint16_t *long_bands = MP3_LONG_BANDS[rate_index];
+    const uint16_t *short_bands = MP3_SHORT_BANDS[rate_index];
+    unsigned int count = 0;
+
+    if (granule.block_type != 2) {
+        for (unsigned int i = 0; i < 22; i++) out[count++] = { long_bands[i], long_bands[i + 1], -1, static_cast<uint8_t>(i) };
+        return count;
+    }
+
+    /* mixed blocks start with the long bands below the third short one */
+    unsigned int first_short = 0;
+    if (granule.mixed) {
+        const unsigned int long_count = lsf ? 6 : 8;
+        for (unsigned int i = 0; i < long_count; i++) out[count++] = { long_bands[i], long_bands[i + 1], -1, static_cast<uint8_t>(i) };
+        first_short = 3;
+    }
+
+    for (unsigned int i = first_short; i < 13; i++) {
+        const unsigned int width = short_bands[i + 1] - short_bands[i];
+
+        for (unsigned int window = 0; window < 3; window++) {
+            const unsigned int start = short_bands[i] * 3 + window * width;
+            out[count++] = { static_cast<uint16_t>(start), static_cast<uint16_t>(start + width), static_cast<int8_t>(window), static_cast<uint8_t>(i) };
+        }
+    }
+
+    return count;
+}
+
+/* part 2 of one channel's granule, the scalefactors in band order. for the right channel of
+   intensity stereo illegal gets the value of each band that marks it as not intensity coded */
+static void read_scalefactors(mpeg_bits &bits, const granule_info &granule, bool lsf, const uint8_t *scfsi, bool second, bool intensity_right, uint8_t *scalefactors,
+                              uint8_t *illegal, bool &preflag, unsigned int &intensity_scale) {
+    std::fill(illegal, illegal + 40, 7);
+    preflag = granule.preflag;
+
+    if (!lsf) {
+        const unsigned int slen1 = MP3_SLEN[0][granule.scalefac_compress];
+        const unsigned int slen2 = MP3_SLEN[1][granule.scalefac_compress];
+
+        if (granule.block_type == 2) {
+            const unsigned int first = granule.mixed ? 17 : 18;
+            unsigned int n = 0;
+
+            for (; n < first; n++) scalefactors[n] = static_cast<uint8_t>(bits.bits(slen1));
+            for (; n < first + 18; n++) scalefactors[n] = static_cast<uint8_t>(bits.bits(slen2));
+            std::fill(scalefactors + n, scalefactors + 40, 0);
+            return;
+        }
+
+        /* the second granule can reuse the first one's scalefactors a group of bands at a time */
+        static const unsigned int GROUPS[5] = { 0, 6, 11, 16, 21 };
+
+        for (unsigned int group = 0; group < 4; group++) {
+            if (second && scfsi[group]) continue;
+
+            const unsigned int length = group < 2 ? slen1 : slen2;
+            for (unsigned int i = GROUPS[group]; i < GROUPS[group + 1]; i++) scalefactors[i] = static_cast<uint8_t>(bits.bits(length));
+        }
+
+        scalefactors[21] = 0;
+        return;
+    }
+
+    unsigned int slen[4] = {};
+    unsigned int table = 0;
+    unsigned int compress = granule.scalefac_compress;
+
+    if (intensity_right) {
+        intensity_scale = compress & 1;
+        compress >>= 1;
+
+        if (compress < 180) {
+            slen[0] = compress / 36;
+            slen[1] = (compress % 36) / 6;
+            slen[2] = compress % 6;
+            table = 3;
+        } else if (compress < 244) {
+            compress -= 180;
+            slen[0] = (compress % 64) >> 4;
+            slen[1] = (compress % 16) >> 2;
+            slen[2] = compress % 4;
+            table = 4;
+        } else {
+            compress -= 244;
+            slen[0] = compress / 3;
+            slen[1] = compress % 3;
+            table = 5;
+        }
+    } else if (compress < 400) {
+        slen[0] = (compress >> 4) / 5;
+        slen[1] = (compress >> 4) % 5;
+        slen[2] = (compress % 16) >> 2;
+        slen[3] = compress % 4;
+    } else if (compress < 500) {
+        compress -= 400;
+        slen[0] = (compress >> 2) / 5;
+        slen[1] = (compress >> 2) % 5;
+        slen[2] = compress % 4;
+        table = 1;
+    } else {
+        compress -= 500;
+        slen[0] = compress / 3;
+        slen[1] = compress % 3;
+        table = 2;
+        preflag = true;
+    }
+
+    const unsigned int block = granule.block_type == 2 ? (granule.mixed ? 2 : 1) : 0;
+    unsigned int n = 0;
+
+    for (unsigned int group = 0; group < 4; group++) {
+        for (unsigned int i = 0; i < MP3_LSF_BANDS[table][block][group]; i++, n++) {
+            scalefactors[n] = static_cast<uint8_t>(bits.bits(slen[group]));
+            illegal[n] = static_cast<uint8_t>((1u << slen[group]) - 1);
+        }
+    }
+
+    std::fill(scalefactors + n, scalefactors + 40, 0);
+}
+
+/* part 3, the huffman coded lines, requantized into xr with the scalefactors. returns how many
+   lines from the bottom can be nonzero */
+static unsigned int read_spectrum(mpeg_bits &bits, size_t end, const granule_info &granule, const band *bands, unsigned int band_count, const uint8_t *scalefactors,
+                                  bool preflag, float *xr) {
+    const std::vector<huffman_table> &tables = huffman_tables();
+    int values[576];
+
+    /* the big values come in up to three regions, each with its own table */
+    const unsigned int big_end = granule.big_values * 2;
+    unsigned int region_end[3] = { 0, 0, big_end };
+    unsigned int sum = 0;
+
+    for (unsigned int i = 0; i < band_count; i++) {
+        sum += bands[i].end - bands[i].start;
+        if (i == granule.region0_count) region_end[0] = sum;
+        if (i == granule.region0_count + granule.region1_count + 1) region_end[1] = sum;
+    }
+
+    if (region_end[0] == 0) region_end[0] = 576;
+    if (region_end[1] == 0) region_end[1] = 576;
+    region_end[0] = std::min(region_end[0], big_end);
+    region_end[1] = std::min(std::max(region_end[1], region_end[0]), big_end);
+
+    unsigned int line = 0;
+
+    for (unsigned int region = 0; region < 3; region++) {
+        const huffman_table &table = tables[granule.table_select[region]];
+
+        if (table.lookup.empty()) {
+            for (; line < region_end[region]; line++) values[line] = 0;
+            continue;
+        }
+
+        for (; line < region_end[region]; line += 2) {
+            const uint32_t symbol = huffman_symbol(table, bits.peek());
+            bits.skip(symbol >> 8);
+
+            int x = (symbol >> 4) & 15;
+            int y = symbol & 15;
+
+            if (x == 15 && table.linbits) x += bits.bits(table.linbits);
+            if (x && bits.bits(1)) x = -x;
+            if (y == 15 && table.linbits) y += bits.bits(table.linbits);
+            if (y && bits.bits(1)) y = -y;
+
+            values[line] = x;
+            values[line + 1] = y;
+        }
+    }
+
+    /* then quadruples of zeros and ones until the part runs out, a quadruple that overran it is
+       dropped */
+    const huffman_table &quads = tables[32];
+
+    while (line + 4 <= 576 && bits.position() < end) {
+        unsigned int quad;
+
+        if (granule.count1_table) {
+            quad = 15 - bits.bits(4);
+        } else {
+            const uint32_t symbol = huffman_symbol(quads, bits.peek());
+            bits.skip(symbol >> 8);
+            quad = symbol & 15;
+        }
+
+        int quadruple[4];
+        for (int i = 0; i < 4; i++) {
+            quadruple[i] = (quad >> (3 - i)) & 1;
+            if (quadruple[i] && bits.bits(1)) quadruple[i] = -1;
+        }
+
+        if (bits.position() > end) break;
+
+        for (int i = 0; i < 4; i++) values[line++] = quadruple[i];
+    }
+
+    const unsigned int limit = line;
+    const float *power = power_table();
+    static const float QUARTERS[4] = { 1.0f, 1.18920712f, 1.41421356f, 1.68179283f };
+
+    for (unsigned int i = 0; i < band_count && bands[i].start < limit; i++) {
+        const band &b = bands[i];
+
+        int exponent = static_cast<int>(granule.global_gain) - 210;
+        int scale = scalefactors[i];
+
+        if (b.window >= 0) {
+            exponent -= 8 * static_cast<int>(granule.subblock_gain[b.window]);
+        } else if (preflag) {
+            scale += MP3_PRETAB[b.index];
+        }
+
+        exponent -= (granule.scalefac_scale ? 4 : 2) * scale;
+        const float gain = std::ldexp(QUARTERS[exponent & 3], exponent >> 2);
+
+        for (unsigned int j = b.start; j < b.end && j < limit; j++) {
+            const int value = values[j];
+            xr[j] = value > 0 ? power[value] * gain : value < 0 ? -power[-value] * gain : 0.0f;
+        }
+    }
+
+    std::fill(xr + limit, xr + 576, 0.0f);
+    return limit;
+}
+
+/* mid/side and intensity stereo, band by band with the right channel's layout. intensity coding
+   covers the bands above the right channel's last nonzero one, per window for short blocks */
+static void decode_stereo(float *left, float *right, bool mid_side, bool intensity, bool lsf, const band *bands, unsigned int band_count, const uint8_t *scalefactors,
+                          const uint8_t *illegal, unsigned int intensity_scale) {
+    static const float HALF_ROOT = 0.70710678f;
+
+    if (!intensity) {
+        for (int i = 0; i < 576; i++) {
+            const float mid = left[i], side = right[i];
+            left[i] = (mid + side) * HALF_ROOT;
+            right[i] = (mid - side) * HALF_ROOT;
+        }
+        return;
+    }
+
+    int last_long = -1;
+    int last_short[3] = { -1, -1, -1 };
+
+    for (unsigned int i = 0; i < band_count; i++) {
+        const band &b = bands[i];
+        bool nonzero = false;
+        for (unsigned int j = b.start; j < b.end && !nonzero; j++) nonzero = right[j] != 0.0f;
+        if (!nonzero) continue;
+
+        if (b.window < 0) last_long = static_cast<int>(i);
+        else last_short[b.window] = b.index;
+    }
+
+    const bool short_nonzero = last_short[0] >= 0 || last_short[1] >= 0 || last_short[2] >= 0;
+
+    for (unsigned int i = 0; i < band_count; i++) {
+        const band &b = bands[i];
+        bool coded = b.window < 0 ? (static_cast<int>(i) > last_long && !short_nonzero) : static_cast<int>(b.index) > last_short[b.window];
+
+        /* the last band has no position of its own and takes the one below it */
+        unsigned int source = i;
+        if (b.window < 0 && b.index == 21) source = i - 1;
+        if (b.window >= 0 && b.index == 12) source = i - 3;
+
+        const unsigned int position = scalefactors[source];
+        if (position == illegal[source]) coded = false;
+
+        if (coded) {
+            float kl, kr;
+
+            if (!lsf) {
+                const double angle = position * M_PI / 12.0;
+                kl = static_cast<float>(std::sin(angle) / (std::sin(angle) + std::cos(angle)));
+                kr = static_cast<float>(std::cos(angle) / (std::sin(angle) + std::cos(angle)));
+            } else {
+                const double base = intensity_scale ? HALF_ROOT : 0.84089642;
+                kl = (position & 1) ? static_cast<float>(std::pow(base, (position + 1) / 2)) : 1.0f;
+                kr = (position & 1) ? 1.0f : static_cast<float>(std::pow(base, position / 2));
+            }
+
+            for (unsigned int j = b.start; j < b.end; j++) {
+                const float value = left[j];
+                left[j] = value * kl;
+                right[j] = value * kr;
+            }
+        } else if (mid_side) {
+            for (unsigned int j = b.start; j < b.end; j++) {
+                const float mid = left[j], side = right[j];
+                left[j] = (mid + side) * HALF_ROOT;
+                right[j] = (mid - side) * HALF_ROOT;
+            }
+        }
+    }
+}
+
+/* imdct cosines with the window of each long block type folded in, and the one short window.
+   indexed input first, so each input line adds into a run of outputs the compiler vectorizes */
+struct imdct_tables {
+    float windows[4][18][36];
+    float short_window[6][12];
+};
+
+static const imdct_tables &imdct() {
+    static const imdct_tables tables = [] {
+        imdct_tables out = {};
+
+        for (int type = 0; type < 4; type++) {
+            for (int i = 0; i < 36; i++) {
+                double window = std::sin(M_PI / 36.0 * (i + 0.5));
+
+                if (type == 1) {
+                    if (i >= 30) window = 0.0;
+                    else if (i >= 24) window = std::sin(M_PI / 12.0 * (i - 18 + 0.5));
+                    else if (i >= 18) window = 1.0;
+                } else if (type == 3) {
+                    if (i < 6) window = 0.0;
+                    else if (i < 12) window = std::sin(M_PI / 12.0 * (i - 6 + 0.5));
+                    else if (i < 18) window = 1.0;
+                }
+
+                for (int k = 0; k < 18; k++) out.windows[type][k][i] = static_cast<float>(window * std::cos(M_PI / 72.0 * (2 * i + 19) * (2 * k + 1)));
+            }
+        }
+
+        for (int i = 0; i < 12; i++) {
+            for (int k = 0; k < 6; k++) out.short_window[k][i] = static_cast<float>(std::sin(M_PI / 12.0 * (i + 0.5)) * std::cos(M_PI / 24.0 * (2 * i + 7) * (2 * k + 1)));
+        }
+
+        return out;
+    }();
+
+    return tables;
+}
+
+/* alias reduction, the imdct and the overlap with the previous granule, leaving 18 samples of each
+   subband in out, time major and with every other sample of the odd subbands inverted */
+static void hybrid(float *xr, unsigned int limit, const granule_info &granule, const band *bands, unsigned int band_count, float *overlap, float (*out)[32]) {
+    unsigned int long_end = 576;
+
+    if (granule.block_type == 2) {
+        long_end = 0;
+        for (unsigned int i = 0; i < band_count && bands[i].window < 0; i++) long_end = bands[i].end;
+
+        /* short block lines come window by window in each band, the imdct takes them interleaved */
+        float reordered[576];
+        for (unsigned int i = 0; i + 2 < band_count; i++) {
+            if (bands[i].window != 0) continue;
+
+            const unsigned int start = bands[i].start;
+            const unsigned int width = bands[i].end - start;
+            for (unsigned int window = 0; window < 3; window++) {
+                for (unsigned int j = 0; j < width; j++) reordered[start + j * 3 + window] = xr[start + window * width + j];
+            }
+        }
+
+        std::copy(reordered + long_end, reordered + 576, xr + long_end);
+
+        limit = 576;
+        while (limit > 0 && xr[limit - 1] == 0.0f) limit--;
+    }
+
+    static const float CS[8] = { 0.857492926f, 0.881741997f, 0.949628649f, 0.983314592f, 0.995517816f, 0.999160558f, 0.999899195f, 0.999993155f };
+    static const float CA[8] = { -0.514495755f, -0.471731969f, -0.313377454f, -0.181913200f, -0.094574193f, -0.040965583f, -0.014198569f, -0.003699975f };
+
+    for (unsigned int sb = 1; sb < long_end / 18 && sb * 18 < limit + 8; sb++) {
+        for (int i = 0; i < 8; i++) {
+            float &up = xr[sb * 18 - 1 - i];
+            float &down = xr[sb * 18 + i];
+            const float u = up, d = down;
+            up = u * CS[i] - d * CA[i];
+            down = d * CS[i] + u * CA[i];
+        }
+    }
+
+    const imdct_tables &tables = imdct();
+    const unsigned int used = std::min(32u, (limit + 8 + 17) / 18);
+
+    for (unsigned int sb = 0; sb < 32; sb++) {
+        float *previous = overlap + sb * 18;
+
+        if (sb >= used) {
+            for (int i = 0; i < 18; i++) {
+                out[i][sb] = previous[i];
+                previous[i] = 0.0f;
+            }
+        } else {
+            const float *x = xr + sb * 18;
+            float y[36] = {};
+
+            if (sb * 18 < long_end) {
+                const float (*window)[36] = tables.windows[granule.block_type == 2 ? 0 : granule.block_type];
+
+                for (int k = 0; k < 18; k++) {
+                    for (int i = 0; i < 36; i++) y[i] += x[k] * window[k][i];
+                }
+            } else {
+                for (int window = 0; window < 3; window++) {
+                    float *part = y + 6 + window * 6;
+
+                    for (int k = 0; k < 6; k++) {
+                        for (int i = 0; i < 12; i++) part[i] += x[k * 3 + window] * tables.short_window[k][i];
+                    }
+                }
+            }
+
+            for (int i = 0; i < 18; i++) {
+                out[i][sb] = y[i] + previous[i];
+                previous[i] = y[18 + i];
+            }
+        }
+
+        if (sb & 1) {
+            for (int i = 1; i < 18; i += 2) out[i][sb] = -out[i][sb];
+        }
+    }
+}
+
+/* the polyphase synthesis: the 32 point dct that its 64 point matrixing reduces to, indexed
+   input first like the imdct, and the window D[i] */
+struct synthesis_tables {
+    float dct[32][32];
+    float window[512];
+};
+
+static const synthesis_tables &synthesis() {
+    static const synthesis_tables tables = [] {
+        synthesis_tables out = {};
+
+        for (int m = 0; m < 32; m++) {
+            for (int k = 0; k < 32; k++) out.dct[k][m] = static_cast<float>(std::cos(m * (2 * k + 1) * M_PI / 64.0));
+        }
+
+        for (int i = 0; i <= 256; i++) {
+            const float value = MP3_WINDOW[i] / 65536.0f;
+            out.window[i] = value;
+            if (i > 0) out.window[512 - i] = (i & 63) ? -value : value;
+        }
+
+        return out;
+    }();
+
+    return tables;
+}
+
+void mp3_decoder::synthesize(unsigned int channel, const float (*subbands)[32], float *out) {
+    const synthesis_tables &tables = synthesis();
+    float *v = _synth[channel];
+    unsigned int &offset = _synth_offset[channel];
+
+    for (int t = 0; t < 18; t++) {
+        offset = (offset - 64) & 1023;
+
+        float x[32] = {};
+        for (int k = 0; k < 32; k++) {
+            const float sample = subbands[t][k];
+            if (sample == 0.0f) continue;
+
+            for (int m = 0; m < 32; m++) x[m] += sample * tables.dct[k][m];
+        }
+
+        /* the 64 matrixed values are the dct's mirrored around 16 and 48 */
+        float *row = v + offset;
+        for (int i = 0; i < 16; i++) row[i] = x[16 + i];
+        row[16] = 0.0f;
+        for (int i = 17; i < 64; i++) row[i] = -x[std::abs(48 - i)];
+
+        /* offset is a multiple of 64, so each run of 32 stays clear of the buffer's end */
+        float sums[32] = {};
+        for (int i = 0; i < 8; i++) {
+            const float *even = v + ((offset + i * 128) & 1023);
+            const float *odd = v + ((offset + i * 128 + 96) & 1023);
+            const float *window = tables.window + i * 64;
+
+            for (int j = 0; j < 32; j++) sums[j] += even[j] * window[j] + odd[j] * window[32 + j];
+        }
+
+        for (int j = 0; j < 32; j++) out[(t * 32 + j) * _channels] = sums[j];
+    }
+}
+
+bool mp3_decoder::open(const std::string &path, const uint8_t *data, size_t size) {
+    if (!data) {
+        if (!read_whole_file(path, _file)) return false;
+
+        data = _file.data();
+        size = _file.size();
+    }
+
+    _data = data;
+    _size = size;
+
+    if (!index_frames()) return false;
+
+    _source = sample_format::f32;
+    _bits_per_sample = 32;
+    _pcm.assign(static_cast<size_t>(_frame_samples) * _channels, 0.0f);
+
+    _next = 0;
+    _position = 0;
+    return true;
+}
+
+/* walks the frame headers from the first frame to the end of the stream into _frames, and takes
+   the stream's format and gapless trim from the first frame */
+bool mp3_decoder::index_frames() {
+    size_t pos = 0;
+    for (size_t length; (length = id3v2_length(_data + pos, _size - pos)) != 0;) {
+        if (length > _size - pos) return false;
+        pos += length;
+    }
+
+    mpeg_header stream;
+    if (!find_frame(_data, _size, pos, RESYNC_LIMIT, nullptr, pos, stream)) return false;
+
+    _channels = stream.channels;
+    _sample_rate = stream.sample_rate;
+    _rate_index = stream.rate_index;
+    _lsf = stream.lsf;
+    _frame_samples = stream.lsf ? 576 : 1152;
+
+    /* a tag in the first frame replaces its audio */
+    stream_tag tag;
+    if (read_stream_tag(_data + pos, stream, tag)) pos += stream.length;
+
+    _frames.clear();
+    mpeg_header header;
+
+    while (pos + 4 <= _size) {
+        if (parse_mpeg_header(_data + pos, header) && same_stream(header, stream) && header.length <= _size - pos) {
+            _frames.push_back(pos);
+            pos += header.length;
+            continue;
+        }
+
+        /* an id3v1 or ape tag ends the stream, anything else is junk to find the next frame past */
+        if (std::memcmp(_data + pos, "TAG", 3) == 0 || (_size - pos >= 8 && std::memcmp(_data + pos, "APETAGEX", 8) == 0)) break;
+        if (!find_frame(_data, _size, pos + 1, RESYNC_LIMIT, &stream, pos, header)) break;
+    }
+
+    if (_frames.empty()) return false;
+
+    /* lame counts its delay and padding from the decoder's first sample, which comes after the
+       filterbanks' own delay */
+    const uint64_t decoded = static_cast<uint64_t>(_frames.size()) * _frame_samples;
+
+    if (tag.gapless) {
+        _skip = std::min(decoded, tag.delay + DECODER_DELAY);
+        const uint64_t end = std::min(decoded, decoded + DECODER_DELAY - std::min<uint64_t>(decoded, tag.padding));
+        _frame_count = end > _skip ? end - _skip : 0;
+    } else {
+        _skip = 0;
+        _frame_count = decoded;
+    }
+
+    return true;
+}
+
+/* keeps the last RESERVOIR_BYTES of main data, the furthest back a frame's can start */
+void mp3_decoder::append_reservoir(const uint8_t *data, size_t length) {
+    if (length >= RESERVOIR_BYTES) {
+        std::memcpy(_reservoir, data + length - RESERVOIR_BYTES, RESERVOIR_BYTES);
+        _reservoir_size = RESERVOIR_BYTES;
+        return;
+    }
+
+    const size_t keep = std::min(_reservoir_size, RESERVOIR_BYTES - length);
+    std::memmove(_reservoir, _reservoir + _reservoir_size - keep, keep);
+    std::memcpy(_reservoir + keep, data, length);
+    _reservoir_size = keep + length;
+}
+
+/* the main data of the frames before frame, as decoding up to it would have left the reservoir */
+void mp3_decoder::prime_reservoir(size_t frame) {
+    _reservoir_size = 0;
+
+    size_t first = frame;
+    size_t bytes = 0;
+    mpeg_header header;
+
+    while (first > 0 && bytes < RESERVOIR_BYTES) {
+        first--;
+        parse_mpeg_header(_data + _frames[first], header);
+        bytes += header.length - 4 - (header.crc ? 2 : 0) - header.side_info;
+    }
+
+    for (size_t i = first; i < frame; i++) {
+        parse_mpeg_header(_data + _frames[i], header);
+
+        const size_t start = 4 + (header.crc ? 2 : 0) + header.side_info;
+        append_reservoir(_data + _frames[i] + start, header.length - start);
+    }
+}
+
+/* decodes one frame into _pcm. a frame whose main data is missing or broken plays as silence
+   while still running the filterbanks, as would a missing one */
+void mp3_decoder::decode_frame(size_t frame) {
+    const uint8_t *p = _data + _frames[frame];
+    mpeg_header header;
+    parse_mpeg_header(p, header);
+
+    const unsigned int granules = _lsf ? 1 : 2;
+    const size_t side_start = 4 + (header.crc ? 2 : 0);
+    const size_t main_start = side_start + header.side_info;
+
+    mpeg_bits side_bits(p, header.length, side_start * 8);
+    const size_t main_data_begin = side_bits.bits(_lsf ? 8 : 9);
+    side_bits.skip(_lsf ? (_channels == 1 ? 1 : 2) : (_channels == 1 ? 5 : 3));
+
+    uint8_t scfsi[2][4] = {};
+    if (!_lsf) {
+        for (unsigned int channel = 0; channel < _channels; channel++) {
+            for (int group = 0; group < 4; group++) scfsi[channel][group] = static_cast<uint8_t>(side_bits.bits(1));
+        }
+    }
+
+    granule_info side[2][2];
+    size_t main_bits = 0;
+    bool valid = true;
+
+    for (unsigned int gr = 0; gr < granules; gr++) {
+        for (unsigned int channel = 0; channel < _channels; channel++) {
+            granule_info &g = side[gr][channel];
+
+            g.part2_3_length = side_bits.bits(12);
+            g.big_values = side_bits.bits(9);
+            g.global_gain = side_bits.bits(8);
+            g.scalefac_compress = side_bits.bits(_lsf ? 9 : 4);
+
+            if (side_bits.bits(1)) {
+                g.block_type = side_bits.bits(2);
+                g.mixed = side_bits.bits(1) != 0;
+                for (int i = 0; i < 2; i++) g.table_select[i] = side_bits.bits(5);
+                for (int i = 0; i < 3; i++) g.subblock_gain[i] = side_bits.bits(3);
+
+                g.region0_count = (g.block_type == 2 && !g.mixed) ? 8 : 7;
+                g.region1_count = 36;
+
+                /* block type 0 is coded without window switching */
+                if (g.block_type == 0) valid = false;
+            } else {
+                for (int i = 0; i < 3; i++) g.table_select[i] = side_bits.bits(5);
+                g.region0_count = side_bits.bits(4);
+                g.region1_count = side_bits.bits(3);
+            }
+
+            if (!_lsf) g.preflag = side_bits.bits(1) != 0;
+            g.scalefac_scale = side_bits.bits(1) != 0;
+            g.count1_table = side_bits.bits(1) != 0;
+
+            main_bits += g.part2_3_length;
+            if (g.big_values > 288) valid = false;
+        }
+    }
+
+    /* the frame's main data starts main_data_begin bytes back in the frames before it. a frame
+       whose side info does not fit it is most likely not a frame at all, none of it is used */
+    const size_t main_length = header.length - main_start;
+    const bool complete = valid && main_data_begin <= _reservoir_size && main_bits <= (main_data_begin + main_length) * 8;
+
+    if (complete) {
+        _main.assign(_reservoir + _reservoir_size - main_data_begin, _reservoir + _reservoir_size);
+        _main.insert(_main.end(), p + main_start, p + header.length);
+    }
+
+    append_reservoir(p + main_start, main_length);
+
+    const bool intensity = header.mode == 1 && (header.mode_extension & 1);
+    const bool mid_side = header.mode == 1 && (header.mode_extension & 2);
+    size_t bit = 0;
+
+    for (unsigned int gr = 0; gr < granules; gr++) {
+        band bands[2][40];
+        unsigned int band_count[2] = {};
+        unsigned int limit[2] = {};
+        unsigned int intensity_scale = 0;
+
+        for (unsigned int channel = 0; channel < _channels; channel++) {
+            const granule_info &g = side[gr][channel];
+            const size_t end = bit + g.part2_3_length;
+            float *xr = _spectrum[channel];
+
+            band_count[channel] = band_layout(_rate_index, _lsf, g, bands[channel]);
+
+            if (complete) {
+                mpeg_bits bits(_main.data(), _main.size(), bit);
+                bool preflag = false;
+
+                read_scalefactors(bits, g, _lsf, scfsi[channel], gr == 1, intensity && channel == 1, _scalefactors[channel], _illegal, preflag, intensity_scale);
+                limit[channel] = read_spectrum(bits, end, g, bands[channel], band_count[channel], _scalefactors[channel], preflag, xr);
+            } else {
+                std::fill(xr, xr + 576, 0.0f);
+            }
+
+            bit = end;
+        }
+
+        if (_channels == 2 && (mid_side || intensity)) {
+            decode_stereo(_spectrum[0], _spectrum[1], mid_side, intensity, _lsf, bands[1], band_count[1], _scalefactors[1], _illegal, intensity_scale);
+
+            /* either channel can now reach as high as the other did */
+            limit[0] = limit[1] = intensity ? 576 : std::max(limit[0], limit[1]);
+        }
+
+        for (unsigned int channel = 0; channel < _channels; channel++) {
+            float subbands[18][32];
+            hybrid(_spectrum[channel], limit[channel], side[gr][channel], bands[channel], band_count[channel], _overlap[channel], subbands);
+            synthesize(channel, subbands, _pcm.data() + gr * 576 * _channels + channel);
+        }
+    }
+}
+
+uint64_t mp3_decoder::read(uint64_t frames, void *out) {
+    float *samples = static_cast<float *>(out);
+    uint64_t done = 0;
+
+    while (done < frames && _position < _frame_count) {
+        if (_pcm_read == _pcm_frames) {
+            if (_next >= _frames.size()) break;
+
+            /* frames before the position only settle the decoder, the encoder delay at the start
+               and the frames a seek decodes ahead of its target */
+            const uint64_t start = static_cast<uint64_t>(_next) * _frame_samples;
+            const uint64_t wanted = _position + _skip;
+
+            decode_frame(_next++);
+            _pcm_frames = _frame_samples;
+            _pcm_read = static_cast<uint32_t>(wanted > start ? std::min<uint64_t>(wanted - start, _frame_samples) : 0);
+            continue;
+        }
+
+        const uint64_t count = std::min<uint64_t>({ frames - done, _pcm_frames - _pcm_read, _frame_count - _position });
+        std::memcpy(samples + done * _channels, _pcm.data() + static_cast<size_t>(_pcm_read) * _channels, count * _channels * sizeof(float));
+
+        _pcm_read += static_cast<uint32_t>(count);
+        _position += count;
+        done += count;
+    }
+
+    return done;
+}
+
+bool mp3_decoder::seek(uint64_t frame) {
+    _pcm_frames = _pcm_read = 0;
+
+    if (frame >= _frame_count) {
+        _next = _frames.size();
+        _position = _frame_count;
+        return true;
+    }
+
+    /* the frame before the target (the two before it for single granule frames) is decoded for
+       the overlap and the synthesis history it leaves, and needs the reservoir as it was */
+    const size_t target = static_cast<size_t>((frame + _skip) / _frame_samples);
+    const size_t ahead = _lsf ? 2 : 1;
+    const size_t first = target > ahead ? target - ahead : 0;
+
+    std::memset(_overlap, 0, sizeof(_overlap));
+    std::memset(_synth, 0, sizeof(_synth));
+    _synth_offset[0] = _synth_offset[1] = 0;
+
+    prime_reservoir(first);
+    _next = first;
+    _position = frame;
+    return true;
+}
+
+static void append_utf8(std::string &out, uint32_t code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+/* an id3 text frame's first string as utf-8. latin-1 and utf-16 are widened, characters outside
+   the basic plane are dropped */
+static std::string id3_text(const uint8_t *p, size_t length) {
+    std::string text;
+    if (length < 1) return text;
+
+    const uint8_t encoding = p[0];
+    p++;
+    length--;
+
+    if (encoding == 0 || encoding == 3) {
+        for (size_t i = 0; i < length && p[i] != 0; i++) {
+            if (encoding == 3) text.push_back(static_cast<char>(p[i]));
+            else append_utf8(text, p[i]);
+        }
+    } else if (encoding == 1 || encoding == 2) {
+        bool big = (encoding == 2);
+        size_t i = 0;
+
+        if (encoding == 1 && length >= 2) {
+            big = (p[0] == 0xFE && p[1] == 0xFF);
+            i = 2;
+        }
+
+        for (; i + 1 < length; i += 2) {
+            const uint32_t unit = big ? ((p[i] << 8) | p[i + 1]) : ((p[i + 1] << 8) | p[i]);
+            if (unit == 0) break;
+            if (unit < 0xD800 || unit > 0xDFFF) append_utf8(text, unit);
+        }
+    }
+
+    return text;
+}
+
+/* title, artist, album and genre from the frames of an id3v2.3 or 2.4 tag */
+static void read_id3_tags(const uint8_t *header, const uint8_t *tag, size_t length, std::string &tags) {
+    const int version = header[3];
+    if (version < 3 || version > 4) return;
+
+    /* an extended header comes before the frames */
+    size_t pos = 0;
+    if ((header[5] & 0x40) && length >= 4) pos = (version == 4) ? syncsafe(tag) : big_endian(tag, 4) + 4;
+
+    static const char *const FRAMES[] = { "TIT2", "TPE1", "TALB", "TCON" };
+
+    while (pos + 10 <= length && tag[pos] != 0) {
+        const uint8_t *frame = tag + pos;
+        const size_t size = (version == 4) ? syncsafe(frame + 4) : big_endian(frame + 4, 4);
+        if (size > length - pos - 10) break;
+
+        for (const char *wanted : FRAMES) {
+            if (std::memcmp(frame, wanted, 4) != 0) continue;
+
+            const std::string text = id3_text(frame + 10, size);
+            append_tag(tags, text.data(), text.size());
+        }
+
+        pos += 10 + size;
+    }
+}
+
+bool probe_mp3(const std::string &path, track_probe &out) {
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (!file) return false;
+
+    /* the tags come first, the audio starts after them */
+    long start = 0;
+    uint8_t header[10];
+
+    while (std::fseek(file, start, SEEK_SET) == 0 && std::fread(header, 1, sizeof(header), file) == sizeof(header)) {
+        const size_t length = id3v2_length(header, sizeof(header));
+        if (length == 0) break;
+
+        if (start == 0) {
+            std::vector<uint8_t> tag(std::min(length - 10, ID3_READ_LIMIT));
+            tag.resize(std::fread(tag.data(), 1, tag.size(), file));
+            read_id3_tags(header, tag.data(), tag.size(), out.tags);
+        }
+
+        start += static_cast<long>(length);
+    }
+
+    std::vector<uint8_t> head(PROBE_BYTES);
+    bool ok = std::fseek(file, start, SEEK_SET) == 0;
+    head.resize(ok ? std::fread(head.data(), 1, head.size(), file) : 0);
+
+    long end = 0;
+    uint8_t trailer[3] = {};
+    ok = ok && std::fseek(file, 0, SEEK_END) == 0 && (end = std::ftell(file)) >= start;
+    if (ok && end - start >= 128 && std::fseek(file, end - 128, SEEK_SET) == 0 && std::fread(trailer, 1, 3, file) == 3 && std::memcmp(trailer, "TAG", 3) == 0) end -= 128;
+    std::fclose(file);
+
+    size_t pos;
+    mpeg_header stream;
+    if (!ok || !find_frame(head.data(), head.size(), 0, head.size(), nullptr, pos, stream)) return false;
+
+    out.sample_rate = stream.sample_rate;
+    out.channels = stream.channels;
+
+    const uint64_t samples = stream.lsf ? 576 : 1152;
+    stream_tag tag;
+
+    if (stream.length <= head.size() - pos && read_stream_tag(head.data() + pos, stream, tag) && tag.frames) {
+        const uint64_t decoded = tag.frames * samples;
+        const uint64_t trim = tag.gapless ? std::min<uint64_t>(decoded, tag.delay + tag.padding) : 0;
+        out.frame_count = decoded - trim;
+    } else {
+        /* no frame count, so the length is what the first frame's bitrate gives for the file */
+        const uint64_t bytes = static_cast<uint64_t>(end - start) - pos;
+        out.frame_count = bytes * 8 * stream.sample_rate / stream.bitrate;
+    }
+
+    return true;
+}
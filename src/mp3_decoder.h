@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decoder.h"
+
+/* native mpeg-1, 2 and 2.5 layer iii, decoded a frame at a time from the mapping (or from the whole
+   file read into memory when it could not be mapped) to f32.
+
+   open() hops from frame header to frame header once and keeps every frame's offset, so a seek
+   goes straight to the frame holding the target. it refills the bit reservoir from the frames
+   before it and decodes one more frame ahead of it (two for the single granule mpeg-2 frames) to
+   settle the filterbanks, so what plays after a seek is exactly what decoding from the start would
+   have produced. the encoder delay and padding of a lame tag are trimmed off for gapless playback */
+class mp3_decoder : public decoder {
+    private:
+        /* the furthest back a frame's main data can start */
+        static constexpr size_t RESERVOIR_BYTES = 511;
+
+        std::vector<uint8_t> _file;
+        const uint8_t *_data = nullptr;
+        size_t _size = 0;
+
+        std::vector<size_t> _frames;
+        unsigned int _rate_index = 0;
+        bool _lsf = false;
+        unsigned int _frame_samples = 0;
+        uint64_t _skip = 0;
+
+        /* main data of the frames decoded so far, the newest last */
+        uint8_t _reservoir[RESERVOIR_BYTES] = {};
+        size_t _reservoir_size = 0;
+        std::vector<uint8_t> _main;
+
+        float _spectrum[2][576] = {};
+        uint8_t _scalefactors[2][40] = {};
+        uint8_t _illegal[40] = {};
+        float _overlap[2][576] = {};
+        float _synth[2][1024] = {};
+        unsigned int _synth_offset[2] = {};
+
+        /* the decoded frame, interleaved */
+        std::vector<float> _pcm;
+        uint32_t _pcm_frames = 0;
+        uint32_t _pcm_read = 0;
+
+        size_t _next = 0;
+        uint64_t _position = 0;
+
+        bool index_frames();
+        void append_reservoir(const uint8_t *data, size_t length);
+        void prime_reservoir(size_t frame);
+        void decode_frame(size_t frame);
+        void synthesize(unsigned int channel, const float (*subbands)[32], float *out);
+
+    public:
+        bool open(const std::string &path, const uint8_t *data, size_t size) override;
+        uint64_t read(uint64_t frames, void *out) override;
+        bool seek(uint64_t frame) override;
+};
+
+/* stream info from the first frame and its xing or lame tag (the length estimated from the file
+   size for a constant bitrate file without one), and title, artist, album and genre from an id3v2
+   tag at the head of the file */
+bool probe_mp3(const std::string &path, track_probe &out);
@@ -0,0 +1,265 @@
+#include "pcm_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <sys/stat.h>
+
+static bool file_stat(const std::string &path, uint64_t &size, int64_t &mtime) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+static size_t entry_frame_bytes(const pcm_entry &entry) {
+    return sample_size(entry.source) * entry.channels;
+}
+
+bool pcm_cache::init(size_t budget_bytes) {
+    cleanup();
+
+    const size_t chunks = std::min<size_t>(budget_bytes / CHUNK_BYTES, UINT32_MAX);
+    if (chunks == 0) return true;
+
+    /* left uninitialized, pages only become resident as chunks are first written */
+    _pool.reset(new (std::nothrow) uint8_t[chunks * CHUNK_BYTES]);
+    if (!_pool) {
+        std::cerr << "failed to allocate " << chunks * CHUNK_BYTES << " bytes for the decode cache, it stays off\n";
+        return false;
+    }
+
+    _chunk_count = chunks;
+    _free.reserve(chunks);
+    for (size_t i = chunks; i > 0; i--) _free.push_back(static_cast<uint32_t>(i - 1));
+
+    return true;
+}
+
+void pcm_cache::cleanup() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _index.clear();
+    _entries.clear();
+    _free.clear();
+
+    _pool.reset();
+    _chunk_count = 0;
+}
+
+void pcm_cache::free_entry(std::list<pcm_entry>::iterator it) {
+    for (uint64_t i = 0; i < it->reserved; i++) _free.push_back(it->chunks[i]);
+
+    _entries.erase(it);
+}
+
+/* least recently used entries go first, the ones a stream has open are skipped */
+bool pcm_cache::take_chunk(uint32_t &chunk, bool evict) {
+    while (_free.empty() && evict) {
+        auto victim = std::find_if(_entries.rbegin(), _entries.rend(), [](const pcm_entry &entry) { return entry.users == 0; });
+        if (victim == _entries.rend()) return false;
+
+        const auto it = std::next(victim).base();
+        _index.erase(it->path);
+        free_entry(it);
+    }
+
+    if (_free.empty()) return false;
+
+    chunk = _free.back();
+    _free.pop_back();
+    return true;
+}
+
+pcm_entry *pcm_cache::find(const std::string &path) {
+    if (!enabled()) return nullptr;
+
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!file_stat(path, size, mtime)) return nullptr;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto found = _index.find(path);
+    if (found == _index.end()) {
+        _misses++;
+        return nullptr;
+    }
+
+    const auto it = found->second;
+
+    /* the file changed, its entry goes as soon as nobody reads it any more */
+    if (it->size != size || it->mtime != mtime) {
+        _index.erase(found);
+        if (it->users == 0) free_entry(it);
+        else it->orphaned = true;
+
+        _misses++;
+        return nullptr;
+    }
+
+    if (it->filled == 0) {
+        _misses++;
+        return nullptr;
+    }
+
+    _entries.splice(_entries.begin(), _entries, it);
+    it->users++;
+    _hits++;
+    return &*it;
+}
+
+pcm_entry *pcm_cache::insert(const std::string &path, unsigned int channels, unsigned int sample_rate, unsigned int bits_per_sample,
+                             sample_format source, uint64_t frame_count) {
+    if (!enabled() || channels == 0 || frame_count == 0 || sample_size(source) * channels > CHUNK_BYTES) return nullptr;
+
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (!file_stat(path, size, mtime)) return nullptr;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto found = _index.find(path);
+    if (found != _index.end()) {
+        const auto it = found->second;
+
+        if (it->size == size && it->mtime == mtime && it->channels == channels && it->source == source) {
+            _entries.splice(_entries.begin(), _entries, it);
+            it->users++;
+            return &*it;
+        }
+
+        _index.erase(found);
+        if (it->users == 0) free_entry(it);
+        else it->orphaned = true;
+    }
+
+    _entries.emplace_front();
+    pcm_entry &entry = _entries.front();
+
+    entry.path = path;
+    entry.size = size;
+    entry.mtime = mtime;
+
+    entry.channels = channels;
+    entry.sample_rate = sample_rate;
+    entry.bits_per_sample = bits_per_sample;
+    entry.source = source;
+    entry.frame_count = frame_count;
+
+    /* a header claiming more than the whole pool only ever gets its head cached */
+    entry.chunk_frames = CHUNK_BYTES / entry_frame_bytes(entry);
+    entry.chunks.resize(std::min<uint64_t>((frame_count + entry.chunk_frames - 1) / entry.chunk_frames, _chunk_count));
+
+    entry.users = 1;
+    _index[path] = _entries.begin();
+    return &entry;
+}
+
+bool pcm_cache::claim(pcm_entry &entry, const void *owner) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (entry.writer != nullptr || entry.complete || entry.orphaned) return false;
+    entry.writer = owner;
+
+    /* as much as is free, and evicting for up to a share of the pool. appending takes more once
+       it gets there, but never evicts */
+    const uint64_t share = std::max<uint64_t>(_chunk_count / CLAIM_SHARE, 1);
+
+    while (entry.reserved < entry.chunks.size() && take_chunk(entry.chunks[entry.reserved], entry.reserved < share)) entry.reserved++;
+    return true;
+}
+
+void pcm_cache::release(pcm_entry *entry, const void *owner) {
+    if (!entry) return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (entry->writer == owner) {
+        entry->writer = nullptr;
+
+        /* the writer stopped early, what it did not get to goes back */
+        const uint64_t used = (entry->filled + entry->chunk_frames - 1) / entry->chunk_frames;
+        while (entry->reserved > used) _free.push_back(entry->chunks[--entry->reserved]);
+    }
+
+    if (--entry->users > 0) return;
+
+    /* nothing worth keeping, or superseded by a newer version of the file */
+    if (!entry->orphaned && entry->filled > 0) return;
+
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (&*it != entry) continue;
+
+        if (!entry->orphaned) _index.erase(entry->path);
+        free_entry(it);
+        return;
+    }
+}
+
+const uint8_t *pcm_cache::frames(const pcm_entry &entry, uint64_t frame, uint64_t &frames) const {
+    const uint64_t filled = entry.filled.load(std::memory_order_acquire);
+    if (frame >= filled) return nullptr;
+
+    const uint64_t chunk = frame / entry.chunk_frames;
+    const uint64_t offset = frame % entry.chunk_frames;
+
+    frames = std::min({ frames, filled - frame, entry.chunk_frames - offset });
+    return _pool.get() + static_cast<size_t>(entry.chunks[chunk]) * CHUNK_BYTES + offset * entry_frame_bytes(entry);
+}
+
+/* only the writer gets here and only it moves filled, readers see each store of it with the chunk
+   contents it covers */
+bool pcm_cache::append(pcm_entry &entry, const void *owner, uint64_t frame, const uint8_t *in, uint64_t frames, bool last) {
+    if (entry.writer.load(std::memory_order_relaxed) != owner) return false;
+
+    uint64_t filled = entry.filled.load(std::memory_order_relaxed);
+
+    /* the writer seeked away from the end of what it wrote */
+    if (frame != filled || entry.complete) return false;
+
+    const size_t frame_bytes = entry_frame_bytes(entry);
+    uint64_t done = 0;
+
+    while (done < frames) {
+        const uint64_t chunk = filled / entry.chunk_frames;
+        const uint64_t offset = filled % entry.chunk_frames;
+
+        /* a chunk is taken ahead of the one being written, so when the lock is busy the next
+           append tries again before the writer runs out */
+        if (chunk + 1 >= entry.reserved && entry.reserved < entry.chunks.size()) {
+            std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+            if (lock.owns_lock() && take_chunk(entry.chunks[entry.reserved], false)) entry.reserved++;
+        }
+
+        if (chunk >= entry.reserved) break;
+
+        const uint64_t count = std::min(frames - done, entry.chunk_frames - offset);
+        uint8_t *out = _pool.get() + static_cast<size_t>(entry.chunks[chunk]) * CHUNK_BYTES + offset * frame_bytes;
+        std::memcpy(out, in + done * frame_bytes, count * frame_bytes);
+
+        done += count;
+        filled += count;
+    }
+
+    entry.filled.store(filled, std::memory_order_release);
+
+    /* out of room, the entry keeps the head it has */
+    if (done < frames) return false;
+
+    if (last) {
+        entry.complete = true;
+        return false;
+    }
+
+    return true;
+}
+
+size_t pcm_cache::used() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return (_chunk_count - _free.size()) * CHUNK_BYTES;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sample_convert.h"
+
+/* the decoded head (or all) of one track, in the sample format its decoder produces */
+struct pcm_entry {
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+
+    unsigned int channels = 0;
+    unsigned int sample_rate = 0;
+    unsigned int bits_per_sample = 0;
+    sample_format source = sample_format::f32;
+    uint64_t frame_count = 0;
+
+    /* frames [0, filled) are in chunks, each holding chunk_frames of them. chunks is sized for the
+       whole track up front so readers can index it while the writer appends */
+    uint64_t chunk_frames = 0;
+    std::vector<uint32_t> chunks;
+    std::atomic<uint64_t> filled{0};
+    std::atomic<bool> complete{false};
+
+    /* chunks [0, reserved) are taken from the pool. the writer claims the entry and reserves a first
+       share of it under the cache's mutex, then appends into what it reserved and takes free chunks
+       as it runs out. only the writer moves reserved, and only with the mutex held */
+    std::atomic<const void *> writer{nullptr};
+    uint64_t reserved = 0;
+
+    /* guarded by the cache's mutex */
+    uint32_t users = 0;
+    bool orphaned = false;
+};
+
+/* decoded pcm of recently played tracks, so replaying one or seeking back into it reads memory
+   instead of the decoder. shared by playback, the waveform worker and loudness analysis through
+   track_stream.
+
+   entries are keyed by path, size and mtime and filled front to back by whichever stream decodes
+   the track first, other streams read the filled part while that one carries on. the samples live
+   in fixed-size chunks carved out of one pool allocated in init(), so entries come and go without
+   touching the heap. when the pool runs out the least recently used entries nobody has open are
+   evicted whole, but only for the first quarter of the pool a writer claims. past that it only
+   takes chunks that are free, so one long track keeps as much of its head as fits without
+   emptying the cache.
+
+   find(), insert(), claim() and release() stat files, lock and may free memory, so they belong on
+   the thread that opens and closes the stream. frames() only touches atomics and the pool, and
+   append() adds a try_lock to take free chunks, so the audio thread reads and fills through them
+   without ever waiting.
+
+   tracks whose pcm is mapped straight from the file are cached too. the stream drops the mapped
+   pages behind its cursor as it plays, so without a copy here a replay goes back to the disk */
+class pcm_cache {
+    public:
+        static constexpr size_t CHUNK_BYTES = 256 * 1024;
+
+        /* claim() evicts for at most pool / CLAIM_SHARE chunks */
+        static constexpr size_t CLAIM_SHARE = 4;
+
+    private:
+        std::unique_ptr<uint8_t[]> _pool;
+        std::vector<uint32_t> _free;
+        size_t _chunk_count = 0;
+
+        mutable std::mutex _mutex;
+        std::list<pcm_entry> _entries;
+        std::unordered_map<std::string, std::list<pcm_entry>::iterator> _index;
+
+        std::atomic<uint64_t> _hits{0};
+        std::atomic<uint64_t> _misses{0};
+
+        bool take_chunk(uint32_t &chunk, bool evict);
+        void free_entry(std::list<pcm_entry>::iterator it);
+
+    public:
+        /* sizes the pool, rounded down to whole chunks. 0 leaves the cache off */
+        bool init(size_t budget_bytes);
+        void cleanup();
+
+        bool enabled() const { return _chunk_count > 0; }
+
+        /* the entry for path if it has frames and the file has not changed since, pinned until
+           release(). nullptr otherwise */
+        pcm_entry *find(const std::string &path);
+
+        /* the entry for path, created empty for the given format when there is none. pinned */
+        pcm_entry *insert(const std::string &path, unsigned int channels, unsigned int sample_rate, unsigned int bits_per_sample,
+                          sample_format source, uint64_t frame_count);
+
+        /* makes owner the entry's writer when it has none and is not complete, and reserves chunks
+           for the rest of the track from the free ones, evicting other entries for up to a share of
+           the pool. false when owner cannot write */
+        bool claim(pcm_entry &entry, const void *owner);
+
+        /* unpins the entry. when owner is its writer, the chunks it reserved and never filled go
+           back to the pool */
+        void release(pcm_entry *entry, const void *owner);
+
+        /* points at up to frames frames from frame on, stopping at a chunk boundary or the end of
+           what is filled. sets frames to the count, nullptr when frame is not cached yet */
+        const uint8_t *frames(const pcm_entry &entry, uint64_t frame, uint64_t &frames) const;
+
+        /* appends frames decoded from frame on, when owner claimed the entry and frame is where it
+           ends. last marks the end of the track. reserves more free chunks when it runs out, unless
+           the cache is locked elsewhere. returns false once the track is complete, the frames no
+           longer follow on or there is no room left, owner stops appending then */
+        bool append(pcm_entry &entry, const void *owner, uint64_t frame, const uint8_t *in, uint64_t frames, bool last);
+
+        size_t budget() const { return _chunk_count * CHUNK_BYTES; }
+        size_t used() const;
+        uint64_t hits() const { return _hits; }
+        uint64_t misses() const { return _misses; }
+};
@@ -0,0 +1,338 @@
+#include "peak_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#include <sys/stat.h>
+
+#include "sample_convert.h"
+#include "track_stream.h"
+
+namespace fs = std::filesystem;
+
+static const char PEAK_MAGIC[8] = { 'h', 'e', 'x', 'e', 'n', 'p', 'k', '\0' };
+
+constexpr uint32_t peak_cache::LEVEL_FRAMES[peak_cache::LEVEL_COUNT];
+
+static size_t padded_path_length(size_t length) {
+    return (length + 7) & ~static_cast<size_t>(7);
+}
+
+static bool source_stat(const std::string &path, uint64_t &size, int64_t &mtime) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+
+    size = static_cast<uint64_t>(st.st_size);
+    mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+static int16_t to_s16(float value) {
+    return static_cast<int16_t>(std::lrint(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+bool peak_cache::init(const std::string &dir, pcm_cache *pcm) {
+    _dir = dir;
+    _pcm = pcm;
+
+    std::error_code ec;
+    fs::create_directories(_dir, ec);
+    if (ec) std::cerr << "waveform cache unavailable, overviews will not persist: " << _dir << "\n";
+
+    _running = true;
+    _worker = std::thread(&peak_cache::worker_thread, this);
+    return true;
+}
+
+void peak_cache::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _wake.notify_all();
+    if (_worker.joinable()) _worker.join();
+
+    reset();
+    _current.clear();
+}
+
+std::string peak_cache::file_for(const std::string &path) const {
+    /* fnv-1a of the path, the header keeps the full path to catch collisions */
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : path) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.peaks", static_cast<unsigned long long>(hash));
+    return _dir + "/" + name;
+}
+
+void peak_cache::reset() {
+    _file.close();
+    _blob.clear();
+
+    for (peak_level &level : _levels) level = peak_level();
+    _ready = false;
+}
+
+bool peak_cache::attach(const uint8_t *data, size_t size, const std::string &path) {
+    peak_header header;
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, PEAK_MAGIC, sizeof(PEAK_MAGIC)) != 0 || header.version != VERSION ||
+        header.level_count != LEVEL_COUNT || header.path_length != path.size()) {
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+    if (size < offset + padded_path_length(path.size()) ||
+        std::memcmp(data + offset, path.data(), path.size()) != 0) {
+        return false;
+    }
+
+    /* the source changed since the overview was made */
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    if (!source_stat(path, source_size, source_mtime) || source_size != header.size || source_mtime != header.mtime) {
+        return false;
+    }
+
+    offset += padded_path_length(path.size());
+
+    peak_level levels[LEVEL_COUNT];
+    for (int i = 0; i < LEVEL_COUNT; i++) {
+        const uint64_t bytes = static_cast<uint64_t>(header.bin_count[i]) * sizeof(peak_bin);
+        if (header.frames_per_bin[i] != LEVEL_FRAMES[i] || offset + bytes > size) return false;
+
+        levels[i].bins = reinterpret_cast<const peak_bin *>(data + offset);
+        levels[i].count = header.bin_count[i];
+        levels[i].frames_per_bin = header.frames_per_bin[i];
+
+        offset += bytes;
+    }
+
+    std::copy(levels, levels + LEVEL_COUNT, _levels);
+    _ready = true;
+    return true;
+}
+
+void peak_cache::select(const std::string &path) {
+    if (path == _current) return;
+
+    reset();
+    _current = path;
+
+    if (path.empty()) return;
+
+    if (_file.open(file_for(path)) && attach(_file.data(), _file.size(), path)) return;
+    _file.close();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = path;
+    }
+
+    _wake.notify_one();
+}
+
+bool peak_cache::poll() {
+    if (!_result_ready) return false;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _result_ready = false;
+
+    if (_ready || _result_path != _current) {
+        _result.clear();
+        return false;
+    }
+
+    _blob.swap(_result);
+    _result.clear();
+
+    if (!attach(_blob.data(), _blob.size(), _current)) {
+        _blob.clear();
+        return false;
+    }
+
+    return true;
+}
+
+const peak_level *peak_cache::level_for(float width) const {
+    if (!_ready) return nullptr;
+
+    for (int i = LEVEL_COUNT - 1; i > 0; i--) {
+        if (_levels[i].count >= width) return &_levels[i];
+    }
+
+    return &_levels[0];
+}
+
+void peak_cache::worker_thread() {
+    for (;;) {
+        std::string path;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this] { return !_running || !_pending.empty(); });
+            if (!_running) return;
+
+            path.swap(_pending);
+        }
+
+        std::vector<uint8_t> blob;
+        if (!compute(path, blob)) continue;
+
+        write(path, blob);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _result.swap(blob);
+        _result_path = path;
+        _result_ready = true;
+    }
+}
+
+bool peak_cache::compute(const std::string &path, std::vector<uint8_t> &blob) {
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    if (!source_stat(path, source_size, source_mtime)) return false;
+
+    track_stream stream;
+    stream.set_cache(_pcm, true);
+    if (!stream.open(path) || stream.channels() == 0) return false;
+    stream.set_output(sample_format::f32, false);
+
+    const unsigned int channels = stream.channels();
+    std::vector<float> scratch(READ_FRAMES * channels);
+
+    /* finest level in one pass over the decoded samples, the coarser ones are folded from it */
+    std::vector<peak_bin> levels[LEVEL_COUNT];
+    std::vector<float> energy;
+    levels[0].reserve(stream.frame_count() / LEVEL_FRAMES[0] + 1);
+
+    sample_stats bin;
+    uint64_t bin_frames = 0;
+
+    auto emit = [&]() {
+        const float mean_square = bin.count ? static_cast<float>(bin.sum_squares / bin.count) : 0.0f;
+
+        levels[0].push_back({ to_s16(bin.min), to_s16(bin.max), static_cast<uint16_t>(to_s16(std::sqrt(mean_square))), 0 });
+        energy.push_back(mean_square);
+
+        bin = sample_stats();
+        bin_frames = 0;
+    };
+
+    while (!stream.finished() && _running) {
+        const void *samples = nullptr;
+        const uint64_t frames = stream.read(READ_FRAMES, scratch.data(), &samples);
+        if (frames == 0) break;
+
+        /* a mapped float wav can hand out an unaligned pointer, as in mixer::refill */
+        if (reinterpret_cast<uintptr_t>(samples) % alignof(float) != 0) {
+            std::memcpy(scratch.data(), samples, frames * stream.frame_bytes());
+            samples = scratch.data();
+        }
+
+        const float *in = static_cast<const float *>(samples);
+
+        for (uint64_t done = 0; done < frames; ) {
+            const uint64_t count = std::min<uint64_t>(frames - done, LEVEL_FRAMES[0] - bin_frames);
+
+            accumulate_stats(in + done * channels, count * channels, bin);
+            bin_frames += count;
+            done += count;
+
+            if (bin_frames == LEVEL_FRAMES[0]) emit();
+        }
+    }
+
+    if (!_running) return false;
+    if (bin_frames > 0) emit();
+
+    for (int i = 1; i < LEVEL_COUNT; i++) {
+        const uint32_t ratio = LEVEL_FRAMES[i] / LEVEL_FRAMES[i - 1];
+        const std::vector<peak_bin> &finer = levels[i - 1];
+
+        std::vector<float> coarse_energy;
+
+        for (size_t start = 0; start < finer.size(); start += ratio) {
+            const size_t end = std::min(finer.size(), start + ratio);
+
+            peak_bin out = { INT16_MAX, INT16_MIN, 0, 0 };
+            float sum = 0.0f;
+
+            for (size_t j = start; j < end; j++) {
+                out.min = std::min(out.min, finer[j].min);
+                out.max = std::max(out.max, finer[j].max);
+                sum += energy[j];
+            }
+
+            const float mean_square = sum / (end - start);
+            out.rms = static_cast<uint16_t>(to_s16(std::sqrt(mean_square)));
+
+            levels[i].push_back(out);
+            coarse_energy.push_back(mean_square);
+        }
+
+        energy.swap(coarse_energy);
+    }
+
+    peak_header header = {};
+    std::memcpy(header.magic, PEAK_MAGIC, sizeof(PEAK_MAGIC));
+    header.version = VERSION;
+    header.level_count = LEVEL_COUNT;
+    header.size = source_size;
+    header.mtime = source_mtime;
+    header.frame_count = stream.frame_count();
+    header.path_length = static_cast<uint32_t>(path.size());
+
+    size_t total = sizeof(header) + padded_path_length(path.size());
+    for (int i = 0; i < LEVEL_COUNT; i++) {
+        header.frames_per_bin[i] = LEVEL_FRAMES[i];
+        header.bin_count[i] = static_cast<uint32_t>(levels[i].size());
+        total += levels[i].size() * sizeof(peak_bin);
+    }
+
+    blob.assign(total, 0);
+
+    uint8_t *out = blob.data();
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), path.data(), path.size());
+    out += sizeof(header) + padded_path_length(path.size());
+
+    for (int i = 0; i < LEVEL_COUNT; i++) {
+        if (levels[i].empty()) continue;
+
+        std::memcpy(out, levels[i].data(), levels[i].size() * sizeof(peak_bin));
+        out += levels[i].size() * sizeof(peak_bin);
+    }
+
+    return true;
+}
+
+bool peak_cache::write(const std::string &path, const std::vector<uint8_t> &blob) {
+    const std::string target = file_for(path);
+    const std::string temp_path = target + ".tmp";
+
+    FILE *file = std::fopen(temp_path.c_str(), "wb");
+    if (!file) return false;
+
+    bool ok = std::fwrite(blob.data(), 1, blob.size(), file) == blob.size();
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (!ok || std::rename(temp_path.c_str(), target.c_str()) != 0) {
+        std::cerr << "failed to write waveform cache: " << target << "\n";
+        std::remove(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
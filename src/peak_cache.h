@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+#include "pcm_cache.h"
+
+/* on-disk layout: peak_header, the track path padded to 8 bytes, then each level's bins in order */
+struct peak_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t level_count;
+
+    uint64_t size;
+    int64_t mtime;
+    uint64_t frame_count;
+
+    uint32_t path_length;
+    uint32_t reserved;
+
+    uint32_t frames_per_bin[3];
+    uint32_t bin_count[3];
+};
+
+/* min and max of all channels in the bin, and their rms, scaled to s16 range */
+struct peak_bin {
+    int16_t min;
+    int16_t max;
+    uint16_t rms;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(peak_header) == 72, "peak_header layout changed");
+static_assert(sizeof(peak_bin) == 8, "peak_bin layout changed");
+
+struct peak_level {
+    const peak_bin *bins = nullptr;
+    uint32_t count = 0;
+    uint32_t frames_per_bin = 0;
+};
+
+/* waveform overviews for the progress bar, one small file per track in a cache directory next to
+   the library database. a track seen before is mapped straight from its file, anything else is
+   decoded by a background worker that writes the file and hands the result back through poll() */
+class peak_cache {
+    private:
+        static constexpr uint32_t VERSION = 2;
+        static constexpr int LEVEL_COUNT = 3;
+        static constexpr uint32_t LEVEL_FRAMES[LEVEL_COUNT] = { 256, 4096, 65536 };
+        static constexpr uint64_t READ_FRAMES = 64 * 256;
+
+        std::string _dir;
+        pcm_cache *_pcm = nullptr;
+
+        std::string _current;
+        mapped_file _file;
+        std::vector<uint8_t> _blob;
+        peak_level _levels[LEVEL_COUNT];
+        bool _ready = false;
+
+        std::thread _worker;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        std::atomic<bool> _running{false};
+
+        std::string _pending;
+        std::string _result_path;
+        std::vector<uint8_t> _result;
+        std::atomic<bool> _result_ready{false};
+
+        std::string file_for(const std::string &path) const;
+        bool attach(const uint8_t *data, size_t size, const std::string &path);
+        void reset();
+
+        void worker_thread();
+        bool compute(const std::string &path, std::vector<uint8_t> &blob);
+        bool write(const std::string &path, const std::vector<uint8_t> &blob);
+
+    public:
+        /* pcm, when set, is shared with playback so the track being played is decoded only once */
+        bool init(const std::string &dir, pcm_cache *pcm = nullptr);
+        void cleanup();
+
+        /* switches the overview to path, an empty path clears it */
+        void select(const std::string &path);
+        bool poll();
+
+        bool ready() const { return _ready; }
+
+        /* the coarsest level that still has a bin for every pixel, or nullptr if nothing is loaded */
+        const peak_level *level_for(float width) const;
+};
@@ -0,0 +1,650 @@
+#include "player_ui.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+
+#include "audio_engine.h"
+#include "library_db.h"
+#include "library_index.h"
+#include "loudness_cache.h"
+#include "peak_cache.h"
+#include "profiler.h"
+
+#include "config.h"
+
+#ifdef _WIN32 /* windows */
+    #include <window.h>
+
+    std::string get_username() {
+        char username[256];
+        DWORD size = sizeof(username);
+        
+        if (GetUserNameA(username, &size)) {
+            return std::string(username);
+        }
+
+        return "unknown";
+    }
+#else /* linux */
+    #include <unistd.h>
+    #include <sys/types.h>
+    #include <pwd.h>
+    #include <cstdlib>
+
+    std::string get_username() {
+        if (const char *user_env = getenv("USER")) { 
+            return std::string(user_env); 
+        }
+
+        struct passwd *pw = getpwuid(getuid());
+        if (pw) { 
+            return std::string(pw->pw_name); 
+        }
+
+        return "unknown";
+    }
+#endif
+
+void remove_substring(std::string& str, const std::string& toRemove) {
+    size_t pos;
+    while ((pos = str.find(toRemove)) != std::string::npos) {
+        str.erase(pos, toRemove.length());
+    }
+}
+
+void format_time(char *buffer, size_t size, float seconds) {
+    if (seconds < 0) seconds = 0;
+    
+    int minutes = static_cast<int>(seconds) / 60;
+    int secs = static_cast<int>(seconds) % 60;
+    
+    snprintf(buffer, size, "%d:%02d", minutes, secs);
+}
+
+void format_size(char *buffer, size_t size, uint64_t bytes) {
+    if (bytes >= 1024ull * 1024 * 1024) {
+        snprintf(buffer, size, "%.1f gb", bytes / (1024.0 * 1024.0 * 1024.0));
+    } else if (bytes >= 1024ull * 1024) {
+        snprintf(buffer, size, "%.1f mb", bytes / (1024.0 * 1024.0));
+    } else {
+        snprintf(buffer, size, "%llu kb", static_cast<unsigned long long>(bytes / 1024));
+    }
+}
+
+/* one column per pixel, each covering the bins of level that fall under it. the played part is drawn brighter */
+void draw_waveform(ImDrawList *draw_list, ImVec2 pos, ImVec2 size, const peak_level &level, float progress) {
+    const int columns = static_cast<int>(size.x);
+    if (columns <= 0 || level.count == 0) return;
+
+    const float center = pos.y + size.y * 0.5f;
+    const float half_height = size.y * 0.5f / 32767.0f;
+    const int played = static_cast<int>(progress * columns);
+
+    for (int x = 0; x < columns; x++) {
+        const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(x) * level.count / columns);
+        const uint32_t last = std::max(first + 1, static_cast<uint32_t>(static_cast<uint64_t>(x + 1) * level.count / columns));
+
+        int min = 0, max = 0, rms = 0;
+        for (uint32_t i = first; i < last && i < level.count; i++) {
+            min = std::min<int>(min, level.bins[i].min);
+            max = std::max<int>(max, level.bins[i].max);
+            rms = std::max<int>(rms, level.bins[i].rms);
+        }
+
+        const float left = pos.x + x;
+        const bool done = x < played;
+
+        draw_list->AddRectFilled(
+            ImVec2(left, center - max * half_height - 0.5f),
+            ImVec2(left + 1.0f, center - min * half_height + 0.5f),
+            done ? IM_COL32(150, 150, 150, 255) : IM_COL32(80, 84, 92, 255)
+        );
+
+        draw_list->AddRectFilled(
+            ImVec2(left, center - rms * half_height),
+            ImVec2(left + 1.0f, center + rms * half_height),
+            done ? IM_COL32(220, 220, 220, 255) : IM_COL32(110, 114, 122, 255)
+        );
+    }
+}
+
+/* log-frequency bars with a peak/rms meter on the right */
+void draw_spectrum(ImDrawList *draw_list, ImVec2 pos, ImVec2 size, const spectrum_analyzer &spectrum) {
+    const float meter_width = 12.0f;
+    const float gap = 2.0f;
+
+    const float bars_width = size.x - meter_width - gap * 2;
+    const float bar_width = bars_width / spectrum_analyzer::BAND_COUNT;
+    const float bottom = pos.y + size.y;
+
+    for (int b = 0; b < spectrum_analyzer::BAND_COUNT; b++) {
+        const float left = pos.x + b * bar_width;
+        const float height = spectrum.bands()[b] * size.y;
+
+        draw_list->AddRectFilled(
+            ImVec2(left, bottom - height),
+            ImVec2(left + std::max(1.0f, bar_width - gap), bottom),
+            IM_COL32(110, 114, 122, 255)
+        );
+    }
+
+    const float meter_left = pos.x + size.x - meter_width;
+
+    draw_list->AddRectFilled(ImVec2(meter_left, pos.y), ImVec2(meter_left + meter_width, bottom), IM_COL32(40, 44, 52, 255));
+    draw_list->AddRectFilled(ImVec2(meter_left, bottom - spectrum.rms() * size.y), ImVec2(meter_left + meter_width, bottom), IM_COL32(200, 200, 200, 255));
+
+    const float peak_y = bottom - spectrum.peak() * size.y;
+    draw_list->AddLine(ImVec2(meter_left, peak_y), ImVec2(meter_left + meter_width, peak_y), IM_COL32(255, 255, 255, 255));
+}
+
+void player_ui::init(const player_services &services, const std::string &library_root, ImFont *bold_font) {
+    _services = services;
+    _library_root = library_root;
+    _current_dir = library_root;
+    _bold_font = bold_font;
+    _username = get_username();
+
+    ImGuiStyle& style = ImGui::GetStyle();
+    style.Colors[ImGuiCol_WindowBg] = WINDOW_BG_COLOR;
+}
+
+void player_ui::show_directory(const std::string &path) {
+    _current_tab = "home";
+    _current_dir = path;
+}
+
+void player_ui::show_search(const std::string &query) {
+    _current_tab = "search";
+    std::snprintf(_search_text, sizeof(_search_text), "%s", query.c_str());
+    _search_stale = true;
+}
+
+void player_ui::frame() {
+    PROFILE_SCOPE(profile_zone::ui_frame);
+
+    ImGuiIO& io = ImGui::GetIO();
+    const playback_state state = _services.audio->get_state();
+    _playing = state.playing;
+
+    if (state.track_serial != _display_serial) {
+        _display_track = state.track;
+        remove_substring(_display_track, _library_root + "/");
+
+        const size_t extension = _display_track.rfind('.');
+        if (extension != std::string::npos && is_audio_file(_display_track.data(), _display_track.size())) _display_track.erase(extension);
+
+        _display_serial = state.track_serial;
+
+        _services.peaks->select(state.track);
+    }
+
+    _services.peaks->poll();
+
+    if (state.playing && _services.audio->read_analysis(state.analysis_position, _analysis_samples, spectrum_analyzer::FFT_SIZE)) {
+        _spectrum.analyze(_analysis_samples, state.sample_rate, io.DeltaTime);
+    } else {
+        _spectrum.decay(io.DeltaTime);
+    }
+
+    ImGuiViewport* viewport = ImGui::GetMainViewport();
+    const ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove |
+                                          ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoSavedSettings |
+                                          ImGuiWindowFlags_NoBringToFrontOnFocus | ImGuiWindowFlags_NoNavFocus;
+
+    ImGui::NewFrame();
+        ImGui::SetNextWindowPos(viewport->Pos);
+        ImGui::SetNextWindowSize(viewport->Size);
+
+        ImGui::PushStyleColor(ImGuiCol_Button, ImVec4(0, 0, 0, 0));
+        ImGui::PushStyleColor(ImGuiCol_ButtonHovered, ImVec4(1, 1, 1, 0.1f));
+        ImGui::PushStyleColor(ImGuiCol_ButtonActive, ImVec4(1, 1, 1, 0.2f));
+
+        ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
+        ImGui::Begin("hexen", nullptr, window_flags);
+
+        ImVec2 p = ImGui::GetCursorScreenPos();
+        ImVec2 size = ImVec2(200, ImGui::GetContentRegionAvail().y);
+        ImGui::GetWindowDrawList()->AddRectFilled(p, ImVec2(p.x + size.x, p.y + size.y), IM_COL32(13, 15, 18, 255));
+
+        ImGui::BeginChild("sidebar", size, false, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoBackground);
+           ImGui::SetWindowFontScale(0.8f);
+
+           ImGui::Dummy(ImVec2(0, 8));
+           ImGui::Indent(10.0f);
+
+           ImGui::Indent(3.0f);
+           ImGui::PushFont(_bold_font);
+           ImGui::TextColored(ImVec4(100.0f / 255.0f, 100.0f / 255.0f, 100.0f / 255.0f, 1.0f), "hexen");
+           ImGui::PopFont();
+           ImGui::Unindent(3.0f);
+
+           if (ImGui::Button("home")) { _current_tab = "home"; }
+           if (ImGui::Button("favourites")) { }
+           if (ImGui::Button("search")) { _current_tab = "search"; _search_focus = true; }
+
+           ImGui::Unindent(10.0f);
+        ImGui::EndChild();
+        ImGui::SameLine();
+        ImGui::BeginChild("home", ImVec2(0, 0), false, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoBackground);
+            ImGui::Dummy(ImVec2(0, 8));
+            ImGui::Indent(10.0f);
+
+            ImGui::PushFont(_bold_font);
+
+            if (_current_tab == "search") {
+                ImGui::Text("find something to play, %s", _username.c_str());
+            } else {
+                ImGui::Text("get back where u left off, %s", _username.c_str());
+            }
+
+            ImGui::PopFont();
+
+            ImGui::BeginChild("music_browser", ImVec2(0, 0), true, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoBackground);
+                float control_bar_height = 150.0f;
+                float visualizer_height = 60.0f;
+                float file_browser_height = ImGui::GetContentRegionAvail().y - control_bar_height - visualizer_height;
+
+                ImGui::BeginChild("file_browser", ImVec2(0, file_browser_height), true);
+                    draw_browser();
+                ImGui::EndChild();
+                ImGui::BeginChild("visualizer", ImVec2(0, visualizer_height), false, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoBackground);
+                    ImVec2 visualizer_pos = ImGui::GetCursorScreenPos();
+                    ImVec2 visualizer_size = ImGui::GetContentRegionAvail();
+
+                    draw_spectrum(ImGui::GetWindowDrawList(), visualizer_pos, ImVec2(visualizer_size.x, visualizer_size.y - 4.0f), _spectrum);
+                ImGui::EndChild();
+                ImGui::BeginChild("playback_controls", ImVec2(0, control_bar_height), false, ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoBackground);
+                    draw_playback_controls(state);
+                ImGui::EndChild();
+
+                if (ImGui::BeginDragDropTarget()) {
+                    if (const ImGuiPayload *payload = ImGui::AcceptDragDropPayload("AUDIO_FILE")) {
+                        _services.audio->enqueue(static_cast<const char *>(payload->Data));
+                    }
+                    ImGui::EndDragDropTarget();
+                }
+            ImGui::EndChild();
+            ImGui::Unindent(10.0f);
+        ImGui::EndChild();
+    ImGui::End();
+    ImGui::PopStyleVar();
+    ImGui::PopStyleColor(3);
+
+    if (ImGui::IsKeyPressed(ImGuiKey_F2, false)) _show_profiler = !_show_profiler;
+    if (_show_profiler) draw_profiler();
+
+    ImGui::Render();
+}
+
+/* the f2 overlay: per-zone timings, the counters, the decode latency histogram and trace export */
+void player_ui::draw_profiler() {
+#ifdef HEXEN_PROFILE
+    ImGui::SetNextWindowPos(ImVec2(220, 60), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(520, 360), ImGuiCond_FirstUseEver);
+
+    if (!ImGui::Begin("profiler", &_show_profiler)) {
+        ImGui::End();
+        return;
+    }
+
+    profile_stats stats;
+    const ImGuiTableFlags table_flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp;
+
+    if (ImGui::BeginTable("zones", 7, table_flags)) {
+        ImGui::TableSetupColumn("zone");
+        ImGui::TableSetupColumn("count");
+        ImGui::TableSetupColumn("last us");
+        ImGui::TableSetupColumn("mean us");
+        ImGui::TableSetupColumn("p50 us");
+        ImGui::TableSetupColumn("p99 us");
+        ImGui::TableSetupColumn("max us");
+        ImGui::TableHeadersRow();
+
+        for (size_t z = 0; z < static_cast<size_t>(profile_zone::count); z++) {
+            const profile_zone zone = static_cast<profile_zone>(z);
+            profile_snapshot(zone, stats);
+
+            const double mean = stats.count ? static_cast<double>(stats.total_ns) / stats.count : 0.0;
+
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(profile_zone_name(zone));
+            ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(stats.count));
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", stats.last_ns / 1000.0);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", mean / 1000.0);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", profile_percentile(stats, 0.5) / 1000.0);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", profile_percentile(stats, 0.99) / 1000.0);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", stats.max_ns / 1000.0);
+        }
+
+        ImGui::EndTable();
+    }
+
+    for (size_t c = 0; c < static_cast<size_t>(profile_counter::count); c++) {
+        const profile_counter counter = static_cast<profile_counter>(c);
+        ImGui::Text("%s: %lld", profile_counter_name(counter), static_cast<long long>(profile_counter_value(counter)));
+    }
+
+    /* only the span of buckets that has samples, so the shape is readable */
+    profile_snapshot(profile_zone::decode, stats);
+
+    size_t first = PROFILE_BUCKETS, last = 0;
+    for (size_t b = 0; b < PROFILE_BUCKETS; b++) {
+        if (stats.histogram[b] == 0) continue;
+        first = std::min(first, b);
+        last = b;
+    }
+
+    if (first <= last) {
+        float counts[PROFILE_BUCKETS];
+        for (size_t b = first; b <= last; b++) counts[b - first] = static_cast<float>(stats.histogram[b]);
+
+        char overlay[64];
+        std::snprintf(overlay, sizeof(overlay), "decode %.1f - %.1f us", profile_bucket_floor(first) / 1000.0,
+                      profile_bucket_floor(last + 1) / 1000.0);
+
+        ImGui::PlotHistogram("##decode", counts, static_cast<int>(last - first + 1), 0, overlay, 0.0f, FLT_MAX, ImVec2(-1, 80));
+    }
+
+    if (ImGui::Button("export trace")) {
+        _trace_status = profile_export_trace(TRACE_EXPORT_PATH) ? "wrote " TRACE_EXPORT_PATH : "failed to write " TRACE_EXPORT_PATH;
+    }
+
+    if (!_trace_status.empty()) {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(_trace_status.c_str());
+    }
+
+    ImGui::End();
+#else
+    ImGui::SetNextWindowSize(ImVec2(320, 0), ImGuiCond_FirstUseEver);
+    ImGui::Begin("profiler", &_show_profiler);
+    ImGui::TextUnformatted("built without HEXEN_PROFILE");
+    ImGui::End();
+#endif
+}
+
+/* the file_browser child: the current directory as a table, or the search box and its results */
+void player_ui::draw_browser() {
+    ImGui::SetWindowFontScale(0.6f);
+
+    /* copying an album fires a few events per file, the database gets them as one batch once they
+       stop, and only re-reads the paths they name */
+    const double now = ImGui::GetTime();
+    if (_services.library->poll()) _library_changed_at = now;
+
+    if (_library_changed_at >= 0.0 && now - _library_changed_at >= LIBRARY_SETTLE_SECONDS) {
+        std::vector<std::string> changes;
+        bool everything = false;
+        _services.library->take_changes(changes, everything);
+        _library_changed_at = -1.0;
+
+        if (everything) _services.db->revalidate(_library_root);
+        else _services.db->revalidate(_library_root, std::move(changes));
+    }
+
+    if (_services.db->poll()) {
+        _services.library->hydrate(*_services.db);
+        if (_services.loudness) _services.loudness->scan(*_services.db);
+
+        /* the shown results name docs the update may move, and whatever the worker has in hand too */
+        _search_results.clear();
+        _search_parents.clear();
+        _search_parent_offsets.clear();
+        _search_pending = false;
+
+        _services.search->update(*_services.db);
+        _search_stale = true;
+    }
+
+    if (_services.search->poll(_search_results)) {
+        _search_pending = false;
+
+        _search_parents.clear();
+        _search_parent_offsets.clear();
+
+        for (const search_result &result : _search_results) {
+            std::string parent = _services.search->path(result.doc);
+            parent.erase(std::min(parent.size(), parent.rfind('/')));
+            remove_substring(parent, _library_root);
+
+            _search_parent_offsets.push_back(static_cast<uint32_t>(_search_parents.size()));
+            _search_parents.append(parent.empty() ? "/" : parent);
+            _search_parents.push_back('\0');
+        }
+    }
+
+    if (_current_tab == "search") {
+        if (_search_focus) {
+            ImGui::SetKeyboardFocusHere();
+            _search_focus = false;
+        }
+
+        ImGui::SetNextItemWidth(-1.0f);
+        if (ImGui::InputTextWithHint("##search", "artist, album, title or folder", _search_text, sizeof(_search_text))) _search_stale = true;
+
+        /* only when the text or the library changed, not every frame. the worker runs it and the results
+           replace the shown ones once they are back */
+        if (_search_stale) {
+            _services.search->submit(_search_text);
+            _search_stale = false;
+            _search_pending = true;
+        }
+
+
+        for (size_t i = 0; i < _search_results.size(); i++) {
+            const uint32_t id = _search_results[i].doc;
+            const char *label = _services.search->label(id);
+
+            ImGui::PushID(static_cast<int>(id));
+
+            const bool clicked = ImGui::Selectable(label, false);
+
+            /* where it lives, dimmed after the name */
+            const ImVec2 row = ImGui::GetItemRectMin();
+            const float name_width = ImGui::CalcTextSize(label).x;
+            ImGui::GetWindowDrawList()->AddText(
+                ImGui::GetFont(), ImGui::GetFontSize(),
+                ImVec2(row.x + name_width + 12.0f, row.y),
+                ImGui::GetColorU32(ImGuiCol_TextDisabled),
+                _search_parents.data() + _search_parent_offsets[i]
+            );
+
+            if (_services.search->doc(id).kind == entry_kind::directory) {
+                if (clicked) {
+                    _current_dir = _services.search->path(id);
+                    _current_tab = "home";
+                }
+            } else {
+                if (clicked) {
+                    std::vector<std::string> queue;
+                    for (size_t j = i + 1; j < _search_results.size(); j++) {
+                        if (_services.search->doc(_search_results[j].doc).kind == entry_kind::track) queue.push_back(_services.search->path(_search_results[j].doc));
+                    }
+
+                    _services.audio->play(_services.search->path(id), std::move(queue));
+                }
+
+                if (ImGui::BeginDragDropSource()) {
+                    std::string path = _services.search->path(id);
+                    ImGui::SetDragDropPayload("AUDIO_FILE", path.c_str(), path.size() + 1);
+                    ImGui::Text("dragging %s", label);
+                    ImGui::EndDragDropSource();
+                }
+            }
+
+            ImGui::PopID();
+        }
+
+        if (_search_text[0] != '\0' && _search_results.empty()) ImGui::TextDisabled("nothing matches");
+    } else {
+        const library_directory &dir = _services.library->open(_current_dir);
+
+        const ImGuiTableFlags table_flags = ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg |
+                                            ImGuiTableFlags_Resizable | ImGuiTableFlags_NoBordersInBody;
+
+        if (ImGui::BeginTable("tracks", 4, table_flags)) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("name", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_WidthStretch, 0.0f, static_cast<ImGuiID>(track_column::name));
+            ImGui::TableSetupColumn("length", ImGuiTableColumnFlags_WidthFixed, 0.0f, static_cast<ImGuiID>(track_column::duration));
+            ImGui::TableSetupColumn("rate", ImGuiTableColumnFlags_WidthFixed, 0.0f, static_cast<ImGuiID>(track_column::sample_rate));
+            ImGui::TableSetupColumn("size", ImGuiTableColumnFlags_WidthFixed, 0.0f, static_cast<ImGuiID>(track_column::size));
+            ImGui::TableHeadersRow();
+
+            if (ImGuiTableSortSpecs *specs = ImGui::TableGetSortSpecs()) {
+                if (specs->SpecsDirty && specs->SpecsCount > 0) {
+                    _sort_column = static_cast<track_column>(specs->Specs[0].ColumnUserID);
+                    _sort_ascending = specs->Specs[0].SortDirection != ImGuiSortDirection_Descending;
+                }
+                specs->SpecsDirty = false;
+            }
+
+            _tracks.update(dir, _sort_column, _sort_ascending);
+            const std::vector<uint32_t> &order = _tracks.order();
+
+            /* only the rows on screen are laid out */
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(order.size()));
+
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    const library_entry &entry = dir.entries[order[row]];
+                    const char *label = dir.label(entry);
+
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::PushID(static_cast<int>(order[row]));
+
+                    const bool clicked = ImGui::Selectable(label, false, ImGuiSelectableFlags_SpanAllColumns);
+
+                    if (entry.kind == entry_kind::directory) {
+                        if (clicked) _current_dir = dir.entry_path(entry);
+                    } else {
+                        if (clicked) {
+                            std::vector<std::string> queue;
+                            for (size_t j = row + 1; j < order.size(); j++) {
+                                if (dir.entries[order[j]].kind == entry_kind::track) queue.push_back(dir.entry_path(dir.entries[order[j]]));
+                            }
+
+                            _services.audio->play(dir.entry_path(entry), std::move(queue));
+                        }
+
+                        if (ImGui::BeginDragDropSource()) {
+                            std::string path = dir.entry_path(entry);
+                            ImGui::SetDragDropPayload("AUDIO_FILE", path.c_str(), path.size() + 1);
+                            ImGui::Text("dragging %s", label);
+                            ImGui::EndDragDropSource();
+                        }
+
+                        /* header fields are zero until the library database has read the file */
+                        if (entry.info.sample_rate > 0) {
+                            char cell[32];
+
+                            ImGui::TableNextColumn();
+                            format_time(cell, sizeof(cell), entry.info.duration());
+                            ImGui::TextDisabled("%s", cell);
+
+                            ImGui::TableNextColumn();
+                            ImGui::TextDisabled("%.1f khz", entry.info.sample_rate / 1000.0f);
+
+                            ImGui::TableNextColumn();
+                            format_size(cell, sizeof(cell), entry.info.size);
+                            ImGui::TextDisabled("%s", cell);
+                        }
+                    }
+
+                    ImGui::PopID();
+                }
+            }
+
+            ImGui::EndTable();
+        }
+    }
+}
+
+void player_ui::draw_playback_controls(const playback_state &state) {
+    float total_width = ImGui::GetContentRegionAvail().x;
+    float stop_button_width = 60.0f;
+
+    ImGui::PushFont(_bold_font);
+
+    ImVec2 text_size = ImGui::CalcTextSize(_display_track.empty() ? "no track playing" : _display_track.c_str());
+    float centered_x = (total_width - text_size.x) * 0.5f;
+
+    ImGui::SetCursorPosX(centered_x);
+    ImGui::SetWindowFontScale(0.6f);
+
+    ImGui::Text("%s", _display_track.empty() ? "no track playing" : _display_track.c_str());
+
+    ImGui::PopFont();
+    ImGui::Dummy(ImVec2(0.0f, 1.0f));
+
+    ImGui::SetCursorPosX(0);
+    if (ImGui::Button("[stop]", ImVec2(stop_button_width, 40.0f))) {
+        _services.audio->stop();
+    }
+
+    ImGui::Dummy(ImVec2(0.0f, 0.0f));
+
+    float current_time = state.position;
+    float duration = state.duration;
+    float progress = (duration > 0) ? current_time / duration : 0.0f;
+    progress = std::clamp(progress, 0.0f, 1.0f);
+
+    char current_time_str[16], total_time_str[16], time_display[40];
+    format_time(current_time_str, sizeof(current_time_str), current_time);
+    format_time(total_time_str, sizeof(total_time_str), duration);
+    snprintf(time_display, sizeof(time_display), "%s / %s", current_time_str, total_time_str);
+
+    ImGui::SetWindowFontScale(0.5f);
+
+    ImVec2 time_text_size = ImGui::CalcTextSize(time_display);
+
+    float time_padding = 10.0f;
+    float progress_bar_width = total_width - time_text_size.x - time_padding;
+
+    ImVec2 progress_bar_size = ImVec2(progress_bar_width, 20.0f);
+    ImVec2 cursor_pos = ImGui::GetCursorScreenPos();
+
+    if (const peak_level *level = _services.peaks->level_for(progress_bar_size.x)) {
+        draw_waveform(ImGui::GetWindowDrawList(), cursor_pos, progress_bar_size, *level, progress);
+    } else {
+        ImGui::GetWindowDrawList()->AddRectFilled(
+            cursor_pos,
+            ImVec2(cursor_pos.x + progress_bar_size.x, cursor_pos.y + progress_bar_size.y),
+            IM_COL32(60, 64, 72, 255)
+        );
+
+        ImGui::GetWindowDrawList()->AddRectFilled(
+            cursor_pos,
+            ImVec2(cursor_pos.x + progress_bar_size.x * progress, cursor_pos.y + progress_bar_size.y),
+            IM_COL32(200, 200, 200, 255)
+        );
+    }
+
+    ImGui::InvisibleButton("##progress_bar", progress_bar_size);
+
+    if (ImGui::IsItemClicked()) {
+        ImVec2 mouse_pos = ImGui::GetMousePos();
+
+        float click_x = mouse_pos.x - cursor_pos.x;
+        float new_progress = click_x / progress_bar_size.x;
+
+        new_progress = std::clamp(new_progress, 0.0f, 1.0f);
+
+        float new_time = new_progress * duration;
+        _services.audio->seek(new_time);
+    }
+
+    ImGui::SameLine();
+    ImGui::SetCursorPosX(progress_bar_width + time_padding);
+    ImGui::SetCursorPosY(ImGui::GetCursorPosY() + 3);
+
+    if (!_display_track.empty()) {
+        ImGui::TextColored(ImVec4(0.8f, 0.8f, 0.8f, 1.0f), "%s", time_display);
+    } else {
+        ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "0:00 / 0:00");
+    }
+
+    ImGui::SetWindowFontScale(0.6f);
+}
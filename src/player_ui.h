@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "imgui.h"
+
+#include "search_index.h"
+#include "spectrum.h"
+#include "track_table.h"
+
+class audio_engine;
+class library_db;
+class library_index;
+class loudness_cache;
+class peak_cache;
+struct playback_state;
+
+/* the subsystems the ui drives, owned by whoever runs the frame loop. loudness may be null */
+struct player_services {
+    audio_engine *audio = nullptr;
+    library_index *library = nullptr;
+    library_db *db = nullptr;
+    loudness_cache *loudness = nullptr;
+    search_index *search = nullptr;
+    peak_cache *peaks = nullptr;
+};
+
+/* the whole player window as one imgui frame. it makes no gl or glfw calls, so the same frame
+   runs in the real window and headless in the benchmark */
+class player_ui {
+    private:
+        player_services _services;
+        ImFont *_bold_font = nullptr;
+        std::string _username;
+        std::string _library_root;
+
+        std::string _current_tab = "home";
+
+        std::string _display_track;
+        uint32_t _display_serial = UINT32_MAX;
+
+        spectrum_analyzer _spectrum;
+        float _analysis_samples[spectrum_analyzer::FFT_SIZE];
+        bool _playing = false;
+
+        std::string _current_dir;
+
+        /* when the last filesystem event arrived, negative once the database has been handed it */
+        double _library_changed_at = -1.0;
+
+        track_table _tracks;
+        track_column _sort_column = track_column::name;
+        bool _sort_ascending = true;
+
+        char _search_text[256] = "";
+        std::vector<search_result> _search_results;
+        bool _search_stale = false;
+        bool _search_pending = false;
+
+        /* where each result lives, relative to the library root, "parent\0" per result in order */
+        std::string _search_parents;
+        std::vector<uint32_t> _search_parent_offsets;
+        bool _search_focus = false;
+
+        bool _show_profiler = false;
+        std::string _trace_status;
+
+        void draw_browser();
+        void draw_playback_controls(const playback_state &state);
+        void draw_profiler();
+
+    public:
+        void init(const player_services &services, const std::string &library_root, ImFont *bold_font);
+
+        /* everything from ImGui::NewFrame() to ImGui::Render(). the caller starts the backends' frames
+           before and submits the draw data after */
+        void frame();
+
+        /* true while something on screen moves by itself or a search is due back, so the loop should
+           not wait for input */
+        bool animating() const { return _playing || !_spectrum.settled() || _search_pending; }
+
+        /* what the sidebar buttons and the search box do, for driving the ui without input */
+        void show_directory(const std::string &path);
+        void show_search(const std::string &query);
+};
@@ -0,0 +1,221 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static constexpr size_t ZONE_COUNT = static_cast<size_t>(profile_zone::count);
+static constexpr size_t COUNTER_COUNT = static_cast<size_t>(profile_counter::count);
+static constexpr size_t TRACE_CAPACITY = 1 << 16;
+
+static const char *ZONE_NAMES[ZONE_COUNT] = { "ui frame", "ui render", "open track", "seek", "decode", "mix", "upload" };
+static const char *COUNTER_NAMES[COUNTER_COUNT] = { "underruns", "queue depth" };
+
+namespace {
+
+struct zone_totals {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> last_ns{0};
+    std::atomic<uint32_t> histogram[PROFILE_BUCKETS] = {};
+};
+
+enum class event_kind : uint8_t { zone, counter };
+
+struct trace_event {
+    uint64_t start_ns;
+    int64_t value;
+    event_kind kind;
+    uint8_t id;
+};
+
+/* the last TRACE_CAPACITY events of one thread. written only by that thread, read back the same way
+   as sample_ring: the exporter drops whatever the writer lapped while it was copying */
+struct trace_ring {
+    char name[32] = "thread";
+    uint32_t tid = 0;
+
+    trace_event events[TRACE_CAPACITY];
+
+    alignas(64) std::atomic<uint64_t> writing{0};
+    alignas(64) std::atomic<uint64_t> written{0};
+
+    void push(const trace_event &event) {
+        const uint64_t position = written.load(std::memory_order_relaxed);
+
+        writing.store(position + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        events[position & (TRACE_CAPACITY - 1)] = event;
+
+        written.store(position + 1, std::memory_order_release);
+    }
+};
+
+}
+
+static zone_totals _zones[ZONE_COUNT];
+static std::atomic<int64_t> _counters[COUNTER_COUNT];
+
+static std::mutex _rings_mutex;
+static std::vector<std::unique_ptr<trace_ring>> _rings;
+
+static const std::chrono::steady_clock::time_point _epoch = std::chrono::steady_clock::now();
+
+/* registered on first use and never freed, so the exporter can still read a finished thread's events */
+static trace_ring &thread_ring() {
+    static thread_local trace_ring *ring = nullptr;
+    if (ring) return *ring;
+
+    std::lock_guard<std::mutex> lock(_rings_mutex);
+    _rings.push_back(std::make_unique<trace_ring>());
+
+    ring = _rings.back().get();
+    ring->tid = static_cast<uint32_t>(_rings.size());
+    return *ring;
+}
+
+static size_t bucket_for(uint64_t ns) {
+    ns = std::max<uint64_t>(ns, 1);
+
+    const unsigned int octave = 63 - __builtin_clzll(ns);
+    const unsigned int step = (octave >= 2) ? (ns >> (octave - 2)) & 3 : 0;
+
+    return std::min<size_t>(octave * 4 + step, PROFILE_BUCKETS - 1);
+}
+
+const char *profile_zone_name(profile_zone zone) {
+    return ZONE_NAMES[static_cast<size_t>(zone)];
+}
+
+const char *profile_counter_name(profile_counter counter) {
+    return COUNTER_NAMES[static_cast<size_t>(counter)];
+}
+
+uint64_t profile_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _epoch).count();
+}
+
+void profile_thread_name(const char *name) {
+    trace_ring &ring = thread_ring();
+
+    std::lock_guard<std::mutex> lock(_rings_mutex);
+    std::snprintf(ring.name, sizeof(ring.name), "%s", name);
+}
+
+void profile_record(profile_zone zone, uint64_t start_ns, uint64_t end_ns) {
+    const uint64_t duration = end_ns - start_ns;
+    zone_totals &totals = _zones[static_cast<size_t>(zone)];
+
+    totals.count.fetch_add(1, std::memory_order_relaxed);
+    totals.total_ns.fetch_add(duration, std::memory_order_relaxed);
+    totals.last_ns.store(duration, std::memory_order_relaxed);
+    totals.histogram[bucket_for(duration)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = totals.max_ns.load(std::memory_order_relaxed);
+    while (duration > max && !totals.max_ns.compare_exchange_weak(max, duration, std::memory_order_relaxed)) {}
+
+    thread_ring().push({ start_ns, static_cast<int64_t>(duration), event_kind::zone, static_cast<uint8_t>(zone) });
+}
+
+void profile_count(profile_counter counter, int64_t delta) {
+    const int64_t value = _counters[static_cast<size_t>(counter)].fetch_add(delta, std::memory_order_relaxed) + delta;
+    thread_ring().push({ profile_now(), value, event_kind::counter, static_cast<uint8_t>(counter) });
+}
+
+void profile_gauge(profile_counter counter, int64_t value) {
+    /* only changes are traced, a steady queue depth would otherwise flood the ring */
+    if (_counters[static_cast<size_t>(counter)].exchange(value, std::memory_order_relaxed) == value) return;
+    thread_ring().push({ profile_now(), value, event_kind::counter, static_cast<uint8_t>(counter) });
+}
+
+int64_t profile_counter_value(profile_counter counter) {
+    return _counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+void profile_snapshot(profile_zone zone, profile_stats &stats) {
+    const zone_totals &totals = _zones[static_cast<size_t>(zone)];
+
+    stats.count = totals.count.load(std::memory_order_relaxed);
+    stats.total_ns = totals.total_ns.load(std::memory_order_relaxed);
+    stats.max_ns = totals.max_ns.load(std::memory_order_relaxed);
+    stats.last_ns = totals.last_ns.load(std::memory_order_relaxed);
+
+    for (size_t b = 0; b < PROFILE_BUCKETS; b++) stats.histogram[b] = totals.histogram[b].load(std::memory_order_relaxed);
+}
+
+uint64_t profile_bucket_floor(size_t bucket) {
+    const unsigned int octave = static_cast<unsigned int>(bucket / 4);
+    const uint64_t step = bucket % 4;
+
+    return (octave >= 2) ? (4 + step) << (octave - 2) : uint64_t(1) << octave;
+}
+
+uint64_t profile_percentile(const profile_stats &stats, double fraction) {
+    uint64_t total = 0;
+    for (uint32_t count : stats.histogram) total += count;
+    if (total == 0) return 0;
+
+    const uint64_t rank = static_cast<uint64_t>(fraction * (total - 1));
+    uint64_t seen = 0;
+
+    for (size_t b = 0; b < PROFILE_BUCKETS; b++) {
+        seen += stats.histogram[b];
+        if (seen > rank) return profile_bucket_floor(b);
+    }
+
+    return stats.max_ns;
+}
+
+bool profile_export_trace(const std::string &path) {
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    std::vector<trace_event> events(TRACE_CAPACITY);
+    bool first = true;
+
+    auto separator = [&] {
+        const char *text = first ? "" : ",\n";
+        first = false;
+        return text;
+    };
+
+    std::lock_guard<std::mutex> lock(_rings_mutex);
+
+    for (const std::unique_ptr<trace_ring> &ring : _rings) {
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                     separator(), ring->tid, ring->name);
+
+        const uint64_t end = ring->written.load(std::memory_order_acquire);
+        const uint64_t begin = end > TRACE_CAPACITY ? end - TRACE_CAPACITY : 0;
+
+        for (uint64_t i = begin; i < end; i++) events[i - begin] = ring->events[i & (TRACE_CAPACITY - 1)];
+
+        /* anything the writer has started on since may have been overwritten mid-copy */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t safe = ring->writing.load(std::memory_order_relaxed);
+        const uint64_t first_valid = std::max(begin, safe > TRACE_CAPACITY ? safe - TRACE_CAPACITY : 0);
+
+        for (uint64_t i = first_valid; i < end; i++) {
+            const trace_event &event = events[i - begin];
+
+            if (event.kind == event_kind::zone) {
+                std::fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"hexen\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                             separator(), ZONE_NAMES[event.id], ring->tid, event.start_ns / 1000.0, event.value / 1000.0);
+            } else {
+                std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                             separator(), COUNTER_NAMES[event.id], ring->tid, event.start_ns / 1000.0, static_cast<long long>(event.value));
+            }
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
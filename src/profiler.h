@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* hot-path timers, counters and a trace of recent events, always recording while compiled in.
+   zone timings go into per-zone totals and a latency histogram, and every event is also kept in a
+   per-thread ring that profile_export_trace() writes out in chrome's trace event format.
+
+   build without HEXEN_PROFILE and the macros below expand to nothing */
+
+enum class profile_zone : uint8_t { ui_frame, ui_render, open_track, seek, decode, mix, upload, count };
+enum class profile_counter : uint8_t { underruns, queue_depth, count };
+
+static constexpr size_t PROFILE_BUCKETS = 128;
+
+/* bucket b covers durations from 2^(b / 4) ns in quarter-octave steps */
+struct profile_stats {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t last_ns = 0;
+    uint32_t histogram[PROFILE_BUCKETS] = {};
+};
+
+const char *profile_zone_name(profile_zone zone);
+const char *profile_counter_name(profile_counter counter);
+
+uint64_t profile_now();
+
+/* the name the calling thread gets in exported traces */
+void profile_thread_name(const char *name);
+
+void profile_record(profile_zone zone, uint64_t start_ns, uint64_t end_ns);
+void profile_count(profile_counter counter, int64_t delta);
+void profile_gauge(profile_counter counter, int64_t value);
+
+int64_t profile_counter_value(profile_counter counter);
+void profile_snapshot(profile_zone zone, profile_stats &stats);
+
+/* in ns, resolved to the histogram bucket it falls in */
+uint64_t profile_percentile(const profile_stats &stats, double fraction);
+uint64_t profile_bucket_floor(size_t bucket);
+
+bool profile_export_trace(const std::string &path);
+
+class profile_scope {
+    private:
+        profile_zone _zone;
+        uint64_t _start;
+
+    public:
+        explicit profile_scope(profile_zone zone) : _zone(zone), _start(profile_now()) {}
+        ~profile_scope() { profile_record(_zone, _start, profile_now()); }
+
+        profile_scope(const profile_scope &) = delete;
+        profile_scope &operator=(const profile_scope &) = delete;
+};
+
+#ifdef HEXEN_PROFILE
+    #define PROFILE_CONCAT_(a, b) a##b
+    #define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+    #define PROFILE_SCOPE(zone) profile_scope PROFILE_CONCAT(profile_scope_, __LINE__)(zone)
+    #define PROFILE_COUNT(counter, delta) profile_count(counter, delta)
+    #define PROFILE_GAUGE(counter, value) profile_gauge(counter, value)
+    #define PROFILE_THREAD(name) profile_thread_name(name)
+#else
+    #define PROFILE_SCOPE(zone) ((void)0)
+    #define PROFILE_COUNT(counter, delta) ((void)0)
+    #define PROFILE_GAUGE(counter, value) ((void)0)
+    #define PROFILE_THREAD(name) ((void)0)
+#endif
@@ -0,0 +1,330 @@
+#include "resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define HEXEN_X86 1
+    #include <immintrin.h>
+#endif
+
+/* passband edge as a fraction of the lower nyquist, and the kaiser window's beta (about -80 dB sidelobes) */
+static constexpr double ROLLOFF = 0.9;
+static constexpr double KAISER_BETA = 8.0;
+
+/* the window is tabulated over |x| in [0, 1] and interpolated, so a rate change rebuilds the bank
+   without a bessel series per tap */
+static constexpr size_t WINDOW_POINTS = 4096;
+
+struct resample_kernels {
+    const char *name;
+
+    /* TAPS long */
+    float (*dot)(const float *taps, const float *history);
+    void (*blend)(const float *a, const float *b, float weight, float *out);
+};
+
+/* scalar */
+
+static float scalar_dot(const float *taps, const float *history) {
+    float sum = 0.0f;
+    for (unsigned int k = 0; k < resampler::TAPS; k++) sum += taps[k] * history[k];
+    return sum;
+}
+
+static void scalar_blend(const float *a, const float *b, float weight, float *out) {
+    for (unsigned int k = 0; k < resampler::TAPS; k++) out[k] = a[k] + weight * (b[k] - a[k]);
+}
+
+static const resample_kernels SCALAR_KERNELS = { "scalar", scalar_dot, scalar_blend };
+
+#ifdef HEXEN_X86
+
+/* sse2 */
+
+static inline float sse2_sum(__m128 v) {
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static float sse2_dot(const float *taps, const float *history) {
+    __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+
+    for (unsigned int k = 0; k < resampler::TAPS; k += 8) {
+        a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(taps + k), _mm_loadu_ps(history + k)));
+        b = _mm_add_ps(b, _mm_mul_ps(_mm_loadu_ps(taps + k + 4), _mm_loadu_ps(history + k + 4)));
+    }
+
+    return sse2_sum(_mm_add_ps(a, b));
+}
+
+static void sse2_blend(const float *a, const float *b, float weight, float *out) {
+    const __m128 w = _mm_set1_ps(weight);
+
+    for (unsigned int k = 0; k < resampler::TAPS; k += 4) {
+        const __m128 va = _mm_loadu_ps(a + k);
+        _mm_storeu_ps(out + k, _mm_add_ps(va, _mm_mul_ps(w, _mm_sub_ps(_mm_loadu_ps(b + k), va))));
+    }
+}
+
+static const resample_kernels SSE2_KERNELS = { "sse2", sse2_dot, sse2_blend };
+
+/* avx2 */
+
+#define HEXEN_AVX2 __attribute__((target("avx2")))
+
+HEXEN_AVX2 static float avx2_dot(const float *taps, const float *history) {
+    __m256 a = _mm256_setzero_ps(), b = _mm256_setzero_ps();
+
+    for (unsigned int k = 0; k < resampler::TAPS; k += 16) {
+        a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(taps + k), _mm256_loadu_ps(history + k)));
+        b = _mm256_add_ps(b, _mm256_mul_ps(_mm256_loadu_ps(taps + k + 8), _mm256_loadu_ps(history + k + 8)));
+    }
+
+    const __m256 sum = _mm256_add_ps(a, b);
+    return sse2_sum(_mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1)));
+}
+
+HEXEN_AVX2 static void avx2_blend(const float *a, const float *b, float weight, float *out) {
+    const __m256 w = _mm256_set1_ps(weight);
+
+    for (unsigned int k = 0; k < resampler::TAPS; k += 8) {
+        const __m256 va = _mm256_loadu_ps(a + k);
+        _mm256_storeu_ps(out + k, _mm256_add_ps(va, _mm256_mul_ps(w, _mm256_sub_ps(_mm256_loadu_ps(b + k), va))));
+    }
+}
+
+static const resample_kernels AVX2_KERNELS = { "avx2", avx2_dot, avx2_blend };
+
+#endif
+
+static const resample_kernels &kernels() {
+    static const resample_kernels &selected = []() -> const resample_kernels & {
+#ifdef HEXEN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return AVX2_KERNELS;
+        if (__builtin_cpu_supports("sse2")) return SSE2_KERNELS;
+#endif
+        return SCALAR_KERNELS;
+    }();
+
+    return selected;
+}
+
+const char *resampler_backend() {
+    return kernels().name;
+}
+
+/* zeroth order modified bessel function of the first kind, for the kaiser window */
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+
+    return sum;
+}
+
+static const std::vector<double> &kaiser_table() {
+    static const std::vector<double> table = [] {
+        std::vector<double> values(WINDOW_POINTS + 2);
+        const double scale = 1.0 / bessel_i0(KAISER_BETA);
+
+        for (size_t i = 0; i <= WINDOW_POINTS; i++) {
+            const double x = static_cast<double>(i) / WINDOW_POINTS;
+            values[i] = bessel_i0(KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - x * x))) * scale;
+        }
+
+        values[WINDOW_POINTS + 1] = 0.0;
+        return values;
+    }();
+
+    return table;
+}
+
+static double kaiser(const std::vector<double> &table, double x) {
+    const double position = std::min(std::abs(x), 1.0) * WINDOW_POINTS;
+    const size_t i = static_cast<size_t>(position);
+    const double t = position - i;
+
+    return table[i] + t * (table[i + 1] - table[i]);
+}
+
+resampler::resampler() {
+    kaiser_table();
+
+    _bank.resize((MAX_PHASES + 1) * TAPS);
+    for (std::vector<float> &history : _history) history.resize(HISTORY_FRAMES);
+}
+
+void resampler::configure(unsigned int in_rate, unsigned int out_rate, unsigned int channels) {
+    _channels = std::min(channels, MAX_CHANNELS);
+
+    if (in_rate != _in_rate || out_rate != _out_rate) {
+        const unsigned int divisor = std::gcd(in_rate, out_rate);
+
+        _in_rate = in_rate;
+        _out_rate = out_rate;
+        _in_step = in_rate / divisor;
+        _out_step = out_rate / divisor;
+        _step_whole = _in_step / _out_step;
+        _step_frac = _in_step % _out_step;
+
+        if (!passthrough()) build_bank();
+    }
+
+    reset();
+}
+
+void resampler::build_bank() {
+    _exact = _out_step <= MAX_PHASES;
+    _phases = _exact ? static_cast<unsigned int>(_out_step) : MAX_PHASES;
+
+    /* downsampling moves the cutoff down to the output's nyquist */
+    const double cutoff = ROLLOFF * std::min(1.0, static_cast<double>(_out_rate) / _in_rate);
+
+    /* sin(pi * cutoff * distance) steps along a row by a fixed angle, so it is rotated rather than evaluated */
+    const double step_sin = std::sin(M_PI * cutoff), step_cos = std::cos(M_PI * cutoff);
+    const std::vector<double> &window = kaiser_table();
+
+    /* phase p and phases - p are mirror images of each other, only the first half is computed */
+    for (unsigned int phase = 0; phase <= _phases / 2; phase++) {
+        float *row = _bank.data() + phase * TAPS;
+        const double offset = static_cast<double>(phase) / _phases;
+        double sum = 0.0;
+
+        const double first = -static_cast<double>(HALF - 1) - offset;
+        double sin_arg = std::sin(M_PI * cutoff * first), cos_arg = std::cos(M_PI * cutoff * first);
+
+        /* tap k sits on input sample floor(t) - (HALF - 1) + k */
+        for (unsigned int k = 0; k < TAPS; k++) {
+            const double distance = first + k;
+            const double arg = M_PI * cutoff * distance;
+            const double sinc = (std::abs(arg) < 1e-9) ? 1.0 : sin_arg / arg;
+
+            row[k] = static_cast<float>(cutoff * sinc * kaiser(window, distance / HALF));
+            sum += row[k];
+
+            const double next_sin = sin_arg * step_cos + cos_arg * step_sin;
+            cos_arg = cos_arg * step_cos - sin_arg * step_sin;
+            sin_arg = next_sin;
+        }
+
+        /* unity gain at dc for every phase, so a constant signal comes out flat */
+        for (unsigned int k = 0; k < TAPS; k++) row[k] = static_cast<float>(row[k] / sum);
+
+        float *mirror = _bank.data() + (_phases - phase) * TAPS;
+        for (unsigned int k = 0; k < TAPS; k++) mirror[TAPS - 1 - k] = row[k];
+    }
+}
+
+void resampler::reset() {
+    /* HALF - 1 frames of silence ahead of the input centre the first output on input frame 0 */
+    _filled = passthrough() ? 0 : HALF - 1;
+    for (unsigned int c = 0; c < _channels; c++) std::fill(_history[c].begin(), _history[c].begin() + _filled, 0.0f);
+
+    _index = 0;
+    _frac = 0;
+    _discarded = 0;
+}
+
+void resampler::compact() {
+    const size_t drop = std::min(_index, _filled);
+
+    for (unsigned int c = 0; c < _channels; c++) {
+        std::memmove(_history[c].data(), _history[c].data() + drop, (_filled - drop) * sizeof(float));
+    }
+
+    _filled -= drop;
+    _index -= drop;
+    _discarded += drop;
+}
+
+size_t resampler::process(const float *in, size_t in_frames, size_t &consumed, float *out, size_t out_frames) {
+    if (passthrough()) {
+        const size_t count = std::min(in_frames, out_frames);
+        std::memcpy(out, in, count * _channels * sizeof(float));
+
+        consumed = count;
+        _discarded += count;
+        return count;
+    }
+
+    const resample_kernels &k = kernels();
+    alignas(32) float blended[TAPS];
+
+    consumed = 0;
+    size_t produced = 0;
+
+    while (produced < out_frames) {
+        if (_index + TAPS > _filled) {
+            if (consumed == in_frames) break;
+            if (_filled == HISTORY_FRAMES) compact();
+
+            const size_t count = std::min(in_frames - consumed, HISTORY_FRAMES - _filled);
+            const float *source = in + consumed * _channels;
+
+            for (unsigned int c = 0; c < _channels; c++) {
+                float *history = _history[c].data() + _filled;
+                for (size_t i = 0; i < count; i++) history[i] = source[i * _channels + c];
+            }
+
+            _filled += count;
+            consumed += count;
+            continue;
+        }
+
+        while (produced < out_frames && _index + TAPS <= _filled) {
+            /* with an exact bank _frac indexes its phases directly, otherwise it can run past the
+               bank and the two nearest phases are blended instead */
+            const float *taps = blended;
+
+            if (_exact) {
+                taps = _bank.data() + _frac * TAPS;
+            } else {
+                const double position = static_cast<double>(_frac) * _phases / _out_step;
+                const unsigned int phase = static_cast<unsigned int>(position);
+
+                k.blend(_bank.data() + phase * TAPS, _bank.data() + (phase + 1) * TAPS, static_cast<float>(position - phase), blended);
+            }
+
+            float *frame = out + produced * _channels;
+            for (unsigned int c = 0; c < _channels; c++) frame[c] = k.dot(taps, _history[c].data() + _index);
+
+            produced++;
+            _index += _step_whole;
+            _frac += _step_frac;
+
+            if (_frac >= _out_step) {
+                _frac -= _out_step;
+                _index++;
+            }
+        }
+    }
+
+    return produced;
+}
+
+double resampler::position() const {
+    return static_cast<double>(_discarded + _index) + static_cast<double>(_frac) / _out_step;
+}
+
+uint64_t resampler::frames_until(uint64_t end) const {
+    /* outputs n with (whole * out_step + frac + n * in_step) < end * out_step */
+    const uint64_t whole = _discarded + _index;
+    const uint64_t now = whole * _out_step + _frac;
+    const uint64_t limit = end * _out_step;
+
+    if (limit <= now) return 0;
+    return (limit - now + _in_step - 1) / _in_step;
+}
+
+uint64_t resampler::output_frames(uint64_t in_frames) const {
+    return (in_frames * _out_step + _in_step - 1) / _in_step;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* polyphase windowed-sinc sample rate converter for interleaved float audio.
+
+   the ratio is kept as the reduced fraction out_rate / in_rate, and time advances in exact integer
+   steps of 1 / out_rate input samples, so it never drifts. when the numerator fits MAX_PHASES the bank
+   holds one kaiser-windowed sinc per output phase. otherwise it holds MAX_PHASES of them and each
+   output interpolates between the two nearest. the taps are dot products run by simd kernels picked
+   at startup like sample_convert's.
+
+   everything is allocated up front, configure() and process() never allocate */
+class resampler {
+    public:
+        static constexpr unsigned int TAPS = 64;
+        static constexpr unsigned int MAX_PHASES = 1024;
+        static constexpr unsigned int MAX_CHANNELS = 2;
+
+    private:
+        static constexpr size_t HISTORY_FRAMES = 4096;
+        static constexpr unsigned int HALF = TAPS / 2;
+
+        /* (phases + 1) rows of TAPS, the extra row lets interpolation read one phase past the last */
+        std::vector<float> _bank;
+        unsigned int _phases = 0;
+        bool _exact = true;
+
+        unsigned int _in_rate = 0;
+        unsigned int _out_rate = 0;
+        unsigned int _channels = 0;
+
+        /* time advances by _step_whole + _step_frac / _out_step input samples per output frame */
+        uint64_t _in_step = 1;
+        uint64_t _out_step = 1;
+        uint64_t _step_whole = 1;
+        uint64_t _step_frac = 0;
+
+        /* planar input history. _index is the first tap of the next output, _frac / _out_step
+           the fraction of a sample past it */
+        std::vector<float> _history[MAX_CHANNELS];
+        size_t _filled = 0;
+        size_t _index = 0;
+        uint64_t _frac = 0;
+
+        /* input frames already dropped off the front of the history */
+        uint64_t _discarded = 0;
+
+        void build_bank();
+        void compact();
+
+    public:
+        resampler();
+
+        /* clears the history and, when the ratio changed, rebuilds the filter bank */
+        void configure(unsigned int in_rate, unsigned int out_rate, unsigned int channels);
+        void reset();
+
+        bool passthrough() const { return _in_rate == _out_rate; }
+        unsigned int in_rate() const { return _in_rate; }
+        unsigned int out_rate() const { return _out_rate; }
+
+        /* consumes up to in_frames of input and writes up to out_frames of output, both interleaved.
+           returns the output frames written, consumed is set to the input frames taken */
+        size_t process(const float *in, size_t in_frames, size_t &consumed, float *out, size_t out_frames);
+
+        /* the input frame, counted from configure() or reset(), the next output frame sits on */
+        double position() const;
+
+        /* output frames left before the input position reaches frame end */
+        uint64_t frames_until(uint64_t end) const;
+
+        /* output frames that span the first in_frames of input */
+        uint64_t output_frames(uint64_t in_frames) const;
+};
+
+const char *resampler_backend();
@@ -0,0 +1,610 @@
+#include "sample_convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define HEXEN_X86 1
+    #include <immintrin.h>
+#endif
+
+static constexpr float S16_SCALE = 32768.0f;
+static constexpr float S16_TO_F32 = 1.0f / 32768.0f;
+static constexpr float S24_TO_F32 = 1.0f / 8388608.0f;
+static constexpr float S32_TO_F32 = 1.0f / 2147483648.0f;
+
+/* conversions that need an intermediate float pass run in blocks of this many samples on the stack */
+static constexpr size_t BLOCK_SAMPLES = 1024;
+
+struct convert_kernels {
+    const char *name;
+
+    void (*s16_to_f32)(const uint8_t *in, float *out, size_t samples);
+    void (*s24_to_f32)(const uint8_t *in, float *out, size_t samples);
+    void (*s32_to_f32)(const uint8_t *in, float *out, size_t samples);
+
+    void (*f32_to_s16)(const float *in, int16_t *out, size_t samples);
+    void (*f32_to_s16_dither)(const float *in, int16_t *out, size_t samples, uint32_t *lanes);
+
+    void (*interleave2)(const float *left, const float *right, float *out, size_t frames);
+    void (*deinterleave2)(const float *in, float *left, float *right, size_t frames);
+
+    void (*stats)(const float *in, size_t samples, float *min, float *max, double *sum_squares);
+};
+
+/* scalar */
+
+static inline int32_t load_s24(const uint8_t *p) {
+    return static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 24) >> 8;
+}
+
+static inline uint32_t xorshift(uint32_t &x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static inline float unit_random(uint32_t &x) {
+    return static_cast<float>(xorshift(x) >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline int16_t quantize_s16(float scaled) {
+    scaled = std::min(std::max(scaled, -32768.0f), 32767.0f);
+    return static_cast<int16_t>(std::lrint(scaled));
+}
+
+static void scalar_s16_to_f32(const uint8_t *in, float *out, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        int16_t v;
+        std::memcpy(&v, in + i * 2, sizeof(v));
+        out[i] = v * S16_TO_F32;
+    }
+}
+
+static void scalar_s24_to_f32(const uint8_t *in, float *out, size_t samples) {
+    for (size_t i = 0; i < samples; i++) out[i] = load_s24(in + i * 3) * S24_TO_F32;
+}
+
+static void scalar_s32_to_f32(const uint8_t *in, float *out, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        int32_t v;
+        std::memcpy(&v, in + i * 4, sizeof(v));
+        out[i] = v * S32_TO_F32;
+    }
+}
+
+static void scalar_f32_to_s16(const float *in, int16_t *out, size_t samples) {
+    for (size_t i = 0; i < samples; i++) out[i] = quantize_s16(in[i] * S16_SCALE);
+}
+
+static void scalar_f32_to_s16_dither(const float *in, int16_t *out, size_t samples, uint32_t *lanes) {
+    for (size_t i = 0; i < samples; i++) {
+        const float noise = unit_random(lanes[0]) - unit_random(lanes[1]);
+        out[i] = quantize_s16(in[i] * S16_SCALE + noise);
+    }
+}
+
+static void scalar_interleave2(const float *left, const float *right, float *out, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        out[i * 2] = left[i];
+        out[i * 2 + 1] = right[i];
+    }
+}
+
+static void scalar_deinterleave2(const float *in, float *left, float *right, size_t frames) {
+    for (size_t i = 0; i < frames; i++) {
+        left[i] = in[i * 2];
+        right[i] = in[i * 2 + 1];
+    }
+}
+
+static void scalar_stats(const float *in, size_t samples, float *min, float *max, double *sum_squares) {
+    float lo = *min, hi = *max;
+    double squares = 0.0;
+
+    for (size_t i = 0; i < samples; i++) {
+        lo = std::min(lo, in[i]);
+        hi = std::max(hi, in[i]);
+        squares += static_cast<double>(in[i]) * in[i];
+    }
+
+    *min = lo;
+    *max = hi;
+    *sum_squares += squares;
+}
+
+static const convert_kernels SCALAR_KERNELS = {
+    "scalar",
+    scalar_s16_to_f32, scalar_s24_to_f32, scalar_s32_to_f32,
+    scalar_f32_to_s16, scalar_f32_to_s16_dither,
+    scalar_interleave2, scalar_deinterleave2,
+    scalar_stats,
+};
+
+#ifdef HEXEN_X86
+
+/* sse2, the x86-64 baseline */
+
+static void sse2_s16_to_f32(const uint8_t *in, float *out, size_t samples) {
+    const __m128 scale = _mm_set1_ps(S16_TO_F32);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2));
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+
+    scalar_s16_to_f32(in + i * 2, out + i, samples - i);
+}
+
+static inline int32_t load_u32(const uint8_t *p) {
+    int32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void sse2_s24_to_f32(const uint8_t *in, float *out, size_t samples) {
+    const __m128 scale = _mm_set1_ps(S24_TO_F32);
+    size_t i = 0;
+
+    /* each lane loads 4 bytes starting at its sample, so stop one sample early to stay in bounds */
+    for (; i + 5 <= samples; i += 4) {
+        const uint8_t *p = in + i * 3;
+        __m128i v = _mm_set_epi32(load_u32(p + 9), load_u32(p + 6), load_u32(p + 3), load_u32(p));
+        v = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+
+    scalar_s24_to_f32(in + i * 3, out + i, samples - i);
+}
+
+static void sse2_s32_to_f32(const uint8_t *in, float *out, size_t samples) {
+    const __m128 scale = _mm_set1_ps(S32_TO_F32);
+    size_t i = 0;
+
+    for (; i + 4 <= samples; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 4));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+
+    scalar_s32_to_f32(in + i * 4, out + i, samples - i);
+}
+
+static inline __m128i sse2_quantize(__m128 scaled) {
+    scaled = _mm_min_ps(_mm_max_ps(scaled, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+    return _mm_cvtps_epi32(scaled);
+}
+
+static void sse2_f32_to_s16(const float *in, int16_t *out, size_t samples) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        const __m128i lo = sse2_quantize(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+        const __m128i hi = sse2_quantize(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(lo, hi));
+    }
+
+    scalar_f32_to_s16(in + i, out + i, samples - i);
+}
+
+static inline __m128i sse2_xorshift(__m128i &x) {
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    return x;
+}
+
+/* top 23 random bits as the mantissa of a float in [1, 2) */
+static inline __m128 sse2_unit_random(__m128i &x) {
+    const __m128i bits = _mm_or_si128(_mm_srli_epi32(sse2_xorshift(x), 9), _mm_set1_epi32(0x3f800000));
+    return _mm_castsi128_ps(bits);
+}
+
+static void sse2_f32_to_s16_dither(const float *in, int16_t *out, size_t samples, uint32_t *lanes) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lanes + 4));
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        const __m128 noise_lo = _mm_sub_ps(sse2_unit_random(a), sse2_unit_random(b));
+        const __m128 noise_hi = _mm_sub_ps(sse2_unit_random(a), sse2_unit_random(b));
+
+        const __m128i lo = sse2_quantize(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), noise_lo));
+        const __m128i hi = sse2_quantize(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), noise_hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(lo, hi));
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), a);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 4), b);
+
+    scalar_f32_to_s16_dither(in + i, out + i, samples - i, lanes);
+}
+
+static void sse2_interleave2(const float *left, const float *right, float *out, size_t frames) {
+    size_t i = 0;
+
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 l = _mm_loadu_ps(left + i);
+        const __m128 r = _mm_loadu_ps(right + i);
+
+        _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(l, r));
+    }
+
+    scalar_interleave2(left + i, right + i, out + i * 2, frames - i);
+}
+
+static void sse2_deinterleave2(const float *in, float *left, float *right, size_t frames) {
+    size_t i = 0;
+
+    for (; i + 4 <= frames; i += 4) {
+        const __m128 a = _mm_loadu_ps(in + i * 2);
+        const __m128 b = _mm_loadu_ps(in + i * 2 + 4);
+
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+    scalar_deinterleave2(in + i * 2, left + i, right + i, frames - i);
+}
+
+static void sse2_stats(const float *in, size_t samples, float *min, float *max, double *sum_squares) {
+    __m128 lo = _mm_set1_ps(*min), hi = _mm_set1_ps(*max);
+    __m128d squares = _mm_setzero_pd();
+    size_t i = 0;
+
+    /* squares are summed in double, a float sum stops growing once it dwarfs each term */
+    for (; i + 4 <= samples; i += 4) {
+        const __m128 v = _mm_loadu_ps(in + i);
+        const __m128 square = _mm_mul_ps(v, v);
+
+        lo = _mm_min_ps(lo, v);
+        hi = _mm_max_ps(hi, v);
+        squares = _mm_add_pd(squares, _mm_add_pd(_mm_cvtps_pd(square), _mm_cvtps_pd(_mm_movehl_ps(square, square))));
+    }
+
+    alignas(16) float lanes_lo[4], lanes_hi[4];
+    _mm_store_ps(lanes_lo, lo);
+    _mm_store_ps(lanes_hi, hi);
+
+    *min = std::min(std::min(lanes_lo[0], lanes_lo[1]), std::min(lanes_lo[2], lanes_lo[3]));
+    *max = std::max(std::max(lanes_hi[0], lanes_hi[1]), std::max(lanes_hi[2], lanes_hi[3]));
+    *sum_squares += _mm_cvtsd_f64(_mm_add_sd(squares, _mm_unpackhi_pd(squares, squares)));
+
+    scalar_stats(in + i, samples - i, min, max, sum_squares);
+}
+
+static const convert_kernels SSE2_KERNELS = {
+    "sse2",
+    sse2_s16_to_f32, sse2_s24_to_f32, sse2_s32_to_f32,
+    sse2_f32_to_s16, sse2_f32_to_s16_dither,
+    sse2_interleave2, sse2_deinterleave2,
+    sse2_stats,
+};
+
+/* avx2, compiled per function so the rest of the build stays baseline */
+
+#define HEXEN_AVX2 __attribute__((target("avx2")))
+
+HEXEN_AVX2 static void avx2_s16_to_f32(const uint8_t *in, float *out, size_t samples) {
+    const __m256 scale = _mm256_set1_ps(S16_TO_F32);
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        const __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2)));
+        const __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2 + 16)));
+
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+
+    sse2_s16_to_f32(in + i * 2, out + i, samples - i);
+}
+
+HEXEN_AVX2 static void avx2_s24_to_f32(const uint8_t *in, float *out, size_t samples) {
+    const __m256 scale = _mm256_set1_ps(S24_TO_F32);
+
+    /* place each 3-byte sample in the top of a 32-bit lane, then shift it back down with sign */
+    const __m256i shuffle = _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+    size_t i = 0;
+
+    /* the second 16-byte load starts 12 bytes in, keep it inside the input */
+    for (; i * 3 + 28 <= samples * 3; i += 8) {
+        const uint8_t *p = in + i * 3;
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12));
+
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuffle), 8);
+
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    sse2_s24_to_f32(in + i * 3, out + i, samples - i);
+}
+
+HEXEN_AVX2 static void avx2_s32_to_f32(const uint8_t *in, float *out, size_t samples) {
+    const __m256 scale = _mm256_set1_ps(S32_TO_F32);
+    size_t i = 0;
+
+    for (; i + 8 <= samples; i += 8) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i * 4));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    sse2_s32_to_f32(in + i * 4, out + i, samples - i);
+}
+
+HEXEN_AVX2 static inline __m256i avx2_quantize(__m256 scaled) {
+    scaled = _mm256_min_ps(_mm256_max_ps(scaled, _mm256_set1_ps(-32768.0f)), _mm256_set1_ps(32767.0f));
+    return _mm256_cvtps_epi32(scaled);
+}
+
+/* packs works per 128-bit lane, the permute puts the four 64-bit halves back in order */
+HEXEN_AVX2 static inline __m256i avx2_pack(__m256i lo, __m256i hi) {
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+HEXEN_AVX2 static void avx2_f32_to_s16(const float *in, int16_t *out, size_t samples) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        const __m256i lo = avx2_quantize(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale));
+        const __m256i hi = avx2_quantize(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), avx2_pack(lo, hi));
+    }
+
+    sse2_f32_to_s16(in + i, out + i, samples - i);
+}
+
+HEXEN_AVX2 static inline __m256 avx2_unit_random(__m256i &x) {
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+
+    const __m256i bits = _mm256_or_si256(_mm256_srli_epi32(x, 9), _mm256_set1_epi32(0x3f800000));
+    return _mm256_castsi256_ps(bits);
+}
+
+HEXEN_AVX2 static void avx2_f32_to_s16_dither(const float *in, int16_t *out, size_t samples, uint32_t *lanes) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lanes + 8));
+    size_t i = 0;
+
+    for (; i + 16 <= samples; i += 16) {
+        const __m256 noise_lo = _mm256_sub_ps(avx2_unit_random(a), avx2_unit_random(b));
+        const __m256 noise_hi = _mm256_sub_ps(avx2_unit_random(a), avx2_unit_random(b));
+
+        const __m256i lo = avx2_quantize(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), noise_lo));
+        const __m256i hi = avx2_quantize(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), noise_hi));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), avx2_pack(lo, hi));
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), a);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes + 8), b);
+
+    scalar_f32_to_s16_dither(in + i, out + i, samples - i, lanes);
+}
+
+HEXEN_AVX2 static void avx2_interleave2(const float *left, const float *right, float *out, size_t frames) {
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8) {
+        const __m256 l = _mm256_loadu_ps(left + i);
+        const __m256 r = _mm256_loadu_ps(right + i);
+
+        const __m256 lo = _mm256_unpacklo_ps(l, r);
+        const __m256 hi = _mm256_unpackhi_ps(l, r);
+
+        _mm256_storeu_ps(out + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+
+    sse2_interleave2(left + i, right + i, out + i * 2, frames - i);
+}
+
+HEXEN_AVX2 static void avx2_deinterleave2(const float *in, float *left, float *right, size_t frames) {
+    const __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    size_t i = 0;
+
+    for (; i + 8 <= frames; i += 8) {
+        const __m256 a = _mm256_loadu_ps(in + i * 2);
+        const __m256 b = _mm256_loadu_ps(in + i * 2 + 8);
+
+        const __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm256_storeu_ps(left + i, _mm256_permutevar8x32_ps(l, order));
+        _mm256_storeu_ps(right + i, _mm256_permutevar8x32_ps(r, order));
+    }
+
+    sse2_deinterleave2(in + i * 2, left + i, right + i, frames - i);
+}
+
+HEXEN_AVX2 static void avx2_stats(const float *in, size_t samples, float *min, float *max, double *sum_squares) {
+    __m256 lo = _mm256_set1_ps(*min), hi = _mm256_set1_ps(*max);
+    __m256d squares_a = _mm256_setzero_pd(), squares_b = _mm256_setzero_pd();
+    size_t i = 0;
+
+    /* two accumulators so consecutive adds do not wait on each other */
+    for (; i + 16 <= samples; i += 16) {
+        const __m256 a = _mm256_loadu_ps(in + i);
+        const __m256 b = _mm256_loadu_ps(in + i + 8);
+
+        lo = _mm256_min_ps(lo, _mm256_min_ps(a, b));
+        hi = _mm256_max_ps(hi, _mm256_max_ps(a, b));
+        const __m256 square_a = _mm256_mul_ps(a, a);
+        const __m256 square_b = _mm256_mul_ps(b, b);
+
+        squares_a = _mm256_add_pd(squares_a, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(square_a)), _mm256_cvtps_pd(_mm256_extractf128_ps(square_a, 1))));
+        squares_b = _mm256_add_pd(squares_b, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(square_b)), _mm256_cvtps_pd(_mm256_extractf128_ps(square_b, 1))));
+    }
+
+    const __m128 lo4 = _mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1));
+    const __m128 hi4 = _mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1));
+    const __m256d squares = _mm256_add_pd(squares_a, squares_b);
+    const __m128d squares2 = _mm_add_pd(_mm256_castpd256_pd128(squares), _mm256_extractf128_pd(squares, 1));
+
+    alignas(16) float lanes_lo[4], lanes_hi[4];
+    _mm_store_ps(lanes_lo, lo4);
+    _mm_store_ps(lanes_hi, hi4);
+
+    *min = std::min(std::min(lanes_lo[0], lanes_lo[1]), std::min(lanes_lo[2], lanes_lo[3]));
+    *max = std::max(std::max(lanes_hi[0], lanes_hi[1]), std::max(lanes_hi[2], lanes_hi[3]));
+    *sum_squares += _mm_cvtsd_f64(_mm_add_sd(squares2, _mm_unpackhi_pd(squares2, squares2)));
+
+    sse2_stats(in + i, samples - i, min, max, sum_squares);
+}
+
+static const convert_kernels AVX2_KERNELS = {
+    "avx2",
+    avx2_s16_to_f32, avx2_s24_to_f32, avx2_s32_to_f32,
+    avx2_f32_to_s16, avx2_f32_to_s16_dither,
+    avx2_interleave2, avx2_deinterleave2,
+    avx2_stats,
+};
+
+#endif
+
+static const convert_kernels *supported_kernels(const char *name) {
+    if (std::strcmp(name, SCALAR_KERNELS.name) == 0) return &SCALAR_KERNELS;
+
+#ifdef HEXEN_X86
+    __builtin_cpu_init();
+    if (std::strcmp(name, AVX2_KERNELS.name) == 0 && __builtin_cpu_supports("avx2")) return &AVX2_KERNELS;
+    if (std::strcmp(name, SSE2_KERNELS.name) == 0 && __builtin_cpu_supports("sse2")) return &SSE2_KERNELS;
+#endif
+
+    return nullptr;
+}
+
+static const convert_kernels *&selected_kernels() {
+    static const convert_kernels *selected = []() -> const convert_kernels * {
+#ifdef HEXEN_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return &AVX2_KERNELS;
+        if (__builtin_cpu_supports("sse2")) return &SSE2_KERNELS;
+#endif
+        return &SCALAR_KERNELS;
+    }();
+
+    return selected;
+}
+
+static const convert_kernels &kernels() {
+    return *selected_kernels();
+}
+
+size_t sample_size(sample_format format) {
+    switch (format) {
+        case sample_format::s16: return 2;
+        case sample_format::s24: return 3;
+        case sample_format::s32: return 4;
+        case sample_format::f32: return 4;
+    }
+
+    return 0;
+}
+
+const char *convert_backend() {
+    return kernels().name;
+}
+
+bool use_convert_backend(const char *name) {
+    const convert_kernels *wanted = supported_kernels(name);
+    if (!wanted) return false;
+
+    selected_kernels() = wanted;
+    return true;
+}
+
+void convert_to_f32(const void *in, sample_format format, float *out, size_t samples) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(in);
+
+    switch (format) {
+        case sample_format::s16: kernels().s16_to_f32(bytes, out, samples); break;
+        case sample_format::s24: kernels().s24_to_f32(bytes, out, samples); break;
+        case sample_format::s32: kernels().s32_to_f32(bytes, out, samples); break;
+        case sample_format::f32: std::memcpy(out, in, samples * sizeof(float)); break;
+    }
+}
+
+void convert_to_s16(const void *in, sample_format format, int16_t *out, size_t samples, dither_state *dither) {
+    const convert_kernels &k = kernels();
+
+    if (format == sample_format::s16) {
+        std::memcpy(out, in, samples * sizeof(int16_t));
+        return;
+    }
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(in);
+    const size_t stride = sample_size(format);
+
+    float block[BLOCK_SAMPLES];
+
+    for (size_t done = 0; done < samples; ) {
+        const size_t count = std::min(BLOCK_SAMPLES, samples - done);
+
+        const float *source = block;
+        if (format == sample_format::f32) {
+            source = reinterpret_cast<const float *>(bytes + done * stride);
+            if (reinterpret_cast<uintptr_t>(source) % alignof(float) != 0) {
+                std::memcpy(block, source, count * sizeof(float));
+                source = block;
+            }
+        } else {
+            convert_to_f32(bytes + done * stride, format, block, count);
+        }
+
+        if (dither) {
+            k.f32_to_s16_dither(source, out + done, count, dither->lanes);
+        } else {
+            k.f32_to_s16(source, out + done, count);
+        }
+
+        done += count;
+    }
+}
+
+void interleave_f32(const float *const *planes, unsigned int channels, float *out, size_t frames) {
+    if (channels == 2) {
+        kernels().interleave2(planes[0], planes[1], out, frames);
+        return;
+    }
+
+    for (size_t i = 0; i < frames; i++) {
+        for (unsigned int c = 0; c < channels; c++) out[i * channels + c] = planes[c][i];
+    }
+}
+
+void deinterleave_f32(const float *in, unsigned int channels, float *const *planes, size_t frames) {
+    if (channels == 2) {
+        kernels().deinterleave2(in, planes[0], planes[1], frames);
+        return;
+    }
+
+    for (size_t i = 0; i < frames; i++) {
+        for (unsigned int c = 0; c < channels; c++) planes[c][i] = in[i * channels + c];
+    }
+}
+
+void accumulate_stats(const float *in, size_t samples, sample_stats &stats) {
+    kernels().stats(in, samples, &stats.min, &stats.max, &stats.sum_squares);
+    stats.count += samples;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+enum class sample_format : uint8_t { s16, s24, s32, f32 };
+
+size_t sample_size(sample_format format);
+
+/* triangular dither for requantizing to s16, one per stream. each simd lane runs its own generator */
+struct dither_state {
+    uint32_t lanes[16] = { 0x9e3779b9u, 0x7f4a7c15u, 0x85ebca6bu, 0xc2b2ae35u,
+                           0x27d4eb2fu, 0x165667b1u, 0xd3a2646cu, 0xfd7046c5u,
+                           0xb55a4f09u, 0x1b873593u, 0xcc9e2d51u, 0xe6546b64u,
+                           0x61c88647u, 0x68e31da4u, 0xb5297a4du, 0x1b56c4e9u };
+};
+
+/* vectorized kernels, picked once at startup from what the cpu supports (avx2, sse2 or scalar).
+   input may be unaligned, counts are in samples, not frames */
+void convert_to_f32(const void *in, sample_format format, float *out, size_t samples);
+
+/* pass a dither_state to add +-1 lsb tpdf noise before rounding, or nullptr to round plainly.
+   s16 input is copied as-is either way */
+void convert_to_s16(const void *in, sample_format format, int16_t *out, size_t samples, dither_state *dither);
+
+void interleave_f32(const float *const *planes, unsigned int channels, float *out, size_t frames);
+void deinterleave_f32(const float *in, unsigned int channels, float *const *planes, size_t frames);
+
+const char *convert_backend();
+
+/* switches to the "scalar", "sse2" or "avx2" kernels, false when the cpu lacks them. for tests
+   and benchmarks comparing backends, call it before any conversion runs on another thread */
+bool use_convert_backend(const char *name);
+
+/* running min, max and energy of a stream of float samples, for meters and waveform overviews.
+   min and max stay at +-inf until the first sample */
+struct sample_stats {
+    float min = INFINITY;
+    float max = -INFINITY;
+    double sum_squares = 0.0;
+    uint64_t count = 0;
+};
+
+void accumulate_stats(const float *in, size_t samples, sample_stats &stats);
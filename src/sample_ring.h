@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* history of the last Capacity samples written by a single producer thread, addressed by a running
+   sample count. readers copy a window out without blocking the writer and are told if it was
+   overwritten while they copied */
+template <size_t Capacity>
+class sample_ring {
+    static_assert((Capacity & (Capacity - 1)) == 0, "sample_ring capacity must be a power of two");
+
+    private:
+        float _samples[Capacity];
+
+        alignas(64) std::atomic<uint64_t> _writing{0};
+        alignas(64) std::atomic<uint64_t> _written{0};
+
+    public:
+        void write(const float *samples, size_t count) {
+            uint64_t position = _written.load(std::memory_order_relaxed);
+
+            if (count > Capacity) {
+                position += count - Capacity;
+                samples += count - Capacity;
+                count = Capacity;
+            }
+
+            _writing.store(position + count, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            const size_t start = position & (Capacity - 1);
+            const size_t first = std::min(count, Capacity - start);
+
+            std::memcpy(_samples + start, samples, first * sizeof(float));
+            std::memcpy(_samples, samples + first, (count - first) * sizeof(float));
+
+            _written.store(position + count, std::memory_order_release);
+        }
+
+        uint64_t written() const { return _written.load(std::memory_order_acquire); }
+
+        /* copies the count samples that end at position end */
+        bool read(uint64_t end, float *out, size_t count) const {
+            if (count > Capacity || end < count || end > _written.load(std::memory_order_acquire)) return false;
+
+            const uint64_t begin = end - count;
+            const size_t start = begin & (Capacity - 1);
+            const size_t first = std::min(count, Capacity - start);
+
+            std::memcpy(out, _samples + start, first * sizeof(float));
+            std::memcpy(out + first, _samples, (count - first) * sizeof(float));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return _writing.load(std::memory_order_relaxed) <= begin + Capacity;
+        }
+};
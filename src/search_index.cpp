@@ -0,0 +1,496 @@
+#include "search_index.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "library_db.h"
+
+static constexpr char WORD_START = '\x01';
+
+static bool is_word_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || (c & 0x80);
+}
+
+static char lower(char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+static uint32_t trigram_bucket(char a, char b, char c) {
+    const uint32_t key = static_cast<uint32_t>(static_cast<unsigned char>(a)) << 16 |
+                         static_cast<uint32_t>(static_cast<unsigned char>(b)) << 8 |
+                         static_cast<uint32_t>(static_cast<unsigned char>(c));
+    return (key * 2654435761u) >> 16;
+}
+
+static bool word_start(std::string_view text, size_t pos) {
+    return pos == 0 || !is_word_char(text[pos - 1]);
+}
+
+static void append_lower(std::string &out, std::string_view text) {
+    for (char c : text) out.push_back(lower(c));
+}
+
+bool search_index::init() {
+    _running = true;
+    _worker = std::thread(&search_index::worker_thread, this);
+    return true;
+}
+
+void search_index::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _running = false;
+    }
+    _wake.notify_one();
+
+    if (_worker.joinable()) _worker.join();
+}
+
+void search_index::clear() {
+    std::lock_guard<std::mutex> index_lock(_index_mutex);
+    _generation++;
+
+    _docs.clear();
+    _bounds.clear();
+    _paths.clear();
+    _labels.clear();
+    _text.clear();
+
+    _indexed_count = 0;
+    _dead_count = 0;
+    _name_postings = postings();
+    _postings = postings();
+    _by_path.clear();
+}
+
+uint32_t search_index::add_doc(std::string_view path, std::string_view tags, entry_kind kind) {
+    const size_t slash = path.rfind('/');
+    std::string_view name = (slash == std::string_view::npos) ? path : path.substr(slash + 1);
+    const std::string_view parents = (slash == std::string_view::npos) ? std::string_view() : path.substr(0, slash);
+
+    search_doc doc;
+    doc.path_offset = static_cast<uint32_t>(_paths.size());
+    doc.path_length = static_cast<uint32_t>(path.size());
+    doc.label_offset = static_cast<uint32_t>(_labels.size());
+    doc.kind = kind;
+    doc.live = true;
+
+    _paths.append(path);
+
+    _labels.append(name);
+    if (kind == entry_kind::directory) _labels.push_back('/');
+    _labels.push_back('\0');
+
+    /* the extension on every track would match everything */
+    if (kind == entry_kind::track && is_audio_file(name.data(), name.size())) {
+        const size_t dot = name.rfind('.');
+        if (dot != std::string_view::npos && dot > 0) name = name.substr(0, dot);
+    }
+
+    std::string text;
+    append_lower(text, name);
+    const size_t name_end = text.size();
+
+    text.push_back('\n');
+    append_lower(text, tags);
+    const size_t tags_end = text.size();
+
+    /* the two nearest parents, usually album and artist */
+    text.push_back('\n');
+    const size_t parent = parents.rfind('/');
+    const size_t grandparent = (parent == std::string_view::npos || parent == 0) ? std::string_view::npos : parents.rfind('/', parent - 1);
+    append_lower(text, parents.substr(grandparent == std::string_view::npos ? 0 : grandparent + 1));
+
+    text.resize(std::min<size_t>(text.size(), UINT16_MAX));
+
+    doc.text_offset = static_cast<uint32_t>(_text.size());
+    doc.name_end = static_cast<uint16_t>(std::min<size_t>(name_end, UINT16_MAX));
+    doc.tags_end = static_cast<uint16_t>(std::min<size_t>(tags_end, UINT16_MAX));
+    doc.text_length = static_cast<uint16_t>(text.size());
+    _text += text;
+
+    _docs.push_back(doc);
+    _bounds.push_back({ text[0], static_cast<uint8_t>(std::min<size_t>(name_end, 200)) });
+    return static_cast<uint32_t>(_docs.size() - 1);
+}
+
+void search_index::update(const library_db &db) {
+    std::lock_guard<std::mutex> index_lock(_index_mutex);
+    _generation++;
+
+    std::vector<uint32_t> next;
+    next.reserve(db.size());
+
+    auto doc_path = [this](uint32_t id) {
+        return std::string_view(_paths.data() + _docs[id].path_offset, _docs[id].path_length);
+    };
+
+    auto kill = [this](uint32_t id) {
+        _docs[id].live = false;
+        _dead_count++;
+    };
+
+    std::string lowered_tags;
+    size_t j = 0;
+
+    /* both sides are sorted by path, so this is one merge pass */
+    for (uint32_t i = 0; i < db.size(); i++) {
+        const db_record &record = db.record(i);
+        const std::string_view path = db.path(record);
+        const std::string_view tags = db.tags(record);
+
+        while (j < _by_path.size() && doc_path(_by_path[j]) < path) kill(_by_path[j++]);
+
+        if (j < _by_path.size() && doc_path(_by_path[j]) == path) {
+            const uint32_t id = _by_path[j++];
+            const search_doc &doc = _docs[id];
+
+            lowered_tags.clear();
+            append_lower(lowered_tags, tags);
+
+            const std::string_view indexed_tags(_text.data() + doc.text_offset + doc.name_end + 1, doc.tags_end - doc.name_end - 1);
+            if (indexed_tags == lowered_tags && static_cast<uint8_t>(doc.kind) == record.kind) {
+                next.push_back(id);
+                continue;
+            }
+
+            kill(id);
+        }
+
+        next.push_back(add_doc(path, tags, static_cast<entry_kind>(record.kind)));
+    }
+
+    while (j < _by_path.size()) kill(_by_path[j++]);
+
+    _by_path.swap(next);
+
+    /* dead docs only cost memory, so they can pile up further */
+    if (_docs.size() - _indexed_count > MAX_DELTA || _dead_count > std::max<size_t>(MAX_DELTA, _by_path.size() / 8)) rebuild();
+}
+
+/* calls emit once per distinct bucket of doc. seen[bucket] == id marks buckets already emitted */
+template <typename Emit>
+static void for_each_bucket(std::string_view text, uint32_t id, std::vector<uint32_t> &seen, Emit emit) {
+    auto visit = [&](uint32_t bucket) {
+        if (seen[bucket] == id) return;
+        seen[bucket] = id;
+        emit(bucket);
+    };
+
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '\n') continue;
+
+        if (is_word_char(text[i]) && word_start(text, i)) {
+            visit(trigram_bucket(WORD_START, WORD_START, text[i]));
+            if (i + 1 < text.size() && text[i + 1] != '\n') visit(trigram_bucket(WORD_START, text[i], text[i + 1]));
+        }
+
+        if (i + 2 < text.size() && text[i + 1] != '\n' && text[i + 2] != '\n') {
+            visit(trigram_bucket(text[i], text[i + 1], text[i + 2]));
+        }
+    }
+}
+
+void search_index::rebuild() {
+    /* compact the live docs in path order, which also keeps every postings run sorted */
+    std::vector<search_doc> docs;
+    std::vector<doc_bound> bounds;
+    std::string paths, labels, text;
+
+    docs.reserve(_by_path.size());
+    bounds.reserve(_by_path.size());
+    paths.reserve(_paths.size());
+    labels.reserve(_labels.size());
+    text.reserve(_text.size());
+
+    for (uint32_t id : _by_path) {
+        search_doc doc = _docs[id];
+        const char *label = _labels.data() + doc.label_offset;
+
+        doc.label_offset = static_cast<uint32_t>(labels.size());
+        labels.append(label, std::char_traits<char>::length(label) + 1);
+
+        paths.append(_paths, doc.path_offset, doc.path_length);
+        doc.path_offset = static_cast<uint32_t>(paths.size() - doc.path_length);
+
+        text.append(_text, doc.text_offset, doc.text_length);
+        doc.text_offset = static_cast<uint32_t>(text.size() - doc.text_length);
+
+        docs.push_back(doc);
+        bounds.push_back(_bounds[id]);
+    }
+
+    _docs.swap(docs);
+    _bounds.swap(bounds);
+    _paths.swap(paths);
+    _labels.swap(labels);
+    _text.swap(text);
+
+    for (uint32_t i = 0; i < _by_path.size(); i++) _by_path[i] = i;
+
+    build_postings(_name_postings, true);
+    build_postings(_postings, false);
+
+    _indexed_count = static_cast<uint32_t>(_docs.size());
+    _dead_count = 0;
+}
+
+void search_index::build_postings(postings &out, bool names_only) const {
+    auto text = [&](uint32_t id) { return names_only ? doc_text(id).substr(0, _docs[id].name_end) : doc_text(id); };
+
+    /* count, prefix sum, fill */
+    out.offsets.assign(TRIGRAM_BUCKETS + 1, 0);
+    std::vector<uint32_t> seen(TRIGRAM_BUCKETS, UINT32_MAX);
+
+    for (uint32_t id = 0; id < _docs.size(); id++) {
+        for_each_bucket(text(id), id, seen, [&out](uint32_t bucket) { out.offsets[bucket + 1]++; });
+    }
+
+    for (uint32_t b = 0; b < TRIGRAM_BUCKETS; b++) out.offsets[b + 1] += out.offsets[b];
+
+    out.ids.resize(out.offsets[TRIGRAM_BUCKETS]);
+    out.ids.shrink_to_fit();
+    std::vector<uint32_t> fill(out.offsets.begin(), out.offsets.end() - 1);
+    std::fill(seen.begin(), seen.end(), UINT32_MAX);
+
+    for (uint32_t id = 0; id < _docs.size(); id++) {
+        for_each_bucket(text(id), id, seen, [&](uint32_t bucket) { out.ids[fill[bucket]++] = id; });
+    }
+}
+
+void search_index::term_buckets(std::string_view term, std::vector<uint32_t> &out) const {
+    if (term.size() == 1) {
+        out.push_back(trigram_bucket(WORD_START, WORD_START, term[0]));
+    } else if (term.size() == 2) {
+        out.push_back(trigram_bucket(WORD_START, term[0], term[1]));
+    } else {
+        for (size_t i = 0; i + 2 < term.size(); i++) out.push_back(trigram_bucket(term[i], term[i + 1], term[i + 2]));
+    }
+}
+
+/* first position in [first, last) not below id, galloping out from first before the binary search */
+static const uint32_t *gallop(const uint32_t *first, const uint32_t *last, uint32_t id) {
+    size_t step = 1;
+    while (first + step < last && first[step] < id) step *= 2;
+
+    return std::lower_bound(first, std::min(first + step + 1, last), id);
+}
+
+void search_index::intersect(const postings &table, std::vector<uint32_t> &out) {
+    /* leapfrog over all the runs at once, driven by the shortest */
+    std::sort(_buckets.begin(), _buckets.end(), [&table](uint32_t a, uint32_t b) {
+        return table.run_length(a) != table.run_length(b) ? table.run_length(a) < table.run_length(b) : a < b;
+    });
+
+    _cursors.clear();
+    for (uint32_t bucket : _buckets) {
+        _cursors.push_back({ table.ids.data() + table.offsets[bucket], table.ids.data() + table.offsets[bucket + 1] });
+    }
+
+    const cursor driver = _cursors.front();
+
+    for (const uint32_t *it = driver.first; it != driver.last; it++) {
+        const uint32_t id = *it;
+        bool match = true;
+
+        for (size_t i = 1; i < _cursors.size(); i++) {
+            cursor &other = _cursors[i];
+
+            other.first = gallop(other.first, other.last, id);
+            if (other.first == other.last) return;
+
+            if (*other.first != id) {
+                match = false;
+                break;
+            }
+        }
+
+        if (match) out.push_back(id);
+    }
+}
+
+/* best placement of every term, name beats tags beats folders and word starts beat the middle of a word.
+   a term found in the name needs nothing further, so with name_only the rest of the text is skipped */
+int32_t search_index::score(const search_doc &doc, bool name_only) const {
+    const std::string_view text(_text.data() + doc.text_offset, name_only ? doc.name_end : doc.text_length);
+    int32_t total = 0;
+
+    for (std::string_view term : _terms) {
+        int32_t best = -1;
+
+        for (size_t pos = text.find(term); pos != std::string_view::npos; pos = text.find(term, pos + 1)) {
+            const bool at_word = word_start(text, pos);
+            if (term.size() < 3 && !at_word) continue;
+
+            int32_t value;
+            if (pos < doc.name_end) {
+                value = (pos == 0) ? 1000 : (at_word ? 600 : 300);
+            } else if (pos < doc.tags_end) {
+                value = at_word ? 200 : 100;
+            } else {
+                value = at_word ? 80 : 40;
+            }
+
+            best = std::max(best, value);
+            if (best == 1000) break;
+        }
+
+        if (best < 0) return -1;
+        total += best;
+    }
+
+    /* shorter names are closer matches. query() bounds scores by the 1000, 600 and 200 above */
+    return total - std::min<int32_t>(doc.name_end, 200);
+}
+
+void search_index::query(std::string_view text, std::vector<search_result> &results) {
+    results.clear();
+
+    _query.clear();
+    append_lower(_query, text);
+
+    _terms.clear();
+    for (size_t pos = 0; pos < _query.size(); ) {
+        const size_t end = std::min(_query.find(' ', pos), _query.size());
+        if (end > pos) _terms.emplace_back(_query.data() + pos, end - pos);
+        pos = end + 1;
+    }
+
+    if (_terms.empty()) return;
+
+    auto better = [](const search_result &a, const search_result &b) {
+        return a.score != b.score ? a.score > b.score : a.doc < b.doc;
+    };
+
+    /* the best MAX_RESULTS are kept in a heap with the worst of them on top. a doc that can't beat that
+       even at its best is skipped without reading its text */
+    results.reserve(MAX_RESULTS);
+
+    /* a term is worth 1000 only as a name prefix and 600 anywhere else in the name. in_name is false for
+       docs known to have a term outside their name, which then scores 200 at best */
+    const int32_t terms = static_cast<int32_t>(_terms.size());
+
+    auto bound = [&](const doc_bound &doc, bool in_name) {
+        int32_t prefixes = 0;
+        for (std::string_view term : _terms) prefixes += term[0] == doc.lead;
+
+        const int32_t best = 600 * terms + 400 * prefixes - doc.name_penalty;
+        return in_name ? best : best - (prefixes == terms ? 1000 : 600) + 200;
+    };
+
+    auto offer = [&](uint32_t id, bool in_name) {
+        if (results.size() == MAX_RESULTS && !better({ id, bound(_bounds[id], in_name) }, results.front())) return;
+
+        const search_doc &doc = _docs[id];
+        if (!doc.live) return;
+
+        /* with every term in the name the rest of the text can't add anything. the postings only say
+           they probably are, a hash collision falls back to the whole text */
+        int32_t value = in_name ? score(doc, true) : -1;
+        if (value < 0) value = score(doc, false);
+        if (value < 0) return;
+
+        const search_result result = { id, value };
+
+        if (results.size() < MAX_RESULTS) {
+            results.push_back(result);
+            std::push_heap(results.begin(), results.end(), better);
+        } else if (better(result, results.front())) {
+            std::pop_heap(results.begin(), results.end(), better);
+            results.back() = result;
+            std::push_heap(results.begin(), results.end(), better);
+        }
+    };
+
+    _buckets.clear();
+    for (std::string_view term : _terms) term_buckets(term, _buckets);
+    std::sort(_buckets.begin(), _buckets.end());
+    _buckets.erase(std::unique(_buckets.begin(), _buckets.end()), _buckets.end());
+
+    /* docs matching every term by name first. the unindexed delta could match anywhere */
+    _name_matches.clear();
+    if (_indexed_count > 0) intersect(_name_postings, _name_matches);
+
+    for (uint32_t id : _name_matches) offer(id, true);
+    for (uint32_t id = _indexed_count; id < _docs.size(); id++) offer(id, true);
+
+    /* then the rest, unless even a name prefix for all but one term can't make the results. for a query
+       the names already answer, that rules out the tags and folders without looking at them */
+    const int32_t rest_bound = 1000 * (terms - 1) + 200;
+
+    if (_indexed_count > 0 && !(results.size() == MAX_RESULTS && rest_bound < results.front().score)) {
+        _candidates.clear();
+        intersect(_postings, _candidates);
+
+        /* both are sorted by id */
+        auto scored = _name_matches.begin();
+        for (uint32_t id : _candidates) {
+            while (scored != _name_matches.end() && *scored < id) scored++;
+            if (scored != _name_matches.end() && *scored == id) continue;
+
+            offer(id, false);
+        }
+    }
+
+    std::sort_heap(results.begin(), results.end(), better);
+}
+
+void search_index::submit(std::string_view text) {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (!_running) {
+        query(text, _finished);
+        _finished_generation = _generation;
+        _finished_ready = true;
+        return;
+    }
+
+    _request.assign(text.data(), text.size());
+    _requested = true;
+    lock.unlock();
+
+    _wake.notify_one();
+}
+
+bool search_index::poll(std::vector<search_result> &results) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_finished_ready) return false;
+
+    _finished_ready = false;
+    if (_finished_generation != _generation) return false;
+
+    results.swap(_finished);
+    return true;
+}
+
+void search_index::worker_thread() {
+    std::vector<search_result> results;
+    std::string text;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (;;) {
+        _wake.wait(lock, [this] { return !_running || _requested; });
+        if (!_running) return;
+
+        text.swap(_request);
+        _requested = false;
+        lock.unlock();
+
+        uint32_t generation;
+        {
+            std::lock_guard<std::mutex> index_lock(_index_mutex);
+            query(text, results);
+            generation = _generation;
+        }
+
+        lock.lock();
+
+        /* a newer request supersedes these before anyone sees them */
+        if (_requested) continue;
+
+        _finished.swap(results);
+        _finished_generation = generation;
+        _finished_ready = true;
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "library_index.h"
+
+class library_db;
+
+/* one searchable path. text is the lowercased name, then tags, then the two parent directories,
+   separated by '\n'. the regions are scored differently */
+struct search_doc {
+    uint32_t path_offset;
+    uint32_t path_length;
+    uint32_t label_offset;
+
+    uint32_t text_offset;
+    uint16_t name_end;
+    uint16_t tags_end;
+    uint16_t text_length;
+
+    entry_kind kind;
+    bool live;
+};
+
+struct search_result {
+    uint32_t doc;
+    int32_t score;
+};
+
+/* trigram index over every path in the library database, for search-as-you-type.
+
+   postings live in flat csr layouts: trigrams hash into TRIGRAM_BUCKETS buckets, and
+   offsets[b] .. offsets[b + 1] is the sorted run of doc ids in ids for bucket b. word starts are also
+   indexed padded with \x01, so one and two letter terms still work as prefixes.
+
+   the name region gets postings of its own. a query ranks the docs matching every term by name first,
+   and only goes on to the docs matching elsewhere while those could still make the results
+
+   update() diffs the database against the indexed docs. removals just clear doc.live and new docs are
+   appended past the postings and scanned directly, until there are enough of them to rebuild.
+
+   the ui queries through submit() and poll(), which run query() on a worker so typing never waits on
+   it. update() holds the index lock against a query in progress */
+class search_index {
+    private:
+        static constexpr uint32_t TRIGRAM_BUCKETS = 1 << 16;
+        static constexpr size_t MAX_RESULTS = 200;
+
+        /* unindexed docs are scored on every query, so they are kept few */
+        static constexpr size_t MAX_DELTA = 2048;
+
+        /* what query() needs to bound a doc's score without reading its text: the first byte of the
+           name, which tells a name prefix from a match further in, and min(name_end, 200). kept apart
+           from _docs, so the check streams through two bytes a doc */
+        struct doc_bound {
+            char lead;
+            uint8_t name_penalty;
+        };
+
+        std::vector<search_doc> _docs;
+        std::vector<doc_bound> _bounds;
+        std::string _paths;
+        std::string _labels;
+        std::string _text;
+
+        struct postings {
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> ids;
+
+            uint32_t run_length(uint32_t bucket) const { return offsets[bucket + 1] - offsets[bucket]; }
+        };
+
+        /* docs below _indexed_count have postings, the rest are the unindexed delta */
+        uint32_t _indexed_count = 0;
+        uint32_t _dead_count = 0;
+        postings _name_postings;
+        postings _postings;
+
+        /* live docs ordered by path, mirrors the database order for diffing */
+        std::vector<uint32_t> _by_path;
+
+        std::vector<std::string_view> _terms;
+        std::vector<uint32_t> _buckets;
+        struct cursor {
+            const uint32_t *first;
+            const uint32_t *last;
+        };
+
+        std::vector<cursor> _cursors;
+        std::vector<uint32_t> _name_matches;
+        std::vector<uint32_t> _candidates;
+        std::string _query;
+
+        /* bumped by every update(), results from before it name docs that may have moved */
+        uint32_t _generation = 0;
+        std::mutex _index_mutex;
+
+        std::thread _worker;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        bool _running = false;
+
+        std::string _request;
+        bool _requested = false;
+        std::vector<search_result> _finished;
+        uint32_t _finished_generation = 0;
+        bool _finished_ready = false;
+
+        void worker_thread();
+
+        uint32_t add_doc(std::string_view path, std::string_view tags, entry_kind kind);
+        void rebuild();
+        void build_postings(postings &out, bool names_only) const;
+
+        std::string_view doc_text(uint32_t id) const { return std::string_view(_text.data() + _docs[id].text_offset, _docs[id].text_length); }
+
+        /* appends the buckets a term's postings must all be in */
+        void term_buckets(std::string_view term, std::vector<uint32_t> &out) const;
+        void intersect(const postings &table, std::vector<uint32_t> &out);
+        int32_t score(const search_doc &doc, bool name_only) const;
+
+    public:
+        bool init();
+        void cleanup();
+
+        void update(const library_db &db);
+        void clear();
+
+        /* space separated terms, all of which must match. results are best first. not for use alongside
+           submit(), which runs it on the worker */
+        void query(std::string_view text, std::vector<search_result> &results);
+
+        /* queues a query for the worker, replacing one that hasn't started. without init() it runs
+           straight away. poll() hands back the newest results still valid for the index */
+        void submit(std::string_view text);
+        bool poll(std::vector<search_result> &results);
+
+        const search_doc &doc(uint32_t id) const { return _docs[id]; }
+        std::string path(uint32_t id) const { return _paths.substr(_docs[id].path_offset, _docs[id].path_length); }
+        const char *label(uint32_t id) const { return _labels.data() + _docs[id].label_offset; }
+
+        size_t size() const { return _by_path.size(); }
+};
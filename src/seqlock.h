@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/* single-writer snapshot; readers never block the writer and retry if they raced a store */
+template <typename T>
+class seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "seqlock value must be trivially copyable");
+
+    private:
+        std::atomic<uint32_t> _sequence{0};
+        T _value{};
+
+    public:
+        void store(const T &value) {
+            const uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+
+            _sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            std::memcpy(&_value, &value, sizeof(T));
+
+            _sequence.store(sequence + 2, std::memory_order_release);
+        }
+
+        T load() const {
+            T value;
+            uint32_t before, after;
+
+            do {
+                before = _sequence.load(std::memory_order_acquire);
+                std::memcpy(&value, &_value, sizeof(T));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = _sequence.load(std::memory_order_relaxed);
+            } while (before != after || (before & 1));
+
+            return value;
+        }
+};
@@ -0,0 +1,223 @@
+#include "spectrum.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "sample_convert.h"
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+static constexpr float PI = 3.14159265358979f;
+
+static constexpr float MIN_FREQUENCY = 20.0f;
+static constexpr float MAX_FREQUENCY = 20000.0f;
+
+constexpr size_t spectrum_analyzer::FFT_SIZE;
+constexpr size_t spectrum_analyzer::HALF;
+
+static float normalize_db(float db, float floor_db) {
+    return std::clamp((db - floor_db) / -floor_db, 0.0f, 1.0f);
+}
+
+spectrum_analyzer::spectrum_analyzer() {
+    static_assert(HALF == 1024, "the radix-4 passes expect a power of four");
+
+    for (size_t i = 0; i < FFT_SIZE; i++) {
+        _window[i] = 0.5f - 0.5f * std::cos(2.0f * PI * i / FFT_SIZE);
+    }
+
+    /* base-4 digit reversal of the input order */
+    for (size_t i = 0; i < HALF; i++) {
+        size_t reversed = 0;
+        for (size_t n = i, digits = HALF; digits > 1; digits /= 4, n /= 4) reversed = reversed * 4 + (n & 3);
+        _reverse[i] = static_cast<uint16_t>(reversed);
+    }
+
+    /* per pass: w^j, w^2j and w^3j as separate real and imaginary runs */
+    float *twiddle = _twiddles;
+    for (size_t quarter = 1; quarter < HALF; quarter *= 4) {
+        const size_t length = quarter * 4;
+
+        for (int m = 1; m <= 3; m++) {
+            for (size_t j = 0; j < quarter; j++) {
+                const float angle = -2.0f * PI * m * j / length;
+                twiddle[j] = std::cos(angle);
+                twiddle[quarter + j] = std::sin(angle);
+            }
+            twiddle += 2 * quarter;
+        }
+    }
+
+    /* rotation that splits the packed complex result back into the real transform */
+    for (size_t k = 0; k < HALF; k++) {
+        const float angle = -2.0f * PI * k / FFT_SIZE;
+        _split_re[k] = std::cos(angle);
+        _split_im[k] = std::sin(angle);
+    }
+
+    std::fill(_band_first, _band_first + BAND_COUNT, 0);
+    std::fill(_band_last, _band_last + BAND_COUNT, 0);
+}
+
+void spectrum_analyzer::layout_bands(unsigned int sample_rate) {
+    _sample_rate = sample_rate;
+
+    const float top = std::min(MAX_FREQUENCY, sample_rate * 0.5f);
+    const float bin_hz = static_cast<float>(sample_rate) / FFT_SIZE;
+
+    for (int b = 0; b < BAND_COUNT; b++) {
+        const float low = MIN_FREQUENCY * std::pow(top / MIN_FREQUENCY, static_cast<float>(b) / BAND_COUNT);
+        const float high = MIN_FREQUENCY * std::pow(top / MIN_FREQUENCY, static_cast<float>(b + 1) / BAND_COUNT);
+
+        /* low bands are narrower than a bin, they share the nearest one */
+        const size_t first = std::min<size_t>(HALF - 1, std::max<size_t>(1, static_cast<size_t>(std::lround(low / bin_hz))));
+        const size_t last = std::min<size_t>(HALF, std::max<size_t>(first + 1, static_cast<size_t>(std::lround(high / bin_hz))));
+
+        _band_first[b] = static_cast<uint16_t>(first);
+        _band_last[b] = static_cast<uint16_t>(last);
+    }
+}
+
+/* one radix-4 butterfly column: x0..x3 are a quarter apart, w1..w3 the twiddles for this column */
+static inline void butterfly(float *re, float *im, size_t quarter, float w1r, float w1i, float w2r, float w2i, float w3r, float w3i) {
+    const float a0r = re[0], a0i = im[0];
+    const float a1r = re[quarter] * w1r - im[quarter] * w1i, a1i = re[quarter] * w1i + im[quarter] * w1r;
+    const float a2r = re[2 * quarter] * w2r - im[2 * quarter] * w2i, a2i = re[2 * quarter] * w2i + im[2 * quarter] * w2r;
+    const float a3r = re[3 * quarter] * w3r - im[3 * quarter] * w3i, a3i = re[3 * quarter] * w3i + im[3 * quarter] * w3r;
+
+    const float b0r = a0r + a2r, b0i = a0i + a2i;
+    const float b1r = a0r - a2r, b1i = a0i - a2i;
+    const float b2r = a1r + a3r, b2i = a1i + a3i;
+    const float b3r = a1r - a3r, b3i = a1i - a3i;
+
+    re[0] = b0r + b2r;                im[0] = b0i + b2i;
+    re[quarter] = b1r + b3i;          im[quarter] = b1i - b3r;
+    re[2 * quarter] = b0r - b2r;      im[2 * quarter] = b0i - b2i;
+    re[3 * quarter] = b1r - b3i;      im[3 * quarter] = b1i + b3r;
+}
+
+#ifdef __SSE2__
+
+static inline void complex_mul(__m128 ar, __m128 ai, __m128 wr, __m128 wi, __m128 &outr, __m128 &outi) {
+    outr = _mm_sub_ps(_mm_mul_ps(ar, wr), _mm_mul_ps(ai, wi));
+    outi = _mm_add_ps(_mm_mul_ps(ar, wi), _mm_mul_ps(ai, wr));
+}
+
+/* four butterfly columns at once, quarter is a multiple of 4 */
+static inline void butterfly4(float *re, float *im, size_t quarter, const float *twiddle, size_t j) {
+    float *r0 = re, *r1 = re + quarter, *r2 = re + 2 * quarter, *r3 = re + 3 * quarter;
+    float *i0 = im, *i1 = im + quarter, *i2 = im + 2 * quarter, *i3 = im + 3 * quarter;
+
+    __m128 a1r, a1i, a2r, a2i, a3r, a3i;
+    complex_mul(_mm_loadu_ps(r1), _mm_loadu_ps(i1), _mm_loadu_ps(twiddle + j), _mm_loadu_ps(twiddle + quarter + j), a1r, a1i);
+    complex_mul(_mm_loadu_ps(r2), _mm_loadu_ps(i2), _mm_loadu_ps(twiddle + 2 * quarter + j), _mm_loadu_ps(twiddle + 3 * quarter + j), a2r, a2i);
+    complex_mul(_mm_loadu_ps(r3), _mm_loadu_ps(i3), _mm_loadu_ps(twiddle + 4 * quarter + j), _mm_loadu_ps(twiddle + 5 * quarter + j), a3r, a3i);
+
+    const __m128 a0r = _mm_loadu_ps(r0), a0i = _mm_loadu_ps(i0);
+
+    const __m128 b0r = _mm_add_ps(a0r, a2r), b0i = _mm_add_ps(a0i, a2i);
+    const __m128 b1r = _mm_sub_ps(a0r, a2r), b1i = _mm_sub_ps(a0i, a2i);
+    const __m128 b2r = _mm_add_ps(a1r, a3r), b2i = _mm_add_ps(a1i, a3i);
+    const __m128 b3r = _mm_sub_ps(a1r, a3r), b3i = _mm_sub_ps(a1i, a3i);
+
+    _mm_storeu_ps(r0, _mm_add_ps(b0r, b2r)); _mm_storeu_ps(i0, _mm_add_ps(b0i, b2i));
+    _mm_storeu_ps(r1, _mm_add_ps(b1r, b3i)); _mm_storeu_ps(i1, _mm_sub_ps(b1i, b3r));
+    _mm_storeu_ps(r2, _mm_sub_ps(b0r, b2r)); _mm_storeu_ps(i2, _mm_sub_ps(b0i, b2i));
+    _mm_storeu_ps(r3, _mm_sub_ps(b1r, b3i)); _mm_storeu_ps(i3, _mm_add_ps(b1i, b3r));
+}
+
+#endif
+
+void spectrum_analyzer::transform() {
+    const float *twiddle = _twiddles;
+
+    for (size_t quarter = 1; quarter < HALF; quarter *= 4) {
+        const size_t length = quarter * 4;
+
+        for (size_t k = 0; k < HALF; k += length) {
+            size_t j = 0;
+
+#ifdef __SSE2__
+            for (; j + 4 <= quarter; j += 4) butterfly4(_re + k + j, _im + k + j, quarter, twiddle, j);
+#endif
+
+            for (; j < quarter; j++) {
+                butterfly(_re + k + j, _im + k + j, quarter,
+                          twiddle[j], twiddle[quarter + j],
+                          twiddle[2 * quarter + j], twiddle[3 * quarter + j],
+                          twiddle[4 * quarter + j], twiddle[5 * quarter + j]);
+            }
+        }
+
+        twiddle += 6 * quarter;
+    }
+}
+
+void spectrum_analyzer::analyze(const float *samples, unsigned int sample_rate, float dt) {
+    if (sample_rate == 0) {
+        decay(dt);
+        return;
+    }
+
+    if (sample_rate != _sample_rate) layout_bands(sample_rate);
+
+    /* even samples become the real part and odd ones the imaginary part, loaded in digit-reversed order */
+    for (size_t n = 0; n < HALF; n++) {
+        _re[_reverse[n]] = samples[2 * n] * _window[2 * n];
+        _im[_reverse[n]] = samples[2 * n + 1] * _window[2 * n + 1];
+    }
+
+    transform();
+
+    /* hann has a coherent gain of 0.5, so a full scale sine peaks at FFT_SIZE / 4 */
+    const float scale = 4.0f / FFT_SIZE;
+
+    _power[0] = (_re[0] + _im[0]) * (_re[0] + _im[0]) * scale * scale;
+
+    for (size_t k = 1; k < HALF; k++) {
+        const float zr = _re[k], zi = _im[k];
+        const float cr = _re[HALF - k], ci = -_im[HALF - k];
+
+        const float even_r = 0.5f * (zr + cr), even_i = 0.5f * (zi + ci);
+        const float odd_r = 0.5f * (zi - ci), odd_i = -0.5f * (zr - cr);
+
+        const float xr = even_r + _split_re[k] * odd_r - _split_im[k] * odd_i;
+        const float xi = even_i + _split_re[k] * odd_i + _split_im[k] * odd_r;
+
+        _power[k] = (xr * xr + xi * xi) * scale * scale;
+    }
+
+    const float release = std::exp(-dt / RELEASE_SECONDS);
+
+    for (int b = 0; b < BAND_COUNT; b++) {
+        float power = 0.0f;
+        for (size_t k = _band_first[b]; k < _band_last[b]; k++) power = std::max(power, _power[k]);
+
+        const float level = normalize_db(10.0f * std::log10(power + 1e-12f), FLOOR_DB);
+        _bands[b] = std::max(level, _bands[b] * release);
+    }
+
+    sample_stats stats;
+    accumulate_stats(samples, FFT_SIZE, stats);
+
+    const float peak = std::max(-stats.min, stats.max);
+    const float rms = static_cast<float>(std::sqrt(stats.sum_squares / FFT_SIZE));
+
+    _peak = std::max(normalize_db(20.0f * std::log10(peak + 1e-6f), FLOOR_DB), _peak * release);
+    _rms = std::max(normalize_db(20.0f * std::log10(rms + 1e-6f), FLOOR_DB), _rms * release);
+}
+
+void spectrum_analyzer::decay(float dt) {
+    const float release = std::exp(-dt / RELEASE_SECONDS);
+
+    for (float &band : _bands) band *= release;
+    _peak *= release;
+    _rms *= release;
+}
+
+bool spectrum_analyzer::settled() const {
+    if (_peak > 0.01f || _rms > 0.01f) return false;
+    return std::all_of(_bands, _bands + BAND_COUNT, [](float band) { return band <= 0.01f; });
+}
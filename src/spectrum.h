@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* log-frequency spectrum and level meter over the most recent FFT_SIZE mono samples.
+   a real fft of FFT_SIZE points runs as a radix-4 complex fft of half the size, with the window,
+   digit reversal and twiddles precomputed. everything lives in fixed arrays, analyze() never allocates */
+class spectrum_analyzer {
+    public:
+        static constexpr size_t FFT_SIZE = 2048;
+        static constexpr int BAND_COUNT = 48;
+
+    private:
+        static constexpr size_t HALF = FFT_SIZE / 2;
+        static constexpr float FLOOR_DB = -72.0f;
+        static constexpr float RELEASE_SECONDS = 0.25f;
+
+        float _window[FFT_SIZE];
+        uint16_t _reverse[HALF];
+        float _twiddles[6 * HALF];
+        float _split_re[HALF];
+        float _split_im[HALF];
+
+        alignas(16) float _re[HALF];
+        alignas(16) float _im[HALF];
+        float _power[HALF];
+
+        unsigned int _sample_rate = 0;
+        uint16_t _band_first[BAND_COUNT];
+        uint16_t _band_last[BAND_COUNT];
+
+        float _bands[BAND_COUNT] = {};
+        float _peak = 0.0f;
+        float _rms = 0.0f;
+
+        void layout_bands(unsigned int sample_rate);
+        void transform();
+
+    public:
+        spectrum_analyzer();
+
+        /* samples must hold FFT_SIZE mono samples, dt is the time since the last update */
+        void analyze(const float *samples, unsigned int sample_rate, float dt);
+
+        /* lets the display fall back to silence while nothing is playing */
+        void decay(float dt);
+
+        /* all levels are normalized to 0..1 over FLOOR_DB..0 dBFS */
+        const float *bands() const { return _bands; }
+        float peak() const { return _peak; }
+        float rms() const { return _rms; }
+
+        /* power of each of the FFT_SIZE / 2 bins from the last analyze(), a full scale sine peaks at 1 */
+        const float *power() const { return _power; }
+
+        /* true once everything has decayed to nothing, so the ui can stop redrawing for it */
+        bool settled() const;
+};
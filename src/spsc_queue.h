@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/* bounded wait-free queue for exactly one producer thread and one consumer thread */
+template <typename T, size_t Capacity>
+class spsc_queue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "spsc_queue capacity must be a power of two");
+
+    private:
+        T _items[Capacity];
+
+        alignas(64) std::atomic<size_t> _head{0};
+        alignas(64) std::atomic<size_t> _tail{0};
+
+    public:
+        bool push(T item) {
+            const size_t head = _head.load(std::memory_order_relaxed);
+            if (head - _tail.load(std::memory_order_acquire) == Capacity) return false;
+
+            _items[head & (Capacity - 1)] = std::move(item);
+            _head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T &out) {
+            const size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail == _head.load(std::memory_order_acquire)) return false;
+
+            out = std::move(_items[tail & (Capacity - 1)]);
+            _tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const {
+            return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+        }
+};
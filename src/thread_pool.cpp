@@ -0,0 +1,124 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#ifdef __linux__
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+/* which queue the calling thread owns, so tasks spawned by a worker stay local to it */
+static thread_local size_t current_worker = SIZE_MAX;
+
+bool thread_pool::init(size_t threads, bool background) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    _running = true;
+
+    for (size_t i = 0; i < threads; i++) _queues.push_back(std::make_unique<worker_queue>());
+    for (size_t i = 0; i < threads; i++) _threads.emplace_back(&thread_pool::worker, this, i, background);
+
+    return true;
+}
+
+void thread_pool::cleanup() {
+    {
+        std::lock_guard<std::mutex> lock(_sleep_mutex);
+        _running = false;
+    }
+
+    _wake.notify_all();
+    for (std::thread &thread : _threads) thread.join();
+
+    _threads.clear();
+    _queues.clear();
+
+    _queued = 0;
+    _active = 0;
+    _drained.notify_all();
+}
+
+void thread_pool::submit(task work) {
+    if (_queues.empty()) return;
+
+    const size_t index = (current_worker < _queues.size()) ? current_worker : _next++ % _queues.size();
+
+    /* counted under the deque's lock, so _queued never claims a task take() can't find yet */
+    {
+        std::lock_guard<std::mutex> lock(_queues[index]->mutex);
+        _queues[index]->tasks.push_back(std::move(work));
+        _queued++;
+    }
+
+    /* a worker checks _queued and goes to sleep under the sleep mutex, passing through it here means
+       it is either already waiting for this notify or will see the task before it waits */
+    { std::lock_guard<std::mutex> lock(_sleep_mutex); }
+    _wake.notify_one();
+}
+
+bool thread_pool::take(size_t index, task &out) {
+    {
+        worker_queue &own = *_queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty()) {
+            out = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            _active++;
+            _queued--;
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < _queues.size(); offset++) {
+        worker_queue &victim = *_queues[(index + offset) % _queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tasks.empty()) {
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            _active++;
+            _queued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void thread_pool::worker(size_t index, bool background) {
+    current_worker = index;
+
+#ifdef __linux__
+    /* per-thread on linux, keeps batch work out of the way of the ui and audio threads */
+    if (background) setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 10);
+#else
+    (void)background;
+#endif
+
+    task work;
+
+    while (_running) {
+        if (take(index, work)) {
+            work();
+            work = nullptr;
+
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _active--;
+            if (_queued == 0 && _active == 0) _drained.notify_all();
+            continue;
+        }
+
+        /* _queued only counts tasks still sitting in a deque, so a worker sleeps once they are all
+           taken. if a scan missed one that was pushed behind it, _queued is still up and it scans again */
+        std::unique_lock<std::mutex> lock(_sleep_mutex);
+        _wake.wait(lock, [this] { return !_running || _queued > 0; });
+    }
+}
+
+void thread_pool::wait() {
+    std::unique_lock<std::mutex> lock(_sleep_mutex);
+    _drained.wait(lock, [this] { return !_running || (_queued == 0 && _active == 0); });
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* fixed set of workers, each with its own task deque. a worker takes its newest task first and
+   steals the oldest task from another worker when its own deque runs dry, so long batches spread
+   over every core without one shared queue being fought over */
+class thread_pool {
+    private:
+        using task = std::function<void()>;
+
+        struct worker_queue {
+            std::mutex mutex;
+            std::deque<task> tasks;
+        };
+
+        std::vector<std::unique_ptr<worker_queue>> _queues;
+        std::vector<std::thread> _threads;
+
+        std::mutex _sleep_mutex;
+        std::condition_variable _wake;
+        std::condition_variable _drained;
+
+        std::atomic<size_t> _queued{0};
+        std::atomic<size_t> _active{0};
+        std::atomic<size_t> _next{0};
+        std::atomic<bool> _running{false};
+
+        bool take(size_t index, task &out);
+        void worker(size_t index, bool background);
+
+    public:
+        /* threads == 0 uses one per core. background workers run at a lower scheduling priority */
+        bool init(size_t threads = 0, bool background = true);
+
+        /* drops whatever is still queued and joins the workers */
+        void cleanup();
+
+        void submit(task work);
+
+        /* blocks until every submitted task has finished */
+        void wait();
+
+        size_t pending() const { return _queued + _active; }
+        size_t size() const { return _threads.size(); }
+};
@@ -0,0 +1,280 @@
+#include "track_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+void track_stream::set_cache(pcm_cache *cache, bool fill) {
+    _cache = (cache && cache->enabled()) ? cache : nullptr;
+    _cache_fill = fill;
+}
+
+bool track_stream::open(const std::string &path) {
+    close();
+
+    codec format;
+    if (!codec_for_name(path.data(), path.size(), format)) return false;
+
+    _path = path;
+    _output = sample_format::s16;
+
+    /* a fully cached track opens without touching the file. one that is only partly cached gets
+       its decoder now, so reading past the cached head does not open the file mid-playback */
+    if (_cache && (_entry = _cache->find(path)) != nullptr) {
+        _channels = _entry->channels;
+        _sample_rate = _entry->sample_rate;
+        _bits_per_sample = _entry->bits_per_sample;
+        _source = _entry->source;
+        _frame_count = _entry->complete ? _entry->filled.load() : _entry->frame_count;
+
+        if (!_entry->complete && ensure_decoder() && _cache_fill) _writing = _cache->claim(*_entry, this);
+
+        _open = true;
+        return true;
+    }
+
+    if (!open_decoder(format)) {
+        _path.clear();
+        return false;
+    }
+
+    _channels = _decoder->channels();
+    _sample_rate = _decoder->sample_rate();
+    _bits_per_sample = _decoder->bits_per_sample();
+    _source = _decoder->source();
+    _frame_count = _decoder->frame_count();
+
+    if (_cache && _cache_fill) {
+        _entry = _cache->insert(path, _channels, _sample_rate, _bits_per_sample, _source, _frame_count);
+        _writing = _entry && _cache->claim(*_entry, this);
+    }
+
+    _open = true;
+    return true;
+}
+
+bool track_stream::open_decoder(codec format) {
+    std::unique_ptr<decoder> opened = make_decoder(format);
+    const bool mapped = _map.open(_path);
+
+    if (!opened || !opened->open(_path, mapped ? _map.data() : nullptr, mapped ? _map.size() : 0)) {
+        _map.close();
+        return false;
+    }
+
+    if (mapped) _map.advise_sequential();
+
+    _decoder = std::move(opened);
+    _data = _decoder->pcm();
+    _decoder_cursor = 0;
+    return true;
+}
+
+/* opens the decoder behind a cache hit that does not hold the whole track */
+bool track_stream::ensure_decoder() {
+    if (_decoder) return true;
+
+    codec format;
+    if (!codec_for_name(_path.data(), _path.size(), format) || !open_decoder(format)) return false;
+
+    if (_decoder->channels() != _channels || _decoder->sample_rate() != _sample_rate || _decoder->source() != _source) {
+        _decoder.reset();
+        _map.close();
+        _data = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void track_stream::close() {
+    if (_entry) _cache->release(_entry, this);
+    _entry = nullptr;
+    _writing = false;
+
+    _decoder.reset();
+    _map.close();
+
+    _open = false;
+    _path.clear();
+
+    _data = nullptr;
+    _released = 0;
+
+    _channels = 0;
+    _sample_rate = 0;
+    _bits_per_sample = 0;
+
+    _frame_count = 0;
+    _cursor = 0;
+    _decoder_cursor = 0;
+    _finished = false;
+
+    _preroll_frames = 0;
+    _preroll_read = 0;
+}
+
+void track_stream::set_output(sample_format output, bool dither) {
+    _output = (output == sample_format::f32) ? sample_format::f32 : sample_format::s16;
+    _dither = dither;
+}
+
+void track_stream::reserve(drwav_uint64 frames) {
+    if (!_open || _data || _source == _output) return;
+
+    const size_t raw_bytes = frames * source_frame_bytes();
+    if (_raw.size() < raw_bytes) _raw.resize(raw_bytes);
+}
+
+void track_stream::preroll(size_t budget_bytes) {
+    if (!_open || _preroll_read < _preroll_frames) return;
+
+    /* nothing to decode, just get the file paged in from the cursor */
+    if (_data) {
+        _map.advise_willneed((_data - _map.data()) + _cursor * source_frame_bytes(), budget_bytes);
+        return;
+    }
+
+    /* already decoded, by this stream or an earlier one */
+    if (_entry && _entry->filled > _cursor) return;
+
+    const drwav_uint64 frames = budget_bytes / frame_bytes();
+    if (_preroll.size() < frames * frame_bytes()) _preroll.resize(frames * frame_bytes());
+
+    _preroll_frames = decode(_cursor, frames, _preroll.data());
+    _preroll_read = 0;
+}
+
+void track_stream::convert(const uint8_t *in, size_t samples, void *out) {
+    if (_output == sample_format::f32) {
+        convert_to_f32(in, _source, static_cast<float *>(out), samples);
+    } else {
+        convert_to_s16(in, _source, static_cast<int16_t *>(out), samples, _dither ? &_dither_state : nullptr);
+    }
+}
+
+/* reads through the decoder from frame on, for compressed formats and files that could not be
+   mapped. what it decodes goes into the cache as it is, and is converted here unless it already
+   is in the output format */
+drwav_uint64 track_stream::decode(drwav_uint64 frame, drwav_uint64 frames, uint8_t *out) {
+    if (!ensure_decoder()) return 0;
+
+    if (_decoder_cursor != frame) {
+        if (!_decoder->seek(frame)) return 0;
+        _decoder_cursor = frame;
+    }
+
+    uint8_t *raw = out;
+    if (_source != _output) {
+        const size_t raw_bytes = frames * source_frame_bytes();
+        if (_raw.size() < raw_bytes) _raw.resize(raw_bytes);
+        raw = _raw.data();
+    }
+
+    const drwav_uint64 count = _decoder->read(frames, raw);
+    _decoder_cursor += count;
+
+    if (_writing) _writing = _cache->append(*_entry, this, frame, raw, count, count < frames);
+    if (raw != out) convert(raw, count * _channels, out);
+
+    return count;
+}
+
+drwav_uint64 track_stream::read(drwav_uint64 frames, void *scratch, const void **samples) {
+    *samples = scratch;
+    if (!_open) return 0;
+
+    /* frames already in the cache come straight out of its pool, up to a chunk at a time */
+    if (_entry && _preroll_read == _preroll_frames) {
+        uint64_t count = frames;
+        const uint8_t *in = _cache->frames(*_entry, _cursor, count);
+
+        if (in) {
+            if (_source == _output) {
+                *samples = in;
+            } else {
+                convert(in, count * _channels, scratch);
+            }
+
+            _cursor += count;
+            if (_entry->complete && _cursor == _entry->filled) _finished = true;
+
+            return count;
+        }
+
+        if (_entry->complete && _cursor >= _entry->filled) {
+            _finished = true;
+            return 0;
+        }
+    }
+
+    if (_data) {
+        const drwav_uint64 count = std::min(frames, _frame_count - _cursor);
+        const uint8_t *in = _data + _cursor * source_frame_bytes();
+
+        release_behind(_cursor);
+
+        if (_source == _output) {
+            *samples = in;
+        } else {
+            convert(in, count * _channels, scratch);
+        }
+
+        if (_writing) _writing = _cache->append(*_entry, this, _cursor, in, count, count < frames);
+
+        _cursor += count;
+        if (count < frames) _finished = true;
+
+        return count;
+    }
+
+    uint8_t *out = static_cast<uint8_t *>(scratch);
+    drwav_uint64 total = 0;
+
+    if (_preroll_read < _preroll_frames) {
+        const drwav_uint64 count = std::min(frames, _preroll_frames - _preroll_read);
+        std::memcpy(out, _preroll.data() + _preroll_read * frame_bytes(), count * frame_bytes());
+
+        _preroll_read += count;
+        total += count;
+    }
+
+    if (total < frames) {
+        total += decode(_cursor + total, frames - total, out + total * frame_bytes());
+    }
+
+    _cursor += total;
+    if (total < frames) _finished = true;
+
+    return total;
+}
+
+/* pages behind the read cursor have already been uploaded, drop them so a long track
+   does not stay resident */
+void track_stream::release_behind(drwav_uint64 frame) {
+    const size_t consumed = static_cast<size_t>(frame) * source_frame_bytes();
+    if (consumed < _released + RELEASE_STRIDE) return;
+
+    _map.advise_dontneed((_data - _map.data()) + _released, consumed - _released);
+    _released = consumed;
+}
+
+bool track_stream::seek(drwav_uint64 frame) {
+    if (!_open) return false;
+
+    frame = std::min(frame, _frame_count);
+
+    if (_data) {
+        _released = static_cast<size_t>(frame) * source_frame_bytes();
+    } else if (!_entry || frame >= _entry->filled) {
+        /* past what is cached, the decoder has to get there */
+        if (!ensure_decoder() || !_decoder->seek(frame)) return false;
+        _decoder_cursor = frame;
+    }
+
+    _preroll_frames = 0;
+    _preroll_read = 0;
+
+    _cursor = frame;
+    _finished = false;
+    return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../vendor/dr_wav.h"
+
+#include "decoder.h"
+#include "mapped_file.h"
+#include "pcm_cache.h"
+#include "sample_convert.h"
+
+/* one open track, decoded to s16 or f32 on demand. the head of the track can be decoded ahead
+   of time into a preroll buffer so switching to it costs no file access at all.
+
+   files are memory-mapped and opened with the decoder for their extension. pcm s16/s24/s32 and
+   f32 wav data is converted straight out of the mapping with the simd kernels in sample_convert,
+   and when it is already in the output format reads hand out pointers into the mapping instead.
+   other wav encodings are decoded from the mapping to f32, flac to s16 or s32 and mp3 to f32 by
+   flac_decoder and mp3_decoder, and converted the same way.
+
+   with a pcm_cache set, tracks are read from and written to it, so a track opened again
+   while it is still cached starts without opening the file at all. open() and close() do all of
+   the cache's locking and any file access, read() only touches the cache lock-free */
+class track_stream {
+    private:
+        static constexpr size_t RELEASE_STRIDE = 4 * 1024 * 1024;
+
+        std::unique_ptr<decoder> _decoder;
+        bool _open = false;
+        std::string _path;
+
+        mapped_file _map;
+        const uint8_t *_data = nullptr;
+        size_t _released = 0;
+
+        pcm_cache *_cache = nullptr;
+        bool _cache_fill = false;
+        pcm_entry *_entry = nullptr;
+        bool _writing = false;
+
+        unsigned int _channels = 0;
+        unsigned int _sample_rate = 0;
+        unsigned int _bits_per_sample = 0;
+        sample_format _source = sample_format::s16;
+        sample_format _output = sample_format::s16;
+
+        bool _dither = false;
+        dither_state _dither_state;
+
+        drwav_uint64 _frame_count = 0;
+        drwav_uint64 _cursor = 0;
+        bool _finished = false;
+
+        /* the frame the decoder reads next, behind or ahead of _cursor after cached reads */
+        drwav_uint64 _decoder_cursor = 0;
+
+        std::vector<uint8_t> _raw;
+
+        std::vector<uint8_t> _preroll;
+        drwav_uint64 _preroll_frames = 0;
+        drwav_uint64 _preroll_read = 0;
+
+        size_t source_frame_bytes() const { return sample_size(_source) * _channels; }
+
+        bool open_decoder(codec format);
+        bool ensure_decoder();
+
+        void release_behind(drwav_uint64 frame);
+        void convert(const uint8_t *in, size_t samples, void *out);
+        drwav_uint64 decode(drwav_uint64 frame, drwav_uint64 frames, uint8_t *out);
+
+    public:
+        track_stream() = default;
+        ~track_stream() { close(); }
+
+        track_stream(const track_stream &) = delete;
+        track_stream &operator=(const track_stream &) = delete;
+
+        /* set before open(). fill false only reads what other streams have cached, for one-off
+           passes over many tracks that would otherwise push out the ones being played */
+        void set_cache(pcm_cache *cache, bool fill);
+
+        bool open(const std::string &path);
+        void close();
+
+        /* output is s16 or f32, set it before preroll() or the first read. dither only
+           applies when requantizing higher resolution sources down to s16 */
+        void set_output(sample_format output, bool dither);
+
+        /* sizes the decode buffer for reads of up to frames, so that reading never allocates. call it
+           after set_output() and off the audio thread */
+        void reserve(drwav_uint64 frames);
+
+        /* decodes up to budget_bytes from the cursor on, the buffer is reused across tracks */
+        void preroll(size_t budget_bytes);
+
+        /* points samples at up to frames frames, inside the mapped file, the cache or scratch,
+           which must hold frames * frame_bytes(). valid until the next read or seek */
+        drwav_uint64 read(drwav_uint64 frames, void *scratch, const void **samples);
+        bool seek(drwav_uint64 frame);
+
+        bool is_open() const { return _open; }
+        bool cached() const { return _entry != nullptr && _decoder == nullptr; }
+        bool finished() const { return _finished; }
+
+        const std::string &path() const { return _path; }
+        drwav_uint64 cursor() const { return _cursor; }
+
+        bool zero_copy() const { return _data != nullptr && _source == _output; }
+        bool high_resolution() const { return _bits_per_sample > 16; }
+
+        sample_format output_format() const { return _output; }
+        size_t frame_bytes() const { return sample_size(_output) * _channels; }
+
+        unsigned int channels() const { return _channels; }
+        unsigned int sample_rate() const { return _sample_rate; }
+        drwav_uint64 frame_count() const { return _frame_count; }
+        float duration() const { return _open ? static_cast<float>(_frame_count) / _sample_rate : 0.0f; }
+};
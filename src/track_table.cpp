@@ -0,0 +1,105 @@
+#include "track_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint64_t DIRECTORY_GROUP = 0;
+static constexpr uint64_t TRACK_GROUP = uint64_t(1) << 63;
+
+static unsigned char fold(char c) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'A' && u <= 'Z') ? u + ('a' - 'A') : u;
+}
+
+/* case-insensitive, with the raw bytes deciding between names that only differ in case */
+static bool name_less(const char *a, const char *b, size_t skip = 0) {
+    const char *x = a + skip, *y = b + skip;
+
+    for (; *x && *y; x++, y++) {
+        if (fold(*x) != fold(*y)) return fold(*x) < fold(*y);
+    }
+
+    if (*x || *y) return *y != '\0';
+    return std::strcmp(a, b) < 0;
+}
+
+/* the first eight folded bytes, big endian, so most name comparisons are one integer compare */
+static uint64_t name_prefix(const char *name) {
+    uint64_t prefix = 0;
+    int i = 0;
+
+    for (; i < 8 && name[i]; i++) prefix = (prefix << 8) | fold(name[i]);
+    return prefix << (8 * (8 - i));
+}
+
+static uint64_t column_key(const library_entry &entry, track_column column) {
+    const track_info &info = entry.info;
+
+    switch (column) {
+        case track_column::duration:
+            return info.sample_rate ? info.frame_count * 1000 / info.sample_rate : 0;
+        case track_column::sample_rate:
+            return info.sample_rate;
+        case track_column::size:
+            return info.size;
+        default:
+            return 0;
+    }
+}
+
+void track_table::rank_names(const library_directory &dir) {
+    const uint32_t count = static_cast<uint32_t>(dir.entries.size());
+    _keys.resize(count);
+
+    for (uint32_t row = 0; row < count; row++) _keys[row] = { name_prefix(dir.label(dir.entries[row])), 0, row };
+
+    std::sort(_keys.begin(), _keys.end(), [&](const sort_key &a, const sort_key &b) {
+        if (a.primary != b.primary) return a.primary < b.primary;
+
+        /* equal prefixes with a non-zero last byte mean both names share their first eight bytes */
+        return name_less(dir.label(dir.entries[a.row]), dir.label(dir.entries[b.row]), (a.primary & 0xff) ? 8 : 0);
+    });
+
+    _name_rank.resize(count);
+    for (uint32_t rank = 0; rank < count; rank++) _name_rank[_keys[rank].row] = rank;
+}
+
+void track_table::sort(const library_directory &dir) {
+    const uint32_t count = static_cast<uint32_t>(dir.entries.size());
+    _keys.resize(count);
+
+    for (uint32_t row = 0; row < count; row++) {
+        const library_entry &entry = dir.entries[row];
+
+        /* descending flips the value bits and leaves the group bit alone, so folders stay on top */
+        uint64_t value = std::min(column_key(entry, _column), TRACK_GROUP - 1);
+        if (!_ascending) value = (TRACK_GROUP - 1) - value;
+
+        const uint64_t group = (entry.kind == entry_kind::directory) ? DIRECTORY_GROUP : TRACK_GROUP;
+        const uint32_t rank = _ascending || _column != track_column::name ? _name_rank[row] : count - 1 - _name_rank[row];
+
+        _keys[row] = { group | value, rank, row };
+    }
+
+    std::sort(_keys.begin(), _keys.end(), [](const sort_key &a, const sort_key &b) {
+        return a.primary != b.primary ? a.primary < b.primary : a.name_rank < b.name_rank;
+    });
+
+    _order.resize(count);
+    for (uint32_t i = 0; i < count; i++) _order[i] = _keys[i].row;
+}
+
+void track_table::update(const library_directory &dir, track_column column, bool ascending) {
+    const bool listing_changed = dir.generation != _generation || _order.size() != dir.entries.size();
+    if (!listing_changed && column == _column && ascending == _ascending) return;
+
+    _column = column;
+    _ascending = ascending;
+
+    if (listing_changed) {
+        rank_names(dir);
+        _generation = dir.generation;
+    }
+
+    sort(dir);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "library_index.h"
+
+enum class track_column : uint8_t { name, duration, sample_rate, size };
+
+/* display order for a directory listing. keys are computed once per listing, re-sorting is one
+   std::sort over a flat array of fixed-size keys and never allocates per row. directories always
+   come first, ties fall back to the name order */
+class track_table {
+    private:
+        struct sort_key {
+            uint64_t primary;
+            uint32_t name_rank;
+            uint32_t row;
+        };
+
+        uint32_t _generation = UINT32_MAX;
+        track_column _column = track_column::name;
+        bool _ascending = true;
+
+        std::vector<uint32_t> _name_rank;
+        std::vector<sort_key> _keys;
+        std::vector<uint32_t> _order;
+
+        void rank_names(const library_directory &dir);
+        void sort(const library_directory &dir);
+
+    public:
+        /* re-sorts only when the listing or the sort changed */
+        void update(const library_directory &dir, track_column column, bool ascending);
+
+        /* entry indices in display order */
+        const std::vector<uint32_t> &order() const { return _order; }
+};
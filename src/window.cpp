@@ -21,6 +21,8 @@ void window::create(const char *title, int width, int height)
     int _framebuffer_width = 0, _framebuffer_height = 0;
     glfwGetFramebufferSize(_window, &_framebuffer_width, &_framebuffer_height);
     glViewport(0, 0, _framebuffer_width, _framebuffer_height);
+
+    install_activity_callbacks();
 }
 
 void window::cleanup() {
@@ -36,6 +38,37 @@ void window::poll_events() {
     glfwPollEvents();
 }
 
+void window::wait_events(double timeout) {
+    if (_active_frames > 0) {
+        _active_frames--;
+        glfwPollEvents();
+        return;
+    }
+
+    glfwWaitEventsTimeout(timeout);
+}
+
+void window::mark_active(GLFWwindow *window) {
+    if (auto *self = static_cast<class window *>(glfwGetWindowUserPointer(window))) {
+        self->_active_frames = ACTIVE_FRAMES;
+    }
+}
+
+/* installed before the imgui backend, which chains to these from its own callbacks */
+void window::install_activity_callbacks() {
+    glfwSetWindowUserPointer(_window, this);
+
+    glfwSetCursorPosCallback(_window, [](GLFWwindow *w, double, double) { mark_active(w); });
+    glfwSetMouseButtonCallback(_window, [](GLFWwindow *w, int, int, int) { mark_active(w); });
+    glfwSetScrollCallback(_window, [](GLFWwindow *w, double, double) { mark_active(w); });
+    glfwSetKeyCallback(_window, [](GLFWwindow *w, int, int, int, int) { mark_active(w); });
+    glfwSetCharCallback(_window, [](GLFWwindow *w, unsigned int) { mark_active(w); });
+    glfwSetWindowFocusCallback(_window, [](GLFWwindow *w, int) { mark_active(w); });
+    glfwSetCursorEnterCallback(_window, [](GLFWwindow *w, int) { mark_active(w); });
+    glfwSetFramebufferSizeCallback(_window, [](GLFWwindow *w, int, int) { mark_active(w); });
+    glfwSetWindowRefreshCallback(_window, [](GLFWwindow *w) { mark_active(w); });
+}
+
 bool window::should_close() const {
     return _window ? glfwWindowShouldClose(_window) : true;
 }
@@ -7,7 +7,13 @@
 
 class window {
     private:
+        static constexpr int ACTIVE_FRAMES = 4;
+
         GLFWwindow *_window = nullptr;
+        int _active_frames = ACTIVE_FRAMES;
+
+        void install_activity_callbacks();
+        static void mark_active(GLFWwindow *window);
 
     public:
         void create(const char *title, int width, int height);
@@ -16,6 +22,10 @@ class window {
         void swap_buffers();
         void poll_events();
 
+        /* idle mode: blocks until input arrives or timeout seconds pass. after any input it keeps
+           redrawing for a few frames so imgui can settle hover and click state */
+        void wait_events(double timeout);
+
         bool should_close() const;
 
         GLFWwindow *get_window() const { return _window; }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../vendor/dr_wav.h"
+
+/* each test is its own executable run by ctest. a failed check is reported and counted, the test
+   carries on and fails at the end through test_result() */
+inline int test_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+    do { \
+        const double check_value = (value), check_expected = (expected); \
+        if (!(std::fabs(check_value - check_expected) <= (tolerance))) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s is %g, expected %g +- %g\n", __FILE__, __LINE__, #value, check_value, check_expected, static_cast<double>(tolerance)); \
+            test_failures++; \
+        } \
+    } while (0)
+
+inline int test_result() {
+    if (test_failures > 0) std::fprintf(stderr, "%d checks failed\n", test_failures);
+    return test_failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* an empty directory under the system temp dir, removed by the caller */
+inline std::string make_temp_dir(const char *name) {
+    std::string path = (std::filesystem::temp_directory_path() / (std::string(name) + ".XXXXXX")).string();
+    return mkdtemp(&path[0]) ? path : std::string();
+}
+
+inline size_t write_to_file(void *user, const void *data, size_t bytes) {
+    return std::fwrite(data, 1, bytes, static_cast<FILE *>(user));
+}
+
+inline drwav_bool32 seek_in_file(void *user, int offset, drwav_seek_origin origin) {
+    const int whence = (origin == DRWAV_SEEK_SET) ? SEEK_SET : (origin == DRWAV_SEEK_CUR) ? SEEK_CUR : SEEK_END;
+    return std::fseek(static_cast<FILE *>(user), offset, whence) == 0;
+}
+
+/* interleaved float samples as 16-bit pcm, with a riff INFO title when one is given */
+inline bool write_wav(const std::string &path, unsigned int channels, unsigned int sample_rate, const std::vector<float> &samples,
+                      const char *title = nullptr) {
+    drwav_data_format format;
+    format.container = drwav_container_riff;
+    format.format = DR_WAVE_FORMAT_PCM;
+    format.channels = channels;
+    format.sampleRate = sample_rate;
+    format.bitsPerSample = 16;
+
+    std::vector<drwav_int16> pcm(samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        pcm[i] = static_cast<drwav_int16>(std::lround(std::fmax(-1.0f, std::fmin(samples[i], 1.0f)) * 32767.0f));
+    }
+
+    FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    drwav_metadata metadata = {};
+    metadata.type = drwav_metadata_type_list_info_title;
+    metadata.data.infoText.pString = const_cast<char *>(title);
+    metadata.data.infoText.stringLength = title ? static_cast<drwav_uint32>(std::char_traits<char>::length(title)) : 0;
+
+    drwav wav;
+    if (!drwav_init_write_with_metadata(&wav, &format, write_to_file, seek_in_file, file, NULL, title ? &metadata : NULL, title ? 1 : 0)) {
+        std::fclose(file);
+        return false;
+    }
+
+    const drwav_uint64 frames = samples.size() / channels;
+    const bool ok = drwav_write_pcm_frames(&wav, frames, pcm.data()) == frames;
+    drwav_uninit(&wav);
+    std::fclose(file);
+    return ok;
+}
+
+/* a sine of the given peak amplitude, the same in every channel */
+inline std::vector<float> sine(unsigned int channels, unsigned int sample_rate, double frequency, double amplitude, size_t frames) {
+    std::vector<float> samples(frames * channels);
+
+    for (size_t i = 0; i < frames; i++) {
+        const float value = static_cast<float>(amplitude * std::sin(2.0 * M_PI * frequency * i / sample_rate));
+        for (unsigned int c = 0; c < channels; c++) samples[i * channels + c] = value;
+    }
+
+    return samples;
+}
@@ -0,0 +1,273 @@
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_engine.h"
+#include "test.h"
+
+/* the engine runs on an ALC_SOFT_loopback device like hexen_bench, so its output can be pulled and
+   compared against what the tracks hold */
+static constexpr unsigned int RATE = 48000;
+static constexpr size_t BLOCK = 480;
+
+static std::string dir;
+
+/* stereo noise that never starts on silence, so the first audible frame marks where the track begins */
+static std::vector<float> noise(unsigned int seed, size_t frames) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> spread(-0.5f, 0.5f);
+
+    std::vector<float> samples(frames * 2);
+    for (float &value : samples) value = spread(random);
+    samples[0] = samples[1] = 0.25f;
+    return samples;
+}
+
+/* what the decoder hands the mixer for samples once they have been through a 16-bit wav */
+static std::vector<float> quantized(const std::vector<float> &samples) {
+    std::vector<float> out(samples.size());
+    for (size_t i = 0; i < samples.size(); i++) out[i] = std::lround(samples[i] * 32767.0f) / 32768.0f;
+    return out;
+}
+
+static std::string track(const char *name, const std::vector<float> &samples, unsigned int rate = RATE) {
+    const std::string path = dir + "/" + name;
+    CHECK(write_wav(path, 2, rate, samples));
+    return path;
+}
+
+/* pulls frames of output a block at a time, giving the audio thread a moment between blocks to
+   refill the buffer ring the way a sound card's pace would */
+static std::vector<float> render(audio_engine &engine, size_t frames) {
+    std::vector<float> out(frames * 2);
+
+    for (size_t done = 0; done < frames; done += BLOCK) {
+        CHECK(engine.render(out.data() + done * 2, std::min(BLOCK, frames - done)));
+        std::this_thread::sleep_for(std::chrono::microseconds(2000));
+    }
+
+    return out;
+}
+
+static size_t first_audible(const std::vector<float> &out) {
+    for (size_t i = 0; i < out.size() / 2; i++) {
+        if (out[i * 2] != 0.0f || out[i * 2 + 1] != 0.0f) return i;
+    }
+
+    return out.size() / 2;
+}
+
+/* frames of out from start that match expected, up to its end */
+static size_t matching(const std::vector<float> &out, size_t start, const std::vector<float> &expected) {
+    size_t frames = 0;
+
+    while (frames < expected.size() / 2 && start + frames < out.size() / 2) {
+        const size_t i = start + frames;
+        if (std::fabs(out[i * 2] - expected[frames * 2]) > 1e-6f || std::fabs(out[i * 2 + 1] - expected[frames * 2 + 1]) > 1e-6f) break;
+        frames++;
+    }
+
+    return frames;
+}
+
+static bool all_silent(const std::vector<float> &out, size_t from) {
+    for (size_t i = from * 2; i < out.size(); i++) {
+        if (out[i] != 0.0f) return false;
+    }
+
+    return true;
+}
+
+static bool wait_until_stopped(audio_engine &engine) {
+    for (int i = 0; i < 500; i++) {
+        if (!engine.get_state().playing) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    return false;
+}
+
+/* a track longer than the whole buffer ring comes out sample for sample, with no gap or repeat
+   where one buffer hands over to the next */
+static void test_streaming() {
+    audio_settings settings;
+    settings.loopback_rate = RATE;
+
+    audio_engine engine;
+    CHECK(engine.init(settings));
+
+    const std::vector<float> samples = noise(1, RATE * 3 / 2);
+    const std::string path = track("stream.wav", samples);
+
+    engine.play(path);
+    const std::vector<float> out = render(engine, RATE * 2);
+
+    const size_t start = first_audible(out);
+    const size_t matched = matching(out, start, quantized(samples));
+    std::fprintf(stderr, "streaming: starts at frame %zu, %zu of %zu frames match\n", start, matched, samples.size() / 2);
+
+    CHECK(start < RATE / 10);
+    CHECK(matched == samples.size() / 2);
+    CHECK(all_silent(out, start + samples.size() / 2));
+
+    CHECK(wait_until_stopped(engine));
+    const playback_state state = engine.get_state();
+    CHECK(std::string(state.track) == path);
+    CHECK_NEAR(state.duration, 1.5, 1e-6);
+    CHECK_NEAR(state.position, 1.5, 1e-6);
+
+    engine.cleanup();
+}
+
+/* stop() silences the source straight away instead of letting the queued buffers play out */
+static void test_stop() {
+    audio_settings settings;
+    settings.loopback_rate = RATE;
+
+    audio_engine engine;
+    CHECK(engine.init(settings));
+
+    engine.play(track("long.wav", noise(2, RATE * 4)));
+    const std::vector<float> before = render(engine, RATE / 2);
+    CHECK(first_audible(before) < RATE / 10);
+    CHECK(engine.get_state().playing);
+
+    engine.stop();
+    CHECK(wait_until_stopped(engine));
+
+    const std::vector<float> after = render(engine, RATE / 2);
+    CHECK(all_silent(after, 0));
+    CHECK(engine.get_state().track[0] == '\0');
+
+    engine.cleanup();
+}
+
+/* a missing file plays nothing and leaves the engine usable */
+static void test_missing_track() {
+    audio_settings settings;
+    settings.loopback_rate = RATE;
+
+    audio_engine engine;
+    CHECK(engine.init(settings));
+
+    engine.play(dir + "/missing.wav");
+    CHECK(all_silent(render(engine, RATE / 4), 0));
+    CHECK(!engine.get_state().playing);
+
+    const std::vector<float> samples = noise(3, RATE / 2);
+    engine.play(track("after.wav", samples));
+
+    const std::vector<float> out = render(engine, RATE);
+    CHECK(matching(out, first_audible(out), quantized(samples)) == samples.size() / 2);
+
+    engine.cleanup();
+}
+
+/* the queue plays back to back with no gap or overlap, including a track shorter than one buffer
+   and one enqueued while the first is already playing */
+static void test_gapless() {
+    audio_settings settings;
+    settings.loopback_rate = RATE;
+
+    audio_engine engine;
+    CHECK(engine.init(settings));
+
+    const std::vector<float> a = noise(10, RATE / 2), b = noise(11, 1000), c = noise(12, RATE / 3), d = noise(13, RATE / 4);
+    const std::string path_d = track("d.wav", d);
+
+    engine.play(track("a.wav", a), { track("b.wav", b), track("c.wav", c) });
+    std::vector<float> out = render(engine, RATE / 4);
+    engine.enqueue(path_d);
+
+    const std::vector<float> rest = render(engine, RATE * 3 / 2);
+    out.insert(out.end(), rest.begin(), rest.end());
+
+    std::vector<float> expected = quantized(a);
+    for (const std::vector<float> *next : { &b, &c, &d }) {
+        const std::vector<float> samples = quantized(*next);
+        expected.insert(expected.end(), samples.begin(), samples.end());
+    }
+
+    const size_t start = first_audible(out);
+    const size_t matched = matching(out, start, expected);
+    std::fprintf(stderr, "gapless: %zu of %zu frames match\n", matched, expected.size() / 2);
+
+    CHECK(matched == expected.size() / 2);
+    CHECK(all_silent(out, start + expected.size() / 2));
+
+    CHECK(wait_until_stopped(engine));
+    CHECK(std::string(engine.get_state().track) == path_d);
+
+    engine.cleanup();
+}
+
+/* a steady 0.25 at 48 khz into a steady 0.5 at 44.1 khz. the second comes out resampled to the
+   same length in time, and the equal-power fade between them starts exactly its length ahead of the
+   end of the first. the first outlasts the buffer ring, so the second is loaded before the fade */
+static void test_crossfade() {
+    static constexpr size_t FADE = RATE / 10;
+
+    audio_settings settings;
+    settings.loopback_rate = RATE;
+    settings.crossfade_seconds = 0.1f;
+
+    audio_engine engine;
+    CHECK(engine.init(settings));
+
+    const std::vector<float> a(RATE * 3 / 2 * 2, 0.25f), b(44100 / 2 * 2, 0.5f);
+    engine.play(track("fade_a.wav", a), { track("fade_b.wav", b, 44100) });
+
+    const std::vector<float> out = render(engine, RATE * 5 / 2);
+    const size_t start = first_audible(out);
+    const size_t fade_start = start + RATE * 3 / 2 - FADE;
+    const size_t end = fade_start + RATE / 2;
+
+    size_t last = out.size() / 2;
+    while (last > 0 && out[(last - 1) * 2] == 0.0f) last--;
+    std::fprintf(stderr, "crossfade: starts at frame %zu, ends at %zu, expected %zu\n", start, last, end);
+
+    /* the resampler rings for a few frames where the second track starts and ends */
+    static constexpr size_t SETTLE = 64;
+    double error = 0.0;
+
+    for (size_t i = start; i < end - SETTLE; i++) {
+        if (i >= fade_start && i < fade_start + SETTLE) continue;
+
+        double expected = 0.25;
+
+        if (i >= fade_start + FADE) {
+            expected = 0.5;
+        } else if (i >= fade_start) {
+            const double x = (i - fade_start + 0.5) / FADE * M_PI / 2.0;
+            expected = 0.25 * std::cos(x) + 0.5 * std::sin(x);
+        }
+
+        error = std::max({ error, std::fabs(out[i * 2] - expected), std::fabs(out[i * 2 + 1] - expected) });
+    }
+
+    std::fprintf(stderr, "crossfade: max error %g\n", error);
+    CHECK(error < 1e-3);
+    CHECK(last + SETTLE >= end && last <= end + SETTLE);
+    CHECK(all_silent(out, end + SETTLE));
+
+    CHECK(wait_until_stopped(engine));
+    engine.cleanup();
+}
+
+int main() {
+    dir = make_temp_dir("hexen_audio_engine");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    test_streaming();
+    test_stop();
+    test_missing_track();
+    test_gapless();
+    test_crossfade();
+
+    std::filesystem::remove_all(dir);
+    return test_result();
+}
@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "decoder.h"
+#include "test.h"
+
+static std::string dir;
+
+static bool write_file(const std::string &path, const std::vector<uint8_t> &bytes) {
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    const bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    std::fclose(file);
+    return ok;
+}
+
+class bit_writer {
+    public:
+        std::vector<uint8_t> bytes;
+        unsigned int used = 8;
+
+        void put(uint64_t value, unsigned int bits) {
+            for (unsigned int i = bits; i-- > 0;) {
+                if (used == 8) {
+                    bytes.push_back(0);
+                    used = 0;
+                }
+
+                bytes.back() |= static_cast<uint8_t>(((value >> i) & 1) << (7 - used));
+                used++;
+            }
+        }
+
+        void rice(int32_t value, unsigned int k) {
+            const uint32_t folded = (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+            for (uint32_t i = 0; i < (folded >> k); i++) put(0, 1);
+            put(1, 1);
+            put(folded, k);
+        }
+
+        void align() { used = 8; }
+};
+
+static uint8_t flac_crc8(const uint8_t *data, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t flac_crc16(const uint8_t *data, size_t length) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int bit = 0; bit < 8; bit++) crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x8005) : static_cast<uint16_t>(crc << 1);
+    }
+    return crc;
+}
+
+static constexpr uint64_t FLAC_BLOCK = 4096;
+
+/* stereo 16-bit flac in fixed blocks of FLAC_BLOCK with a short last one. the subframes take
+   turns between verbatim, the second order fixed predictor with rice coded residuals, and
+   constant for the blocks that are silent */
+static std::vector<uint8_t> encode_flac(const std::vector<int16_t> &samples, unsigned int sample_rate) {
+    const uint64_t frames = samples.size() / 2;
+
+    bit_writer out;
+    out.put(0x664C6143, 32);
+
+    /* STREAMINFO, the last metadata block */
+    out.put(0x80, 8);
+    out.put(34, 24);
+    out.put(FLAC_BLOCK, 16);
+    out.put(FLAC_BLOCK, 16);
+    out.put(0, 48);
+    out.put(sample_rate, 20);
+    out.put(1, 3);
+    out.put(15, 5);
+    out.put(frames, 36);
+    out.put(0, 64);
+    out.put(0, 64);
+
+    for (uint64_t first = 0, number = 0; first < frames; first += FLAC_BLOCK, number++) {
+        const uint32_t block = static_cast<uint32_t>(std::min<uint64_t>(FLAC_BLOCK, frames - first));
+        const size_t start = out.bytes.size();
+
+        out.put(0xFFF8, 16);
+        out.put(block == FLAC_BLOCK ? 12 : 7, 4);
+        out.put(0, 4);
+        out.put(1, 4);
+        out.put(4, 3);
+        out.put(0, 1);
+
+        /* the frame number, utf-8 coded */
+        if (number < 0x80) {
+            out.put(number, 8);
+        } else {
+            out.put(0xC0 | (number >> 6), 8);
+            out.put(0x80 | (number & 0x3F), 8);
+        }
+
+        if (block != FLAC_BLOCK) out.put(block - 1, 16);
+        out.put(flac_crc8(out.bytes.data() + start, out.bytes.size() - start), 8);
+
+        for (unsigned int channel = 0; channel < 2; channel++) {
+            std::vector<int32_t> s(block);
+            bool silent = true;
+            for (uint32_t i = 0; i < block; i++) {
+                s[i] = samples[(first + i) * 2 + channel];
+                silent = silent && s[i] == 0;
+            }
+
+            if (silent) {
+                out.put(0, 8);
+                out.put(0, 16);
+            } else if ((number + channel) % 2 == 0) {
+                out.put(0x02, 8);
+                for (int32_t value : s) out.put(static_cast<uint16_t>(value), 16);
+            } else {
+                out.put(0x14, 8);
+                out.put(static_cast<uint16_t>(s[0]), 16);
+                out.put(static_cast<uint16_t>(s[1]), 16);
+
+                std::vector<int32_t> residual;
+                uint64_t total = 0;
+                for (uint32_t i = 2; i < block; i++) {
+                    residual.push_back(s[i] - 2 * s[i - 1] + s[i - 2]);
+                    total += static_cast<uint64_t>(std::abs(residual.back()));
+                }
+
+                unsigned int k = 0;
+                while (k < 14 && (uint64_t(1) << (k + 1)) * residual.size() < total) k++;
+
+                out.put(0, 2);
+                out.put(0, 4);
+                out.put(k, 4);
+                for (int32_t value : residual) out.rice(value, k);
+            }
+        }
+
+        out.align();
+        out.put(flac_crc16(out.bytes.data() + start, out.bytes.size() - start), 16);
+    }
+
+    return out.bytes;
+}
+
+static std::unique_ptr<decoder> open_decoder(const std::string &path, std::vector<uint8_t> &file, bool mapped) {
+    codec format;
+    if (!codec_for_name(path.data(), path.size(), format) || !read_whole_file(path, file)) return nullptr;
+
+    std::unique_ptr<decoder> out = make_decoder(format);
+    if (!out || !out->open(path, mapped ? file.data() : nullptr, file.size())) return nullptr;
+    return out;
+}
+
+/* every sample comes back exactly, through the mapping and through stdio, and a seek anywhere
+   reads the same samples as reading up to it did */
+static void test_flac() {
+    static constexpr uint64_t FRAMES = FLAC_BLOCK * 9 + 1000;
+    std::mt19937 random(11);
+
+    std::vector<int16_t> samples(FRAMES * 2);
+    for (uint64_t i = 0; i < FRAMES; i++) {
+        const bool silent = i / FLAC_BLOCK == 3;
+        samples[i * 2] = silent ? 0 : static_cast<int16_t>(20000.0 * std::sin(i * 0.01) + random() % 200);
+        samples[i * 2 + 1] = silent ? 0 : static_cast<int16_t>(random() % 65536 - 32768);
+    }
+
+    const std::string path = dir + "/test.flac";
+    CHECK(write_file(path, encode_flac(samples, 44100)));
+
+    for (bool mapped : { true, false }) {
+        std::vector<uint8_t> file;
+        std::unique_ptr<decoder> flac = open_decoder(path, file, mapped);
+        CHECK(flac != nullptr);
+        if (!flac) return;
+
+        CHECK(flac->channels() == 2 && flac->sample_rate() == 44100 && flac->bits_per_sample() == 16);
+        CHECK(flac->source() == sample_format::s16);
+        CHECK(flac->frame_count() == FRAMES);
+
+        std::vector<int16_t> out(FRAMES * 2 + 2);
+        uint64_t total = 0;
+        for (uint64_t read; (read = flac->read(1500, out.data() + total * 2)) != 0;) total += read;
+
+        CHECK(total == FRAMES);
+        CHECK(std::memcmp(out.data(), samples.data(), FRAMES * 4) == 0);
+
+        for (uint64_t target : { uint64_t(0), uint64_t(1), FLAC_BLOCK - 1, FLAC_BLOCK * 3 + 17, FLAC_BLOCK * 9 + 999, uint64_t(random() % FRAMES) }) {
+            CHECK(flac->seek(target));
+
+            int16_t block[64] = {};
+            const uint64_t read = flac->read(32, block);
+            CHECK(read == std::min<uint64_t>(32, FRAMES - target));
+            CHECK(std::memcmp(block, samples.data() + target * 2, read * 4) == 0);
+        }
+    }
+
+    track_probe probe;
+    CHECK(probe_track(path, probe));
+    CHECK(probe.frame_count == FRAMES && probe.sample_rate == 44100 && probe.channels == 2);
+}
+
+/* a silent mpeg-1 layer iii frame at 44.1 khz and 128 kbit/s, no main data and every granule
+   coded empty */
+static constexpr size_t MP3_FRAME = 417;
+
+static void append_mp3_frame(std::vector<uint8_t> &out) {
+    static const uint8_t HEADER[4] = { 0xFF, 0xFB, 0x90, 0x00 };
+    out.insert(out.end(), HEADER, HEADER + 4);
+    out.resize(out.size() + MP3_FRAME - 4, 0);
+}
+
+/* the frame lame writes ahead of the audio: a xing tag with the frame count, then the lame
+   extension with the encoder delay and padding */
+static void append_info_frame(std::vector<uint8_t> &out, uint32_t frames, uint32_t delay, uint32_t padding) {
+    const size_t start = out.size();
+    append_mp3_frame(out);
+
+    uint8_t *tag = out.data() + start + 4 + 32;
+    std::memcpy(tag, "Info", 4);
+    tag[7] = 1;
+    tag[8] = static_cast<uint8_t>(frames >> 24);
+    tag[9] = static_cast<uint8_t>(frames >> 16);
+    tag[10] = static_cast<uint8_t>(frames >> 8);
+    tag[11] = static_cast<uint8_t>(frames);
+
+    uint8_t *lame = tag + 12;
+    std::memcpy(lame, "LAME3.100", 9);
+    lame[21] = static_cast<uint8_t>(delay >> 4);
+    lame[22] = static_cast<uint8_t>(((delay & 15) << 4) | (padding >> 8));
+    lame[23] = static_cast<uint8_t>(padding);
+}
+
+static void append_id3_title(std::vector<uint8_t> &out, const char *title) {
+    const size_t length = std::strlen(title);
+    const size_t frame = 10 + 1 + length;
+
+    const uint8_t header[10] = { 'I', 'D', '3', 3, 0, 0, 0, 0, static_cast<uint8_t>(frame >> 7), static_cast<uint8_t>(frame & 0x7F) };
+    out.insert(out.end(), header, header + 10);
+
+    const uint8_t frame_header[10] = { 'T', 'I', 'T', '2', 0, 0, 0, static_cast<uint8_t>(1 + length), 0, 0 };
+    out.insert(out.end(), frame_header, frame_header + 10);
+    out.push_back(0);
+    out.insert(out.end(), title, title + length);
+}
+
+/* the frame walk: the lame tag's delay and padding trim the length, junk between frames is
+   skipped and an id3v1 tag ends the stream. every sample of the silent frames comes back, from
+   the start and after any seek */
+static void test_mp3() {
+    static constexpr uint32_t FRAMES = 40;
+    static constexpr uint32_t DELAY = 576;
+    static constexpr uint32_t PADDING = 1000;
+    static constexpr uint64_t LENGTH = FRAMES * 1152 - DELAY - PADDING;
+
+    std::vector<uint8_t> bytes;
+    append_id3_title(bytes, "Silence");
+    append_info_frame(bytes, FRAMES, DELAY, PADDING);
+
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        append_mp3_frame(bytes);
+        if (i == FRAMES / 2) bytes.resize(bytes.size() + 300, 0x20);
+    }
+
+    const uint8_t id3v1[3] = { 'T', 'A', 'G' };
+    bytes.insert(bytes.end(), id3v1, id3v1 + 3);
+    bytes.resize(bytes.size() + 125, 0);
+
+    const std::string path = dir + "/test.mp3";
+    CHECK(write_file(path, bytes));
+
+    std::vector<uint8_t> file;
+    std::unique_ptr<decoder> mp3 = open_decoder(path, file, true);
+    CHECK(mp3 != nullptr);
+    if (!mp3) return;
+
+    CHECK(mp3->channels() == 2 && mp3->sample_rate() == 44100);
+    CHECK(mp3->source() == sample_format::f32);
+    CHECK(mp3->frame_count() == LENGTH);
+
+    std::vector<float> out(LENGTH * 2 + 2, 1.0f);
+    uint64_t total = 0;
+    for (uint64_t read; (read = mp3->read(1000, out.data() + total * 2)) != 0;) total += read;
+
+    CHECK(total == LENGTH);
+    bool silent = true;
+    for (uint64_t i = 0; i < LENGTH * 2; i++) silent = silent && out[i] == 0.0f;
+    CHECK(silent);
+
+    for (uint64_t target : { uint64_t(0), uint64_t(1151), uint64_t(20000), LENGTH - 1, LENGTH }) {
+        CHECK(mp3->seek(target));
+
+        float block[2000];
+        uint64_t read = 0;
+        for (uint64_t count; (count = mp3->read(1000, block)) != 0;) read += count;
+        CHECK(read == LENGTH - target);
+    }
+
+    track_probe probe;
+    CHECK(probe_track(path, probe));
+    CHECK(probe.frame_count == LENGTH && probe.sample_rate == 44100 && probe.channels == 2);
+    CHECK(probe.tags == "Silence");
+
+    /* without the tag nothing is trimmed */
+    std::vector<uint8_t> plain;
+    for (uint32_t i = 0; i < FRAMES; i++) append_mp3_frame(plain);
+
+    const std::string plain_path = dir + "/plain.mp3";
+    CHECK(write_file(plain_path, plain));
+
+    mp3 = open_decoder(plain_path, file, false);
+    CHECK(mp3 && mp3->frame_count() == FRAMES * 1152);
+}
+
+static void test_codecs() {
+    codec format;
+    CHECK(codec_for_name("a.flac", 6, format) && format == codec::flac);
+    CHECK(codec_for_name("a.mp3", 5, format) && format == codec::mp3);
+    CHECK(codec_for_name("a.wav", 5, format) && format == codec::wav);
+    CHECK(!codec_for_name("a.ogg", 5, format));
+}
+
+int main() {
+    dir = make_temp_dir("hexen_decoder");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    test_codecs();
+    test_flac();
+    test_mp3();
+
+    std::filesystem::remove_all(dir);
+    return test_result();
+}
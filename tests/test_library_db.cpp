@@ -0,0 +1,112 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "library_db.h"
+#include "library_index.h"
+#include "test.h"
+
+namespace fs = std::filesystem;
+
+/* waits out the background pass, giving up after ten seconds */
+static bool wait_for(library_db &db) {
+    for (int i = 0; i < 1000; i++) {
+        if (db.poll()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
+
+static void check_contents(const library_db &db, const std::string &music) {
+    CHECK(db.size() == 4);
+    if (db.size() != 4) return;
+
+    /* records are sorted by path, directories included, other files left out */
+    CHECK(db.path(db.record(0)) == music + "/a.wav");
+    CHECK(db.path(db.record(1)) == music + "/b.wav");
+    CHECK(db.path(db.record(2)) == music + "/sub");
+    CHECK(db.path(db.record(3)) == music + "/sub/c.wav");
+
+    const db_record &a = db.record(0);
+    CHECK(a.kind == static_cast<uint8_t>(entry_kind::track));
+    CHECK(a.frame_count == 4800);
+    CHECK(a.sample_rate == 48000);
+    CHECK(a.channels == 2);
+    CHECK(a.size == fs::file_size(music + "/a.wav"));
+    CHECK(db.tags(a) == "Morning");
+
+    const db_record &b = db.record(1);
+    CHECK(b.frame_count == 22050);
+    CHECK(b.sample_rate == 44100);
+    CHECK(b.channels == 1);
+    CHECK(db.tags(b).empty());
+
+    CHECK(db.record(2).kind == static_cast<uint8_t>(entry_kind::directory));
+    CHECK(db.tags(db.record(3)) == "Evening");
+
+    CHECK(db.find(music + "/sub/c.wav") == &db.record(3));
+    CHECK(db.find(music + "/notes.txt") == nullptr);
+    CHECK(db.find(music + "/c.wav") == nullptr);
+}
+
+int main() {
+    const std::string dir = make_temp_dir("hexen_library_db");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    const std::string music = dir + "/music";
+    const std::string path = dir + "/library.db";
+    fs::create_directories(music + "/sub");
+
+    CHECK(write_wav(music + "/a.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 4800), "Morning"));
+    CHECK(write_wav(music + "/b.wav", 1, 44100, sine(1, 44100, 440.0, 0.5, 22050)));
+    CHECK(write_wav(music + "/sub/c.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 480), "Evening"));
+    std::FILE *notes = std::fopen((music + "/notes.txt").c_str(), "w");
+    if (notes) std::fclose(notes);
+
+    /* no file yet, so an empty library */
+    library_db db;
+    CHECK(!db.load(path));
+    CHECK(db.size() == 0);
+
+    db.revalidate(music);
+    CHECK(wait_for(db));
+    check_contents(db, music);
+
+    /* the written file maps back to the same records */
+    library_db reloaded;
+    CHECK(reloaded.load(path));
+    check_contents(reloaded, music);
+    reloaded.cleanup();
+
+    /* a second pass over unchanged files keeps every record as it was */
+    db.revalidate(music);
+    CHECK(wait_for(db));
+    check_contents(db, music);
+
+    /* removed files drop out */
+    fs::remove(music + "/b.wav");
+    db.revalidate(music);
+    CHECK(wait_for(db));
+    CHECK(db.size() == 3);
+    CHECK(db.find(music + "/b.wav") == nullptr);
+    CHECK(db.find(music + "/a.wav") != nullptr);
+    db.cleanup();
+
+    /* a file that isn't a database is ignored rather than trusted */
+    std::FILE *junk = std::fopen(path.c_str(), "wb");
+    if (junk) {
+        std::fputs("not a database at all, but long enough for a header", junk);
+        std::fclose(junk);
+    }
+
+    library_db corrupt;
+    CHECK(!corrupt.load(path));
+    CHECK(corrupt.size() == 0);
+    corrupt.cleanup();
+
+    fs::remove_all(dir);
+    return test_result();
+}
@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "library_db.h"
+#include "library_index.h"
+#include "test.h"
+
+namespace fs = std::filesystem;
+
+static std::vector<std::string> names(const library_directory &dir) {
+    std::vector<std::string> out;
+    for (const library_entry &entry : dir.entries) out.push_back(dir.label(entry));
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+/* polls until the listing reads expected, giving up after two seconds */
+static bool wait_for_listing(library_index &index, const std::string &path, const std::vector<std::string> &expected) {
+    for (int i = 0; i < 200; i++) {
+        index.poll();
+        if (names(index.open(path)) == expected) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::fprintf(stderr, "%s lists:", path.c_str());
+    for (const std::string &name : names(index.open(path))) std::fprintf(stderr, " %s", name.c_str());
+    std::fprintf(stderr, "\n");
+    return false;
+}
+
+static bool wait_for(library_db &db) {
+    for (int i = 0; i < 1000; i++) {
+        if (db.poll()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
+
+static std::vector<std::string> take(library_index &index) {
+    std::vector<std::string> paths;
+    bool everything = true;
+    index.take_changes(paths, everything);
+    CHECK(!everything);
+    return paths;
+}
+
+static void touch(const std::string &path) {
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (file) std::fclose(file);
+}
+
+/* events keep the open listing current and are handed on as the paths they touched */
+static void test_events(const std::string &music) {
+    library_index index;
+    CHECK(index.init());
+
+    CHECK(names(index.open(music)) == std::vector<std::string>({ "a.wav", "sub/" }));
+    CHECK(take(index).empty());
+
+    CHECK(write_wav(music + "/b.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 480)));
+    touch(music + "/notes.txt");
+    CHECK(wait_for_listing(index, music, { "a.wav", "b.wav", "sub/" }));
+
+    /* create and close_write name the same file, it comes out once. the text file not at all */
+    CHECK(take(index) == std::vector<std::string>({ music + "/b.wav" }));
+    CHECK(take(index).empty());
+
+    fs::rename(music + "/b.wav", music + "/c.wav");
+    fs::remove(music + "/a.wav");
+    CHECK(wait_for_listing(index, music, { "c.wav", "sub/" }));
+    CHECK(take(index) == std::vector<std::string>({ music + "/a.wav", music + "/b.wav", music + "/c.wav" }));
+
+    /* a new directory is watched straight away, so files copied into it are seen without opening it */
+    fs::create_directories(music + "/new");
+    CHECK(wait_for_listing(index, music, { "c.wav", "new/", "sub/" }));
+    CHECK(write_wav(music + "/new/d.wav", 1, 44100, sine(1, 44100, 440.0, 0.5, 441)));
+
+    std::vector<std::string> changes;
+    for (int i = 0; i < 200 && changes.size() < 2; i++) {
+        index.poll();
+        const std::vector<std::string> more = take(index);
+        changes.insert(changes.end(), more.begin(), more.end());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CHECK(changes == std::vector<std::string>({ music + "/new", music + "/new/d.wav" }));
+    CHECK(names(index.open(music + "/new")) == std::vector<std::string>({ "d.wav" }));
+
+    /* removing from a big directory swaps the last entry into the hole and keeps the names right */
+    for (int i = 0; i < 300; i++) touch(music + "/sub/" + std::to_string(i) + ".wav");
+    std::vector<std::string> expected = { "e.wav" };
+    for (int i = 0; i < 300; i++) expected.push_back(std::to_string(i) + ".wav");
+    std::sort(expected.begin(), expected.end());
+    CHECK(wait_for_listing(index, music + "/sub", expected));
+
+    for (int i = 0; i < 300; i += 2) fs::remove(music + "/sub/" + std::to_string(i) + ".wav");
+    expected.erase(std::remove_if(expected.begin(), expected.end(), [](const std::string &name) {
+        return name != "e.wav" && std::stoi(name) % 2 == 0;
+    }), expected.end());
+    CHECK(wait_for_listing(index, music + "/sub", expected));
+
+    for (int i = 0; i < 300; i += 2) fs::remove(music + "/sub/" + std::to_string(i + 1) + ".wav");
+    CHECK(wait_for_listing(index, music + "/sub", { "e.wav" }));
+    take(index);
+
+    index.cleanup();
+}
+
+/* a targeted pass re-reads the paths it is given and keeps every other record untouched, even one
+   that no longer matches the disk */
+static void test_targeted_revalidate(const std::string &dir, const std::string &music) {
+    library_db db;
+    db.load(dir + "/library.db");
+    db.revalidate(music);
+    CHECK(wait_for(db));
+
+    const uint32_t before = db.size();
+    CHECK(db.find(music + "/c.wav") != nullptr);
+    CHECK(db.find(music + "/new/d.wav") != nullptr);
+
+    /* added without an event, so only a full pass finds it */
+    CHECK(write_wav(music + "/sub/hidden.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 480)));
+
+    CHECK(write_wav(music + "/f.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 960)));
+    CHECK(write_wav(music + "/new/g.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 480)));
+    fs::remove(music + "/c.wav");
+
+    db.revalidate(music, { music + "/f.wav", music + "/c.wav", music + "/new", music + "/new/g.wav", "/elsewhere/h.wav" });
+    CHECK(wait_for(db));
+
+    CHECK(db.size() == before + 1);
+    CHECK(db.find(music + "/c.wav") == nullptr);
+    CHECK(db.find(music + "/new/d.wav") != nullptr);
+    CHECK(db.find(music + "/sub/hidden.wav") == nullptr);
+
+    const db_record *f = db.find(music + "/f.wav");
+    CHECK(f && f->frame_count == 960);
+
+    /* still sorted, with the new directory's records once each */
+    for (uint32_t i = 1; i < db.size(); i++) CHECK(db.path(db.record(i - 1)) < db.path(db.record(i)));
+
+    db.revalidate(music);
+    CHECK(wait_for(db));
+    CHECK(db.find(music + "/sub/hidden.wav") != nullptr);
+
+    db.cleanup();
+}
+
+int main() {
+    const std::string dir = make_temp_dir("hexen_library_index");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    const std::string music = dir + "/music";
+    fs::create_directories(music + "/sub");
+    CHECK(write_wav(music + "/a.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 480)));
+    CHECK(write_wav(music + "/sub/e.wav", 2, 48000, sine(2, 48000, 440.0, 0.5, 480)));
+
+    test_events(music);
+    test_targeted_revalidate(dir, music);
+
+    fs::remove_all(dir);
+    return test_result();
+}
@@ -0,0 +1,135 @@
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "loudness.h"
+#include "test.h"
+
+static std::string dir;
+
+static bool measure(const char *name, const std::vector<float> &samples, unsigned int channels, loudness_result &result) {
+    const std::string path = dir + "/" + name;
+    if (!write_wav(path, channels, 48000, samples)) {
+        std::fprintf(stderr, "failed to write %s\n", path.c_str());
+        return false;
+    }
+
+    std::atomic<bool> cancel{false};
+    return measure_loudness(path, result, cancel);
+}
+
+static double amplitude(double dbfs) {
+    return std::pow(10.0, dbfs / 20.0);
+}
+
+/* the stationary cases from ebu tech 3341: a stereo 1 khz sine at a given level reads as that many lufs */
+static void test_stationary_sine(double dbfs) {
+    loudness_result result;
+    CHECK(measure("sine.wav", sine(2, 48000, 997.0, amplitude(dbfs), 48000 * 20), 2, result));
+
+    std::fprintf(stderr, "%g dbfs sine: %g lufs, %g dbtp\n", dbfs, result.integrated_lufs, result.true_peak_dbtp);
+    CHECK_NEAR(result.integrated_lufs, dbfs, 0.1);
+    CHECK_NEAR(result.true_peak_dbtp, dbfs, 0.2);
+}
+
+/* tech 3341 case 3: 10 s at -36, 60 s at -23, 10 s at -36. the quiet parts fall under the relative
+   gate, so only the middle counts */
+static void test_relative_gate() {
+    std::vector<float> samples = sine(2, 48000, 997.0, amplitude(-36.0), 48000 * 10);
+    const std::vector<float> loud = sine(2, 48000, 997.0, amplitude(-23.0), 48000 * 60);
+    samples.insert(samples.end(), loud.begin(), loud.end());
+    samples.insert(samples.end(), samples.begin(), samples.begin() + 48000 * 10 * 2);
+
+    loudness_result result;
+    CHECK(measure("gated.wav", samples, 2, result));
+
+    std::fprintf(stderr, "gated: %g lufs\n", result.integrated_lufs);
+    CHECK_NEAR(result.integrated_lufs, -23.0, 0.1);
+}
+
+/* a mono track counts its one channel once, so it reads 3 db lower than the same sine in stereo */
+static void test_mono() {
+    loudness_result result;
+    CHECK(measure("mono.wav", sine(1, 48000, 997.0, amplitude(-20.0), 48000 * 10), 1, result));
+    CHECK_NEAR(result.integrated_lufs, -23.0103, 0.1);
+}
+
+/* a sine in one channel of an n channel track, silence in the others */
+static std::vector<float> one_channel(unsigned int channels, unsigned int channel, double dbfs) {
+    const std::vector<float> mono = sine(1, 48000, 997.0, amplitude(dbfs), 48000 * 10);
+    std::vector<float> samples(mono.size() * channels, 0.0f);
+
+    for (size_t i = 0; i < mono.size(); i++) samples[i * channels + channel] = mono[i];
+    return samples;
+}
+
+/* surrounds count 1.41 times (+1.49 db) and the lfe not at all. a -23 dbfs sine alone in one
+   channel is -26.01 lufs up front */
+static void test_surround() {
+    loudness_result result;
+
+    CHECK(measure("centre.wav", one_channel(6, 2, -23.0), 6, result));
+    CHECK_NEAR(result.integrated_lufs, -26.0103, 0.1);
+
+    CHECK(measure("surround.wav", one_channel(6, 4, -23.0), 6, result));
+    CHECK_NEAR(result.integrated_lufs, -26.0103 + 1.4922, 0.1);
+
+    CHECK(measure("lfe.wav", one_channel(6, 3, -23.0), 6, result));
+    CHECK(std::isinf(result.integrated_lufs) && result.integrated_lufs < 0.0f);
+    CHECK_NEAR(result.true_peak_dbtp, -23.0, 0.2);
+
+    CHECK(measure("quad.wav", one_channel(4, 3, -23.0), 4, result));
+    CHECK_NEAR(result.integrated_lufs, -26.0103 + 1.4922, 0.1);
+
+    CHECK(measure("side.wav", one_channel(8, 7, -23.0), 8, result));
+    CHECK_NEAR(result.integrated_lufs, -26.0103 + 1.4922, 0.1);
+
+    CHECK(measure("rear.wav", one_channel(8, 5, -23.0), 8, result));
+    CHECK_NEAR(result.integrated_lufs, -26.0103, 0.1);
+
+    /* past 7.1 there is no layout to weight by */
+    CHECK(!measure("nine.wav", one_channel(9, 0, -23.0), 9, result));
+}
+
+static void test_silence() {
+    loudness_result result;
+    CHECK(measure("silence.wav", std::vector<float>(48000 * 2 * 5, 0.0f), 2, result));
+    CHECK(std::isinf(result.integrated_lufs) && result.integrated_lufs < 0.0f);
+}
+
+static void test_missing_file() {
+    loudness_result result;
+    std::atomic<bool> cancel{false};
+    CHECK(!measure_loudness(dir + "/missing.wav", result, cancel));
+}
+
+static void test_normalization_gain() {
+    loudness_result result = { -30.0f, -12.0f };
+    CHECK_NEAR(normalization_gain(result, -18.0f, -1.0f), 11.0, 1e-4);
+
+    /* the ceiling wins over the target */
+    result = { -30.0f, -3.0f };
+    CHECK_NEAR(normalization_gain(result, -18.0f, -1.0f), 2.0, 1e-4);
+
+    result = { -10.0f, -0.5f };
+    CHECK_NEAR(normalization_gain(result, -18.0f, -1.0f), -8.0, 1e-4);
+}
+
+int main() {
+    dir = make_temp_dir("hexen_loudness");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    test_stationary_sine(-23.0);
+    test_stationary_sine(-33.0);
+    test_relative_gate();
+    test_mono();
+    test_surround();
+    test_silence();
+    test_missing_file();
+    test_normalization_gain();
+
+    std::filesystem::remove_all(dir);
+    return test_result();
+}
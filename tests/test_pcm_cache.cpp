@@ -0,0 +1,285 @@
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pcm_cache.h"
+#include "test.h"
+#include "track_stream.h"
+
+/* stereo s16, so a chunk holds this many frames */
+static constexpr uint64_t CHUNK_FRAMES = pcm_cache::CHUNK_BYTES / 4;
+
+static std::string dir;
+
+static std::string touch(const char *name) {
+    const std::string path = dir + "/" + name;
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (file) std::fclose(file);
+    return path;
+}
+
+/* sample n of frame f is a function of both, so a frame read from the wrong place shows */
+static int16_t value(uint64_t frame, unsigned int channel) {
+    return static_cast<int16_t>((frame * 2 + channel) % 32749);
+}
+
+static std::vector<int16_t> block(uint64_t frame, uint64_t frames) {
+    std::vector<int16_t> out(frames * 2);
+    for (uint64_t i = 0; i < frames; i++) {
+        out[i * 2] = value(frame + i, 0);
+        out[i * 2 + 1] = value(frame + i, 1);
+    }
+    return out;
+}
+
+static pcm_entry *insert(pcm_cache &cache, const char *name, uint64_t frames) {
+    return cache.insert(touch(name), 2, 48000, 16, sample_format::s16, frames);
+}
+
+/* appends the whole track in blocks, false when the cache stopped taking them */
+static bool fill(pcm_cache &cache, pcm_entry &entry, const void *owner, uint64_t frames, uint64_t step = 10000) {
+    for (uint64_t frame = 0; frame < frames; frame += step) {
+        const uint64_t count = std::min(step, frames - frame);
+        const std::vector<int16_t> samples = block(frame, count);
+        const bool last = frame + count == frames;
+
+        if (!cache.append(entry, owner, frame, reinterpret_cast<const uint8_t *>(samples.data()), count, false)) return false;
+        if (last) cache.append(entry, owner, frames, nullptr, 0, true);
+    }
+
+    return entry.complete;
+}
+
+/* every frame the reader is handed holds what the writer appended there */
+static bool verify(const pcm_cache &cache, const pcm_entry &entry, uint64_t from, uint64_t to) {
+    for (uint64_t frame = from; frame < to;) {
+        uint64_t count = to - frame;
+        const int16_t *samples = reinterpret_cast<const int16_t *>(cache.frames(entry, frame, count));
+        if (!samples) return false;
+
+        for (uint64_t i = 0; i < count; i++) {
+            if (samples[i * 2] != value(frame + i, 0) || samples[i * 2 + 1] != value(frame + i, 1)) return false;
+        }
+
+        frame += count;
+    }
+
+    return true;
+}
+
+/* a reader follows the writer through the filled part without the lock, and never sees a frame
+   before its samples */
+static void test_concurrent_reader() {
+    pcm_cache cache;
+    CHECK(cache.init(32 * pcm_cache::CHUNK_BYTES));
+
+    static constexpr uint64_t FRAMES = CHUNK_FRAMES * 20 + 1234;
+    pcm_entry *entry = insert(cache, "concurrent", FRAMES);
+    CHECK(entry != nullptr);
+    if (!entry) return;
+
+    int writer = 0;
+    CHECK(cache.claim(*entry, &writer));
+
+    /* a second stream on the same track only reads */
+    int other = 0;
+    CHECK(!cache.claim(*entry, &other));
+
+    std::atomic<bool> torn{false};
+    std::atomic<uint64_t> checked{0};
+
+    std::thread reader([&] {
+        uint64_t frame = 0;
+
+        while (frame < FRAMES) {
+            const uint64_t filled = entry->filled.load(std::memory_order_acquire);
+            if (filled == frame) continue;
+
+            if (!verify(cache, *entry, frame, filled)) torn = true;
+            checked += filled - frame;
+            frame = filled;
+        }
+    });
+
+    CHECK(fill(cache, *entry, &writer, FRAMES, 777));
+    reader.join();
+
+    CHECK(!torn);
+    CHECK(checked == FRAMES);
+
+    cache.release(entry, &writer);
+
+    /* and from a fresh lookup once the writer is gone */
+    entry = cache.find(dir + "/concurrent");
+    CHECK(entry && entry->complete && entry->filled == FRAMES);
+    if (entry) CHECK(verify(cache, *entry, 0, FRAMES));
+    cache.release(entry, nullptr);
+
+    CHECK(cache.hits() == 1);
+    cache.cleanup();
+}
+
+/* entries a stream has open survive any amount of pressure, and one claim only evicts for a
+   quarter of the pool. what it cannot get after that it leaves to the free chunks */
+static void test_eviction() {
+    pcm_cache cache;
+    CHECK(cache.init(16 * pcm_cache::CHUNK_BYTES));
+
+    int owner = 0;
+    const char *old_names[] = { "old1", "old2", "old3", "old4" };
+
+    for (const char *name : old_names) {
+        pcm_entry *entry = insert(cache, name, CHUNK_FRAMES * 3);
+        CHECK(entry && cache.claim(*entry, &owner));
+        if (entry) CHECK(fill(cache, *entry, &owner, CHUNK_FRAMES * 3));
+        cache.release(entry, &owner);
+    }
+
+    pcm_entry *pinned = insert(cache, "pinned", CHUNK_FRAMES * 2);
+    CHECK(pinned && cache.claim(*pinned, &owner));
+    if (pinned) CHECK(fill(cache, *pinned, &owner, CHUNK_FRAMES * 2));
+    CHECK(cache.used() == 14 * pcm_cache::CHUNK_BYTES);
+
+    /* two free chunks, then old1 goes to get to the claim's share of four, then the last free one */
+    int writer = 0;
+    pcm_entry *big = insert(cache, "big", CHUNK_FRAMES * 12);
+    CHECK(big && cache.claim(*big, &writer));
+    CHECK(big && big->reserved == 5);
+
+    CHECK(cache.find(dir + "/old1") == nullptr);
+    for (int i = 1; i < 4; i++) {
+        pcm_entry *entry = cache.find(dir + "/" + old_names[i]);
+        CHECK(entry && entry->complete);
+        if (entry) CHECK(verify(cache, *entry, 0, CHUNK_FRAMES * 3));
+        cache.release(entry, nullptr);
+    }
+
+    /* the big track keeps the head it had room for */
+    if (big) {
+        CHECK(!fill(cache, *big, &writer, CHUNK_FRAMES * 12));
+        CHECK(big->filled == CHUNK_FRAMES * 5);
+        CHECK(verify(cache, *big, 0, CHUNK_FRAMES * 5));
+    }
+
+    cache.release(big, &writer);
+
+    /* the pinned entry is the least recently used, it is passed over and big goes instead */
+    pcm_entry *huge = insert(cache, "huge", CHUNK_FRAMES * 100);
+    CHECK(huge && cache.claim(*huge, &writer));
+    CHECK(huge && huge->reserved == 5);
+    CHECK(cache.find(dir + "/big") == nullptr);
+    if (pinned) CHECK(verify(cache, *pinned, 0, CHUNK_FRAMES * 2));
+
+    cache.release(huge, &writer);
+    cache.release(pinned, &owner);
+    cache.cleanup();
+}
+
+/* a writer that stops early hands back what it reserved and never filled, and one that ran out of
+   reserved chunks takes the ones that come free while it appends */
+static void test_release_and_growth() {
+    pcm_cache cache;
+    CHECK(cache.init(8 * pcm_cache::CHUNK_BYTES));
+
+    int first = 0, second = 0;
+
+    pcm_entry *stopped = insert(cache, "stopped", CHUNK_FRAMES * 8);
+    CHECK(stopped && cache.claim(*stopped, &first));
+    CHECK(cache.used() == 8 * pcm_cache::CHUNK_BYTES);
+
+    const std::vector<int16_t> samples = block(0, CHUNK_FRAMES + CHUNK_FRAMES / 2);
+    if (stopped) CHECK(cache.append(*stopped, &first, 0, reinterpret_cast<const uint8_t *>(samples.data()), samples.size() / 2, false));
+
+    /* the writer cannot skip ahead */
+    CHECK(stopped && !cache.append(*stopped, &first, CHUNK_FRAMES * 4, reinterpret_cast<const uint8_t *>(samples.data()), 1, false));
+
+    cache.release(stopped, &first);
+    CHECK(cache.used() == 2 * pcm_cache::CHUNK_BYTES);
+
+    stopped = cache.find(dir + "/stopped");
+    CHECK(stopped && !stopped->complete && stopped->filled == CHUNK_FRAMES + CHUNK_FRAMES / 2);
+    if (stopped) CHECK(verify(cache, *stopped, 0, stopped->filled));
+
+    /* pinned, so the next claim gets the six free chunks and nothing more */
+    pcm_entry *holder = insert(cache, "holder", CHUNK_FRAMES * 6);
+    CHECK(holder && cache.claim(*holder, &first));
+    CHECK(cache.used() == 8 * pcm_cache::CHUNK_BYTES);
+
+    pcm_entry *grows = insert(cache, "grows", CHUNK_FRAMES * 6);
+    CHECK(grows && cache.claim(*grows, &second));
+    CHECK(grows && grows->reserved == 0);
+
+    /* holder gives up before writing anything, its chunks come free and grows fills all of it */
+    cache.release(holder, &first);
+    CHECK(cache.find(dir + "/holder") == nullptr);
+
+    if (grows) {
+        CHECK(fill(cache, *grows, &second, CHUNK_FRAMES * 6));
+        CHECK(verify(cache, *grows, 0, CHUNK_FRAMES * 6));
+    }
+
+    cache.release(grows, &second);
+    cache.release(stopped, nullptr);
+    CHECK(cache.used() == 8 * pcm_cache::CHUNK_BYTES);
+    cache.cleanup();
+}
+
+/* s16 wav is read straight from the mapping, and still lands in the cache for the next open to
+   read without the file */
+static void test_mapped_track() {
+    pcm_cache cache;
+    CHECK(cache.init(8 * pcm_cache::CHUNK_BYTES));
+
+    const std::string path = dir + "/mapped.wav";
+    CHECK(write_wav(path, 2, 48000, sine(2, 48000, 440.0, 0.5, 100000)));
+
+    std::vector<int16_t> first(100000 * 2), scratch(4096 * 2);
+    const void *samples = nullptr;
+
+    track_stream stream;
+    stream.set_cache(&cache, true);
+    CHECK(stream.open(path));
+    CHECK(stream.zero_copy());
+
+    for (size_t frame = 0; !stream.finished();) {
+        const drwav_uint64 count = stream.read(4096, scratch.data(), &samples);
+        std::memcpy(first.data() + frame * 2, samples, count * 4);
+        frame += count;
+    }
+
+    stream.close();
+    CHECK(cache.used() == 2 * pcm_cache::CHUNK_BYTES);
+
+    CHECK(stream.open(path));
+    CHECK(stream.cached());
+    CHECK(stream.frame_count() == 100000);
+
+    bool same = true;
+    for (size_t frame = 0; !stream.finished();) {
+        const drwav_uint64 count = stream.read(4096, scratch.data(), &samples);
+        same = same && std::memcmp(first.data() + frame * 2, samples, count * 4) == 0;
+        frame += count;
+    }
+
+    CHECK(same);
+    CHECK(stream.cursor() == 100000);
+
+    stream.close();
+    cache.cleanup();
+}
+
+int main() {
+    dir = make_temp_dir("hexen_pcm_cache");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    test_concurrent_reader();
+    test_eviction();
+    test_release_and_growth();
+    test_mapped_track();
+
+    std::filesystem::remove_all(dir);
+    return test_result();
+}
@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "peak_cache.h"
+#include "sample_convert.h"
+#include "test.h"
+
+static void put(std::vector<uint8_t> &out, const void *data, size_t bytes) {
+    out.insert(out.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + bytes);
+}
+
+static void put_u32(std::vector<uint8_t> &out, uint32_t value) { put(out, &value, 4); }
+static void put_u16(std::vector<uint8_t> &out, uint16_t value) { put(out, &value, 2); }
+
+/* a float wav with a two byte chunk ahead of the data, so the samples sit two bytes off float
+   alignment in the mapping */
+static bool write_unaligned_float_wav(const std::string &path, unsigned int channels, const std::vector<float> &samples) {
+    std::vector<uint8_t> out;
+    const uint32_t data_bytes = static_cast<uint32_t>(samples.size() * sizeof(float));
+
+    put(out, "RIFF", 4);
+    put_u32(out, 4 + 24 + 10 + 8 + data_bytes);
+    put(out, "WAVE", 4);
+
+    put(out, "fmt ", 4);
+    put_u32(out, 16);
+    put_u16(out, 3);
+    put_u16(out, static_cast<uint16_t>(channels));
+    put_u32(out, 48000);
+    put_u32(out, 48000 * channels * 4);
+    put_u16(out, static_cast<uint16_t>(channels * 4));
+    put_u16(out, 32);
+
+    put(out, "junk", 4);
+    put_u32(out, 2);
+    put_u16(out, 0);
+
+    put(out, "data", 4);
+    put_u32(out, data_bytes);
+    CHECK(out.size() % 4 == 2);
+    put(out, samples.data(), data_bytes);
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    const bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return (std::fclose(file) == 0) && ok;
+}
+
+static bool wait_for(peak_cache &cache) {
+    for (int i = 0; i < 500; i++) {
+        if (cache.poll()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
+
+/* every bin of a half scale square wave reads -0.5 to 0.5 with an rms of 0.5, including the last,
+   shorter one */
+static void check_square(const peak_cache &cache, uint64_t frames) {
+    CHECK(cache.ready());
+
+    const peak_level *level = cache.level_for(1e9f);
+    CHECK(level != nullptr);
+    if (!level) return;
+
+    CHECK(level->frames_per_bin == 256);
+    CHECK(level->count == (frames + 255) / 256);
+
+    for (uint32_t i = 0; i < level->count; i++) {
+        CHECK_NEAR(level->bins[i].min, -16384, 1);
+        CHECK_NEAR(level->bins[i].max, 16384, 1);
+        CHECK_NEAR(level->bins[i].rms, 16384, 1);
+    }
+}
+
+int main() {
+    const std::string dir = make_temp_dir("hexen_peak_cache");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    const uint64_t frames = 48000 * 3 + 100;
+    std::vector<float> samples(frames * 2);
+    for (size_t i = 0; i < samples.size(); i++) samples[i] = (i / 2) % 2 ? 0.5f : -0.5f;
+
+    const std::string path = dir + "/unaligned.wav";
+    CHECK(write_unaligned_float_wav(path, 2, samples));
+
+    /* the scalar kernel reads the floats directly, where a misaligned pointer shows up under ubsan */
+    CHECK(use_convert_backend("scalar"));
+
+    peak_cache cache;
+    CHECK(cache.init(dir + "/peaks"));
+
+    cache.select(path);
+    CHECK(wait_for(cache));
+    check_square(cache, frames);
+
+    /* and again from the file the worker wrote */
+    cache.select("");
+    cache.select(path);
+    if (!cache.ready()) CHECK(wait_for(cache));
+    check_square(cache, frames);
+
+    cache.cleanup();
+    std::filesystem::remove_all(dir);
+    return test_result();
+}
@@ -0,0 +1,125 @@
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "seqlock.h"
+#include "spsc_queue.h"
+#include "test.h"
+
+static void test_spsc_single_thread() {
+    spsc_queue<int, 4> queue;
+    int value = 0;
+
+    CHECK(queue.empty());
+    CHECK(!queue.pop(value));
+
+    for (int i = 0; i < 4; i++) CHECK(queue.push(i));
+    CHECK(!queue.push(4));
+
+    /* wraps around the ring a few times, always in order */
+    for (int i = 0; i < 20; i++) {
+        CHECK(queue.pop(value));
+        CHECK(value == i);
+        CHECK(queue.push(i + 4));
+    }
+
+    for (int i = 20; i < 24; i++) {
+        CHECK(queue.pop(value));
+        CHECK(value == i);
+    }
+
+    CHECK(queue.empty());
+}
+
+static void test_spsc_moves() {
+    spsc_queue<std::string, 2> queue;
+    std::string out;
+
+    CHECK(queue.push(std::string(100, 'x')));
+    CHECK(queue.pop(out));
+    CHECK(out == std::string(100, 'x'));
+}
+
+static void test_spsc_threads() {
+    static constexpr uint32_t COUNT = 1000000;
+    spsc_queue<uint32_t, 64> queue;
+    bool ordered = true;
+
+    std::thread consumer([&] {
+        uint32_t expected = 0, value = 0;
+
+        while (expected < COUNT) {
+            if (!queue.pop(value)) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (value != expected) ordered = false;
+            expected++;
+        }
+    });
+
+    for (uint32_t i = 0; i < COUNT; ) {
+        if (queue.push(i)) i++;
+        else std::this_thread::yield();
+    }
+
+    consumer.join();
+    CHECK(ordered);
+    CHECK(queue.empty());
+}
+
+struct snapshot {
+    uint64_t a;
+    uint64_t b;
+    uint64_t c[14];
+};
+
+/* every field is derived from a, a torn read shows up as a mismatch */
+static void test_seqlock_threads() {
+    static constexpr uint64_t STORES = 200000;
+    seqlock<snapshot> lock;
+    std::atomic<bool> done{false};
+    bool consistent = true;
+    uint64_t last = 0;
+    bool monotonic = true;
+
+    auto store = [&lock](uint64_t i) {
+        snapshot value;
+        value.a = i;
+        value.b = i * 3;
+        for (uint64_t &field : value.c) field = i + 1;
+        lock.store(value);
+    };
+
+    store(0);
+
+    std::thread reader([&] {
+        while (!done) {
+            const snapshot value = lock.load();
+
+            if (value.b != value.a * 3) consistent = false;
+            for (uint64_t field : value.c) if (field != value.a + 1) consistent = false;
+            if (value.a < last) monotonic = false;
+            last = value.a;
+        }
+    });
+
+    for (uint64_t i = 1; i <= STORES; i++) store(i);
+
+    done = true;
+    reader.join();
+
+    CHECK(consistent);
+    CHECK(monotonic);
+    CHECK(lock.load().a == STORES);
+}
+
+int main() {
+    test_spsc_single_thread();
+    test_spsc_moves();
+    test_spsc_threads();
+    test_seqlock_threads();
+    return test_result();
+}
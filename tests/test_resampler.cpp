@@ -0,0 +1,163 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "resampler.h"
+#include "test.h"
+
+/* left is a sine, right its negation, so a channel mix-up shows */
+static std::vector<float> stereo_sine(unsigned int rate, double frequency, double amplitude, size_t frames) {
+    std::vector<float> samples(frames * 2);
+
+    for (size_t i = 0; i < frames; i++) {
+        const float value = static_cast<float>(amplitude * std::sin(2.0 * M_PI * frequency * i / rate));
+        samples[i * 2] = value;
+        samples[i * 2 + 1] = -value;
+    }
+
+    return samples;
+}
+
+static std::vector<float> resample_all(resampler &converter, const std::vector<float> &in, size_t chunk) {
+    std::vector<float> out;
+    std::vector<float> block(1024 * 2);
+    size_t offset = 0;
+
+    while (true) {
+        const size_t available = std::min(chunk, in.size() / 2 - offset);
+        size_t consumed = 0;
+        const size_t produced = converter.process(in.data() + offset * 2, available, consumed, block.data(), 1024);
+
+        out.insert(out.end(), block.begin(), block.begin() + produced * 2);
+        offset += consumed;
+
+        if (produced == 0 && (consumed == 0 || offset == in.size() / 2)) break;
+    }
+
+    return out;
+}
+
+/* output frame j sits on input frame j * in / out, so a resampled sine is the same sine sampled at
+   the output rate, away from the edges where the filter reads the silence around the input */
+static void test_sine(unsigned int in_rate, unsigned int out_rate) {
+    resampler converter;
+    converter.configure(in_rate, out_rate, 2);
+
+    const double frequency = 1000.0, amplitude = 0.5;
+    const std::vector<float> out = resample_all(converter, stereo_sine(in_rate, frequency, amplitude, in_rate), 777);
+
+    const size_t frames = out.size() / 2;
+    CHECK(frames + resampler::TAPS >= converter.output_frames(in_rate));
+
+    double error = 0.0, mirror = 0.0;
+    for (size_t j = resampler::TAPS; j + resampler::TAPS < frames; j++) {
+        const double ideal = amplitude * std::sin(2.0 * M_PI * frequency * j / out_rate);
+        error = std::max(error, std::fabs(static_cast<double>(out[j * 2]) - ideal));
+        mirror = std::max(mirror, static_cast<double>(std::fabs(out[j * 2] + out[j * 2 + 1])));
+    }
+
+    std::fprintf(stderr, "%u -> %u: max error %g\n", in_rate, out_rate, error);
+    CHECK(error < 1e-3);
+    CHECK(mirror == 0.0);
+}
+
+static void test_dc() {
+    resampler converter;
+    converter.configure(44100, 48000, 1);
+
+    const std::vector<float> in(44100, 0.25f);
+    std::vector<float> out(48000);
+    size_t consumed = 0;
+    const size_t produced = converter.process(in.data(), in.size(), consumed, out.data(), out.size());
+
+    double error = 0.0;
+    for (size_t j = resampler::TAPS; j < produced; j++) error = std::max(error, std::fabs(out[j] - 0.25));
+    CHECK(error < 1e-5);
+}
+
+/* a tone above the output's nyquist has to be filtered out rather than folded back down */
+static void test_aliasing() {
+    resampler converter;
+    converter.configure(96000, 48000, 2);
+
+    const std::vector<float> out = resample_all(converter, stereo_sine(96000, 30000.0, 0.5, 96000), 4096);
+
+    double squares = 0.0;
+    size_t count = 0;
+    for (size_t j = resampler::TAPS; j + resampler::TAPS < out.size() / 2; j++, count++) squares += out[j * 2] * out[j * 2];
+
+    const double rms = std::sqrt(squares / count);
+    std::fprintf(stderr, "30 khz at 96 -> 48 khz: rms %g\n", rms);
+    CHECK(rms < 0.5e-3);
+}
+
+/* how the input is split into calls must not change the output */
+static void test_chunking() {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    std::vector<float> in(30000 * 2);
+    for (float &value : in) value = noise(random);
+
+    for (unsigned int out_rate : { 48000u, 47999u }) {
+        resampler whole, pieces;
+        whole.configure(44100, out_rate, 2);
+        pieces.configure(44100, out_rate, 2);
+
+        const std::vector<float> expected = resample_all(whole, in, in.size());
+        const std::vector<float> chunked = resample_all(pieces, in, 61);
+
+        CHECK(expected.size() == chunked.size());
+        CHECK(expected == chunked);
+    }
+}
+
+static void test_positions() {
+    resampler converter;
+    converter.configure(44100, 48000, 1);
+
+    CHECK(converter.output_frames(44100) == 48000);
+    CHECK(converter.output_frames(1) == 2);
+    CHECK(converter.frames_until(44100) == 48000);
+
+    std::vector<float> in(1000, 0.0f), out(2000);
+    size_t consumed = 0;
+    const size_t produced = converter.process(in.data(), in.size(), consumed, out.data(), out.size());
+
+    CHECK(consumed == in.size());
+    CHECK_NEAR(converter.position(), produced * 44100.0 / 48000.0, 1e-9);
+    CHECK(converter.frames_until(44100) == 48000 - produced);
+
+    converter.reset();
+    CHECK(converter.position() == 0.0);
+}
+
+static void test_passthrough() {
+    resampler converter;
+    converter.configure(48000, 48000, 2);
+    CHECK(converter.passthrough());
+
+    const std::vector<float> in = stereo_sine(48000, 440.0, 0.5, 1000);
+    std::vector<float> out(in.size());
+    size_t consumed = 0;
+
+    CHECK(converter.process(in.data(), 1000, consumed, out.data(), 1000) == 1000);
+    CHECK(consumed == 1000);
+    CHECK(out == in);
+}
+
+int main() {
+    std::fprintf(stderr, "backend: %s\n", resampler_backend());
+
+    test_sine(44100, 48000);
+    test_sine(48000, 44100);
+    test_sine(96000, 48000);
+    test_sine(44100, 47999);
+    test_dc();
+    test_aliasing();
+    test_chunking();
+    test_positions();
+    test_passthrough();
+
+    return test_result();
+}
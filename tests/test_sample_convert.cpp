@@ -0,0 +1,144 @@
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "sample_convert.h"
+#include "test.h"
+
+/* odd, so every kernel runs its scalar tail too */
+static constexpr size_t SAMPLES = 4099;
+
+/* everything one backend produces from the same input */
+struct outputs {
+    std::vector<float> from_s16, from_s24, from_s32;
+    std::vector<int16_t> to_s16, to_s16_dither;
+    std::vector<float> interleaved, left, right;
+    sample_stats stats;
+};
+
+static outputs run(const std::vector<uint8_t> &bytes, const std::vector<float> &floats) {
+    outputs out;
+
+    /* one byte in, so the loads are never aligned */
+    const uint8_t *in = bytes.data() + 1;
+
+    out.from_s16.resize(SAMPLES);
+    out.from_s24.resize(SAMPLES);
+    out.from_s32.resize(SAMPLES);
+    convert_to_f32(in, sample_format::s16, out.from_s16.data(), SAMPLES);
+    convert_to_f32(in, sample_format::s24, out.from_s24.data(), SAMPLES);
+    convert_to_f32(in, sample_format::s32, out.from_s32.data(), SAMPLES);
+
+    out.to_s16.resize(SAMPLES);
+    out.to_s16_dither.resize(SAMPLES);
+    convert_to_s16(floats.data(), sample_format::f32, out.to_s16.data(), SAMPLES, nullptr);
+
+    dither_state dither;
+    convert_to_s16(floats.data(), sample_format::f32, out.to_s16_dither.data(), SAMPLES, &dither);
+
+    const size_t frames = SAMPLES / 2;
+    out.interleaved.resize(frames * 2);
+    out.left.resize(frames);
+    out.right.resize(frames);
+
+    const float *planes[2] = { floats.data(), floats.data() + frames };
+    interleave_f32(planes, 2, out.interleaved.data(), frames);
+
+    float *split[2] = { out.left.data(), out.right.data() };
+    deinterleave_f32(floats.data(), 2, split, frames);
+
+    accumulate_stats(floats.data(), SAMPLES, out.stats);
+    return out;
+}
+
+static void compare(const char *backend, const outputs &scalar, const outputs &simd) {
+    std::fprintf(stderr, "comparing %s against scalar\n", backend);
+
+    CHECK(simd.from_s16 == scalar.from_s16);
+    CHECK(simd.from_s24 == scalar.from_s24);
+    CHECK(simd.from_s32 == scalar.from_s32);
+    CHECK(simd.to_s16 == scalar.to_s16);
+    CHECK(simd.interleaved == scalar.interleaved);
+    CHECK(simd.left == scalar.left);
+    CHECK(simd.right == scalar.right);
+
+    CHECK(simd.stats.min == scalar.stats.min);
+    CHECK(simd.stats.max == scalar.stats.max);
+    CHECK(simd.stats.count == scalar.stats.count);
+    CHECK_NEAR(simd.stats.sum_squares, scalar.stats.sum_squares, scalar.stats.sum_squares * 1e-9);
+
+    /* the generators differ per backend, but tpdf noise never moves a sample more than one lsb
+       from plain rounding */
+    size_t off_by_more = 0;
+    for (size_t i = 0; i < SAMPLES; i++) {
+        if (std::abs(simd.to_s16_dither[i] - scalar.to_s16[i]) > 1) off_by_more++;
+    }
+
+    CHECK(off_by_more == 0);
+}
+
+static void test_scalar_reference(const std::vector<uint8_t> &bytes, const outputs &scalar) {
+    const uint8_t *in = bytes.data() + 1;
+
+    int16_t s16;
+    std::memcpy(&s16, in + 2 * 7, sizeof(s16));
+    CHECK(scalar.from_s16[7] == s16 / 32768.0f);
+
+    int32_t s32;
+    std::memcpy(&s32, in + 4 * 7, sizeof(s32));
+    CHECK_NEAR(scalar.from_s32[7], s32 / 2147483648.0, 1e-7);
+
+    const int32_t s24 = static_cast<int32_t>((static_cast<uint32_t>(in[21]) << 8) | (static_cast<uint32_t>(in[22]) << 16) | (static_cast<uint32_t>(in[23]) << 24)) >> 8;
+    CHECK_NEAR(scalar.from_s24[7], s24 / 8388608.0, 1e-7);
+}
+
+static void test_saturation() {
+    const float loud[4] = { 1.5f, -1.5f, 1.0f, -1.0f };
+    int16_t out[4];
+
+    convert_to_s16(loud, sample_format::f32, out, 4, nullptr);
+    CHECK(out[0] == 32767);
+    CHECK(out[1] == -32768);
+    CHECK(out[2] == 32767);
+    CHECK(out[3] <= -32767);
+}
+
+static void test_stats_defaults() {
+    sample_stats stats;
+    const float one = -0.25f;
+
+    accumulate_stats(&one, 1, stats);
+    CHECK(stats.min == -0.25f);
+    CHECK(stats.max == -0.25f);
+}
+
+int main() {
+    std::mt19937 random(1234);
+
+    std::vector<uint8_t> bytes(SAMPLES * 4 + 1);
+    for (uint8_t &byte : bytes) byte = static_cast<uint8_t>(random());
+
+    /* mostly in range, some past full scale to exercise saturation */
+    std::uniform_real_distribution<float> spread(-1.1f, 1.1f);
+    std::vector<float> floats(SAMPLES);
+    for (float &value : floats) value = spread(random);
+
+    CHECK(use_convert_backend("scalar"));
+    const outputs scalar = run(bytes, floats);
+    test_scalar_reference(bytes, scalar);
+    test_saturation();
+    test_stats_defaults();
+
+    for (const char *backend : { "sse2", "avx2" }) {
+        if (!use_convert_backend(backend)) {
+            std::fprintf(stderr, "%s not supported here, skipped\n", backend);
+            continue;
+        }
+
+        compare(backend, scalar, run(bytes, floats));
+        test_saturation();
+    }
+
+    return test_result();
+}
@@ -0,0 +1,191 @@
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "library_db.h"
+#include "search_index.h"
+#include "test.h"
+
+namespace fs = std::filesystem;
+
+static std::string music;
+
+static bool scan(library_db &db, search_index &index) {
+    db.revalidate(music);
+
+    for (int i = 0; i < 3000; i++) {
+        if (db.poll()) {
+            index.update(db);
+            return true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+}
+
+static std::vector<search_result> query(search_index &index, const char *text) {
+    std::vector<search_result> results;
+    index.query(text, results);
+    return results;
+}
+
+/* path relative to the library root */
+static std::string name(const search_index &index, const search_result &result) {
+    return index.path(result.doc).substr(music.size() + 1);
+}
+
+/* a name prefix is worth 1000, a word start in the name 600, the middle of the name 300, tags 200 or
+   100 and the two parent directories 80 or 40, less the name length. the same scores have to come out
+   of the unindexed delta and of the postings */
+static void check_ranking(search_index &index) {
+    const std::vector<search_result> rain = query(index, "rain");
+    CHECK(rain.size() == 5);
+    if (rain.size() == 5) {
+        CHECK(name(index, rain[0]) == "rain");
+        CHECK(rain[0].score == 996);
+        CHECK(index.doc(rain[0].doc).kind == entry_kind::directory);
+        CHECK(std::string(index.label(rain[0].doc)) == "rain/");
+
+        CHECK(name(index, rain[1]) == "rain.wav");
+        CHECK(rain[1].score == 996);
+        CHECK(name(index, rain[2]) == "acid rain.wav");
+        CHECK(rain[2].score == 591);
+        CHECK(name(index, rain[3]) == "brainstorm.wav");
+        CHECK(rain[3].score == 290);
+        CHECK(name(index, rain[4]) == "rain/other.wav");
+        CHECK(rain[4].score == 75);
+    }
+
+    /* case doesn't matter */
+    const std::vector<search_result> upper = query(index, "RAIN");
+    CHECK(upper.size() == rain.size());
+
+    /* every term has to match, each in its best place */
+    const std::vector<search_result> both = query(index, "acid rain");
+    CHECK(both.size() == 1);
+    if (both.size() == 1) CHECK(both[0].score == 1000 + 600 - 9);
+
+    const std::vector<search_result> storm = query(index, "rain storm");
+    CHECK(storm.size() == 1);
+    if (storm.size() == 1) CHECK(name(index, storm[0]) == "brainstorm.wav");
+
+    /* short terms only match at word starts, so "ra" isn't found inside brainstorm */
+    const std::vector<search_result> prefix = query(index, "ra");
+    CHECK(prefix.size() == 4);
+    for (const search_result &result : prefix) CHECK(name(index, result) != "brainstorm.wav");
+
+    /* found through its riff title */
+    const std::vector<search_result> thunder = query(index, "thunder");
+    CHECK(thunder.size() == 1);
+    if (thunder.size() == 1) {
+        CHECK(name(index, thunder[0]) == "storm.wav");
+        CHECK(thunder[0].score == 200 - 5);
+    }
+
+    /* the extension isn't searchable, it would match every track */
+    CHECK(query(index, "wav").empty());
+    CHECK(query(index, "drizzle").empty());
+    CHECK(query(index, "   ").empty());
+}
+
+/* the worker hands back what query() would, and drops results computed before an update */
+static void test_worker(library_db &db) {
+    search_index index;
+    CHECK(index.init());
+    index.update(db);
+
+    std::vector<search_result> expected, results;
+    index.query("rain", expected);
+
+    /* only the last of several queued requests has to come back */
+    index.submit("r");
+    index.submit("ra");
+    index.submit("rain");
+
+    auto same = [&] {
+        if (results.size() != expected.size()) return false;
+        for (size_t i = 0; i < results.size(); i++) {
+            if (results[i].doc != expected[i].doc || results[i].score != expected[i].score) return false;
+        }
+        return true;
+    };
+
+    bool done = false;
+    for (int i = 0; i < 500 && !done; i++) {
+        if (index.poll(results) && same()) done = true;
+        else std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    CHECK(done);
+
+    /* nothing new until the next submit */
+    CHECK(!index.poll(results));
+
+    index.submit("storm");
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    index.update(db);
+    CHECK(!index.poll(results));
+
+    index.cleanup();
+}
+
+int main() {
+    const std::string dir = make_temp_dir("hexen_search_index");
+    if (dir.empty()) return EXIT_FAILURE;
+
+    music = dir + "/music";
+    fs::create_directories(music + "/rain");
+
+    const std::vector<float> samples = sine(1, 8000, 440.0, 0.5, 8);
+    for (const char *file : { "rain.wav", "acid rain.wav", "brainstorm.wav", "rain/other.wav" }) {
+        CHECK(write_wav(music + "/" + file, 1, 8000, samples));
+    }
+    CHECK(write_wav(music + "/storm.wav", 1, 8000, samples, "Thunder"));
+
+    library_db db;
+    db.load(dir + "/library.db");
+    search_index index;
+
+    /* a handful of docs stay in the delta and are scanned directly */
+    CHECK(scan(db, index));
+    CHECK(index.size() == 6);
+    check_ranking(index);
+
+    /* enough new docs to force a rebuild, after which queries go through the postings */
+    fs::create_directories(music + "/many");
+    for (int i = 0; i < 2100; i++) {
+        char file[64];
+        std::snprintf(file, sizeof(file), "/many/track %04d.wav", i);
+        CHECK(write_wav(music + file, 1, 8000, samples));
+    }
+    CHECK(write_wav(music + "/many/track.wav", 1, 8000, samples));
+
+    CHECK(scan(db, index));
+    CHECK(index.size() == 6 + 1 + 2101);
+    check_ranking(index);
+
+    /* far more matches than results. the exact name wins and the rest come best first */
+    const std::vector<search_result> tracks = query(index, "track");
+    CHECK(tracks.size() == 200);
+    if (!tracks.empty()) CHECK(name(index, tracks[0]) == "many/track.wav");
+    for (size_t i = 1; i < tracks.size(); i++) CHECK(tracks[i - 1].score >= tracks[i].score);
+
+    const std::vector<search_result> one = query(index, "track 1234");
+    CHECK(one.size() == 1);
+    if (one.size() == 1) CHECK(name(index, one[0]) == "many/track 1234.wav");
+
+    /* removed files drop out of the results */
+    fs::remove(music + "/acid rain.wav");
+    CHECK(scan(db, index));
+    CHECK(query(index, "acid").empty());
+    CHECK(query(index, "rain").size() == 4);
+
+    test_worker(db);
+
+    db.cleanup();
+    fs::remove_all(dir);
+    return test_result();
+}
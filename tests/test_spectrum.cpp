@@ -0,0 +1,165 @@
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "sample_ring.h"
+#include "spectrum.h"
+#include "test.h"
+
+static constexpr size_t N = spectrum_analyzer::FFT_SIZE;
+
+/* the textbook O(n^2) dft of the hann windowed input, in double, scaled like analyze() */
+static std::vector<double> naive_power(const std::vector<float> &samples) {
+    std::vector<double> power(N / 2);
+    const double scale = 4.0 / N;
+
+    for (size_t k = 0; k < N / 2; k++) {
+        double re = 0.0, im = 0.0;
+
+        for (size_t i = 0; i < N; i++) {
+            const double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / N);
+            const double angle = 2.0 * M_PI * static_cast<double>(k * i % N) / N;
+            re += samples[i] * window * std::cos(angle);
+            im -= samples[i] * window * std::sin(angle);
+        }
+
+        power[k] = (re * re + im * im) * scale * scale;
+    }
+
+    return power;
+}
+
+static void test_against_dft() {
+    std::mt19937 random(99);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    /* noise plus a couple of tones, so both the floor and the peaks are compared */
+    std::vector<float> samples(N);
+    for (size_t i = 0; i < N; i++) {
+        samples[i] = 0.1f * noise(random) + 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 100.5f * i / N) +
+                     0.25f * std::cos(2.0f * static_cast<float>(M_PI) * 333.0f * i / N);
+    }
+
+    spectrum_analyzer analyzer;
+    analyzer.analyze(samples.data(), 48000, 1.0f / 60.0f);
+
+    const std::vector<double> expected = naive_power(samples);
+
+    double largest = 0.0;
+    for (double value : expected) largest = std::max(largest, value);
+
+    double error = 0.0;
+    for (size_t k = 0; k < N / 2; k++) error = std::max(error, std::fabs(analyzer.power()[k] - expected[k]));
+
+    std::fprintf(stderr, "max error against the dft: %g of %g\n", error, largest);
+    CHECK(error <= largest * 1e-4);
+}
+
+static void test_full_scale_sine() {
+    const size_t bin = 64;
+    std::vector<float> samples(N);
+    for (size_t i = 0; i < N; i++) samples[i] = std::sin(2.0f * static_cast<float>(M_PI) * bin * i / N);
+
+    spectrum_analyzer analyzer;
+    analyzer.analyze(samples.data(), 48000, 1.0f / 60.0f);
+
+    CHECK_NEAR(analyzer.power()[bin], 1.0, 1e-3);
+
+    /* hann leaks into the two neighbouring bins at a quarter amplitude, and nowhere further */
+    CHECK_NEAR(analyzer.power()[bin - 1], 0.25, 1e-3);
+    CHECK_NEAR(analyzer.power()[bin + 1], 0.25, 1e-3);
+    CHECK(analyzer.power()[bin - 3] < 1e-6f);
+    CHECK(analyzer.power()[bin + 3] < 1e-6f);
+
+    CHECK(analyzer.peak() > 0.99f);
+}
+
+static void test_silence() {
+    const std::vector<float> samples(N, 0.0f);
+
+    spectrum_analyzer analyzer;
+    analyzer.analyze(samples.data(), 48000, 1.0f / 60.0f);
+
+    for (size_t k = 0; k < N / 2; k++) CHECK(analyzer.power()[k] == 0.0f);
+    for (int b = 0; b < spectrum_analyzer::BAND_COUNT; b++) CHECK(analyzer.bands()[b] == 0.0f);
+
+    analyzer.decay(10.0f);
+    CHECK(analyzer.settled());
+}
+
+/* sample n of the stream is n itself, mod a range a float holds exactly */
+static float ring_value(uint64_t position) {
+    return static_cast<float>(position % 1000000);
+}
+
+static void test_ring() {
+    sample_ring<1024> ring;
+    std::vector<float> block(700), out(1024);
+
+    for (uint64_t position = 0; position < 2100; position += block.size()) {
+        for (size_t i = 0; i < block.size(); i++) block[i] = ring_value(position + i);
+        ring.write(block.data(), block.size());
+    }
+
+    CHECK(ring.written() == 2100);
+
+    /* the last capacity samples across the wrap, but nothing older and nothing not yet written */
+    CHECK(ring.read(2100, out.data(), 1024));
+    for (size_t i = 0; i < 1024; i++) CHECK(out[i] == ring_value(2100 - 1024 + i));
+    CHECK(ring.read(1500, out.data(), 100));
+    CHECK(out[0] == ring_value(1400));
+
+    CHECK(!ring.read(1000, out.data(), 100));
+    CHECK(!ring.read(2101, out.data(), 1));
+    CHECK(!ring.read(2100, out.data(), 1025));
+}
+
+/* the visualizer reads while the audio thread writes. every window the reader is told is good has to
+   hold exactly the samples it asked for */
+static void test_ring_threads() {
+    static constexpr uint64_t SAMPLES = 20000000;
+    sample_ring<4096> ring;
+    std::atomic<bool> done{false};
+    uint64_t good = 0, torn = 0;
+
+    std::thread reader([&] {
+        std::vector<float> out(512);
+
+        while (!done) {
+            const uint64_t end = ring.written();
+            if (end < out.size() || !ring.read(end, out.data(), out.size())) continue;
+
+            good++;
+            for (size_t i = 0; i < out.size(); i++) {
+                if (out[i] != ring_value(end - out.size() + i)) {
+                    torn++;
+                    break;
+                }
+            }
+        }
+    });
+
+    std::vector<float> block(333);
+    for (uint64_t position = 0; position < SAMPLES; position += block.size()) {
+        for (size_t i = 0; i < block.size(); i++) block[i] = ring_value(position + i);
+        ring.write(block.data(), block.size());
+    }
+
+    done = true;
+    reader.join();
+
+    std::fprintf(stderr, "ring: %llu windows read\n", static_cast<unsigned long long>(good));
+    CHECK(good > 0);
+    CHECK(torn == 0);
+}
+
+int main() {
+    test_against_dft();
+    test_full_scale_sine();
+    test_silence();
+    test_ring();
+    test_ring_threads();
+    return test_result();
+}
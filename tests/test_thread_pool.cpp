@@ -0,0 +1,123 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <sys/resource.h>
+
+#include "test.h"
+#include "thread_pool.h"
+
+static double cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void test_runs_everything() {
+    thread_pool pool;
+    CHECK(pool.init(4, false));
+    CHECK(pool.size() == 4);
+
+    std::atomic<int> count{0};
+    for (int i = 0; i < 100000; i++) pool.submit([&count] { count++; });
+
+    pool.wait();
+    CHECK(count == 100000);
+    CHECK(pool.pending() == 0);
+
+    /* and again once every worker has gone back to sleep */
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (int i = 0; i < 1000; i++) pool.submit([&count] { count++; });
+
+    pool.wait();
+    CHECK(count == 101000);
+    pool.cleanup();
+}
+
+/* tasks submitted from a worker land in its own deque. while that worker is busy, the others have
+   to steal them, or this never finishes */
+static void test_stealing() {
+    thread_pool pool;
+    CHECK(pool.init(4, false));
+
+    std::atomic<int> stolen{0};
+    std::atomic<bool> all_ran{false};
+
+    pool.submit([&] {
+        for (int i = 0; i < 16; i++) pool.submit([&stolen] { stolen++; });
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (stolen < 16 && std::chrono::steady_clock::now() < deadline) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        all_ran = stolen == 16;
+    });
+
+    pool.wait();
+    CHECK(all_ran);
+    pool.cleanup();
+}
+
+/* wait() covers tasks that tasks submit */
+static void test_nested() {
+    thread_pool pool;
+    CHECK(pool.init(3, false));
+
+    std::atomic<int> leaves{0};
+    for (int i = 0; i < 50; i++) {
+        pool.submit([&] {
+            for (int j = 0; j < 20; j++) pool.submit([&leaves] { leaves++; });
+        });
+    }
+
+    pool.wait();
+    CHECK(leaves == 1000);
+    pool.cleanup();
+}
+
+/* idle workers sleep instead of spinning */
+static void test_idle() {
+    thread_pool pool;
+    CHECK(pool.init(4, false));
+
+    std::atomic<int> count{0};
+    for (int i = 0; i < 64; i++) pool.submit([&count] { count++; });
+    pool.wait();
+
+    const double before = cpu_seconds();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const double busy = cpu_seconds() - before;
+
+    std::fprintf(stderr, "idle pool used %g s of cpu in 0.3 s\n", busy);
+    CHECK(busy < 0.05);
+    pool.cleanup();
+}
+
+/* cleanup drops what is still queued and returns once the running tasks end */
+static void test_cleanup_with_work_queued() {
+    thread_pool pool;
+    CHECK(pool.init(2, false));
+
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 200; i++) {
+        pool.submit([&ran] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ran++;
+        });
+    }
+
+    pool.cleanup();
+    CHECK(ran < 200);
+    CHECK(pool.size() == 0);
+
+    /* submitting to a pool without workers is a no-op */
+    pool.submit([&ran] { ran = -1; });
+    CHECK(ran >= 0);
+}
+
+int main() {
+    test_runs_everything();
+    test_stealing();
+    test_nested();
+    test_idle();
+    test_cleanup_with_work_queued();
+    return test_result();
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "track_table.h"
+
+static void add(library_directory &dir, const std::string &name, entry_kind kind, uint64_t frames = 0, uint64_t size = 0) {
+    library_entry entry;
+    entry.name_offset = static_cast<uint32_t>(dir.names.size());
+    entry.name_length = static_cast<uint16_t>(name.size());
+    entry.kind = kind;
+    entry.info.frame_count = frames;
+    entry.info.sample_rate = kind == entry_kind::track ? 48000 : 0;
+    entry.info.size = size;
+
+    dir.names += name;
+    if (kind == entry_kind::directory) dir.names.push_back('/');
+    dir.names.push_back('\0');
+
+    dir.entries.push_back(entry);
+    dir.generation++;
+}
+
+static std::vector<std::string> labels(const library_directory &dir, const track_table &table) {
+    std::vector<std::string> out;
+    for (uint32_t row : table.order()) out.push_back(dir.label(dir.entries[row]));
+    return out;
+}
+
+/* folders first, case folded, raw bytes between names that only differ in case, and names that
+   share their first eight bytes still compared past them */
+static void test_names() {
+    library_directory dir;
+    add(dir, "b.wav", entry_kind::track);
+    add(dir, "Zeta", entry_kind::directory);
+    add(dir, "B.wav", entry_kind::track);
+    add(dir, "abcdefgh2.wav", entry_kind::track);
+    add(dir, "ABCDEFGH1.wav", entry_kind::track);
+    add(dir, "abc.wav", entry_kind::track);
+    add(dir, "abcdefgh", entry_kind::track);
+    add(dir, "alpha", entry_kind::directory);
+
+    track_table table;
+    table.update(dir, track_column::name, true);
+    CHECK(labels(dir, table) == std::vector<std::string>({ "alpha/", "Zeta/", "abc.wav", "abcdefgh", "ABCDEFGH1.wav",
+                                                           "abcdefgh2.wav", "B.wav", "b.wav" }));
+
+    /* descending reverses the tracks and the folders, but folders stay on top */
+    table.update(dir, track_column::name, false);
+    CHECK(labels(dir, table) == std::vector<std::string>({ "Zeta/", "alpha/", "b.wav", "B.wav", "abcdefgh2.wav",
+                                                           "ABCDEFGH1.wav", "abcdefgh", "abc.wav" }));
+}
+
+/* other columns break ties by name in either direction, and a listing change is picked up */
+static void test_columns() {
+    library_directory dir;
+    add(dir, "c.wav", entry_kind::track, 48000 * 3, 300);
+    add(dir, "a.wav", entry_kind::track, 48000 * 1, 300);
+    add(dir, "b.wav", entry_kind::track, 48000 * 3, 100);
+    add(dir, "music", entry_kind::directory);
+
+    track_table table;
+    table.update(dir, track_column::duration, true);
+    CHECK(labels(dir, table) == std::vector<std::string>({ "music/", "a.wav", "b.wav", "c.wav" }));
+
+    table.update(dir, track_column::duration, false);
+    CHECK(labels(dir, table) == std::vector<std::string>({ "music/", "b.wav", "c.wav", "a.wav" }));
+
+    table.update(dir, track_column::size, true);
+    CHECK(labels(dir, table) == std::vector<std::string>({ "music/", "b.wav", "a.wav", "c.wav" }));
+
+    add(dir, "d.wav", entry_kind::track, 0, 200);
+    table.update(dir, track_column::size, true);
+    CHECK(labels(dir, table) == std::vector<std::string>({ "music/", "b.wav", "d.wav", "a.wav", "c.wav" }));
+
+    /* tracks the database has not read yet sort as zero */
+    table.update(dir, track_column::duration, true);
+    CHECK(labels(dir, table) == std::vector<std::string>({ "music/", "d.wav", "a.wav", "b.wav", "c.wav" }));
+}
+
+static bool reference_less(const std::string &a, const std::string &b) {
+    std::string x = a, y = b;
+    for (char &c : x) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    for (char &c : y) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return x != y ? x < y : a < b;
+}
+
+/* a big listing of names drawn from a small alphabet, so long shared prefixes are common */
+static void test_against_reference() {
+    std::mt19937 random(7);
+    library_directory dir;
+
+    for (int i = 0; i < 5000; i++) {
+        std::string name;
+        const int length = 1 + random() % 14;
+        for (int j = 0; j < length; j++) name.push_back("aAbB_"[random() % 5]);
+        add(dir, name + ".wav", entry_kind::track, random() % 10 * 48000, random() % 1000);
+    }
+
+    std::vector<uint32_t> expected(dir.entries.size());
+    for (uint32_t i = 0; i < expected.size(); i++) expected[i] = i;
+
+    std::sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) {
+        const uint64_t x = dir.entries[a].info.frame_count, y = dir.entries[b].info.frame_count;
+        if (x != y) return x > y;
+        return reference_less(dir.label(dir.entries[a]), dir.label(dir.entries[b]));
+    });
+
+    track_table table;
+    table.update(dir, track_column::duration, false);
+
+    /* rows with identical names may come in either order */
+    CHECK(table.order().size() == expected.size());
+    for (size_t i = 0; i < expected.size() && i < table.order().size(); i++) {
+        CHECK(std::string(dir.label(dir.entries[table.order()[i]])) == dir.label(dir.entries[expected[i]]));
+    }
+}
+
+int main() {
+    test_names();
+    test_columns();
+    test_against_reference();
+    return test_result();
+}